@@ -0,0 +1,468 @@
+//FK: Headless console host (eg: for running the emulator on linux servers). Loads a rom (.gb, .gbc or the first rom of a .zip or .gz archive),
+//    runs it uncapped for a number of frames or seconds with scripted input and reports emulated frames per second, cycles per second and the
+//    host time spent per subsystem. Optionally writes the final framebuffer (binary ppm) and the 64KB address space to files.
+//    The subsystem times are measured in a second run of the same frames with the same input, since the timestamps slow down the emulator.
+//    The calibrated cost of the timestamps gets subtracted from the subsystem times (see getGBSubsystemProfileTime()).
+//    Build (from the repository root):
+//      g++ -std=c++11 -O2 -DK15_RELEASE_BUILD -Iheadless headless/k15_headless_gb_emulator.cpp -o k15_headless_gb_emulator
+//      or use the CMakeLists.txt in the repository root
+//    Usage:
+//      k15_headless_gb_emulator <rom file> [-frames <count>] [-seconds <count>] [-input <script file>] [-random-input <seed>]
+//                               [-dump-framebuffer <ppm file>] [-dump-ram <file>] [-no-profile]
+//    Input scripts contain one '<frame index> <buttons>' line per change of the joypad state, buttons are any of
+//    a, b, select, start, right, left, up and down joined by '+' or 'none'. Lines starting with '#' are ignored. Example:
+//      0   none
+//      120 start
+//      125 none
+//      300 right+a
+
+#define K15_BREAK_ON_UNKNOWN_INSTRUCTION    0
+#define K15_BREAK_ON_ILLEGAL_INSTRUCTION    0
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#   include <x86intrin.h>
+#endif
+
+#include "../tools/k15_gb_tool_common.h"
+
+static constexpr uint32_t gbHeadlessDefaultFrameCount   = 3600u;
+static constexpr uint32_t gbHeadlessMaxInputEventCount  = 4096u;
+
+struct HeadlessInputEvent
+{
+    uint32_t                frameIndex;
+    GBEmulatorJoypadState   joypadState;
+};
+
+struct HeadlessInput
+{
+    HeadlessInputEvent  events[ gbHeadlessMaxInputEventCount ];
+    uint32_t            eventCount;
+    uint32_t            randomSeed;
+    bool8_t             useRandomInput;
+};
+
+struct HeadlessSettings
+{
+    const char* pRomFilePath;
+    const char* pInputScriptFilePath;
+    const char* pFrameBufferFilePath;
+    const char* pRamFilePath;
+    uint32_t    frameCount;
+    double      seconds;            //FK: Runs for the given host time instead of frameCount if > 0
+    bool8_t     profileSubsystems;
+};
+
+struct HeadlessRunResult
+{
+    uint32_t    frameCount;
+    uint64_t    cycleCount;
+    double      seconds;
+};
+
+bool8_t writeFile( const char* pFilePath, const void* pData, const size_t dataSizeInBytes, const char* pHeader )
+{
+    FILE* pFile = fopen( pFilePath, "wb" );
+    if( pFile == nullptr )
+    {
+        return 0u;
+    }
+
+    const bool8_t success = ( pHeader == nullptr || fputs( pHeader, pFile ) >= 0 ) && fwrite( pData, 1, dataSizeInBytes, pFile ) == dataSizeInBytes;
+    fclose( pFile );
+    return success;
+}
+
+uint64_t getProfileTimestamp()
+{
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _MSC_VER )
+    return __rdtsc();
+#else
+    return ( uint64_t )std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+//FK: Returns the uncompressed rom (same order as the win32 host: plain rom, zip archive, gzip data)
+uint8_t* loadRom( const char* pRomFilePath )
+{
+    size_t fileSizeInBytes = 0u;
+    uint8_t* pFileData = readFile( pRomFilePath, &fileSizeInBytes );
+    if( pFileData == nullptr )
+    {
+        printf( "Can't read '%s'\n", pRomFilePath );
+        return nullptr;
+    }
+
+    if( isGBRomData( pFileData, fileSizeInBytes ) )
+    {
+        return pFileData;
+    }
+
+    uint8_t* pRomData = ( uint8_t* )malloc( gbMaxRomSizeInBytes );
+    uint32_t romSizeInBytes = 0u;
+    bool8_t foundValidRom = 0u;
+
+    ZipArchive zipArchive;
+    GZipData gzipData;
+    if( openZipArchive( &zipArchive, pFileData, ( uint32_t )fileSizeInBytes ) )
+    {
+        const uint32_t romCount = countRomsInZipArchive( &zipArchive );
+        if( romCount > 0u )
+        {
+            const ZipArchiveEntry romEntry = findFirstRomEntryInZipArchive( &zipArchive );
+            if( romCount > 1u )
+            {
+                printf( "'%s' contains %u roms, using '%.*s'\n", pRomFilePath, romCount, romEntry.fileNameLength, romEntry.pFileName );
+            }
+
+            foundValidRom = uncompressZipArchiveEntry( &zipArchive, &romEntry, pRomData, &romSizeInBytes, gbMaxRomSizeInBytes ) == UncompressResult::Success;
+        }
+    }
+    else if( openGZipData( &gzipData, pFileData, ( uint32_t )fileSizeInBytes ) )
+    {
+        foundValidRom = uncompressGZipData( &gzipData, pRomData, &romSizeInBytes, gbMaxRomSizeInBytes ) == UncompressResult::Success;
+    }
+
+    free( pFileData );
+    if( !foundValidRom || !isGBRomData( pRomData, romSizeInBytes ) )
+    {
+        printf( "'%s' is neither a rom nor a zip or gzip archive containing a rom\n", pRomFilePath );
+        free( pRomData );
+        return nullptr;
+    }
+
+    return pRomData;
+}
+
+bool8_t parseJoypadState( const char* pButtons, GBEmulatorJoypadState* pOutJoypadState )
+{
+    static const char* pButtonNames[] = { "a", "b", "select", "start", "right", "left", "up", "down" };
+
+    GBEmulatorJoypadState joypadState;
+    if( strcmp( pButtons, "none" ) == 0 )
+    {
+        *pOutJoypadState = joypadState;
+        return 1u;
+    }
+
+    while( *pButtons != 0 )
+    {
+        const char* pButtonEnd = strchr( pButtons, '+' );
+        const size_t buttonLength = pButtonEnd == nullptr ? strlen( pButtons ) : ( size_t )( pButtonEnd - pButtons );
+
+        uint32_t buttonIndex = 0u;
+        while( buttonIndex < 8u && ( strlen( pButtonNames[ buttonIndex ] ) != buttonLength || strncmp( pButtons, pButtonNames[ buttonIndex ], buttonLength ) != 0 ) )
+        {
+            ++buttonIndex;
+        }
+
+        if( buttonIndex == 8u )
+        {
+            return 0u;
+        }
+
+        //FK: Action buttons are the low byte, dpad buttons the high byte (see GBEmulatorJoypadState)
+        joypadState.value |= ( uint16_t )( buttonIndex < 4u ? 1u << buttonIndex : 0x100u << ( buttonIndex - 4u ) );
+        pButtons += pButtonEnd == nullptr ? buttonLength : buttonLength + 1u;
+    }
+
+    *pOutJoypadState = joypadState;
+    return 1u;
+}
+
+bool8_t parseInputScript( const char* pInputScriptFilePath, HeadlessInput* pOutInput )
+{
+    FILE* pFile = fopen( pInputScriptFilePath, "r" );
+    if( pFile == nullptr )
+    {
+        printf( "Can't read input script '%s'\n", pInputScriptFilePath );
+        return 0u;
+    }
+
+    char line[ 256 ];
+    uint32_t lineNumber = 0u;
+    bool8_t success = 1u;
+    while( success && fgets( line, sizeof( line ), pFile ) != nullptr )
+    {
+        ++lineNumber;
+
+        char* pLine = line;
+        while( isspace( *pLine ) )
+        {
+            ++pLine;
+        }
+
+        if( *pLine == 0 || *pLine == '#' )
+        {
+            continue;
+        }
+
+        unsigned int frameIndex = 0u;
+        char buttons[ 128 ];
+        HeadlessInputEvent* pEvent = pOutInput->events + pOutInput->eventCount;
+        success = sscanf( pLine, "%u %127s", &frameIndex, buttons ) == 2 && parseJoypadState( buttons, &pEvent->joypadState ) &&
+            pOutInput->eventCount < gbHeadlessMaxInputEventCount && ( pOutInput->eventCount == 0u || frameIndex >= pEvent[ -1 ].frameIndex );
+
+        if( !success )
+        {
+            printf( "Invalid line %u in input script '%s' (expected '<frame index> <buttons>' with increasing frame indices)\n", lineNumber, pInputScriptFilePath );
+            break;
+        }
+
+        pEvent->frameIndex = frameIndex;
+        ++pOutInput->eventCount;
+    }
+
+    fclose( pFile );
+    return success;
+}
+
+GBEmulatorJoypadState getFrameJoypadState( const HeadlessInput* pInput, const uint32_t frameIndex, uint32_t* pInOutEventIndex )
+{
+    if( pInput->useRandomInput )
+    {
+        //FK: Buttons are held for a couple of frames like a player would
+        uint32_t value = ( 0x9E3779B9u + pInput->randomSeed * 0x27D4EB2Fu ) ^ ( frameIndex / 12u ) * 0x85EBCA6Bu;
+        value ^= value >> 15u;
+
+        GBEmulatorJoypadState joypadState;
+        joypadState.value = ( uint16_t )( value & 0x0F0F );
+        return joypadState;
+    }
+
+    uint32_t eventIndex = *pInOutEventIndex;
+    while( eventIndex < pInput->eventCount && pInput->events[ eventIndex ].frameIndex <= frameIndex )
+    {
+        ++eventIndex;
+    }
+
+    *pInOutEventIndex = eventIndex;
+    return eventIndex == 0u ? GBEmulatorJoypadState() : pInput->events[ eventIndex - 1u ].joypadState;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    if( loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        free( pCartridgeRamMemory );
+        free( pInstanceMemory );
+        return nullptr;
+    }
+
+    return pInstance;
+}
+
+void destroyInstance( GBEmulatorInstance* pInstance )
+{
+    free( pInstance->cartridge.pRamBaseAddress );
+    free( pInstance );
+}
+
+//FK: frameCount is ignored if seconds is > 0
+HeadlessRunResult runFrames( GBEmulatorInstance* pInstance, const HeadlessInput* pInput, const uint32_t frameCount, const double seconds )
+{
+    HeadlessRunResult result;
+    result.frameCount = 0u;
+
+    uint32_t eventIndex = 0u;
+    const uint64_t startCycle = getGBEmulatorCycleCount( pInstance );
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    while( seconds > 0.0 ? getElapsedSeconds( startTime ) < seconds : result.frameCount < frameCount )
+    {
+        setGBEmulatorJoypadState( pInstance, getFrameJoypadState( pInput, result.frameCount, &eventIndex ) );
+        runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+        ++result.frameCount;
+    }
+
+    result.seconds      = getElapsedSeconds( startTime );
+    result.cycleCount   = getGBEmulatorCycleCount( pInstance ) - startCycle;
+    return result;
+}
+
+void printSubsystemProfile( const uint8_t* pRomData, const HeadlessInput* pInput, const uint32_t frameCount )
+{
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+
+    GBSubsystemProfile profile;
+    memset( &profile, 0, sizeof( profile ) );
+    profile.pGetTimestamp = getProfileTimestamp;
+    setGBEmulatorSubsystemProfile( pInstance, &profile );
+
+    const uint64_t startTimestamp = getProfileTimestamp();
+    const HeadlessRunResult result = runFrames( pInstance, pInput, frameCount, 0.0 );
+    const double secondsPerTimestamp = result.seconds / ( double )( getProfileTimestamp() - startTimestamp );
+
+    //FK: The shares are relative to the time of all subsystems without the timestamps
+    uint64_t subsystemTimes[ K15_GB_SUBSYSTEM_COUNT ];
+    uint64_t totalSubsystemTime = 0u;
+    for( uint32_t subsystemIndex = 0u; subsystemIndex < K15_GB_SUBSYSTEM_COUNT; ++subsystemIndex )
+    {
+        subsystemTimes[ subsystemIndex ] = getGBSubsystemProfileTime( &profile, ( GBSubsystem )subsystemIndex );
+        totalSubsystemTime += subsystemTimes[ subsystemIndex ];
+    }
+
+    printf( "subsystems:  (profiled run, %.2f s including the timestamps, %.1f ns per timestamp subtracted)\n", result.seconds,
+        ( double )profile.timestampOverhead * secondsPerTimestamp * 1e9 );
+    for( uint32_t subsystemIndex = 0u; subsystemIndex < K15_GB_SUBSYSTEM_COUNT; ++subsystemIndex )
+    {
+        const double subsystemSeconds = ( double )subsystemTimes[ subsystemIndex ] * secondsPerTimestamp;
+        printf( "  %-8s   %8.3f s  %5.1f %%  %7.1f ns per instruction\n", getGBSubsystemName( ( GBSubsystem )subsystemIndex ), subsystemSeconds,
+            totalSubsystemTime > 0u ? ( double )subsystemTimes[ subsystemIndex ] / ( double )totalSubsystemTime * 100.0 : 0.0,
+            subsystemSeconds * 1e9 / ( double )profile.instructionCount );
+    }
+
+    setGBEmulatorSubsystemProfile( pInstance, nullptr );
+    destroyInstance( pInstance );
+}
+
+bool8_t dumpFrameBuffer( GBEmulatorInstance* pInstance, const char* pFrameBufferFilePath )
+{
+    static uint8_t rgbFrameBuffer[ gbHorizontalResolutionInPixels * gbVerticalResolutionInPixels * 3 ];
+    convertGBFrameBufferToRGB8Buffer( rgbFrameBuffer, getGBEmulatorFrameBuffer( pInstance ) );
+
+    char header[ 64 ];
+    snprintf( header, sizeof( header ), "P6\n%u %u\n255\n", ( uint32_t )gbHorizontalResolutionInPixels, ( uint32_t )gbVerticalResolutionInPixels );
+    return writeFile( pFrameBufferFilePath, rgbFrameBuffer, sizeof( rgbFrameBuffer ), header );
+}
+
+//FK: The address space as the cpu sees it, so addresses can be used as file offsets
+bool8_t dumpRam( GBEmulatorInstance* pInstance, const char* pRamFilePath )
+{
+    static uint8_t addressSpace[ 0x10000 ];
+    for( uint32_t address = 0u; address < sizeof( addressSpace ); ++address )
+    {
+        addressSpace[ address ] = getMappedMemoryValue( &pInstance->memoryMapper, ( uint16_t )address );
+    }
+
+    return writeFile( pRamFilePath, addressSpace, sizeof( addressSpace ), nullptr );
+}
+
+bool8_t parseArguments( int argc, char** argv, HeadlessSettings* pOutSettings, HeadlessInput* pOutInput )
+{
+    pOutSettings->pRomFilePath          = argv[ 1 ];
+    pOutSettings->pInputScriptFilePath  = nullptr;
+    pOutSettings->pFrameBufferFilePath  = nullptr;
+    pOutSettings->pRamFilePath          = nullptr;
+    pOutSettings->frameCount            = gbHeadlessDefaultFrameCount;
+    pOutSettings->seconds               = 0.0;
+    pOutSettings->profileSubsystems     = 1u;
+
+    for( int argIndex = 2; argIndex < argc; ++argIndex )
+    {
+        const char* pArgument = argv[ argIndex ];
+        const char* pValue = argIndex + 1 < argc ? argv[ argIndex + 1 ] : nullptr;
+        if( strcmp( pArgument, "-no-profile" ) == 0 )
+        {
+            pOutSettings->profileSubsystems = 0u;
+            continue;
+        }
+
+        if( pValue == nullptr )
+        {
+            printf( "Missing value for '%s'\n", pArgument );
+            return 0u;
+        }
+
+        ++argIndex;
+        if( strcmp( pArgument, "-frames" ) == 0 )
+        {
+            pOutSettings->frameCount = ( uint32_t )strtoul( pValue, nullptr, 10 );
+        }
+        else if( strcmp( pArgument, "-seconds" ) == 0 )
+        {
+            pOutSettings->seconds = atof( pValue );
+        }
+        else if( strcmp( pArgument, "-input" ) == 0 )
+        {
+            pOutSettings->pInputScriptFilePath = pValue;
+        }
+        else if( strcmp( pArgument, "-random-input" ) == 0 )
+        {
+            pOutInput->useRandomInput   = 1u;
+            pOutInput->randomSeed       = ( uint32_t )strtoul( pValue, nullptr, 10 );
+        }
+        else if( strcmp( pArgument, "-dump-framebuffer" ) == 0 )
+        {
+            pOutSettings->pFrameBufferFilePath = pValue;
+        }
+        else if( strcmp( pArgument, "-dump-ram" ) == 0 )
+        {
+            pOutSettings->pRamFilePath = pValue;
+        }
+        else
+        {
+            printf( "Unknown argument '%s'\n", pArgument );
+            return 0u;
+        }
+    }
+
+    return pOutSettings->pInputScriptFilePath == nullptr || parseInputScript( pOutSettings->pInputScriptFilePath, pOutInput );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [-frames <count>] [-seconds <count>] [-input <script file>] [-random-input <seed>]\n"
+                "       [-dump-framebuffer <ppm file>] [-dump-ram <file>] [-no-profile]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    static HeadlessInput input;
+    HeadlessSettings settings;
+    if( !parseArguments( argc, argv, &settings, &input ) )
+    {
+        return 1;
+    }
+
+    uint8_t* pRomData = loadRom( settings.pRomFilePath );
+    if( pRomData == nullptr )
+    {
+        return 1;
+    }
+
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+    if( pInstance == nullptr )
+    {
+        printf( "Can't map the cartridge of '%s'\n", settings.pRomFilePath );
+        free( pRomData );
+        return 1;
+    }
+
+    const GBRomHeader romHeader = getGBRomHeader( pRomData );
+    printf( "rom:         %.16s (%s)\n", ( const char* )romHeader.gameTitle, settings.pRomFilePath );
+
+    const HeadlessRunResult result = runFrames( pInstance, &input, settings.frameCount, settings.seconds );
+    const double emulatedSeconds = ( double )result.cycleCount / ( double )gbCyclesPerSecond;
+    printf( "frames:      %u in %.3f s (%.3f s emulated)\n", result.frameCount, result.seconds, emulatedSeconds );
+    printf( "throughput:  %.1f frames/s, %.2f M cycles/s, %.1fx realtime\n", ( double )result.frameCount / result.seconds,
+        ( double )result.cycleCount / result.seconds / 1e6, emulatedSeconds / result.seconds );
+
+    bool8_t success = 1u;
+    if( settings.pFrameBufferFilePath != nullptr )
+    {
+        success &= dumpFrameBuffer( pInstance, settings.pFrameBufferFilePath );
+    }
+
+    if( settings.pRamFilePath != nullptr )
+    {
+        success &= dumpRam( pInstance, settings.pRamFilePath );
+    }
+
+    if( !success )
+    {
+        printf( "Can't write the framebuffer or ram dump\n" );
+    }
+
+    if( settings.profileSubsystems )
+    {
+        printSubsystemProfile( pRomData, &input, result.frameCount );
+    }
+
+    destroyInstance( pInstance );
+    free( pRomData );
+    return success ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_BATCH_RUNNER
+#define K15_GB_BATCH_RUNNER
+
+//FK: Runs a batch of emulator instances on a pool of worker threads (one thread per core).
+//    Each worker owns a contiguous range of instances whose memory gets initialized by the worker itself,
+//    so the memory ends up close to the core that runs the instances (first touch) and no two workers share a cache line.
+//    Workers that run out of instances steal instances from the ranges of other workers.
+
+#include <new>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+//FK: windows.h declares a DebugBreak() function which collides with the DebugBreak macro of k15_types.h
+#   pragma push_macro( "DebugBreak" )
+#   undef DebugBreak
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h>
+#   pragma pop_macro( "DebugBreak" )
+#else
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+static constexpr size_t     gbBatchRunnerCacheLineSizeInBytes   = 64u;
+static constexpr size_t     gbBatchRunnerInstanceAlignment      = Kbyte( 4 ); //FK: Page align the instances so that every instance is first touched by its own worker
+static constexpr uint32_t   gbBatchRunnerMaxWorkerCount         = 256u;
+
+struct alignas( gbBatchRunnerCacheLineSizeInBytes ) GBBatchRunnerWorker
+{
+    std::atomic<uint32_t>   nextInstanceIndex;  //FK: Advanced by the owning worker and by stealing workers
+    uint32_t                firstInstanceIndex;
+    uint32_t                endInstanceIndex;
+    uint32_t                workerIndex;
+    uint64_t                executedInstanceCount;
+    uint64_t                stolenInstanceCount;
+    uint64_t                skippedLagFrameCount;
+};
+
+struct GBBatchRunnerStats
+{
+    uint64_t    executedInstanceCount;
+    uint64_t    stolenInstanceCount;       //FK: Instances that were run by a worker different from their owner
+    uint64_t    skippedLagFrameCount;      //FK: Frames that were run in addition to the cycle budgets (see setGBBatchRunnerMaxLagFrameSkipCount())
+    uint32_t    workerCount;
+    uint32_t    instanceCount;
+};
+
+struct GBBatchRunner
+{
+    GBBatchRunnerWorker*            pWorkers;
+    std::thread*                    pThreads;
+    uint8_t*                        pInstanceMemory;
+    GBEmulatorInstance**            ppInstances;
+
+    const uint32_t*                 pCycleBudgets;      //FK: Only valid while a batch is running
+    GBEmulatorInstanceEventMask*    pEventMasks;
+
+    std::mutex                      mutex;
+    std::condition_variable         batchStarted;
+    std::condition_variable         batchFinished;
+    uint32_t                        batchIndex;
+    uint32_t                        finishedWorkerCount;
+    uint32_t                        maxLagFrameSkipCount;
+    bool8_t                         shutdown;
+
+    size_t                          instanceStrideInBytes;
+    uint32_t                        workerCount;
+    uint32_t                        instanceCount;
+};
+
+size_t calculateGBBatchRunnerInstanceStrideInBytes()
+{
+    return ( calculateGBEmulatorMemoryRequirementsInBytes() + gbBatchRunnerInstanceAlignment - 1u ) & ~( gbBatchRunnerInstanceAlignment - 1u );
+}
+
+size_t calculateGBBatchRunnerMemoryRequirementsInBytes( const uint32_t workerCount, const uint32_t instanceCount )
+{
+    return sizeof( GBBatchRunner ) + gbBatchRunnerCacheLineSizeInBytes + workerCount * ( sizeof( GBBatchRunnerWorker ) + sizeof( std::thread ) ) +
+        instanceCount * sizeof( GBEmulatorInstance* ) + gbBatchRunnerInstanceAlignment + instanceCount * calculateGBBatchRunnerInstanceStrideInBytes();
+}
+
+uint32_t getGBBatchRunnerDefaultWorkerCount()
+{
+    const uint32_t coreCount = ( uint32_t )std::thread::hardware_concurrency();
+    return coreCount > 0u ? GetMin( coreCount, gbBatchRunnerMaxWorkerCount ) : 1u;
+}
+
+//FK: Pins the calling thread. Best effort, the worker still runs if the thread couldn't be pinned
+void pinGBBatchRunnerThreadToCore( const uint32_t coreIndex )
+{
+#ifdef _WIN32
+    SetThreadAffinityMask( GetCurrentThread(), ( DWORD_PTR )1u << ( coreIndex % ( sizeof( DWORD_PTR ) * 8u ) ) );
+#elif defined( __linux__ )
+    cpu_set_t cpuSet;
+    CPU_ZERO( &cpuSet );
+    CPU_SET( coreIndex % CPU_SETSIZE, &cpuSet );
+    pthread_setaffinity_np( pthread_self(), sizeof( cpuSet ), &cpuSet );
+#else
+    K15_UNUSED_VAR( coreIndex );
+#endif
+}
+
+//FK: Claims the next instance of the given worker's range, returns false if the range is exhausted
+bool8_t claimGBBatchRunnerInstance( GBBatchRunnerWorker* pWorker, uint32_t* pOutInstanceIndex )
+{
+    if( pWorker->nextInstanceIndex.load( std::memory_order_relaxed ) >= pWorker->endInstanceIndex )
+    {
+        return 0u;
+    }
+
+    const uint32_t instanceIndex = pWorker->nextInstanceIndex.fetch_add( 1u, std::memory_order_relaxed );
+    *pOutInstanceIndex = instanceIndex;
+    return instanceIndex < pWorker->endInstanceIndex;
+}
+
+//FK: Returns the number of lag frames that got run in addition to the cycle budget
+uint32_t runGBBatchRunnerInstance( GBBatchRunner* pBatchRunner, const uint32_t instanceIndex )
+{
+    GBEmulatorInstance* pInstance = pBatchRunner->ppInstances[ instanceIndex ];
+    uint32_t cycleBudget = pBatchRunner->pCycleBudgets[ instanceIndex ];
+
+    //FK: Run frame by frame so that no vblank gets lost when the budget spans multiple frames
+    GBEmulatorInstanceEventMask eventMask = K15_GB_NO_EVENT_FLAG;
+    GBEmulatorInstanceEventMask frameEventMask = K15_GB_NO_EVENT_FLAG;
+    while( cycleBudget > 0u )
+    {
+        const uint32_t cycleCount = GetMin( cycleBudget, gbCyclesPerFrame );
+        frameEventMask = runGBEmulatorForCycles( pInstance, cycleCount );
+        eventMask |= frameEventMask;
+        cycleBudget -= cycleCount;
+    }
+
+    //FK: Keep running while the last frame finished as a lag frame, so the next batch starts right after a frame that reacts to input
+    uint32_t skippedLagFrameCount = 0u;
+    while( skippedLagFrameCount < pBatchRunner->maxLagFrameSkipCount && ( frameEventMask & K15_GB_LAG_FRAME_EVENT_FLAG ) != 0u )
+    {
+        frameEventMask = runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+        eventMask |= frameEventMask;
+        ++skippedLagFrameCount;
+    }
+
+    pBatchRunner->pEventMasks[ instanceIndex ] = eventMask;
+    return skippedLagFrameCount;
+}
+
+void runGBBatchRunnerWorkerBatch( GBBatchRunner* pBatchRunner, GBBatchRunnerWorker* pWorker )
+{
+    uint32_t instanceIndex = 0u;
+    while( claimGBBatchRunnerInstance( pWorker, &instanceIndex ) )
+    {
+        pWorker->skippedLagFrameCount += runGBBatchRunnerInstance( pBatchRunner, instanceIndex );
+        ++pWorker->executedInstanceCount;
+    }
+
+    //FK: Own range is done, steal from the other workers starting with the next one
+    for( uint32_t victimOffset = 1u; victimOffset < pBatchRunner->workerCount; ++victimOffset )
+    {
+        GBBatchRunnerWorker* pVictim = pBatchRunner->pWorkers + ( pWorker->workerIndex + victimOffset ) % pBatchRunner->workerCount;
+        while( claimGBBatchRunnerInstance( pVictim, &instanceIndex ) )
+        {
+            pWorker->skippedLagFrameCount += runGBBatchRunnerInstance( pBatchRunner, instanceIndex );
+            ++pWorker->executedInstanceCount;
+            ++pWorker->stolenInstanceCount;
+        }
+    }
+}
+
+void runGBBatchRunnerWorker( GBBatchRunner* pBatchRunner, GBBatchRunnerWorker* pWorker )
+{
+    //FK: Pin before touching the instance memory, otherwise the first touch happens on whatever core the thread started on
+    pinGBBatchRunnerThreadToCore( pWorker->workerIndex );
+
+    //FK: Initialize the instances of this worker on this thread (see comment at the top)
+    for( uint32_t instanceIndex = pWorker->firstInstanceIndex; instanceIndex < pWorker->endInstanceIndex; ++instanceIndex )
+    {
+        uint8_t* pInstanceMemory = pBatchRunner->pInstanceMemory + instanceIndex * pBatchRunner->instanceStrideInBytes;
+        memset( pInstanceMemory, 0, pBatchRunner->instanceStrideInBytes );
+        pBatchRunner->ppInstances[ instanceIndex ] = createGBEmulatorInstance( pInstanceMemory );
+    }
+
+    uint32_t batchIndex = 0u;
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock( pBatchRunner->mutex );
+            if( ++pBatchRunner->finishedWorkerCount == pBatchRunner->workerCount )
+            {
+                pBatchRunner->batchFinished.notify_one();
+            }
+
+            pBatchRunner->batchStarted.wait( lock, [ pBatchRunner, batchIndex ] { return pBatchRunner->shutdown || pBatchRunner->batchIndex != batchIndex; } );
+            if( pBatchRunner->shutdown )
+            {
+                return;
+            }
+
+            batchIndex = pBatchRunner->batchIndex;
+        }
+
+        runGBBatchRunnerWorkerBatch( pBatchRunner, pWorker );
+    }
+}
+
+//FK: Spawns workerCount worker threads (use getGBBatchRunnerDefaultWorkerCount() for one worker per core) and creates instanceCount emulator instances.
+//    Returns once all instances have been created, load the roms using getGBBatchRunnerInstance() afterwards.
+GBBatchRunner* createGBBatchRunner( uint8_t* pBatchRunnerMemory, const uint32_t workerCount, const uint32_t instanceCount )
+{
+    RuntimeAssert( workerCount > 0u && workerCount <= gbBatchRunnerMaxWorkerCount );
+
+    GBBatchRunner* pBatchRunner = new( pBatchRunnerMemory ) GBBatchRunner();
+    pBatchRunner->workerCount           = workerCount;
+    pBatchRunner->instanceCount         = instanceCount;
+    pBatchRunner->instanceStrideInBytes = calculateGBBatchRunnerInstanceStrideInBytes();
+    pBatchRunner->batchIndex            = 0u;
+    pBatchRunner->finishedWorkerCount   = 0u;
+    pBatchRunner->maxLagFrameSkipCount  = 0u;
+    pBatchRunner->shutdown              = 0u;
+    pBatchRunner->pCycleBudgets         = nullptr;
+    pBatchRunner->pEventMasks           = nullptr;
+
+    const size_t workerOffset = ( ( size_t )( pBatchRunnerMemory + sizeof( GBBatchRunner ) ) + gbBatchRunnerCacheLineSizeInBytes - 1u ) & ~( gbBatchRunnerCacheLineSizeInBytes - 1u );
+    pBatchRunner->pWorkers      = ( GBBatchRunnerWorker* )workerOffset;
+    pBatchRunner->pThreads      = ( std::thread* )( pBatchRunner->pWorkers + workerCount );
+    pBatchRunner->ppInstances   = ( GBEmulatorInstance** )( pBatchRunner->pThreads + workerCount );
+
+    const size_t instanceOffset = ( ( size_t )( pBatchRunner->ppInstances + instanceCount ) + gbBatchRunnerInstanceAlignment - 1u ) & ~( gbBatchRunnerInstanceAlignment - 1u );
+    pBatchRunner->pInstanceMemory = ( uint8_t* )instanceOffset;
+
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        GBBatchRunnerWorker* pWorker = new( pBatchRunner->pWorkers + workerIndex ) GBBatchRunnerWorker();
+        pWorker->workerIndex            = workerIndex;
+        pWorker->firstInstanceIndex     = ( uint32_t )( ( uint64_t )instanceCount * workerIndex / workerCount );
+        pWorker->endInstanceIndex       = ( uint32_t )( ( uint64_t )instanceCount * ( workerIndex + 1u ) / workerCount );
+        pWorker->executedInstanceCount  = 0u;
+        pWorker->stolenInstanceCount    = 0u;
+        pWorker->skippedLagFrameCount   = 0u;
+        pWorker->nextInstanceIndex.store( pWorker->endInstanceIndex );
+    }
+
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        new( pBatchRunner->pThreads + workerIndex ) std::thread( runGBBatchRunnerWorker, pBatchRunner, pBatchRunner->pWorkers + workerIndex );
+    }
+
+    std::unique_lock<std::mutex> lock( pBatchRunner->mutex );
+    pBatchRunner->batchFinished.wait( lock, [ pBatchRunner ] { return pBatchRunner->finishedWorkerCount == pBatchRunner->workerCount; } );
+    return pBatchRunner;
+}
+
+GBEmulatorInstance* getGBBatchRunnerInstance( GBBatchRunner* pBatchRunner, const uint32_t instanceIndex )
+{
+    RuntimeAssert( instanceIndex < pBatchRunner->instanceCount );
+    return pBatchRunner->ppInstances[ instanceIndex ];
+}
+
+//FK: Instances whose last frame of a batch finished a lag frame (K15_GB_LAG_FRAME_EVENT_FLAG, LY reached 144 without a JOYP access)
+//    run up to maxLagFrameSkipCount additional frames within the same batch, until a frame finishes in which the game polled the joypad.
+//    0 (the default) runs exactly the cycle budgets.
+//    Must not be called while a batch is running.
+void setGBBatchRunnerMaxLagFrameSkipCount( GBBatchRunner* pBatchRunner, const uint32_t maxLagFrameSkipCount )
+{
+    pBatchRunner->maxLagFrameSkipCount = maxLagFrameSkipCount;
+}
+
+//FK: Runs every instance for pCycleBudgets[ instanceIndex ] cycles (use gbCyclesPerFrame * frameCount for frame budgets) and blocks until all instances are done.
+//    pOutEventMasks[ instanceIndex ] receives all events of the instance that got raised during the batch (eg: K15_GB_VBLANK_EVENT_FLAG).
+//    Must not be called concurrently for the same batch runner.
+void runGBBatch( GBBatchRunner* pBatchRunner, const uint32_t* pCycleBudgets, GBEmulatorInstanceEventMask* pOutEventMasks )
+{
+    std::unique_lock<std::mutex> lock( pBatchRunner->mutex );
+    pBatchRunner->pCycleBudgets = pCycleBudgets;
+    pBatchRunner->pEventMasks   = pOutEventMasks;
+
+    for( uint32_t workerIndex = 0u; workerIndex < pBatchRunner->workerCount; ++workerIndex )
+    {
+        GBBatchRunnerWorker* pWorker = pBatchRunner->pWorkers + workerIndex;
+        pWorker->nextInstanceIndex.store( pWorker->firstInstanceIndex, std::memory_order_relaxed );
+    }
+
+    pBatchRunner->finishedWorkerCount = 0u;
+    ++pBatchRunner->batchIndex;
+    pBatchRunner->batchStarted.notify_all();
+    pBatchRunner->batchFinished.wait( lock, [ pBatchRunner ] { return pBatchRunner->finishedWorkerCount == pBatchRunner->workerCount; } );
+
+    pBatchRunner->pCycleBudgets = nullptr;
+    pBatchRunner->pEventMasks   = nullptr;
+}
+
+GBBatchRunnerStats getGBBatchRunnerStats( const GBBatchRunner* pBatchRunner )
+{
+    GBBatchRunnerStats stats;
+    stats.workerCount           = pBatchRunner->workerCount;
+    stats.instanceCount         = pBatchRunner->instanceCount;
+    stats.executedInstanceCount = 0u;
+    stats.stolenInstanceCount   = 0u;
+    stats.skippedLagFrameCount  = 0u;
+
+    for( uint32_t workerIndex = 0u; workerIndex < pBatchRunner->workerCount; ++workerIndex )
+    {
+        stats.executedInstanceCount += pBatchRunner->pWorkers[ workerIndex ].executedInstanceCount;
+        stats.stolenInstanceCount   += pBatchRunner->pWorkers[ workerIndex ].stolenInstanceCount;
+        stats.skippedLagFrameCount  += pBatchRunner->pWorkers[ workerIndex ].skippedLagFrameCount;
+    }
+
+    return stats;
+}
+
+//FK: Joins the worker threads, the instances are invalid afterwards
+void destroyGBBatchRunner( GBBatchRunner* pBatchRunner )
+{
+    {
+        std::unique_lock<std::mutex> lock( pBatchRunner->mutex );
+        pBatchRunner->shutdown = 1u;
+        pBatchRunner->batchStarted.notify_all();
+    }
+
+    for( uint32_t workerIndex = 0u; workerIndex < pBatchRunner->workerCount; ++workerIndex )
+    {
+        pBatchRunner->pThreads[ workerIndex ].join();
+        pBatchRunner->pThreads[ workerIndex ].~thread();
+        pBatchRunner->pWorkers[ workerIndex ].~GBBatchRunnerWorker();
+    }
+
+    pBatchRunner->~GBBatchRunner();
+}
+
+#endif //K15_GB_BATCH_RUNNER
@@ -0,0 +1,237 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_DIFFERENTIAL
+#define K15_GB_DIFFERENTIAL
+
+//FK: Differential runner to catch timing bugs of optimized execution paths.
+//    Two instances run the same rom with the same input: the reference instance one instruction at a time using runSingleInstruction() and the
+//    optimized instance using a run function (eg: runGBEmulatorForCycles() or a future scheduler/JIT). After every compare interval the reference
+//    catches up to the cycle count of the optimized instance and both get compared (state hash, cycle counters and optionally the framebuffers).
+//    The first mismatch is returned with a diff of the cpu state and of the mapped memory.
+
+static constexpr uint32_t gbDifferentialMaxMemoryDiffCount = 16u;
+
+//FK: Runs at least cycleCount cycles (instructions aren't split), returns the number of cycles that actually ran
+typedef uint32_t ( *GBDifferentialRunFunction )( GBEmulatorInstance* pInstance, const uint32_t cycleCount, void* pUserData );
+
+struct GBDifferentialMemoryDiff
+{
+    uint16_t    address;
+    uint8_t     referenceValue;
+    uint8_t     optimizedValue;
+};
+
+struct GBDifferentialMismatch
+{
+    uint64_t                    referenceCycle;         //FK: See getGBEmulatorCycleCount()
+    uint64_t                    optimizedCycle;
+    uint32_t                    regionMask;             //FK: One bit per differing GBStateHashRegion
+    uint32_t                    memoryDiffCount;        //FK: Differing bytes of the mapped memory, only the first gbDifferentialMaxMemoryDiffCount are in memoryDiffs
+    uint32_t                    cartridgeRamDiffCount;
+    uint32_t                    firstCartridgeRamDiffOffset;
+    uint16_t                    lastReferencePC;        //FK: PC of the last instruction the reference ran
+    bool8_t                     frameBufferDiffers;
+    GBCpuState                  referenceCpuState;
+    GBCpuState                  optimizedCpuState;
+    GBDifferentialMemoryDiff    memoryDiffs[ gbDifferentialMaxMemoryDiffCount ];
+};
+
+struct GBDifferentialStats
+{
+    uint64_t    comparisonCount;
+    uint64_t    referenceInstructionCount;
+    uint64_t    cycleCount;
+};
+
+struct GBDifferentialRunner
+{
+    GBEmulatorInstance*         pReferenceInstance;
+    GBEmulatorInstance*         pOptimizedInstance;
+    GBDifferentialRunFunction   pRunFunction;
+    void*                       pUserData;
+    GBDifferentialStats         stats;
+    uint32_t                    compareIntervalInCycles;
+    bool8_t                     compareFrameBuffers;
+};
+
+//FK: The optimized paths of the emulator itself
+uint32_t runGBDifferentialForCycles( GBEmulatorInstance* pInstance, const uint32_t cycleCount, void* pUserData )
+{
+    K15_UNUSED_VAR( pUserData );
+
+    const uint64_t startCycle = getGBEmulatorCycleCount( pInstance );
+    runGBEmulatorForCycles( pInstance, cycleCount );
+    return ( uint32_t )( getGBEmulatorCycleCount( pInstance ) - startCycle );
+}
+
+//FK: Stops at every condition runGBEmulatorUntil() supports, so its early outs are exercised as well
+uint32_t runGBDifferentialUntil( GBEmulatorInstance* pInstance, const uint32_t cycleCount, void* pUserData )
+{
+    K15_UNUSED_VAR( pUserData );
+
+    const GBEmulatorStopMask stopMask = K15_GB_STOP_AT_VBLANK | K15_GB_STOP_AT_LINE | K15_GB_STOP_AT_SERIAL_BYTE | K15_GB_STOP_AT_JOYPAD_READ | K15_GB_STOP_AT_ADDRESS;
+
+    uint32_t cyclesRun = 0u;
+    while( cyclesRun < cycleCount )
+    {
+        cyclesRun += runGBEmulatorUntil( pInstance, stopMask, cycleCount - cyclesRun ).cycleCount;
+    }
+
+    return cyclesRun;
+}
+
+//FK: Rendering must not have any influence on the emulated state (see setGBEmulatorRenderingEnabled())
+uint32_t runGBDifferentialWithoutRendering( GBEmulatorInstance* pInstance, const uint32_t cycleCount, void* pUserData )
+{
+    setGBEmulatorRenderingEnabled( pInstance, 0u );
+    const uint32_t cyclesRun = runGBDifferentialForCycles( pInstance, cycleCount, pUserData );
+    setGBEmulatorRenderingEnabled( pInstance, 1u );
+    return cyclesRun;
+}
+
+size_t calculateGBDifferentialRunnerMemoryRequirementsInBytes()
+{
+    return sizeof( GBDifferentialRunner );
+}
+
+//FK: Both instances need to have the same rom loaded (with their own cartridge ram) and need to be in the same state.
+//    A compare interval of 1 cycle compares after every instruction. Only compare the framebuffers if the run function renders.
+GBDifferentialRunner* createGBDifferentialRunner( uint8_t* pRunnerMemory, GBEmulatorInstance* pReferenceInstance, GBEmulatorInstance* pOptimizedInstance,
+    GBDifferentialRunFunction pRunFunction, void* pUserData, const uint32_t compareIntervalInCycles, const bool8_t compareFrameBuffers )
+{
+    RuntimeAssert( pReferenceInstance != pOptimizedInstance );
+    RuntimeAssert( pRunFunction != nullptr );
+    RuntimeAssert( compareIntervalInCycles > 0u );
+
+    GBDifferentialRunner* pRunner = ( GBDifferentialRunner* )pRunnerMemory;
+    memset( pRunner, 0, sizeof( GBDifferentialRunner ) );
+
+    pRunner->pReferenceInstance         = pReferenceInstance;
+    pRunner->pOptimizedInstance         = pOptimizedInstance;
+    pRunner->pRunFunction               = pRunFunction;
+    pRunner->pUserData                  = pUserData;
+    pRunner->compareIntervalInCycles    = compareIntervalInCycles;
+    pRunner->compareFrameBuffers        = compareFrameBuffers;
+    return pRunner;
+}
+
+void fillGBDifferentialMemoryDiff( GBDifferentialMismatch* pMismatch, const GBEmulatorInstance* pReferenceInstance, const GBEmulatorInstance* pOptimizedInstance )
+{
+    const uint8_t* pReferenceMemory = pReferenceInstance->memoryMapper.memory;
+    const uint8_t* pOptimizedMemory = pOptimizedInstance->memoryMapper.memory;
+    for( size_t memoryOffset = 0u; memoryOffset < gbMappedMemorySizeInBytes; ++memoryOffset )
+    {
+        if( pReferenceMemory[ memoryOffset ] == pOptimizedMemory[ memoryOffset ] )
+        {
+            continue;
+        }
+
+        if( pMismatch->memoryDiffCount < gbDifferentialMaxMemoryDiffCount )
+        {
+            //FK: See gbVideoRamMemoryOffset etc.
+            uint16_t address = ( uint16_t )( 0xFE00 + memoryOffset - gbHighMemoryOffset );
+            address = memoryOffset < gbHighMemoryOffset ? ( uint16_t )( 0xC000 + memoryOffset - gbWorkRamMemoryOffset ) : address;
+            address = memoryOffset < gbWorkRamMemoryOffset ? ( uint16_t )( 0x8000 + memoryOffset - gbVideoRamMemoryOffset ) : address;
+
+            GBDifferentialMemoryDiff* pMemoryDiff = pMismatch->memoryDiffs + pMismatch->memoryDiffCount;
+            pMemoryDiff->address        = address;
+            pMemoryDiff->referenceValue = pReferenceMemory[ memoryOffset ];
+            pMemoryDiff->optimizedValue = pOptimizedMemory[ memoryOffset ];
+        }
+
+        ++pMismatch->memoryDiffCount;
+    }
+
+    const GBCartridge* pReferenceCartridge = &pReferenceInstance->cartridge;
+    const GBCartridge* pOptimizedCartridge = &pOptimizedInstance->cartridge;
+    for( uint32_t ramOffset = 0u; ramOffset < pReferenceCartridge->ramSizeInBytes; ++ramOffset )
+    {
+        if( pReferenceCartridge->pRamBaseAddress[ ramOffset ] != pOptimizedCartridge->pRamBaseAddress[ ramOffset ] )
+        {
+            pMismatch->firstCartridgeRamDiffOffset = pMismatch->cartridgeRamDiffCount == 0u ? ramOffset : pMismatch->firstCartridgeRamDiffOffset;
+            ++pMismatch->cartridgeRamDiffCount;
+        }
+    }
+}
+
+//FK: Returns 0 and fills pOutMismatch if the instances differ
+bool8_t compareGBDifferentialInstances( GBDifferentialRunner* pRunner, const uint16_t lastReferencePC, GBDifferentialMismatch* pOutMismatch )
+{
+    GBEmulatorInstance* pReferenceInstance = pRunner->pReferenceInstance;
+    GBEmulatorInstance* pOptimizedInstance = pRunner->pOptimizedInstance;
+    ++pRunner->stats.comparisonCount;
+
+    //FK: The cpu state chunk of the state hash contains the cycle counters as well
+    GBStateHash referenceStateHash;
+    GBStateHash optimizedStateHash;
+    calculateGBEmulatorStateHash( pReferenceInstance, &referenceStateHash );
+    calculateGBEmulatorStateHash( pOptimizedInstance, &optimizedStateHash );
+
+    const bool8_t frameBufferDiffers = pRunner->compareFrameBuffers &&
+        memcmp( getGBEmulatorFrameBuffer( pReferenceInstance ), getGBEmulatorFrameBuffer( pOptimizedInstance ), gbFrameBufferSizeInBytes ) != 0;
+    if( referenceStateHash.hash == optimizedStateHash.hash && !frameBufferDiffers )
+    {
+        return 1u;
+    }
+
+    memset( pOutMismatch, 0, sizeof( GBDifferentialMismatch ) );
+    pOutMismatch->referenceCycle        = getGBEmulatorCycleCount( pReferenceInstance );
+    pOutMismatch->optimizedCycle        = getGBEmulatorCycleCount( pOptimizedInstance );
+    pOutMismatch->lastReferencePC       = lastReferencePC;
+    pOutMismatch->frameBufferDiffers    = frameBufferDiffers;
+    pOutMismatch->referenceCpuState     = pReferenceInstance->cpuState;
+    pOutMismatch->optimizedCpuState     = pOptimizedInstance->cpuState;
+
+    for( uint32_t regionIndex = 0u; regionIndex < K15_GB_STATE_HASH_REGION_COUNT; ++regionIndex )
+    {
+        pOutMismatch->regionMask |= referenceStateHash.regionHashes[ regionIndex ] != optimizedStateHash.regionHashes[ regionIndex ] ? 1u << regionIndex : 0u;
+    }
+
+    fillGBDifferentialMemoryDiff( pOutMismatch, pReferenceInstance, pOptimizedInstance );
+    return 0u;
+}
+
+//FK: Runs both instances for at least cycleCount cycles with the same joypad state (eg: a frame per call).
+//    Returns 0 at the first mismatch, the instances are left in the mismatching state.
+bool8_t runGBDifferentialRunner( GBDifferentialRunner* pRunner, const GBEmulatorJoypadState joypadState, const uint32_t cycleCount, GBDifferentialMismatch* pOutMismatch )
+{
+    GBEmulatorInstance* pReferenceInstance = pRunner->pReferenceInstance;
+    GBEmulatorInstance* pOptimizedInstance = pRunner->pOptimizedInstance;
+    setGBEmulatorJoypadState( pReferenceInstance, joypadState );
+    setGBEmulatorJoypadState( pOptimizedInstance, joypadState );
+
+    uint32_t cyclesRun = 0u;
+    while( cyclesRun < cycleCount )
+    {
+        const uint32_t remainingCycleCount = cycleCount - cyclesRun;
+        const uint32_t intervalCycleCount = remainingCycleCount < pRunner->compareIntervalInCycles ? remainingCycleCount : pRunner->compareIntervalInCycles;
+        cyclesRun += pRunner->pRunFunction( pOptimizedInstance, intervalCycleCount, pRunner->pUserData );
+
+        //FK: Both run whole instructions, so the reference ends up at the same cycle count unless the optimized path got the timing wrong
+        const uint64_t optimizedCycle = getGBEmulatorCycleCount( pOptimizedInstance );
+        uint16_t lastReferencePC = pReferenceInstance->cpuState.registers.PC;
+        while( getGBEmulatorCycleCount( pReferenceInstance ) < optimizedCycle )
+        {
+            lastReferencePC = pReferenceInstance->cpuState.registers.PC;
+            runSingleInstruction( pReferenceInstance );
+            ++pRunner->stats.referenceInstructionCount;
+        }
+
+        if( !compareGBDifferentialInstances( pRunner, lastReferencePC, pOutMismatch ) )
+        {
+            return 0u;
+        }
+    }
+
+    pRunner->stats.cycleCount += cyclesRun;
+    return 1u;
+}
+
+GBDifferentialStats getGBDifferentialRunnerStats( const GBDifferentialRunner* pRunner )
+{
+    return pRunner->stats;
+}
+
+#endif //K15_GB_DIFFERENTIAL
@@ -1,6 +1,19 @@
 #define K15_ENABLE_EMULATOR_DEBUG_FEATURES      0
-#define K15_BREAK_ON_UNKNOWN_INSTRUCTION        1
-#define K15_BREAK_ON_ILLEGAL_INSTRUCTION        1
+
+//FK: Define as 0 to keep running on illegal or unimplemented opcodes (eg: when running a corpus of roms headless)
+#ifndef K15_BREAK_ON_UNKNOWN_INSTRUCTION
+#   define K15_BREAK_ON_UNKNOWN_INSTRUCTION     1
+#endif
+
+#ifndef K15_BREAK_ON_ILLEGAL_INSTRUCTION
+#   define K15_BREAK_ON_ILLEGAL_INSTRUCTION     1
+#endif
+
+//FK: Define as 1 if the host only reads the framebuffer right after a vblank event (eg: headless or when running many instances),
+//    this saves the memory of the back buffer for every instance.
+#ifndef K15_GB_FRAME_BUFFER_COUNT
+#   define K15_GB_FRAME_BUFFER_COUNT            2
+#endif
 
 #define K15_GB_EMULATOR
 
@@ -8,6 +21,8 @@
 #include "k15_gb_opcodes.h"
 #include "k15_gb_font.h"
 
+#include <atomic>
+
 #ifdef _MSC_VER
 #   pragma warning( push )
 #   pragma warning( disable : 4334)
@@ -27,15 +42,32 @@
 #   pragma warning( pop ) 
 #endif
 
-static constexpr uint8_t    gbStateVersion = 6;
-static constexpr uint32_t   gbStateFourCC  = FourCC( 'K', 'G', 'B', 'C' ); //FK: FourCC of state files
+static constexpr uint8_t    gbStateVersion              = 9;
+static constexpr uint8_t    gbMinCompatibleStateVersion = 8; //FK: First version using the chunked state format
+static constexpr uint32_t   gbStateFourCC               = FourCC( 'K', 'G', 'B', 'C' ); //FK: FourCC of state files
+
+//FK: Tags of the state file chunks
+static constexpr uint32_t   gbStateChunkTagCpu          = FourCC( 'C', 'P', 'U', ' ' );
+static constexpr uint32_t   gbStateChunkTagPpu          = FourCC( 'P', 'P', 'U', ' ' );
+static constexpr uint32_t   gbStateChunkTagApu          = FourCC( 'A', 'P', 'U', ' ' );
+static constexpr uint32_t   gbStateChunkTagTimer        = FourCC( 'T', 'I', 'M', 'R' );
+static constexpr uint32_t   gbStateChunkTagSerial       = FourCC( 'S', 'E', 'R', 'L' );
+static constexpr uint32_t   gbStateChunkTagMbc          = FourCC( 'M', 'B', 'C', ' ' );
+static constexpr uint32_t   gbStateChunkTagVideoRam     = FourCC( 'V', 'R', 'A', 'M' );
+static constexpr uint32_t   gbStateChunkTagWorkRam      = FourCC( 'W', 'R', 'A', 'M' );
+static constexpr uint32_t   gbStateChunkTagOAM          = FourCC( 'O', 'A', 'M', ' ' );
+static constexpr uint32_t   gbStateChunkTagHighRam      = FourCC( 'H', 'R', 'A', 'M' ); //FK: IO registers, HRAM and IE (0xFF00-0xFFFF)
+static constexpr uint32_t   gbStateChunkTagCartridgeRam = FourCC( 'C', 'R', 'A', 'M' );
 
 static constexpr uint8_t    gbNintendoLogo[]                        = { 0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E };
 static constexpr char       gbRamFileExtension[]                    = ".k15_gb_ram";
 static constexpr char       gbStateFileExtension[]                  = ".k15_gb_state";
 static constexpr uint32_t   gbCyclesPerFrame                        = 70224u;
 static constexpr uint32_t   gbSerialClockCyclesPerBitTransfer       = 512u;
+static constexpr uint32_t   gbSerialClockCyclesPerByteTransfer      = gbSerialClockCyclesPerBitTransfer * 8u;
 static constexpr uint32_t   gbEmulatorFrameRate                     = 60u;
+static constexpr uint32_t   gbCyclesPerSecond                       = gbCyclesPerFrame * gbEmulatorFrameRate;
+static constexpr uint32_t   gbInputQueueCapacity                    = 256u; //FK: Needs to be a power of 2
 static constexpr uint8_t    gbOAMSizeInBytes                        = 0x9Fu;
 static constexpr uint8_t    gbDMACycleCount                         = 160u;
 static constexpr uint8_t    gbSpriteHeight                          = 16u;
@@ -52,15 +84,31 @@ static constexpr uint8_t    gbObjectAttributeCapacity               = 40u;
 static constexpr uint8_t    gbSpritesPerScanline                    = 10u; //FK: the hardware allowed no more than 10 sprites per scanline
 static constexpr uint8_t    gbFrameBufferScanlineSizeInBytes        = gbHorizontalResolutionInPixels / 4;
 static constexpr size_t     gbFrameBufferSizeInBytes                = gbFrameBufferScanlineSizeInBytes * gbVerticalResolutionInPixels;
-static constexpr uint8_t    gbFrameBufferCount                      = 2;
-static constexpr size_t     gbMappedMemorySizeInBytes               = 0x10000;
-static constexpr size_t     gbCompressionTokenSizeInBytes           = 1;
+static constexpr uint8_t    gbFrameBufferCount                      = K15_GB_FRAME_BUFFER_COUNT;
+static constexpr uint16_t   gbVideoRamMemoryOffset                  = 0x0000; //FK: 0x8000-0x9FFF
+static constexpr uint16_t   gbWorkRamMemoryOffset                   = 0x2000; //FK: 0xC000-0xDFFF (echo ram 0xE000-0xFDFF maps to the same memory)
+static constexpr uint16_t   gbHighMemoryOffset                      = 0x4000; //FK: 0xFE00-0xFFFF (OAM, IO registers, HRAM and IE)
+static constexpr size_t     gbMappedMemorySizeInBytes               = 0x4200; //FK: Only the writable regions, rom and cartridge ram are accessed through pointers
+static constexpr size_t     gbCompressionMinMatchSizeInBytes        = 4;
+static constexpr size_t     gbCompressionMaxMatchOffset             = 0xFFFF;
+static constexpr uint32_t   gbCompressionHashTableSizeLog2          = 12u;
+static constexpr size_t     gbRewindMinSnapshotSizeInBytes          = 256u; //FK: Used to derive the snapshot capacity from the rewind budget
 static constexpr size_t     gbRamBankSizeInBytes                    = Kbyte( 8 );
 static constexpr size_t     gbRomBankSizeInBytes                    = Kbyte( 16 );
 static constexpr size_t     gbMaxRomSizeInBytes                     = Mbyte( 8 );
+static constexpr size_t     gbMaxRamSizeInBytes                     = Kbyte( 128 );
 static constexpr size_t     gbMinRomSizeInBytes                     = Kbyte( 32 );
+static constexpr size_t     gbSnapshotStorePageSizeInBytes          = Kbyte( 4 );
+static constexpr uint32_t   gbSnapshotStoreMappedMemoryPageCount    = ( uint32_t )( ( gbMappedMemorySizeInBytes + gbSnapshotStorePageSizeInBytes - 1u ) / gbSnapshotStorePageSizeInBytes );
+static constexpr uint32_t   gbSnapshotStoreMaxPagesPerSnapshot      = gbSnapshotStoreMappedMemoryPageCount + ( uint32_t )( gbMaxRamSizeInBytes / gbSnapshotStorePageSizeInBytes );
+static constexpr uint32_t   gbInvalidSnapshotHandle                 = 0xFFFFFFFFu;
+static constexpr uint32_t   gbInvalidSnapshotStorePageIndex         = 0xFFFFFFFFu;
+static constexpr uint32_t   gbSubsystemProfileCalibrationBatchCount = 16u;
+static constexpr uint32_t   gbSubsystemProfileCalibrationBatchSize  = 256u;
 
 typedef uint32_t GBEmulatorInstanceEventMask;
+typedef uint32_t GBEmulatorStopMask;
+typedef uint32_t GBSnapshotHandle;
 
 enum
 {
@@ -68,6 +116,20 @@ enum
     K15_GB_VBLANK_EVENT_FLAG        = 0x01,
     K15_GB_STATE_SAVED_EVENT_FLAG   = 0x02,
     K15_GB_STATE_LOADED_EVENT_FLAG  = 0x04,
+    K15_GB_INPUT_POLLED_EVENT_FLAG  = 0x08, //FK: The game read or wrote JOYP
+    K15_GB_LAG_FRAME_EVENT_FLAG     = 0x10, //FK: A frame finished without the game reading or writing JOYP (see getGBEmulatorInputPollStats())
+};
+
+//FK: Stop conditions of runGBEmulatorUntil(), checked after every instruction
+enum
+{
+    K15_GB_STOP_NONE                = 0x00,
+    K15_GB_STOP_AT_VBLANK           = 0x01, //FK: LY reached 144, the frame got finished (see getGBEmulatorFrameBuffer())
+    K15_GB_STOP_AT_LINE             = 0x02, //FK: LY reached the line set using setGBEmulatorStopLine()
+    K15_GB_STOP_AT_SERIAL_BYTE      = 0x04, //FK: A serial byte transfer finished
+    K15_GB_STOP_AT_JOYPAD_READ      = 0x08, //FK: The game read JOYP
+    K15_GB_STOP_AT_ADDRESS          = 0x10, //FK: PC reached the address set using setGBEmulatorStopAddress(), the instruction at that address didn't run yet
+    K15_GB_STOP_AT_MAX_CYCLES       = 0x20, //FK: Always active
 };
 
 enum 
@@ -86,6 +148,24 @@ enum GBStateLoadResult
     K15_GB_STATE_LOAD_FAILED_WRONG_ROM
 };
 
+//FK: Regions of the state hash, same split as the chunks of save states (see calculateGBEmulatorStateHash())
+enum GBStateHashRegion : uint8_t
+{
+    K15_GB_STATE_HASH_REGION_CPU = 0,
+    K15_GB_STATE_HASH_REGION_PPU,
+    K15_GB_STATE_HASH_REGION_APU,
+    K15_GB_STATE_HASH_REGION_TIMER,
+    K15_GB_STATE_HASH_REGION_SERIAL,
+    K15_GB_STATE_HASH_REGION_MBC,
+    K15_GB_STATE_HASH_REGION_VIDEO_RAM,
+    K15_GB_STATE_HASH_REGION_WORK_RAM,
+    K15_GB_STATE_HASH_REGION_OAM,
+    K15_GB_STATE_HASH_REGION_HIGH_RAM,      //FK: IO registers, HRAM and IE (0xFF00-0xFFFF)
+    K15_GB_STATE_HASH_REGION_CARTRIDGE_RAM,
+
+    K15_GB_STATE_HASH_REGION_COUNT
+};
+
 enum GBMapCartridgeResult
 {
     K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY = 0,
@@ -95,6 +175,7 @@ enum GBMapCartridgeResult
 enum GBMappedIOAdresses
 {
     K15_GB_MAPPED_IO_ADDRESS_JOYP   = 0xFF00,
+    K15_GB_MAPPED_IO_ADDRESS_SB     = 0xFF01,
     K15_GB_MAPPED_IO_ADDRESS_SC     = 0xFF02,
     K15_GB_MAPPED_IO_ADDRESS_DIV    = 0xFF04,
     K15_GB_MAPPED_IO_ADDRESS_TIMA   = 0xFF05,
@@ -127,14 +208,22 @@ enum GBMappedIOAdresses
     K15_GB_MAPPED_IO_ADDRESS_NR51   = 0xFF25,
     K15_GB_MAPPED_IO_ADDRESS_NR52   = 0xFF26,
 
+    K15_GB_MAPPED_IO_ADDRESS_WAVE   = 0xFF30,
+
     K15_GB_MAPPED_IO_ADDRESS_LCDC   = 0xFF40,
     K15_GB_MAPPED_IO_ADDRESS_STAT   = 0xFF41,
+    K15_GB_MAPPED_IO_ADDRESS_SCY    = 0xFF42,
+    K15_GB_MAPPED_IO_ADDRESS_SCX    = 0xFF43,
+    K15_GB_MAPPED_IO_ADDRESS_LY     = 0xFF44,
+    K15_GB_MAPPED_IO_ADDRESS_LYC    = 0xFF45,
 
     K15_GB_MAPPED_IO_ADDRESS_DMA    = 0xFF46,
 
     K15_GB_MAPPED_IO_ADDRESS_BGP    = 0xFF47,
     K15_GB_MAPPED_IO_ADDRESS_OBP0   = 0xFF48,
     K15_GB_MAPPED_IO_ADDRESS_OBP1   = 0xFF49,
+    K15_GB_MAPPED_IO_ADDRESS_WY     = 0xFF4A,
+    K15_GB_MAPPED_IO_ADDRESS_WX     = 0xFF4B,
 
     K15_GB_MAPPED_IO_ADDRESS_IF     = 0xFF0F,
     K15_GB_MAPPED_IO_ADDRESS_IE     = 0xFFFF
@@ -177,6 +266,52 @@ struct GBEmulatorJoypadState
     };
 };
 
+//FK: Joypad state change at an emulated cycle (see getGBEmulatorCycleCount())
+struct GBInputEvent
+{
+    uint64_t                cycle;
+    GBEmulatorJoypadState   joypadState;
+};
+
+//FK: Lock-free single producer/single consumer queue of input events (see setGBEmulatorInputQueue()).
+//    The producer is usually a high frequency input thread, the consumer is the thread running the emulator.
+struct GBInputQueue
+{
+    alignas( 64 ) std::atomic<uint32_t> writeIndex;                         //FK: Only advanced by the producer
+    uint64_t                            lastEventCycle;                     //FK: Only used by the producer
+    alignas( 64 ) std::atomic<uint32_t> readIndex;                          //FK: Only advanced by the emulator
+    alignas( 64 ) std::atomic<int64_t>  hostTimeAtCycleZeroInNanoseconds;   //FK: Published by the emulator thread, see publishGBInputQueueClock()
+    uint64_t                            bufferCycleCount;
+    GBInputEvent                        events[ gbInputQueueCapacity ];
+};
+
+enum GBSubsystem : uint8_t
+{
+    K15_GB_SUBSYSTEM_CPU = 0,   //FK: Instruction fetch/execute, interrupts and memory mapped writes
+    K15_GB_SUBSYSTEM_DMA,
+    K15_GB_SUBSYSTEM_PPU,
+    K15_GB_SUBSYSTEM_APU,
+    K15_GB_SUBSYSTEM_TIMER,
+    K15_GB_SUBSYSTEM_SERIAL,
+
+    K15_GB_SUBSYSTEM_COUNT
+};
+
+//FK: Returns a host timestamp in any unit (eg: rdtsc or nanoseconds), called a few times per instruction so it should be cheap
+typedef uint64_t ( *GBSubsystemTimestampFunction )();
+
+//FK: Host time spent per subsystem (see setGBEmulatorSubsystemProfile()), in units of the timestamp function.
+//    subsystemTimestamps still contain the cost of the timestamps, use getGBSubsystemProfileTime() to get the time without it.
+struct GBSubsystemProfile
+{
+    GBSubsystemTimestampFunction    pGetTimestamp;
+    uint64_t                        subsystemTimestamps[ K15_GB_SUBSYSTEM_COUNT ];
+    uint64_t                        instructionStartTimestamp;
+    uint64_t                        instructionCount;
+    uint64_t                        tickCount;                  //FK: Calls of tickSystem(), each one times every subsystem but the cpu once
+    uint64_t                        timestampOverhead;          //FK: Cost of a single timestamp, measured by setGBEmulatorSubsystemProfile()
+};
+
 struct GBCpuFlags
 {
     union
@@ -256,26 +391,37 @@ struct GBCpuStateFlags
 
 struct GBCpuState
 {
-    uint8_t*        pIE;
-    uint8_t*        pIF;
-
     GBCpuRegisters  registers;
 
     uint32_t        cycleCounter;
     uint16_t        dmaAddress;
     uint8_t         dmaCycleCounter;
     GBCpuStateFlags flags;          //FK: not to be confused with GBCpuRegisters::F
+    uint64_t        totalCycleCounter;  //FK: Cycles since power on, the input events of GBInputQueue are timestamped with it
 };
 
 struct GBSerialState
 {
-    uint8_t* pSerialTransferData    = nullptr;
-    uint8_t* pSerialTransferControl = nullptr;
     uint8_t shiftIndex              = 0u;
     uint8_t inByte                  = 0xFFu;
     uint8_t initiateTransfer        = 0u;
     uint8_t useInternalClock        = 0u;
+    uint8_t linkConnected           = 0u;   //FK: Set by the link cable (see k15_gb_link_cable.h), transfers are then exchanged a byte at a time
+    uint8_t linkTransferDue         = 0u;   //FK: Internal clock transfer finished shifting, waiting for the link cable to exchange the bytes
     uint32_t cycleCounter           = 0u;
+    uint32_t transferredByteCount   = 0u;   //FK: Not part of save states, only used to detect finished transfers (see runGBEmulatorUntil())
+};
+
+//FK: A frame ends when LY reaches 144, frames in which the game neither read nor wrote JOYP are lag frames.
+//    Not part of save states.
+struct GBInputPollState
+{
+    uint32_t frameCount;                    //FK: 32 bit keeps the sub states free of padding (see calculateGBEmulatorSubStateSizeInBytes())
+    uint32_t lagFrameCount;
+    uint32_t frameStartJoypadReadCount;
+    uint32_t frameStartJoypadWriteCount;
+    uint32_t lastFrameJoypadReadCount;
+    uint32_t lastFrameJoypadWriteCount;
 };
 
 enum GBCartridgeType : uint8_t
@@ -364,17 +510,6 @@ struct GBLcdStatus
     uint8_t enableLycEqLyInterrupt      : 1;
 };
 
-struct GBLcdRegisters
-{
-    GBLcdStatus*    pStatus;
-    uint8_t*        pScy;
-    uint8_t*        pScx;
-    uint8_t*        pLy;
-    uint8_t*        pLyc;
-    uint8_t*        pWy;
-    uint8_t*        pWx;
-};
-
 struct GBPpuFlags
 {
     uint8_t drawObjects     : 1;
@@ -385,13 +520,6 @@ struct GBPpuFlags
 struct GBPpuState
 {
     GBPpuFlags          flags;
-    GBLcdRegisters      lcdRegisters;
-    GBObjectAttributes* pOAM;
-    GBLcdControl*       pLcdControl;
-    GBPalette*          pPalettes;
-    uint8_t*            pBackgroundOrWindowTileIds[ 2 ];
-    uint8_t*            pTileBlocks[ 3 ];
-    uint8_t*            pGBFrameBuffers[ gbFrameBufferCount ];
 
     uint32_t            cycleCounter;
     uint32_t            dotCounter;
@@ -414,21 +542,27 @@ enum GBMemoryAccess
 
 struct GBMemoryMapper
 {
-    uint8_t*            pBaseAddress;
-    uint8_t*            pRom0Bank;
-    uint8_t*            pRom1Bank;
-    uint8_t*            pVideoRAM;
-    uint8_t*            pRamBankSwitch;
-    uint8_t*            pSpriteAttributes;
     uint16_t            lastAddressWrittenTo;
     uint16_t            lastAddressReadFrom;
     uint8_t             lastValueWritten;
+    uint32_t            joypadReadCount;    //FK: Number of JOYP reads, used to detect input polling (see runGBEmulatorUntil())
+    uint32_t            joypadWriteCount;
 
     GBMemoryAccess      memoryAccess;
     GBLcdStatus         lcdStatus;  //FK: Mirror lcd status to check whether we can read from VRAM and/or OAM 
     bool8_t             lcdEnabled; //FK: Mirror lcd enabled flag to check whether we can read from VRAM and/or OAM
     bool8_t             dmaActive;  //FK: Mirror dma flag to check whether we can read only from HRAM
     bool8_t             ramEnabled; //FK: Mirror ram enabled flag to check whether we can write to external RAM
+
+    //FK: Rom banks are shared between all instances that loaded the same rom, cartridge ram is owned by the host.
+    //    Both are read through these pointers instead of being copied into the instance (see getMappedMemoryValue())
+    const uint8_t*      pRom0Bank;
+    const uint8_t*      pRom1Bank;
+    uint8_t*            pRamBank;
+    uint16_t            ramBankSizeInBytes;
+
+    //FK: Needs to be the last member (see snapshotGBEmulator()), layout is described by gbVideoRamMemoryOffset etc.
+    uint8_t             memory[ gbMappedMemorySizeInBytes ];
 };
 
 struct GBRomHeader
@@ -500,6 +634,7 @@ struct GBEmulatorInstanceFlags
         {
             uint8_t vblank      : 1;
             uint8_t ramAccessed : 1;
+            uint8_t lagFrame    : 1;
         };
 
         uint8_t value;
@@ -508,11 +643,6 @@ struct GBEmulatorInstanceFlags
 
 struct GBTimerState
 {
-    uint8_t*    pDivider;
-    uint8_t*    pCounter;
-    uint8_t*    pModulo;
-    uint8_t*    pControl;
-
     uint16_t    internalDivCounter;
 
     uint8_t     counterFrequencyBit     : 4;
@@ -553,7 +683,6 @@ struct GBApuSquareWaveChannel2
 
 struct GBApuWaveChannel
 {
-    uint8_t* pWavePattern;
     uint8_t lengthTimer;
     uint8_t currentSample;
     uint16_t samplePosition;
@@ -584,18 +713,32 @@ struct GBApuState
     GBApuFrameSequencer     frameSequencer;
 };
 
+//FK: The instance doesn't contain any pointers into itself, so it can be copied or moved to a different address using memcpy.
+//    The only pointers are the rom and ram pointers of the cartridge which point to memory owned by the host.
 struct GBEmulatorInstance
 {
-    GBCpuState*             pCpuState;
-    GBPpuState*             pPpuState;
-    GBApuState*             pApuState;
-    GBTimerState*           pTimerState;
-    GBMemoryMapper*         pMemoryMapper;
-    GBSerialState*          pSerialState;
-    GBCartridge*            pCartridge;
+    //FK: The sub states are snapshotted in one go, so keep them together and keep the memory mapper last (see snapshotGBEmulator())
+    GBCpuState              cpuState;
+    GBApuState              apuState;
+    GBPpuState              ppuState;
+    GBTimerState            timerState;
+    GBSerialState           serialState;
+    GBInputPollState        inputPollState;
+    GBCartridge             cartridge;
+    GBMemoryMapper          memoryMapper;
+
+    uint8_t                 gbFrameBuffers[ gbFrameBufferCount ][ gbFrameBufferSizeInBytes ];
 
     GBEmulatorJoypadState   joypadState;
     GBEmulatorInstanceFlags flags;
+    bool8_t                 skipRendering;              //FK: Not part of snapshots, see setGBEmulatorRenderingEnabled()
+    GBInputQueue*           pInputQueue;                //FK: Owned by the host, not part of snapshots (see setGBEmulatorInputQueue())
+    GBSubsystemProfile*     pSubsystemProfile;          //FK: Owned by the host, not part of snapshots (see setGBEmulatorSubsystemProfile())
+    uint16_t                stopAddress;                //FK: See setGBEmulatorStopAddress()
+    uint8_t                 stopLine;                   //FK: See setGBEmulatorStopLine()
+
+    std::atomic<uint32_t>   stateSavedCounter;          //FK: Incremented by signalGBEmulatorStateSaved(), possibly from a different thread
+    uint32_t                reportedStateSavedCounter;
 
 #if K15_ENABLE_EMULATOR_DEBUG_FEATURES == 1
     GBEmulatorDebug         debug;
@@ -615,6 +758,210 @@ struct GBEmulatorState
     uint8_t       mappedRamBankNumber;
 };
 
+//FK: Header of an in-memory snapshot (see snapshotGBEmulator()).
+//    Followed by the sub states, the gbMappedMemorySizeInBytes of mapped memory (vram, wram and 0xFE00-0xFFFF) and the cartridge ram.
+struct GBEmulatorSnapshotHeader
+{
+    uint32_t                    cartridgeRamSizeInBytes;
+    uint16_t                    romGlobalChecksum;  //FK: Together with the header checksum, so revisions and hacks of a rom don't restore each other's snapshots
+    uint8_t                     romHeaderChecksum;
+    GBEmulatorJoypadState       joypadState;
+    GBEmulatorInstanceFlags     flags;
+};
+
+struct GBStateHash
+{
+    uint64_t    regionHashes[ K15_GB_STATE_HASH_REGION_COUNT ];
+    uint64_t    hash;                       //FK: Combination of all region hashes
+};
+
+//FK: Save state chunks only contain plain values, so they don't depend on pointers or on the layout of the emulator structs.
+struct GBStateChunkHeader
+{
+    uint32_t tag;
+    uint32_t sizeInBytes;
+    uint32_t compressedSizeInBytes;  //FK: 0 if the chunk data is stored uncompressed
+};
+
+struct GBCpuStateChunk
+{
+    uint16_t    AF;
+    uint16_t    BC;
+    uint16_t    DE;
+    uint16_t    HL;
+    uint16_t    SP;
+    uint16_t    PC;
+    uint32_t    cycleCounter;
+    uint16_t    dmaAddress;
+    uint8_t     dmaCycleCounter;
+    uint8_t     IME;
+    uint8_t     halt;
+    uint8_t     stop;
+    uint8_t     dma;
+    uint8_t     haltBug;
+    uint8_t     pendingEI;
+    uint64_t    totalCycleCounter;  //FK: Added in version 9
+};
+
+struct GBPpuStateChunk
+{
+    uint32_t            cycleCounter;
+    uint32_t            dotCounter;
+    GBObjectAttributes  scanlineSprites[ gbSpritesPerScanline ];
+    uint8_t             objectMonochromePalette[ 8 ];
+    uint8_t             backgroundMonochromePalette[ 4 ];
+    uint8_t             scanlineSpriteCounter;
+    uint8_t             activeFrameBufferIndex;
+    uint8_t             drawObjects;
+    uint8_t             drawBackground;
+    uint8_t             drawWindow;
+};
+
+struct GBApuStateChunk
+{
+    uint16_t    waveSamplePosition;
+    uint16_t    waveCycleCount;
+    uint16_t    waveFrequencyCycleCountTarget;
+    uint16_t    frameSequencerCycleCounter;
+    uint8_t     squareWave1LengthTimer;
+    uint8_t     squareWave2LengthTimer;
+    uint8_t     waveLengthTimer;
+    uint8_t     noiseLengthTimer;
+    uint8_t     waveCurrentSample;
+    uint8_t     waveChannelEnabled;
+    uint8_t     waveVolumeShift;
+    uint8_t     frameSequencerClockCounter;
+};
+
+struct GBTimerStateChunk
+{
+    uint16_t    internalDivCounter;
+    uint8_t     counterFrequencyBit;
+    uint8_t     enableCounter;
+    uint8_t     timerOverflow;
+    uint8_t     timerLoading;
+};
+
+struct GBSerialStateChunk
+{
+    uint32_t    cycleCounter;
+    uint8_t     shiftIndex;
+    uint8_t     inByte;
+    uint8_t     initiateTransfer;
+    uint8_t     useInternalClock;
+};
+
+struct GBMbcStateChunk
+{
+    uint16_t    mappedRom0BankNumber;
+    uint16_t    mappedRom1BankNumber;
+    uint8_t     mappedRamBankNumber;
+    uint8_t     highBankValue;
+    uint8_t     lowBankValue;
+    uint8_t     ramEnabled;
+    uint8_t     bankingMode;
+};
+
+//FK: A save state that has been validated by parseGBEmulatorState() but not yet applied to an instance
+struct GBParsedEmulatorState
+{
+    GBCpuStateChunk     cpuChunk;
+    GBPpuStateChunk     ppuChunk;
+    GBApuStateChunk     apuChunk;
+    GBTimerStateChunk   timerChunk;
+    GBSerialStateChunk  serialChunk;
+    GBMbcStateChunk     mbcChunk;
+    GBStateChunkHeader  cartridgeRamHeader;
+    const uint8_t*      pCartridgeRamChunkData;                     //FK: nullptr if the state doesn't contain cartridge ram
+    uint8_t             mappedMemory[ gbMappedMemorySizeInBytes ];
+};
+
+struct GBRewindSnapshot
+{
+    uint32_t    dataOffset;
+    uint32_t    sizeInBytes;
+    uint32_t    sequence;
+    uint32_t    keyframeSequence;
+    uint16_t    deltaIndex;         //FK: 0 for keyframes, otherwise position of the delta after its keyframe
+};
+
+struct GBRewindBufferStats
+{
+    size_t      budgetInBytes;
+    size_t      memoryUsedInBytes;
+    size_t      averageSnapshotSizeInBytes;
+    size_t      averageKeyframeSizeInBytes;
+    size_t      averageDeltaSizeInBytes;
+    uint32_t    snapshotCount;
+    uint32_t    keyframeCount;
+    uint32_t    rewindableFrameCount;
+    uint32_t    evictedSnapshotCount;
+};
+
+struct GBRewindBuffer
+{
+    GBRewindSnapshot*   pSnapshots;
+    uint8_t*            pSnapshotData;
+    uint8_t*            pKeyframeRawState;  //FK: uncompressed keyframe that deltas are currently stored against
+    uint8_t*            pRawState;
+    uint8_t*            pDeltaRawState;
+    uint8_t*            pCompressedState;
+
+    size_t              budgetInBytes;
+    size_t              rawStateSizeInBytes;
+    size_t              memoryUsedInBytes;
+    size_t              keyframeMemoryUsedInBytes;
+
+    uint32_t            snapshotCapacity;
+    uint32_t            firstSnapshotIndex;
+    uint32_t            snapshotCount;
+    uint32_t            keyframeCount;
+    uint32_t            evictedSnapshotCount;
+    uint32_t            writeOffset;
+    uint32_t            nextSequence;
+    uint32_t            keyframeRawStateSequence;
+
+    uint16_t            framesPerSnapshot;
+    uint16_t            snapshotsPerKeyframe;
+    uint16_t            frameCounter;
+    bool8_t             hasKeyframeRawState;
+};
+
+struct GBSnapshotStoreStats
+{
+    size_t      pageMemoryUsedInBytes;      //FK: Memory used by the unique pages
+    size_t      snapshotSizeInBytes;        //FK: Size of a single snapshot without deduplication (see calculateGBEmulatorSnapshotSizeInBytes())
+    uint32_t    snapshotCount;
+    uint32_t    snapshotCapacity;
+    uint32_t    uniquePageCount;
+    uint32_t    referencedPageCount;        //FK: Sum of the pages of all snapshots, referencedPageCount / uniquePageCount is the dedup ratio
+    uint32_t    pageCapacity;
+};
+
+//FK: Content addressed page store for workloads that keep a lot of snapshots around (eg: tree search).
+//    Each snapshot is split into pages, identical pages are only stored once and reference counted.
+struct GBSnapshotStore
+{
+    uint8_t*    pPages;
+    uint64_t*   pPageHashes;
+    uint32_t*   pPageReferenceCounts;
+    uint32_t*   pFreePageIndices;
+    uint32_t*   pHashTable;                 //FK: Linear probing, stores page index + 1 (0 = empty slot)
+    uint32_t*   pFreeSnapshotHandles;
+    uint8_t*    pSnapshotEntries;           //FK: Page indices followed by the snapshot header and the sub states of each snapshot
+    uint8_t*    pScratchPage;               //FK: Used to pad cartridge ram that is smaller than a page
+
+    size_t      snapshotEntrySizeInBytes;
+
+    uint32_t    pageCapacity;
+    uint32_t    snapshotCapacity;
+    uint32_t    hashTableCapacity;          //FK: Power of two
+    uint32_t    freePageCount;
+    uint32_t    freeSnapshotHandleCount;
+    uint32_t    referencedPageCount;
+    uint32_t    pagesPerSnapshot;           //FK: Set by the first snapshot, all snapshots of a store need to be of the same rom
+};
+
 const uint8_t* getFontGlyphPixel( char glyph )
 {
     //FK: bitmap font starts with space
@@ -715,56 +1062,94 @@ bool8_t isInEchoRamRange( const uint16_t address )
     return address >= 0xE000 && address < 0xFDFF;
 }
 
-void patchIOCartridgeMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBCartridge* pCartridge )
+//FK: Returns the offset of a writable address (VRAM, WRAM, echo ram, OAM, IO registers, HRAM) within GBMemoryMapper::memory
+uint16_t getMappedMemoryOffset( const uint16_t address )
+{
+    RuntimeAssert( address >= 0x8000 && !isInExternalRamRange( address ) );
+    if( address >= 0xFE00 )
+    {
+        return gbHighMemoryOffset + ( address - 0xFE00 );
+    }
+    else if( address >= 0xC000 )
+    {
+        return gbWorkRamMemoryOffset + ( ( address - 0xC000 ) & 0x1FFF );
+    }
+
+    return gbVideoRamMemoryOffset + ( address - 0x8000 );
+}
+
+//FK: Only valid for writable addresses, use getMappedMemoryValue() to read from rom or cartridge ram
+uint8_t* getMappedMemoryAddress( GBMemoryMapper* pMemoryMapper, const uint16_t address )
+{
+    return pMemoryMapper->memory + getMappedMemoryOffset( address );
+}
+
+//FK: Reads from any address without checking the memory access rules
+uint8_t getMappedMemoryValue( const GBMemoryMapper* pMemoryMapper, const uint16_t address )
 {
-    pCartridge->pRomBaseAddress = pMemoryMapper->pBaseAddress;
+    if( address < 0x4000 )
+    {
+        return pMemoryMapper->pRom0Bank[ address ];
+    }
+    else if( address < 0x8000 )
+    {
+        return pMemoryMapper->pRom1Bank[ address - 0x4000 ];
+    }
+    else if( isInExternalRamRange( address ) )
+    {
+        const uint16_t ramAddress = address - 0xA000;
+        return ramAddress < pMemoryMapper->ramBankSizeInBytes ? pMemoryMapper->pRamBank[ ramAddress ] : 0xFF;
+    }
+
+    return pMemoryMapper->memory[ getMappedMemoryOffset( address ) ];
 }
 
-void patchIOCpuMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBCpuState* pState )
+//FK: Writes to any address without checking the memory access rules, writes to rom are ignored
+void setMappedMemoryValue( GBMemoryMapper* pMemoryMapper, const uint16_t address, const uint8_t value )
 {
-    pState->pIE = pMemoryMapper->pBaseAddress + 0xFFFF;
-    pState->pIF = pMemoryMapper->pBaseAddress + 0xFF0F;
+    if( address < 0x8000 )
+    {
+        return;
+    }
+    else if( isInExternalRamRange( address ) )
+    {
+        const uint16_t ramAddress = address - 0xA000;
+        if( ramAddress < pMemoryMapper->ramBankSizeInBytes )
+        {
+            pMemoryMapper->pRamBank[ ramAddress ] = value;
+        }
+
+        return;
+    }
+
+    pMemoryMapper->memory[ getMappedMemoryOffset( address ) ] = value;
 }
 
-void patchIOTimerMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBTimerState* pTimerState )
+//FK: IO registers are accessed through the mapped memory instead of pointers so that the emulator instance stays relocatable
+GBLcdControl* getLcdControl( GBMemoryMapper* pMemoryMapper )
 {
-    pTimerState->pDivider       = pMemoryMapper->pBaseAddress + 0xFF04;
-    pTimerState->pCounter       = pMemoryMapper->pBaseAddress + 0xFF05;
-    pTimerState->pModulo        = pMemoryMapper->pBaseAddress + 0xFF06;
-    pTimerState->pControl       = pMemoryMapper->pBaseAddress + 0xFF07;
+    return (GBLcdControl*)getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LCDC );
 }
 
-void patchIOSerialMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBSerialState* pSerialState )
+GBLcdStatus* getLcdStatus( GBMemoryMapper* pMemoryMapper )
 {
-    pSerialState->pSerialTransferData       = pMemoryMapper->pBaseAddress + 0xFF01;
-    pSerialState->pSerialTransferControl    = pMemoryMapper->pBaseAddress + 0xFF02;
+    return (GBLcdStatus*)getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_STAT );
 }
 
-void patchIOPpuMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBPpuState* pPpuState )
+const GBObjectAttributes* getObjectAttributes( const GBMemoryMapper* pMemoryMapper )
 {
-    pPpuState->pOAM                             = (GBObjectAttributes*)(pMemoryMapper->pBaseAddress + 0xFE00);
-    pPpuState->pLcdControl                      = (GBLcdControl*)(pMemoryMapper->pBaseAddress + 0xFF40);
-    pPpuState->pPalettes                        = (GBPalette*)(pMemoryMapper->pBaseAddress + 0xFF47);
-    pPpuState->pTileBlocks[0]                   = pMemoryMapper->pBaseAddress + 0x8000;
-    pPpuState->pTileBlocks[1]                   = pMemoryMapper->pBaseAddress + 0x8080;
-    pPpuState->pTileBlocks[2]                   = pMemoryMapper->pBaseAddress + 0x9000;
-    pPpuState->pBackgroundOrWindowTileIds[0]    = pMemoryMapper->pBaseAddress + 0x9800;
-    pPpuState->pBackgroundOrWindowTileIds[1]    = pMemoryMapper->pBaseAddress + 0x9C00;
-    pPpuState->dotCounter                       = 0;
-    pPpuState->cycleCounter                     = 0;
+    return (const GBObjectAttributes*)( pMemoryMapper->memory + getMappedMemoryOffset( 0xFE00 ) );
+}
 
-    pPpuState->lcdRegisters.pStatus = (GBLcdStatus*)(pMemoryMapper->pBaseAddress + 0xFF41);
-    pPpuState->lcdRegisters.pScy    = pMemoryMapper->pBaseAddress + 0xFF42;
-    pPpuState->lcdRegisters.pScx    = pMemoryMapper->pBaseAddress + 0xFF43;
-    pPpuState->lcdRegisters.pLy     = pMemoryMapper->pBaseAddress + 0xFF44;
-    pPpuState->lcdRegisters.pLyc    = pMemoryMapper->pBaseAddress + 0xFF45;
-    pPpuState->lcdRegisters.pWy     = pMemoryMapper->pBaseAddress + 0xFF4A;
-    pPpuState->lcdRegisters.pWx     = pMemoryMapper->pBaseAddress + 0xFF4B;
+const uint8_t* getTileData( const GBMemoryMapper* pMemoryMapper, const uint8_t tileDataArea )
+{
+    //FK: tileDataArea 0 = signed tile ids relative to 0x9000, 1 = unsigned tile ids relative to 0x8000
+    return pMemoryMapper->memory + getMappedMemoryOffset( tileDataArea ? 0x8000 : 0x9000 );
 }
 
-void patchIOApuMappedMemoryPointer( GBMemoryMapper* pMemoryMapper, GBApuState* pApuState )
+const uint8_t* getTileMap( const GBMemoryMapper* pMemoryMapper, const uint8_t tileMapArea )
 {
-    pApuState->waveChannel.pWavePattern = pMemoryMapper->pBaseAddress + 0xFF30;
+    return pMemoryMapper->memory + getMappedMemoryOffset( tileMapArea ? 0x9C00 : 0x9800 );
 }
 
 uint8_t calculateGBRomHeaderChecksum( const uint8_t* pRomData )
@@ -1576,298 +1961,1445 @@ uint32_t mapRamSizeToByteSize( uint8_t ramSize )
     return 0;
 }
 
+//FK: Rom and ram banks are mapped by pointer, the rom itself is never copied into the emulator instance
 void mapCartridgeRom0Bank( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMapper, uint16_t romBankNumber )
 {
     RuntimeAssert( romBankNumber < pCartridge->romBankCount );
-    if( pCartridge->mappedRom0BankNumber == romBankNumber )
-    {
-        return;
-    }
 
     pCartridge->mappedRom0BankNumber = romBankNumber;
-
-    const uint8_t* pRomBank = pCartridge->pRomBaseAddress + romBankNumber * gbRomBankSizeInBytes;
-    memcpy( pMemoryMapper->pRom0Bank, pRomBank, gbRomBankSizeInBytes );
+    pMemoryMapper->pRom0Bank = pCartridge->pRomBaseAddress + romBankNumber * gbRomBankSizeInBytes;
 }
 
 void mapCartridgeRom1Bank( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMapper, uint16_t romBankNumber )
 {
     RuntimeAssert( romBankNumber < pCartridge->romBankCount );
-    if( pCartridge->mappedRom1BankNumber == romBankNumber )
-    {
-        return;
-    }
 
     pCartridge->mappedRom1BankNumber = romBankNumber;
-
-    const uint8_t* pRomBank = pCartridge->pRomBaseAddress + romBankNumber * gbRomBankSizeInBytes;
-    memcpy( pMemoryMapper->pRom1Bank, pRomBank, gbRomBankSizeInBytes );
+    pMemoryMapper->pRom1Bank = pCartridge->pRomBaseAddress + romBankNumber * gbRomBankSizeInBytes;
 }
 
+//FK: Cartridges with less than 8kB of ram (eg: 2kB) have a single, smaller bank
 void mapCartridgeRamBank( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMapper, uint8_t ramBankNumber )
 {
-    RuntimeAssert( ramBankNumber < pCartridge->ramBankCount );
-    if( pCartridge->mappedRamBankNumber == ramBankNumber )
+    RuntimeAssert( ramBankNumber == 0u || ramBankNumber < pCartridge->ramBankCount );
+
+    pCartridge->mappedRamBankNumber = ramBankNumber;
+    if( pCartridge->ramSizeInBytes == 0u )
     {
+        pMemoryMapper->pRamBank             = nullptr;
+        pMemoryMapper->ramBankSizeInBytes   = 0u;
         return;
     }
 
-    pCartridge->mappedRamBankNumber = ramBankNumber;
+    const size_t ramBankOffset = ramBankNumber * gbRamBankSizeInBytes;
+    pMemoryMapper->pRamBank             = pCartridge->pRamBaseAddress + ramBankOffset;
+    pMemoryMapper->ramBankSizeInBytes   = ( uint16_t )GetMin( gbRamBankSizeInBytes, pCartridge->ramSizeInBytes - ramBankOffset );
+}
 
-    const uint8_t* pRamBank = pCartridge->pRamBaseAddress + ramBankNumber * gbRamBankSizeInBytes;
-    memcpy( pMemoryMapper->pRamBankSwitch, pRamBank, gbRamBankSizeInBytes );
+//FK: Points the memory mapper at the rom/ram banks that are mapped according to the cartridge state (eg: after a state has been loaded)
+void remapCartridgeBanks( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMapper )
+{
+    mapCartridgeRom0Bank( pCartridge, pMemoryMapper, pCartridge->mappedRom0BankNumber );
+    mapCartridgeRom1Bank( pCartridge, pMemoryMapper, pCartridge->mappedRom1BankNumber );
+    mapCartridgeRamBank( pCartridge, pMemoryMapper, pCartridge->mappedRamBankNumber );
 }
 
 bool8_t isGBEmulatorRomMapped( const GBEmulatorInstance* pEmulatorInstance )
 {
-    return pEmulatorInstance->pCartridge->pRomBaseAddress != nullptr;
+    return pEmulatorInstance->cartridge.pRomBaseAddress != nullptr;
 }
 
 GBRomHeader getGBEmulatorCurrentCartridgeHeader( const GBEmulatorInstance* pEmulatorInstance )
 {
-    RuntimeAssert( pEmulatorInstance->pCartridge->pRomBaseAddress != nullptr );
-    return getGBRomHeader( pEmulatorInstance->pCartridge->pRomBaseAddress );
+    RuntimeAssert( pEmulatorInstance->cartridge.pRomBaseAddress != nullptr );
+    return getGBRomHeader( pEmulatorInstance->cartridge.pRomBaseAddress );
 }
 
-size_t calculateCompressedMemorySizeRLE( const uint8_t* pMemory, size_t memorySizeInBytes )
+static inline uint32_t read32BitValueUnaligned( const uint8_t* pMemory )
 {
-    size_t compressedMemorySizeInBytes = sizeof( uint32_t ); //FK: Compressed memory size in bytes
-    uint16_t tokenCounter = 1;
-    uint8_t token = pMemory[0];
+    uint32_t value;
+    memcpy( &value, pMemory, sizeof( uint32_t ) );
+    return value;
+}
 
-    for( size_t offset = 1; offset < memorySizeInBytes; ++offset )
+//FK: Non-cryptographic 64 bit hash (eg: to compare framebuffers or states without keeping them around).
+//    Hashes 4 interleaved lanes to not be bound by the latency of the multiplication.
+uint64_t calculateGBMemoryHash( const uint8_t* pMemory, const size_t memorySizeInBytes )
+{
+    uint64_t lanes[ 4 ] = { 0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull };
+    for( size_t offset = 0u; offset < memorySizeInBytes; offset += sizeof( lanes ) )
     {
-        if( pMemory[offset] == token )
+        uint64_t values[ 4 ] = {};
+        const size_t remainingSizeInBytes = memorySizeInBytes - offset;
+        memcpy( values, pMemory + offset, remainingSizeInBytes < sizeof( values ) ? remainingSizeInBytes : sizeof( values ) );
+        for( uint32_t laneIndex = 0u; laneIndex < 4u; ++laneIndex )
         {
-            ++tokenCounter;
-            continue;
+            lanes[ laneIndex ] = ( lanes[ laneIndex ] ^ values[ laneIndex ] ) * 0xFF51AFD7ED558CCDull;
+            lanes[ laneIndex ] ^= lanes[ laneIndex ] >> 32u;
         }
+    }
 
-        compressedMemorySizeInBytes += sizeof(uint16_t); //FK: token counter
-        compressedMemorySizeInBytes += gbCompressionTokenSizeInBytes; //FK: token
-        token = pMemory[offset];
-        tokenCounter = 1;
+    uint64_t hash = lanes[ 0 ] ^ ( uint64_t )memorySizeInBytes;
+    for( uint32_t laneIndex = 1u; laneIndex < 4u; ++laneIndex )
+    {
+        hash = ( hash ^ lanes[ laneIndex ] ) * 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 29u;
     }
-    
-    compressedMemorySizeInBytes += sizeof(uint16_t); //FK: token counter
-    compressedMemorySizeInBytes += gbCompressionTokenSizeInBytes; //FK: token
 
-    return compressedMemorySizeInBytes;
+    return hash;
 }
 
-size_t calculateGBEmulatorStateSizeInBytes( const GBEmulatorInstance* pEmulatorInstance )
+static inline uint32_t calculateCompressionHashLZ( const uint32_t sequence )
 {
-    constexpr size_t checksumSizeInBytes   = 2;
-    const size_t compressedRAMSizeInBytes  = calculateCompressedMemorySizeRLE( pEmulatorInstance->pMemoryMapper->pBaseAddress + 0x8000, 0x8000 );
-    const size_t stateSizeInBytes = sizeof( GBEmulatorState ) + sizeof( gbStateFourCC ) + checksumSizeInBytes + sizeof(gbStateVersion) + compressedRAMSizeInBytes;
-    return stateSizeInBytes;
+    //FK: Knuth's multiplicative hash, top bits select the hash table slot
+    return ( sequence * 2654435761u ) >> ( 32u - gbCompressionHashTableSizeLog2 );
+}
+
+size_t calculateCompressedMemoryBoundLZ( const size_t memorySizeInBytes )
+{
+    //FK: Worst case is a single literal run over the whole block (token + literal length bytes + literals)
+    return memorySizeInBytes + memorySizeInBytes / 255u + 16u;
+}
+
+uint8_t* writeCompressionLengthLZ( uint8_t* pDestination, size_t length )
+{
+    while( length >= 255u )
+    {
+        *pDestination++ = 255u;
+        length -= 255u;
+    }
+
+    *pDestination++ = ( uint8_t )length;
+    return pDestination;
 }
 
-size_t compressMemoryBlockRLE( uint8_t* pDestination, const uint8_t* pSource, size_t memorySizeInBytes )
+uint8_t* writeCompressionSequenceLZ( uint8_t* pDestination, const uint8_t* pLiterals, const size_t literalCount, const size_t matchLength, const uint16_t matchOffset )
 {
-    size_t compressedMemorySizeInBytes = sizeof( uint32_t );
-    uint16_t tokenCounter = 1;
-    uint8_t token = pSource[0];
+    //FK: Sequence layout (LZ4 block style):
+    //    token (4 bit literal count | 4 bit match length - min match) | literal count extension | literals | offset | match length extension
+    uint8_t* pToken = pDestination++;
 
-    uint8_t* pDestinationBaseAddress = pDestination;
-    pDestination += sizeof( uint32_t ); //FK: store compressed memory size at beginning of compressed memory block
+    uint8_t token = literalCount >= 15u ? 0xF0 : ( uint8_t )( literalCount << 4u );
+    if( literalCount >= 15u )
+    {
+        pDestination = writeCompressionLengthLZ( pDestination, literalCount - 15u );
+    }
 
-    for( size_t offset = 1; offset < memorySizeInBytes; ++offset )
+    memcpy( pDestination, pLiterals, literalCount );
+    pDestination += literalCount;
+
+    if( matchLength > 0u )
     {
-        if( pSource[offset] == token )
+        memcpy( pDestination, &matchOffset, sizeof( uint16_t ) );
+        pDestination += sizeof( uint16_t );
+
+        const size_t matchLengthToken = matchLength - gbCompressionMinMatchSizeInBytes;
+        token |= matchLengthToken >= 15u ? 0x0F : ( uint8_t )matchLengthToken;
+        if( matchLengthToken >= 15u )
         {
-            ++tokenCounter;
-            continue;
+            pDestination = writeCompressionLengthLZ( pDestination, matchLengthToken - 15u );
         }
+    }
 
-        compressedMemorySizeInBytes += sizeof( uint16_t ); //FK: token counter
-        compressedMemorySizeInBytes += 1; //FK: token
+    *pToken = token;
+    return pDestination;
+}
 
-        memcpy(pDestination, &tokenCounter, sizeof( uint16_t ) );
+//FK: Single pass LZ77 compressor (LZ4 block format without the end of block restrictions).
+//    pDestination has to be able to hold at least calculateCompressedMemoryBoundLZ( memorySizeInBytes ) bytes.
+size_t compressMemoryBlockLZ( uint8_t* pDestination, const uint8_t* pSource, const size_t memorySizeInBytes )
+{
+    uint32_t hashTable[ 1u << gbCompressionHashTableSizeLog2 ];
+    memset( hashTable, 0, sizeof( hashTable ) );
 
-        pDestination[2] = token;
-        pDestination += 3;
+    uint8_t* pDestinationStart          = pDestination;
+    const uint8_t* pSourceEnd           = pSource + memorySizeInBytes;
+    const uint8_t* pMatchSearchEnd      = memorySizeInBytes > gbCompressionMinMatchSizeInBytes ? pSourceEnd - gbCompressionMinMatchSizeInBytes : pSource;
+    const uint8_t* pAnchor              = pSource;
+    const uint8_t* pCurrent             = pSource;
+    uint32_t missCounter                = 0u;
 
-        token = pSource[offset];
-        tokenCounter = 1;
-    }
+    while( pCurrent < pMatchSearchEnd )
+    {
+        const uint32_t sequence         = read32BitValueUnaligned( pCurrent );
+        const uint32_t hash             = calculateCompressionHashLZ( sequence );
+        const uint8_t* pCandidate       = pSource + hashTable[ hash ];
+        const size_t matchOffset        = ( size_t )( pCurrent - pCandidate );
+        hashTable[ hash ]               = ( uint32_t )( pCurrent - pSource );
 
-    compressedMemorySizeInBytes += sizeof( uint16_t );  
-    compressedMemorySizeInBytes += gbCompressionTokenSizeInBytes;                   
-    memcpy( pDestination, &tokenCounter, sizeof( uint16_t ) );
-    pDestination[2] = token;
+        if( matchOffset == 0u || matchOffset > gbCompressionMaxMatchOffset || read32BitValueUnaligned( pCandidate ) != sequence )
+        {
+            //FK: Skip faster through incompressible data
+            pCurrent += 1u + ( missCounter++ >> 6u );
+            continue;
+        }
 
-    //FK: write compressed memory size in bytes at the beginning of the memory block
-    memcpy( pDestinationBaseAddress, &compressedMemorySizeInBytes, sizeof( uint32_t ) );
+        size_t matchLength = gbCompressionMinMatchSizeInBytes;
 
-    return compressedMemorySizeInBytes;
-}
+        //FK: Compare 8 bytes at once first, long matches are common for (delta) states
+        while( pCurrent + matchLength + sizeof( uint64_t ) <= pSourceEnd && memcmp( pCandidate + matchLength, pCurrent + matchLength, sizeof( uint64_t ) ) == 0 )
+        {
+            matchLength += sizeof( uint64_t );
+        }
 
-void storeGBEmulatorState( const GBEmulatorInstance* pEmulatorInstance, uint8_t* pStateMemory, size_t stateMemorySizeInBytes )
-{
-    const GBCpuState* pCpuState         = pEmulatorInstance->pCpuState;
-    const GBPpuState* pPpuState         = pEmulatorInstance->pPpuState;
-    const GBApuState* pApuState         = pEmulatorInstance->pApuState;
-    const GBTimerState* pTimerState     = pEmulatorInstance->pTimerState;
-    const GBMemoryMapper* pMemoryMapper = pEmulatorInstance->pMemoryMapper;
-    const GBSerialState* pSerialState   = pEmulatorInstance->pSerialState;
-    const GBCartridge* pCartridge       = pEmulatorInstance->pCartridge;
+        while( pCurrent + matchLength < pSourceEnd && pCandidate[ matchLength ] == pCurrent[ matchLength ] )
+        {
+            ++matchLength;
+        }
 
-    const GBRomHeader header = getGBEmulatorCurrentCartridgeHeader( pEmulatorInstance );
-    const uint16_t cartridgeChecksum = header.checksumHigher << 8 | header.checksumLower;
+        pDestination = writeCompressionSequenceLZ( pDestination, pAnchor, ( size_t )( pCurrent - pAnchor ), matchLength, ( uint16_t )matchOffset );
+        pCurrent    += matchLength;
+        pAnchor      = pCurrent;
+        missCounter  = 0u;
+    }
 
-    GBEmulatorState state;
-    state.cpuState                  = *pCpuState;
-    state.ppuState                  = *pPpuState;
-    state.apuState                  = *pApuState;
-    state.timerState                = *pTimerState;
-    state.serialState               = *pSerialState;
-    state.cartridge                 = *pCartridge;
-    state.mappedRom0BankNumber      = pCartridge->mappedRom0BankNumber;
-    state.mappedRom1BankNumber      = pCartridge->mappedRom1BankNumber;
-    state.mappedRamBankNumber       = pCartridge->mappedRamBankNumber;
+    if( pAnchor < pSourceEnd || pDestination == pDestinationStart )
+    {
+        //FK: Last sequence only consists of literals
+        pDestination = writeCompressionSequenceLZ( pDestination, pAnchor, ( size_t )( pSourceEnd - pAnchor ), 0u, 0u );
+    }
 
-    memcpy( pStateMemory, &gbStateFourCC, sizeof( gbStateFourCC ) );
-    pStateMemory += sizeof( gbStateFourCC );
+    return ( size_t )( pDestination - pDestinationStart );
+}
 
-    memcpy( pStateMemory, &cartridgeChecksum, sizeof( cartridgeChecksum ) );
-    pStateMemory += sizeof( cartridgeChecksum );
+void extractGBEmulatorState( const GBEmulatorInstance* pEmulatorInstance, GBEmulatorState* pOutState )
+{
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
 
-    *pStateMemory = gbStateVersion;
-    ++pStateMemory;
+    pOutState->cpuState                 = pEmulatorInstance->cpuState;
+    pOutState->ppuState                 = pEmulatorInstance->ppuState;
+    pOutState->apuState                 = pEmulatorInstance->apuState;
+    pOutState->timerState               = pEmulatorInstance->timerState;
+    pOutState->serialState              = pEmulatorInstance->serialState;
+    pOutState->cartridge                = *pCartridge;
+    pOutState->mappedRom0BankNumber     = pCartridge->mappedRom0BankNumber;
+    pOutState->mappedRom1BankNumber     = pCartridge->mappedRom1BankNumber;
+    pOutState->mappedRamBankNumber      = pCartridge->mappedRamBankNumber;
+}
 
-    memcpy( pStateMemory, &state, sizeof( GBEmulatorState ) );
-    pStateMemory += sizeof( GBEmulatorState );
+void storeGBCpuStateChunk( const GBCpuState* pCpuState, GBCpuStateChunk* pOutChunk )
+{
+    pOutChunk->AF               = pCpuState->registers.AF;
+    pOutChunk->BC               = pCpuState->registers.BC;
+    pOutChunk->DE               = pCpuState->registers.DE;
+    pOutChunk->HL               = pCpuState->registers.HL;
+    pOutChunk->SP               = pCpuState->registers.SP;
+    pOutChunk->PC               = pCpuState->registers.PC;
+    pOutChunk->cycleCounter     = pCpuState->cycleCounter;
+    pOutChunk->dmaAddress       = pCpuState->dmaAddress;
+    pOutChunk->dmaCycleCounter  = pCpuState->dmaCycleCounter;
+    pOutChunk->IME              = pCpuState->flags.IME;
+    pOutChunk->halt             = pCpuState->flags.halt;
+    pOutChunk->stop             = pCpuState->flags.stop;
+    pOutChunk->dma              = pCpuState->flags.dma;
+    pOutChunk->haltBug          = pCpuState->flags.haltBug;
+    pOutChunk->pendingEI        = pCpuState->flags.pendingEI;
+    pOutChunk->totalCycleCounter = pCpuState->totalCycleCounter;
+}
 
-    uint8_t* pCompressedMemory = pStateMemory;
-    
-    //FK: Store cartridge data as well...?
-    compressMemoryBlockRLE( pCompressedMemory, pMemoryMapper->pBaseAddress + 0x8000, 0x8000 );
+void loadGBCpuStateChunk( GBCpuState* pCpuState, const GBCpuStateChunk* pChunk )
+{
+    pCpuState->registers.AF     = pChunk->AF;
+    pCpuState->registers.BC     = pChunk->BC;
+    pCpuState->registers.DE     = pChunk->DE;
+    pCpuState->registers.HL     = pChunk->HL;
+    pCpuState->registers.SP     = pChunk->SP;
+    pCpuState->registers.PC     = pChunk->PC;
+    pCpuState->cycleCounter     = pChunk->cycleCounter;
+    pCpuState->dmaAddress       = pChunk->dmaAddress;
+    pCpuState->dmaCycleCounter  = pChunk->dmaCycleCounter;
+    pCpuState->flags.IME        = pChunk->IME;
+    pCpuState->flags.halt       = pChunk->halt;
+    pCpuState->flags.stop       = pChunk->stop;
+    pCpuState->flags.dma        = pChunk->dma;
+    pCpuState->flags.haltBug    = pChunk->haltBug;
+    pCpuState->flags.pendingEI  = pChunk->pendingEI;
+    pCpuState->totalCycleCounter = pChunk->totalCycleCounter;
 }
 
-size_t uncompressMemoryBlockRLE( uint8_t* pDestination, const uint8_t* pSource )
+void storeGBPpuStateChunk( const GBPpuState* pPpuState, GBPpuStateChunk* pOutChunk )
 {
-    uint32_t compressedMemorySizeInBytes;
-    memcpy( &compressedMemorySizeInBytes, pSource, sizeof( uint32_t ) );
+    pOutChunk->cycleCounter             = pPpuState->cycleCounter;
+    pOutChunk->dotCounter               = pPpuState->dotCounter;
+    pOutChunk->scanlineSpriteCounter    = pPpuState->scanlineSpriteCounter;
+    pOutChunk->activeFrameBufferIndex   = pPpuState->activeFrameBufferIndex;
+    pOutChunk->drawObjects              = pPpuState->flags.drawObjects;
+    pOutChunk->drawBackground           = pPpuState->flags.drawBackground;
+    pOutChunk->drawWindow               = pPpuState->flags.drawWindow;
+    memcpy( pOutChunk->scanlineSprites, pPpuState->scanlineSprites, sizeof( pOutChunk->scanlineSprites ) );
+    memcpy( pOutChunk->objectMonochromePalette, pPpuState->objectMonochromePlatte, sizeof( pOutChunk->objectMonochromePalette ) );
+    memcpy( pOutChunk->backgroundMonochromePalette, pPpuState->backgroundMonochromePalette, sizeof( pOutChunk->backgroundMonochromePalette ) );
+}
 
-    size_t sourceMemoryIndex = sizeof( uint32_t );
-    size_t destinationMemoryIndex = 0;
-    while( sourceMemoryIndex < compressedMemorySizeInBytes )
-    {
-        uint16_t tokenCount;
-        memcpy( &tokenCount, pSource + sourceMemoryIndex, sizeof( uint16_t ) );
+void loadGBPpuStateChunk( GBPpuState* pPpuState, const GBPpuStateChunk* pChunk )
+{
+    pPpuState->cycleCounter             = pChunk->cycleCounter;
+    pPpuState->dotCounter               = pChunk->dotCounter;
+    pPpuState->scanlineSpriteCounter    = pChunk->scanlineSpriteCounter;
+    pPpuState->activeFrameBufferIndex   = pChunk->activeFrameBufferIndex % gbFrameBufferCount;
+    pPpuState->flags.drawObjects        = pChunk->drawObjects;
+    pPpuState->flags.drawBackground     = pChunk->drawBackground;
+    pPpuState->flags.drawWindow         = pChunk->drawWindow;
+    memcpy( pPpuState->scanlineSprites, pChunk->scanlineSprites, sizeof( pChunk->scanlineSprites ) );
+    memcpy( pPpuState->objectMonochromePlatte, pChunk->objectMonochromePalette, sizeof( pChunk->objectMonochromePalette ) );
+    memcpy( pPpuState->backgroundMonochromePalette, pChunk->backgroundMonochromePalette, sizeof( pChunk->backgroundMonochromePalette ) );
+}
 
-        const uint8_t token = pSource[sourceMemoryIndex + 2];
-        memset( pDestination + destinationMemoryIndex, token, tokenCount );
+void storeGBApuStateChunk( const GBApuState* pApuState, GBApuStateChunk* pOutChunk )
+{
+    pOutChunk->waveSamplePosition               = pApuState->waveChannel.samplePosition;
+    pOutChunk->waveCycleCount                   = pApuState->waveChannel.cycleCount;
+    pOutChunk->waveFrequencyCycleCountTarget    = pApuState->waveChannel.frequencyCycleCountTarget;
+    pOutChunk->frameSequencerCycleCounter       = pApuState->frameSequencer.cycleCounter;
+    pOutChunk->squareWave1LengthTimer           = pApuState->squareWaveChannel1.lengthTimer;
+    pOutChunk->squareWave2LengthTimer           = pApuState->squareWaveChannel2.lengthTimer;
+    pOutChunk->waveLengthTimer                  = pApuState->waveChannel.lengthTimer;
+    pOutChunk->noiseLengthTimer                 = pApuState->noiseChannel.lengthTimer;
+    pOutChunk->waveCurrentSample                = pApuState->waveChannel.currentSample;
+    pOutChunk->waveChannelEnabled               = pApuState->waveChannel.channelEnabled;
+    pOutChunk->waveVolumeShift                  = pApuState->waveChannel.volumeShift;
+    pOutChunk->frameSequencerClockCounter       = pApuState->frameSequencer.clockCounter;
+}
+
+void loadGBApuStateChunk( GBApuState* pApuState, const GBApuStateChunk* pChunk )
+{
+    pApuState->waveChannel.samplePosition               = pChunk->waveSamplePosition;
+    pApuState->waveChannel.cycleCount                   = pChunk->waveCycleCount;
+    pApuState->waveChannel.frequencyCycleCountTarget    = pChunk->waveFrequencyCycleCountTarget;
+    pApuState->frameSequencer.cycleCounter              = pChunk->frameSequencerCycleCounter;
+    pApuState->squareWaveChannel1.lengthTimer           = pChunk->squareWave1LengthTimer;
+    pApuState->squareWaveChannel2.lengthTimer           = pChunk->squareWave2LengthTimer;
+    pApuState->waveChannel.lengthTimer                  = pChunk->waveLengthTimer;
+    pApuState->noiseChannel.lengthTimer                 = pChunk->noiseLengthTimer;
+    pApuState->waveChannel.currentSample                = pChunk->waveCurrentSample;
+    pApuState->waveChannel.channelEnabled               = pChunk->waveChannelEnabled;
+    pApuState->waveChannel.volumeShift                  = pChunk->waveVolumeShift;
+    pApuState->frameSequencer.clockCounter              = pChunk->frameSequencerClockCounter;
+}
+
+void storeGBTimerStateChunk( const GBTimerState* pTimerState, GBTimerStateChunk* pOutChunk )
+{
+    pOutChunk->internalDivCounter   = pTimerState->internalDivCounter;
+    pOutChunk->counterFrequencyBit  = pTimerState->counterFrequencyBit;
+    pOutChunk->enableCounter        = pTimerState->enableCounter;
+    pOutChunk->timerOverflow        = pTimerState->timerOverflow;
+    pOutChunk->timerLoading         = pTimerState->timerLoading;
+}
+
+void loadGBTimerStateChunk( GBTimerState* pTimerState, const GBTimerStateChunk* pChunk )
+{
+    pTimerState->internalDivCounter     = pChunk->internalDivCounter;
+    pTimerState->counterFrequencyBit    = pChunk->counterFrequencyBit;
+    pTimerState->enableCounter          = pChunk->enableCounter;
+    pTimerState->timerOverflow          = pChunk->timerOverflow;
+    pTimerState->timerLoading           = pChunk->timerLoading;
+}
 
-        sourceMemoryIndex += sizeof( uint16_t ) + gbCompressionTokenSizeInBytes;
-        destinationMemoryIndex += tokenCount;
-    }
+void storeGBSerialStateChunk( const GBSerialState* pSerialState, GBSerialStateChunk* pOutChunk )
+{
+    pOutChunk->cycleCounter     = pSerialState->cycleCounter;
+    pOutChunk->shiftIndex       = pSerialState->shiftIndex;
+    pOutChunk->inByte           = pSerialState->inByte;
+    pOutChunk->initiateTransfer = pSerialState->initiateTransfer;
+    pOutChunk->useInternalClock = pSerialState->useInternalClock;
+}
 
-    return compressedMemorySizeInBytes;
+void loadGBSerialStateChunk( GBSerialState* pSerialState, const GBSerialStateChunk* pChunk )
+{
+    pSerialState->cycleCounter      = pChunk->cycleCounter;
+    pSerialState->shiftIndex        = pChunk->shiftIndex;
+    pSerialState->inByte            = pChunk->inByte;
+    pSerialState->initiateTransfer  = pChunk->initiateTransfer;
+    pSerialState->useInternalClock  = pChunk->useInternalClock;
 }
 
-GBStateLoadResult loadGBEmulatorState( GBEmulatorInstance* pEmulatorInstance, const uint8_t* pStateMemory )
+void storeGBMbcStateChunk( const GBCartridge* pCartridge, GBMbcStateChunk* pOutChunk )
 {
-    uint32_t fourCC;
-    memcpy( &fourCC, pStateMemory, sizeof( gbStateFourCC ) );
-    pStateMemory += sizeof( gbStateFourCC );
+    pOutChunk->mappedRom0BankNumber = pCartridge->mappedRom0BankNumber;
+    pOutChunk->mappedRom1BankNumber = pCartridge->mappedRom1BankNumber;
+    pOutChunk->mappedRamBankNumber  = pCartridge->mappedRamBankNumber;
+    pOutChunk->highBankValue        = pCartridge->highBankValue;
+    pOutChunk->lowBankValue         = pCartridge->lowBankValue;
+    pOutChunk->ramEnabled           = pCartridge->ramEnabled;
+    pOutChunk->bankingMode          = pCartridge->bankingMode;
+}
 
-    if( fourCC != gbStateFourCC )
+bool8_t isGBMbcStateChunkValid( const GBCartridge* pCartridge, const GBMbcStateChunk* pChunk )
+{
+    if( pChunk->mappedRom0BankNumber >= pCartridge->romBankCount || pChunk->mappedRom1BankNumber >= pCartridge->romBankCount )
     {
-        return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        return 0u;
     }
 
-    const uint16_t stateCartridgeChecksum = *(uint16_t*)pStateMemory;
-    pStateMemory += sizeof( stateCartridgeChecksum );
-
-    const GBRomHeader cartridgeHeader = getGBEmulatorCurrentCartridgeHeader( pEmulatorInstance );
-
-    const uint16_t cartridgeChecksum = cartridgeHeader.checksumHigher << 8 | cartridgeHeader.checksumLower;
-    if( cartridgeChecksum != stateCartridgeChecksum )
+    if( pCartridge->ramBankCount > 0u && pChunk->mappedRamBankNumber >= pCartridge->ramBankCount )
     {
-        return K15_GB_STATE_LOAD_FAILED_WRONG_ROM;
+        return 0u;
     }
 
-    const uint8_t stateVersion = *pStateMemory;
-    ++pStateMemory;
+    return 1u;
+}
 
-    if( stateVersion != gbStateVersion )
+bool8_t loadGBMbcStateChunk( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMapper, const GBMbcStateChunk* pChunk )
+{
+    if( !isGBMbcStateChunkValid( pCartridge, pChunk ) )
     {
-        return K15_GB_STATE_LOAD_FAILED_OLD_VERSION;
+        return 0u;
     }
 
-    GBMemoryMapper* pMemoryMapper = pEmulatorInstance->pMemoryMapper;
-
-    uint8_t* pGBFrameBuffers[ gbFrameBufferCount ] = { 
-        pEmulatorInstance->pPpuState->pGBFrameBuffers[ 0 ],
-        pEmulatorInstance->pPpuState->pGBFrameBuffers[ 1 ]
-    };
+    pCartridge->highBankValue   = pChunk->highBankValue;
+    pCartridge->lowBankValue    = pChunk->lowBankValue;
+    pCartridge->ramEnabled      = pChunk->ramEnabled;
+    pCartridge->bankingMode     = pChunk->bankingMode;
 
-    GBEmulatorState state;
-    memcpy( &state, pStateMemory, sizeof( GBEmulatorState ) );
-    pStateMemory += sizeof( GBEmulatorState );
+    mapCartridgeRom0Bank( pCartridge, pMemoryMapper, pChunk->mappedRom0BankNumber );
+    mapCartridgeRom1Bank( pCartridge, pMemoryMapper, pChunk->mappedRom1BankNumber );
 
-    const uint8_t* pRomBaseAddress  = pEmulatorInstance->pCartridge->pRomBaseAddress;
-    uint8_t* pRamBaseAddress        = pEmulatorInstance->pCartridge->pRamBaseAddress;
+    //FK: Cartridges without ram banks always have bank 0 mapped
+    mapCartridgeRamBank( pCartridge, pMemoryMapper, pCartridge->ramBankCount > 0u ? pChunk->mappedRamBankNumber : 0u );
 
-    *pEmulatorInstance->pCpuState       = state.cpuState;
-    *pEmulatorInstance->pPpuState       = state.ppuState;
-    *pEmulatorInstance->pApuState       = state.apuState;
-    *pEmulatorInstance->pTimerState     = state.timerState;
-    *pEmulatorInstance->pSerialState    = state.serialState;
-    *pEmulatorInstance->pCartridge      = state.cartridge;
+    return 1u;
+}
 
-    GBCartridge* pCartridge = pEmulatorInstance->pCartridge;
-    pCartridge->pRomBaseAddress     = pRomBaseAddress;
-    pCartridge->pRamBaseAddress     = pRamBaseAddress;
-    pCartridge->header              = getGBRomHeader( pRomBaseAddress );
+size_t calculateGBStateChunkSizeInBytes( const size_t chunkDataSizeInBytes, const bool8_t compressChunkData )
+{
+    const size_t storedDataSizeInBytes = compressChunkData ? calculateCompressedMemoryBoundLZ( chunkDataSizeInBytes ) : chunkDataSizeInBytes;
+    return sizeof( GBStateChunkHeader ) + storedDataSizeInBytes;
+}
 
-    const size_t romSizeInBytes = mapRomSizeToByteSize( pCartridge->header.romSize );
-    pCartridge->mappedRom1BankNumber = 0xFF;
-    pCartridge->mappedRom0BankNumber = 0xFF;
-    pCartridge->romBankCount         = ( uint16_t )( romSizeInBytes / gbRomBankSizeInBytes );
-    mapCartridgeRom0Bank( pCartridge, pEmulatorInstance->pMemoryMapper, state.mappedRom0BankNumber );
-    mapCartridgeRom1Bank( pCartridge, pEmulatorInstance->pMemoryMapper, state.mappedRom1BankNumber );
+uint8_t* writeGBStateChunk( uint8_t* pStateMemory, const uint32_t tag, const void* pChunkData, const size_t chunkDataSizeInBytes, const bool8_t compressChunkData )
+{
+    GBStateChunkHeader header;
+    header.tag                      = tag;
+    header.sizeInBytes              = castSizeToUint32( chunkDataSizeInBytes );
+    header.compressedSizeInBytes    = 0u;
 
-    const size_t ramSizeInBytes = mapRamSizeToByteSize( pCartridge->header.ramSize );
-    if( ramSizeInBytes > 0u )
+    uint8_t* pChunkDataTarget = pStateMemory + sizeof( GBStateChunkHeader );
+    size_t storedDataSizeInBytes = chunkDataSizeInBytes;
+    if( compressChunkData )
     {
-        pCartridge->mappedRamBankNumber = 0xFF;
-        pCartridge->ramBankCount = ( uint8_t )( ramSizeInBytes / gbRamBankSizeInBytes );
-        mapCartridgeRamBank( pCartridge, pEmulatorInstance->pMemoryMapper, 0 );
+        storedDataSizeInBytes = compressMemoryBlockLZ( pChunkDataTarget, ( const uint8_t* )pChunkData, chunkDataSizeInBytes );
+        header.compressedSizeInBytes = castSizeToUint32( storedDataSizeInBytes );
+    }
+    else
+    {
+        memcpy( pChunkDataTarget, pChunkData, chunkDataSizeInBytes );
     }
 
-    patchIOTimerMappedMemoryPointer( pMemoryMapper, pEmulatorInstance->pTimerState );
-    patchIOPpuMappedMemoryPointer( pMemoryMapper, pEmulatorInstance->pPpuState );
-    patchIOCpuMappedMemoryPointer( pMemoryMapper, pEmulatorInstance->pCpuState );
+    memcpy( pStateMemory, &header, sizeof( GBStateChunkHeader ) );
+    return pChunkDataTarget + storedDataSizeInBytes;
+}
 
-    pEmulatorInstance->pPpuState->pGBFrameBuffers[ 0 ] = pGBFrameBuffers[ 0 ];
-    pEmulatorInstance->pPpuState->pGBFrameBuffers[ 1 ] = pGBFrameBuffers[ 1 ];
+size_t calculateGBStateSizeInBytes( const uint32_t cartridgeRamSizeInBytes )
+{
+    constexpr size_t checksumSizeInBytes        = 2;
+    constexpr size_t chunkDataSizeSizeInBytes   = sizeof( uint32_t );
 
-    pMemoryMapper->lcdStatus  = *pEmulatorInstance->pPpuState->lcdRegisters.pStatus;
-    pMemoryMapper->dmaActive  = pEmulatorInstance->pCpuState->flags.dma;
-    pMemoryMapper->lcdEnabled = pEmulatorInstance->pPpuState->pLcdControl->enable;
-    pMemoryMapper->ramEnabled = pEmulatorInstance->pCartridge->ramEnabled;
+    size_t stateSizeInBytes = sizeof( gbStateFourCC ) + checksumSizeInBytes + sizeof( gbStateVersion ) + chunkDataSizeSizeInBytes;
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBCpuStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBPpuStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBApuStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBTimerStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBSerialStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( sizeof( GBMbcStateChunk ), 0u );
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( 0x2000, 1u );                     //FK: VRAM
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( 0x2000, 1u );                     //FK: WRAM
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( 0xA0, 0u );                       //FK: OAM
+    stateSizeInBytes += calculateGBStateChunkSizeInBytes( 0x100, 0u );                      //FK: IO registers + HRAM
 
-    const uint8_t* pCompressedMemory = pStateMemory;
-    uncompressMemoryBlockRLE( pMemoryMapper->pBaseAddress + 0x8000, pCompressedMemory );
-    return K15_GB_STATE_LOAD_SUCCESS;
+    if( cartridgeRamSizeInBytes > 0u )
+    {
+        stateSizeInBytes += calculateGBStateChunkSizeInBytes( cartridgeRamSizeInBytes, 1u );
+    }
+
+    return stateSizeInBytes;
 }
 
-bool8_t allowReadFromMemoryAddress( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset )
+size_t calculateGBEmulatorStateSizeInBytes( const GBEmulatorInstance* pEmulatorInstance )
 {
-    //FK: Don't allow VRAM and OAM access while ppu is in mode 3 or 2 (drawing and oam search respectively)
-    if( pMemoryMapper->lcdEnabled )
-    {
-        if ( pMemoryMapper->lcdStatus.mode == 3 )
-        {
-            if( isInOAMAddressRange( addressOffset ) ||
-                isInVideoRamAddressRange( addressOffset ) )
-            {
-                return 0;
-            }
-        }
+    //FK: Cheap upper bound - the actual state size is returned by storeGBEmulatorState()
+    return calculateGBStateSizeInBytes( pEmulatorInstance->cartridge.ramSizeInBytes );
+}
+
+//FK: Upper bound of the state size of any rom
+size_t calculateGBEmulatorMaxStateSizeInBytes()
+{
+    return calculateGBStateSizeInBytes( gbMaxRamSizeInBytes );
+}
+
+//FK: pMappedMemory points to the mapped memory of the memory mapper (vram, wram and 0xFE00-0xFFFF)
+size_t writeGBEmulatorState( const GBEmulatorState* pState, const uint8_t* pMappedMemory, const uint8_t* pCartridgeRam, uint8_t* pStateMemory )
+{
+    const GBRomHeader* pHeader = &pState->cartridge.header;
+    const uint16_t cartridgeChecksum = pHeader->checksumHigher << 8 | pHeader->checksumLower;
+
+    uint8_t* pStateMemoryStart = pStateMemory;
+
+    memcpy( pStateMemory, &gbStateFourCC, sizeof( gbStateFourCC ) );
+    pStateMemory += sizeof( gbStateFourCC );
+
+    memcpy( pStateMemory, &cartridgeChecksum, sizeof( cartridgeChecksum ) );
+    pStateMemory += sizeof( cartridgeChecksum );
+
+    *pStateMemory = gbStateVersion;
+    ++pStateMemory;
+
+    //FK: Size of all chunks gets patched in after the chunks have been written
+    uint8_t* pChunkDataSize = pStateMemory;
+    pStateMemory += sizeof( uint32_t );
+
+    uint8_t* pChunkDataStart = pStateMemory;
+
+    GBCpuStateChunk cpuChunk;
+    GBPpuStateChunk ppuChunk;
+    GBApuStateChunk apuChunk;
+    GBTimerStateChunk timerChunk;
+    GBSerialStateChunk serialChunk;
+    GBMbcStateChunk mbcChunk;
+
+    //FK: Chunks contain padding, which would otherwise end up in the state as whatever was on the stack
+    memset( &cpuChunk, 0, sizeof( cpuChunk ) );
+    memset( &ppuChunk, 0, sizeof( ppuChunk ) );
+    memset( &apuChunk, 0, sizeof( apuChunk ) );
+    memset( &timerChunk, 0, sizeof( timerChunk ) );
+    memset( &serialChunk, 0, sizeof( serialChunk ) );
+    memset( &mbcChunk, 0, sizeof( mbcChunk ) );
+
+    storeGBCpuStateChunk( &pState->cpuState, &cpuChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagCpu, &cpuChunk, sizeof( cpuChunk ), 0u );
+
+    storeGBPpuStateChunk( &pState->ppuState, &ppuChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagPpu, &ppuChunk, sizeof( ppuChunk ), 0u );
+
+    storeGBApuStateChunk( &pState->apuState, &apuChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagApu, &apuChunk, sizeof( apuChunk ), 0u );
+
+    storeGBTimerStateChunk( &pState->timerState, &timerChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagTimer, &timerChunk, sizeof( timerChunk ), 0u );
+
+    storeGBSerialStateChunk( &pState->serialState, &serialChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagSerial, &serialChunk, sizeof( serialChunk ), 0u );
+
+    storeGBMbcStateChunk( &pState->cartridge, &mbcChunk );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagMbc, &mbcChunk, sizeof( mbcChunk ), 0u );
+
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagVideoRam, pMappedMemory + gbVideoRamMemoryOffset, 0x2000, 1u );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagWorkRam, pMappedMemory + gbWorkRamMemoryOffset, 0x2000, 1u );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagOAM, pMappedMemory + gbHighMemoryOffset, 0xA0, 0u );
+    pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagHighRam, pMappedMemory + gbHighMemoryOffset + 0x100, 0x100, 0u );
+
+    const uint32_t ramSizeInBytes = pState->cartridge.ramSizeInBytes;
+    if( ramSizeInBytes > 0u )
+    {
+        pStateMemory = writeGBStateChunk( pStateMemory, gbStateChunkTagCartridgeRam, pCartridgeRam, ramSizeInBytes, 1u );
+    }
+
+    const uint32_t chunkDataSizeInBytes = castSizeToUint32( ( size_t )( pStateMemory - pChunkDataStart ) );
+    memcpy( pChunkDataSize, &chunkDataSizeInBytes, sizeof( uint32_t ) );
+
+    return ( size_t )( pStateMemory - pStateMemoryStart );
+}
+
+//FK: Returns 0 if stateMemorySizeInBytes is smaller than calculateGBEmulatorStateSizeInBytes()
+size_t storeGBEmulatorState( const GBEmulatorInstance* pEmulatorInstance, uint8_t* pStateMemory, size_t stateMemorySizeInBytes )
+{
+    RuntimeAssert( isGBEmulatorRomMapped( pEmulatorInstance ) );
+    if( stateMemorySizeInBytes < calculateGBEmulatorStateSizeInBytes( pEmulatorInstance ) )
+    {
+        return 0u;
+    }
+
+    GBEmulatorState state;
+    extractGBEmulatorState( pEmulatorInstance, &state );
+
+    return writeGBEmulatorState( &state, pEmulatorInstance->memoryMapper.memory, pEmulatorInstance->cartridge.pRamBaseAddress, pStateMemory );
+}
+
+//FK: Hashes the same values that get stored in a save state, so the hash doesn't depend on pointers, padding or the layout of the emulator structs
+//    and can be compared between builds and machines. Cheap enough to be calculated every frame (the cost is dominated by hashing ~16KB of mapped
+//    memory and the cartridge ram). Compare the region hashes to find the subsystem or memory region that differs.
+void calculateGBEmulatorStateHash( const GBEmulatorInstance* pEmulatorInstance, GBStateHash* pOutStateHash )
+{
+    GBCpuStateChunk cpuChunk;
+    GBPpuStateChunk ppuChunk;
+    GBApuStateChunk apuChunk;
+    GBTimerStateChunk timerChunk;
+    GBSerialStateChunk serialChunk;
+    GBMbcStateChunk mbcChunk;
+
+    //FK: Chunks contain padding
+    memset( &cpuChunk, 0, sizeof( cpuChunk ) );
+    memset( &ppuChunk, 0, sizeof( ppuChunk ) );
+    memset( &apuChunk, 0, sizeof( apuChunk ) );
+    memset( &timerChunk, 0, sizeof( timerChunk ) );
+    memset( &serialChunk, 0, sizeof( serialChunk ) );
+    memset( &mbcChunk, 0, sizeof( mbcChunk ) );
+
+    storeGBCpuStateChunk( &pEmulatorInstance->cpuState, &cpuChunk );
+    storeGBPpuStateChunk( &pEmulatorInstance->ppuState, &ppuChunk );
+    storeGBApuStateChunk( &pEmulatorInstance->apuState, &apuChunk );
+    storeGBTimerStateChunk( &pEmulatorInstance->timerState, &timerChunk );
+    storeGBSerialStateChunk( &pEmulatorInstance->serialState, &serialChunk );
+    storeGBMbcStateChunk( &pEmulatorInstance->cartridge, &mbcChunk );
+
+    const uint8_t* pMappedMemory = pEmulatorInstance->memoryMapper.memory;
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    uint64_t* pRegionHashes = pOutStateHash->regionHashes;
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_CPU ]           = calculateGBMemoryHash( ( const uint8_t* )&cpuChunk, sizeof( cpuChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_PPU ]           = calculateGBMemoryHash( ( const uint8_t* )&ppuChunk, sizeof( ppuChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_APU ]           = calculateGBMemoryHash( ( const uint8_t* )&apuChunk, sizeof( apuChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_TIMER ]         = calculateGBMemoryHash( ( const uint8_t* )&timerChunk, sizeof( timerChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_SERIAL ]        = calculateGBMemoryHash( ( const uint8_t* )&serialChunk, sizeof( serialChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_MBC ]           = calculateGBMemoryHash( ( const uint8_t* )&mbcChunk, sizeof( mbcChunk ) );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_VIDEO_RAM ]     = calculateGBMemoryHash( pMappedMemory + gbVideoRamMemoryOffset, 0x2000 );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_WORK_RAM ]      = calculateGBMemoryHash( pMappedMemory + gbWorkRamMemoryOffset, 0x2000 );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_OAM ]           = calculateGBMemoryHash( pMappedMemory + gbHighMemoryOffset, 0xA0 );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_HIGH_RAM ]      = calculateGBMemoryHash( pMappedMemory + gbHighMemoryOffset + 0x100, 0x100 );
+    pRegionHashes[ K15_GB_STATE_HASH_REGION_CARTRIDGE_RAM ] = calculateGBMemoryHash( pCartridge->pRamBaseAddress, pCartridge->ramSizeInBytes );
+
+    pOutStateHash->hash = calculateGBMemoryHash( ( const uint8_t* )pRegionHashes, sizeof( pOutStateHash->regionHashes ) );
+}
+
+//FK: Returns K15_GB_STATE_HASH_REGION_COUNT if both hashes are equal
+GBStateHashRegion findFirstDifferingGBStateHashRegion( const GBStateHash* pStateHash, const GBStateHash* pOtherStateHash )
+{
+    uint8_t regionIndex = 0u;
+    while( regionIndex < K15_GB_STATE_HASH_REGION_COUNT && pStateHash->regionHashes[ regionIndex ] == pOtherStateHash->regionHashes[ regionIndex ] )
+    {
+        ++regionIndex;
+    }
+
+    return ( GBStateHashRegion )regionIndex;
+}
+
+const char* getGBStateHashRegionName( const GBStateHashRegion region )
+{
+    switch( region )
+    {
+        case K15_GB_STATE_HASH_REGION_CPU:              return "cpu";
+        case K15_GB_STATE_HASH_REGION_PPU:              return "ppu";
+        case K15_GB_STATE_HASH_REGION_APU:              return "apu";
+        case K15_GB_STATE_HASH_REGION_TIMER:            return "timer";
+        case K15_GB_STATE_HASH_REGION_SERIAL:           return "serial";
+        case K15_GB_STATE_HASH_REGION_MBC:              return "mbc";
+        case K15_GB_STATE_HASH_REGION_VIDEO_RAM:        return "vram";
+        case K15_GB_STATE_HASH_REGION_WORK_RAM:         return "wram";
+        case K15_GB_STATE_HASH_REGION_OAM:              return "oam";
+        case K15_GB_STATE_HASH_REGION_HIGH_RAM:         return "io/hram";
+        case K15_GB_STATE_HASH_REGION_CARTRIDGE_RAM:    return "cartridge ram";
+        default:                                        return "none";
+    }
+}
+
+size_t uncompressMemoryBlockLZ( uint8_t* pDestination, const size_t destinationSizeInBytes, const uint8_t* pSource, const size_t compressedMemorySizeInBytes )
+{
+    uint8_t* pDestinationStart          = pDestination;
+    const uint8_t* pDestinationEnd      = pDestination + destinationSizeInBytes;
+    const uint8_t* pSourceEnd           = pSource + compressedMemorySizeInBytes;
+
+    while( pSource < pSourceEnd )
+    {
+        const uint8_t token = *pSource++;
+
+        size_t literalCount = token >> 4u;
+        if( literalCount == 15u )
+        {
+            uint8_t lengthByte = 255u;
+            while( lengthByte == 255u && pSource < pSourceEnd )
+            {
+                lengthByte = *pSource++;
+                literalCount += lengthByte;
+            }
+        }
+
+        if( literalCount > ( size_t )( pSourceEnd - pSource ) || literalCount > ( size_t )( pDestinationEnd - pDestination ) )
+        {
+            return 0u;
+        }
+
+        memcpy( pDestination, pSource, literalCount );
+        pDestination    += literalCount;
+        pSource         += literalCount;
+
+        if( pSource == pSourceEnd )
+        {
+            //FK: Last sequence only consists of literals
+            break;
+        }
+
+        if( pSourceEnd - pSource < ( ptrdiff_t )sizeof( uint16_t ) )
+        {
+            return 0u;
+        }
+
+        uint16_t matchOffset;
+        memcpy( &matchOffset, pSource, sizeof( uint16_t ) );
+        pSource += sizeof( uint16_t );
+
+        size_t matchLength = ( token & 0x0F );
+        if( matchLength == 15u )
+        {
+            uint8_t lengthByte = 255u;
+            while( lengthByte == 255u && pSource < pSourceEnd )
+            {
+                lengthByte = *pSource++;
+                matchLength += lengthByte;
+            }
+        }
+        matchLength += gbCompressionMinMatchSizeInBytes;
+
+        if( matchOffset == 0u || matchOffset > ( size_t )( pDestination - pDestinationStart ) || matchLength > ( size_t )( pDestinationEnd - pDestination ) )
+        {
+            return 0u;
+        }
+
+        const uint8_t* pMatch = pDestination - matchOffset;
+        if( matchOffset >= matchLength )
+        {
+            memcpy( pDestination, pMatch, matchLength );
+            pDestination += matchLength;
+        }
+        else
+        {
+            //FK: Overlapping match (eg: run of the same byte) needs to be copied byte by byte
+            for( size_t byteIndex = 0u; byteIndex < matchLength; ++byteIndex )
+            {
+                *pDestination++ = *pMatch++;
+            }
+        }
+    }
+
+    return ( size_t )( pDestination - pDestinationStart );
+}
+
+//FK: Walks the sequences of an LZ compressed block like uncompressMemoryBlockLZ() without writing anything.
+//    Returns the uncompressed size or 0 if uncompressMemoryBlockLZ() would fail with a destination of maxUncompressedSizeInBytes.
+size_t calculateUncompressedMemoryBlockSizeLZ( const uint8_t* pSource, const size_t compressedMemorySizeInBytes, const size_t maxUncompressedSizeInBytes )
+{
+    const uint8_t* pSourceEnd = pSource + compressedMemorySizeInBytes;
+
+    size_t uncompressedSizeInBytes = 0u;
+    while( pSource < pSourceEnd )
+    {
+        const uint8_t token = *pSource++;
+
+        size_t literalCount = token >> 4u;
+        if( literalCount == 15u )
+        {
+            uint8_t lengthByte = 255u;
+            while( lengthByte == 255u && pSource < pSourceEnd )
+            {
+                lengthByte = *pSource++;
+                literalCount += lengthByte;
+            }
+        }
+
+        if( literalCount > ( size_t )( pSourceEnd - pSource ) || literalCount > maxUncompressedSizeInBytes - uncompressedSizeInBytes )
+        {
+            return 0u;
+        }
+
+        uncompressedSizeInBytes += literalCount;
+        pSource                 += literalCount;
+
+        if( pSource == pSourceEnd )
+        {
+            break;
+        }
+
+        if( pSourceEnd - pSource < ( ptrdiff_t )sizeof( uint16_t ) )
+        {
+            return 0u;
+        }
+
+        uint16_t matchOffset;
+        memcpy( &matchOffset, pSource, sizeof( uint16_t ) );
+        pSource += sizeof( uint16_t );
+
+        size_t matchLength = ( token & 0x0F );
+        if( matchLength == 15u )
+        {
+            uint8_t lengthByte = 255u;
+            while( lengthByte == 255u && pSource < pSourceEnd )
+            {
+                lengthByte = *pSource++;
+                matchLength += lengthByte;
+            }
+        }
+        matchLength += gbCompressionMinMatchSizeInBytes;
+
+        if( matchOffset == 0u || matchOffset > uncompressedSizeInBytes || matchLength > maxUncompressedSizeInBytes - uncompressedSizeInBytes )
+        {
+            return 0u;
+        }
+
+        uncompressedSizeInBytes += matchLength;
+    }
+
+    return uncompressedSizeInBytes;
+}
+
+void applyGBEmulatorState( GBEmulatorInstance* pEmulatorInstance, const GBEmulatorState* pState )
+{
+    GBMemoryMapper* pMemoryMapper = &pEmulatorInstance->memoryMapper;
+
+    const uint8_t* pRomBaseAddress  = pEmulatorInstance->cartridge.pRomBaseAddress;
+    uint8_t* pRamBaseAddress        = pEmulatorInstance->cartridge.pRamBaseAddress;
+
+    pEmulatorInstance->cpuState         = pState->cpuState;
+    pEmulatorInstance->ppuState         = pState->ppuState;
+    pEmulatorInstance->apuState         = pState->apuState;
+    pEmulatorInstance->timerState       = pState->timerState;
+    pEmulatorInstance->serialState      = pState->serialState;
+    pEmulatorInstance->cartridge        = pState->cartridge;
+
+    GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    pCartridge->pRomBaseAddress     = pRomBaseAddress;
+    pCartridge->pRamBaseAddress     = pRamBaseAddress;
+    pCartridge->header              = getGBRomHeader( pRomBaseAddress );
+
+    const size_t romSizeInBytes = mapRomSizeToByteSize( pCartridge->header.romSize );
+    pCartridge->romBankCount         = ( uint16_t )( romSizeInBytes / gbRomBankSizeInBytes );
+    mapCartridgeRom0Bank( pCartridge, pMemoryMapper, pState->mappedRom0BankNumber );
+    mapCartridgeRom1Bank( pCartridge, pMemoryMapper, pState->mappedRom1BankNumber );
+
+    const size_t ramSizeInBytes = mapRamSizeToByteSize( pCartridge->header.ramSize );
+    pCartridge->ramBankCount = ( uint8_t )( ramSizeInBytes / gbRamBankSizeInBytes );
+    mapCartridgeRamBank( pCartridge, pMemoryMapper, pCartridge->ramBankCount > 0u ? pState->mappedRamBankNumber : 0u );
+
+    pMemoryMapper->lcdStatus  = *getLcdStatus( pMemoryMapper );
+    pMemoryMapper->dmaActive  = pEmulatorInstance->cpuState.flags.dma;
+    pMemoryMapper->lcdEnabled = getLcdControl( pMemoryMapper )->enable;
+    pMemoryMapper->ramEnabled = pCartridge->ramEnabled;
+}
+
+bool8_t readGBStateChunkStruct( void* pChunkStruct, const size_t chunkStructSizeInBytes, const GBStateChunkHeader* pHeader, const uint8_t* pChunkData )
+{
+    if( pHeader->compressedSizeInBytes != 0u )
+    {
+        return 0u;
+    }
+
+    //FK: Chunks of older/newer versions might be smaller/bigger - missing fields keep their current value
+    const size_t sizeToCopyInBytes = pHeader->sizeInBytes < chunkStructSizeInBytes ? pHeader->sizeInBytes : chunkStructSizeInBytes;
+    memcpy( pChunkStruct, pChunkData, sizeToCopyInBytes );
+    return 1u;
+}
+
+bool8_t readGBStateChunkMemory( uint8_t* pMemory, const size_t memorySizeInBytes, const GBStateChunkHeader* pHeader, const uint8_t* pChunkData )
+{
+    if( pHeader->sizeInBytes != memorySizeInBytes )
+    {
+        return 0u;
+    }
+
+    if( pHeader->compressedSizeInBytes == 0u )
+    {
+        memcpy( pMemory, pChunkData, memorySizeInBytes );
+        return 1u;
+    }
+
+    return uncompressMemoryBlockLZ( pMemory, memorySizeInBytes, pChunkData, pHeader->compressedSizeInBytes ) == memorySizeInBytes;
+}
+
+//FK: Same checks as readGBStateChunkMemory() without reading the chunk data into memory
+bool8_t validateGBStateChunkMemory( const size_t memorySizeInBytes, const GBStateChunkHeader* pHeader, const uint8_t* pChunkData )
+{
+    if( pHeader->sizeInBytes != memorySizeInBytes )
+    {
+        return 0u;
+    }
+
+    return pHeader->compressedSizeInBytes == 0u || calculateUncompressedMemoryBlockSizeLZ( pChunkData, pHeader->compressedSizeInBytes, memorySizeInBytes ) == memorySizeInBytes;
+}
+
+//FK: pStateMemory is untrusted (eg: a file from disk), nothing is read beyond stateMemorySizeInBytes. Validates the whole state without touching
+//    the instance, chunks missing in the state keep the current values of the instance. pOutState references pStateMemory.
+GBStateLoadResult parseGBEmulatorState( const GBEmulatorInstance* pEmulatorInstance, const uint8_t* pStateMemory, const size_t stateMemorySizeInBytes, GBParsedEmulatorState* pOutState )
+{
+    constexpr size_t stateHeaderSizeInBytes = sizeof( gbStateFourCC ) + sizeof( uint16_t ) + sizeof( gbStateVersion ) + sizeof( uint32_t );
+    if( stateMemorySizeInBytes < stateHeaderSizeInBytes )
+    {
+        return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    uint32_t fourCC;
+    memcpy( &fourCC, pStateMemory, sizeof( gbStateFourCC ) );
+    pStateMemory += sizeof( gbStateFourCC );
+
+    if( fourCC != gbStateFourCC )
+    {
+        return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    uint16_t stateCartridgeChecksum;
+    memcpy( &stateCartridgeChecksum, pStateMemory, sizeof( stateCartridgeChecksum ) );
+    pStateMemory += sizeof( stateCartridgeChecksum );
+
+    const GBRomHeader cartridgeHeader = getGBEmulatorCurrentCartridgeHeader( pEmulatorInstance );
+
+    const uint16_t cartridgeChecksum = cartridgeHeader.checksumHigher << 8 | cartridgeHeader.checksumLower;
+    if( cartridgeChecksum != stateCartridgeChecksum )
+    {
+        return K15_GB_STATE_LOAD_FAILED_WRONG_ROM;
+    }
+
+    const uint8_t stateVersion = *pStateMemory;
+    ++pStateMemory;
+
+    //FK: Newer versions are fine, unknown chunks will be skipped
+    if( stateVersion < gbMinCompatibleStateVersion )
+    {
+        return K15_GB_STATE_LOAD_FAILED_OLD_VERSION;
+    }
+
+    uint32_t chunkDataSizeInBytes;
+    memcpy( &chunkDataSizeInBytes, pStateMemory, sizeof( uint32_t ) );
+    pStateMemory += sizeof( uint32_t );
+
+    if( chunkDataSizeInBytes > stateMemorySizeInBytes - stateHeaderSizeInBytes )
+    {
+        return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+
+    //FK: Memory chunks get read into a copy of the mapped memory. The cartridge ram chunk (up to 128KB) only gets validated while parsing and is
+    //    read straight into the cartridge ram by applyGBParsedEmulatorState().
+    memcpy( pOutState->mappedMemory, pEmulatorInstance->memoryMapper.memory, gbMappedMemorySizeInBytes );
+    pOutState->pCartridgeRamChunkData = nullptr;
+
+    storeGBCpuStateChunk( &pEmulatorInstance->cpuState, &pOutState->cpuChunk );
+    storeGBPpuStateChunk( &pEmulatorInstance->ppuState, &pOutState->ppuChunk );
+    storeGBApuStateChunk( &pEmulatorInstance->apuState, &pOutState->apuChunk );
+    storeGBTimerStateChunk( &pEmulatorInstance->timerState, &pOutState->timerChunk );
+    storeGBSerialStateChunk( &pEmulatorInstance->serialState, &pOutState->serialChunk );
+    storeGBMbcStateChunk( pCartridge, &pOutState->mbcChunk );
+
+    const uint8_t* pChunkDataEnd = pStateMemory + chunkDataSizeInBytes;
+    while( pStateMemory < pChunkDataEnd )
+    {
+        if( ( size_t )( pChunkDataEnd - pStateMemory ) < sizeof( GBStateChunkHeader ) )
+        {
+            return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        }
+
+        GBStateChunkHeader header;
+        memcpy( &header, pStateMemory, sizeof( GBStateChunkHeader ) );
+        pStateMemory += sizeof( GBStateChunkHeader );
+
+        const uint32_t storedDataSizeInBytes = header.compressedSizeInBytes > 0u ? header.compressedSizeInBytes : header.sizeInBytes;
+        if( ( size_t )( pChunkDataEnd - pStateMemory ) < storedDataSizeInBytes )
+        {
+            return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        }
+
+        bool8_t chunkValid = 1u;
+        switch( header.tag )
+        {
+            case gbStateChunkTagCpu:
+                chunkValid = readGBStateChunkStruct( &pOutState->cpuChunk, sizeof( pOutState->cpuChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagPpu:
+                chunkValid = readGBStateChunkStruct( &pOutState->ppuChunk, sizeof( pOutState->ppuChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagApu:
+                chunkValid = readGBStateChunkStruct( &pOutState->apuChunk, sizeof( pOutState->apuChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagTimer:
+                chunkValid = readGBStateChunkStruct( &pOutState->timerChunk, sizeof( pOutState->timerChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagSerial:
+                chunkValid = readGBStateChunkStruct( &pOutState->serialChunk, sizeof( pOutState->serialChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagMbc:
+                chunkValid = readGBStateChunkStruct( &pOutState->mbcChunk, sizeof( pOutState->mbcChunk ), &header, pStateMemory );
+                break;
+            case gbStateChunkTagVideoRam:
+                chunkValid = readGBStateChunkMemory( pOutState->mappedMemory + gbVideoRamMemoryOffset, 0x2000, &header, pStateMemory );
+                break;
+            case gbStateChunkTagWorkRam:
+                chunkValid = readGBStateChunkMemory( pOutState->mappedMemory + gbWorkRamMemoryOffset, 0x2000, &header, pStateMemory );
+                break;
+            case gbStateChunkTagOAM:
+                chunkValid = readGBStateChunkMemory( pOutState->mappedMemory + gbHighMemoryOffset, 0xA0, &header, pStateMemory );
+                break;
+            case gbStateChunkTagHighRam:
+                chunkValid = readGBStateChunkMemory( pOutState->mappedMemory + gbHighMemoryOffset + 0x100, 0x100, &header, pStateMemory );
+                break;
+            case gbStateChunkTagCartridgeRam:
+                chunkValid = validateGBStateChunkMemory( pCartridge->ramSizeInBytes, &header, pStateMemory );
+                pOutState->cartridgeRamHeader       = header;
+                pOutState->pCartridgeRamChunkData   = pStateMemory;
+                break;
+            default:
+                //FK: Unknown chunk (eg: written by a newer version), skip it
+                break;
+        }
+
+        if( !chunkValid )
+        {
+            return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        }
+
+        pStateMemory += storedDataSizeInBytes;
+    }
+
+    return isGBMbcStateChunkValid( pCartridge, &pOutState->mbcChunk ) ? K15_GB_STATE_LOAD_SUCCESS : K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+}
+
+//FK: Checks whether loadGBEmulatorState() would succeed without loading the state
+GBStateLoadResult validateGBEmulatorState( const GBEmulatorInstance* pEmulatorInstance, const uint8_t* pStateMemory, const size_t stateMemorySizeInBytes )
+{
+    GBParsedEmulatorState parsedState;
+    return parseGBEmulatorState( pEmulatorInstance, pStateMemory, stateMemorySizeInBytes, &parsedState );
+}
+
+void applyGBParsedEmulatorState( GBEmulatorInstance* pEmulatorInstance, const GBParsedEmulatorState* pState )
+{
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBCartridge* pCartridge         = &pEmulatorInstance->cartridge;
+
+    memcpy( pMemoryMapper->memory, pState->mappedMemory, gbMappedMemorySizeInBytes );
+    if( pState->pCartridgeRamChunkData != nullptr )
+    {
+        readGBStateChunkMemory( pCartridge->pRamBaseAddress, pCartridge->ramSizeInBytes, &pState->cartridgeRamHeader, pState->pCartridgeRamChunkData );
+    }
+
+    loadGBMbcStateChunk( pCartridge, pMemoryMapper, &pState->mbcChunk );
+
+    loadGBCpuStateChunk( &pEmulatorInstance->cpuState, &pState->cpuChunk );
+    loadGBPpuStateChunk( &pEmulatorInstance->ppuState, &pState->ppuChunk );
+    loadGBApuStateChunk( &pEmulatorInstance->apuState, &pState->apuChunk );
+    loadGBTimerStateChunk( &pEmulatorInstance->timerState, &pState->timerChunk );
+    loadGBSerialStateChunk( &pEmulatorInstance->serialState, &pState->serialChunk );
+
+    pMemoryMapper->lcdStatus  = *getLcdStatus( pMemoryMapper );
+    pMemoryMapper->dmaActive  = pEmulatorInstance->cpuState.flags.dma;
+    pMemoryMapper->lcdEnabled = getLcdControl( pMemoryMapper )->enable;
+    pMemoryMapper->ramEnabled = pCartridge->ramEnabled;
+}
+
+//FK: pStateMemory is untrusted (eg: a file from disk), nothing is read beyond stateMemorySizeInBytes.
+//    Nothing is applied to the instance before the whole state has been validated, so a corrupt state leaves the instance untouched.
+GBStateLoadResult loadGBEmulatorState( GBEmulatorInstance* pEmulatorInstance, const uint8_t* pStateMemory, const size_t stateMemorySizeInBytes )
+{
+    GBParsedEmulatorState parsedState;
+    const GBStateLoadResult result = parseGBEmulatorState( pEmulatorInstance, pStateMemory, stateMemorySizeInBytes, &parsedState );
+    if( result == K15_GB_STATE_LOAD_SUCCESS )
+    {
+        applyGBParsedEmulatorState( pEmulatorInstance, &parsedState );
+    }
+
+    return result;
+}
+
+//FK: The raw state is an uncompressed, fixed size state meant for in-memory snapshots (eg: rewind).
+//    It doesn't contain any header and is only valid for the same emulator build and rom.
+size_t calculateGBEmulatorRawStateSizeInBytes( const GBEmulatorInstance* pEmulatorInstance )
+{
+    return sizeof( GBEmulatorState ) + gbMappedMemorySizeInBytes + pEmulatorInstance->cartridge.ramSizeInBytes;
+}
+
+void storeGBEmulatorRawState( const GBEmulatorInstance* pEmulatorInstance, uint8_t* pRawStateMemory )
+{
+    GBEmulatorState state;
+    extractGBEmulatorState( pEmulatorInstance, &state );
+
+    memcpy( pRawStateMemory, &state, sizeof( GBEmulatorState ) );
+    pRawStateMemory += sizeof( GBEmulatorState );
+
+    memcpy( pRawStateMemory, pEmulatorInstance->memoryMapper.memory, gbMappedMemorySizeInBytes );
+    pRawStateMemory += gbMappedMemorySizeInBytes;
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    if( pCartridge->ramSizeInBytes > 0u )
+    {
+        memcpy( pRawStateMemory, pCartridge->pRamBaseAddress, pCartridge->ramSizeInBytes );
+    }
+}
+
+size_t calculateGBEmulatorMaxRawStateSizeInBytes()
+{
+    return sizeof( GBEmulatorState ) + gbMappedMemorySizeInBytes + gbMaxRamSizeInBytes;
+}
+
+//FK: Converts a raw state to a (compressed) state without needing the emulator instance.
+//    Can be used to compress and save a raw state on a different thread. Returns 0 if stateMemorySizeInBytes is too small for the state.
+size_t storeGBEmulatorStateFromRawState( const uint8_t* pRawStateMemory, uint8_t* pStateMemory, size_t stateMemorySizeInBytes )
+{
+    GBEmulatorState state;
+    memcpy( &state, pRawStateMemory, sizeof( GBEmulatorState ) );
+
+    if( stateMemorySizeInBytes < calculateGBStateSizeInBytes( state.cartridge.ramSizeInBytes ) )
+    {
+        return 0u;
+    }
+
+    const uint8_t* pMappedMemory    = pRawStateMemory + sizeof( GBEmulatorState );
+    const uint8_t* pCartridgeRam    = pMappedMemory + gbMappedMemorySizeInBytes;
+    return writeGBEmulatorState( &state, pMappedMemory, pCartridgeRam, pStateMemory );
+}
+
+void loadGBEmulatorRawState( GBEmulatorInstance* pEmulatorInstance, const uint8_t* pRawStateMemory )
+{
+    GBEmulatorState state;
+    memcpy( &state, pRawStateMemory, sizeof( GBEmulatorState ) );
+    pRawStateMemory += sizeof( GBEmulatorState );
+
+    //FK: The memory goes first, applyGBEmulatorState() derives the lcd/dma/ram mirrors of the memory mapper from the restored registers
+    memcpy( pEmulatorInstance->memoryMapper.memory, pRawStateMemory, gbMappedMemorySizeInBytes );
+    pRawStateMemory += gbMappedMemorySizeInBytes;
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    if( pCartridge->ramSizeInBytes > 0u )
+    {
+        memcpy( pCartridge->pRamBaseAddress, pRawStateMemory, pCartridge->ramSizeInBytes );
+    }
+
+    applyGBEmulatorState( pEmulatorInstance, &state );
+}
+
+void xorMemoryBlock( uint8_t* restrict_modifier pDestination, const uint8_t* restrict_modifier pSourceA, const uint8_t* restrict_modifier pSourceB, const size_t memorySizeInBytes )
+{
+    for( size_t byteIndex = 0u; byteIndex < memorySizeInBytes; ++byteIndex )
+    {
+        pDestination[ byteIndex ] = pSourceA[ byteIndex ] ^ pSourceB[ byteIndex ];
+    }
+}
+
+uint32_t calculateGBRewindBufferSnapshotCapacity( const size_t budgetInBytes )
+{
+    const size_t snapshotCapacity = budgetInBytes / gbRewindMinSnapshotSizeInBytes;
+    return snapshotCapacity < 2u ? 2u : castSizeToUint32( snapshotCapacity );
+}
+
+
+size_t calculateGBRewindBufferMemoryRequirementsInBytes( const size_t budgetInBytes )
+{
+    const size_t rawStateCapacityInBytes = calculateGBEmulatorMaxRawStateSizeInBytes();
+    const size_t snapshotCapacity = calculateGBRewindBufferSnapshotCapacity( budgetInBytes );
+
+    //FK: keyframe, raw and delta state + compression buffer + the actual snapshot data
+    return sizeof( GBRewindBuffer ) + snapshotCapacity * sizeof( GBRewindSnapshot ) + 
+        rawStateCapacityInBytes * 3u + calculateCompressedMemoryBoundLZ( rawStateCapacityInBytes ) + budgetInBytes;
+}
+
+void resetGBRewindBuffer( GBRewindBuffer* pRewindBuffer )
+{
+    pRewindBuffer->rawStateSizeInBytes          = 0u;
+    pRewindBuffer->memoryUsedInBytes            = 0u;
+    pRewindBuffer->keyframeMemoryUsedInBytes    = 0u;
+    pRewindBuffer->firstSnapshotIndex           = 0u;
+    pRewindBuffer->snapshotCount                = 0u;
+    pRewindBuffer->keyframeCount                = 0u;
+    pRewindBuffer->evictedSnapshotCount         = 0u;
+    pRewindBuffer->writeOffset                  = 0u;
+    pRewindBuffer->frameCounter                 = 0u;
+    pRewindBuffer->hasKeyframeRawState          = 0u;
+}
+
+//FK: budgetInBytes is the amount of memory used for compressed snapshots. 
+//    Every framesPerSnapshot frames a snapshot is taken, every snapshotsPerKeyframe snapshots a full keyframe is stored
+//    (all other snapshots are stored as xor delta against their keyframe).
+GBRewindBuffer* createGBRewindBuffer( uint8_t* pRewindBufferMemory, const size_t budgetInBytes, const uint16_t framesPerSnapshot, const uint16_t snapshotsPerKeyframe )
+{
+    RuntimeAssert( budgetInBytes <= 0xFFFFFFFFu );
+    RuntimeAssert( framesPerSnapshot > 0u );
+    RuntimeAssert( snapshotsPerKeyframe > 0u );
+
+    const size_t rawStateCapacityInBytes = calculateGBEmulatorMaxRawStateSizeInBytes();
+
+    GBRewindBuffer* pRewindBuffer = ( GBRewindBuffer* )pRewindBufferMemory;
+    pRewindBuffer->snapshotCapacity         = calculateGBRewindBufferSnapshotCapacity( budgetInBytes );
+    pRewindBuffer->pSnapshots               = ( GBRewindSnapshot* )( pRewindBuffer + 1 );
+    pRewindBuffer->pKeyframeRawState        = ( uint8_t* )( pRewindBuffer->pSnapshots + pRewindBuffer->snapshotCapacity );
+    pRewindBuffer->pRawState                = pRewindBuffer->pKeyframeRawState + rawStateCapacityInBytes;
+    pRewindBuffer->pDeltaRawState           = pRewindBuffer->pRawState + rawStateCapacityInBytes;
+    pRewindBuffer->pCompressedState         = pRewindBuffer->pDeltaRawState + rawStateCapacityInBytes;
+    pRewindBuffer->pSnapshotData            = pRewindBuffer->pCompressedState + calculateCompressedMemoryBoundLZ( rawStateCapacityInBytes );
+    pRewindBuffer->budgetInBytes            = budgetInBytes;
+    pRewindBuffer->framesPerSnapshot        = framesPerSnapshot;
+    pRewindBuffer->snapshotsPerKeyframe     = snapshotsPerKeyframe;
+    pRewindBuffer->nextSequence             = 0u;
+    pRewindBuffer->keyframeRawStateSequence = 0u;
+
+    resetGBRewindBuffer( pRewindBuffer );
+    return pRewindBuffer;
+}
+
+GBRewindSnapshot* getGBRewindSnapshot( GBRewindBuffer* pRewindBuffer, const uint32_t snapshotIndex )
+{
+    RuntimeAssert( snapshotIndex < pRewindBuffer->snapshotCount );
+    return pRewindBuffer->pSnapshots + ( pRewindBuffer->firstSnapshotIndex + snapshotIndex ) % pRewindBuffer->snapshotCapacity;
+}
+
+void evictOldestGBRewindSnapshots( GBRewindBuffer* pRewindBuffer )
+{
+    //FK: Deltas are useless without their keyframe, so evict them together with the keyframe
+    do
+    {
+        const GBRewindSnapshot* pOldestSnapshot = getGBRewindSnapshot( pRewindBuffer, 0u );
+        pRewindBuffer->memoryUsedInBytes -= pOldestSnapshot->sizeInBytes;
+        if( pOldestSnapshot->deltaIndex == 0u )
+        {
+            pRewindBuffer->keyframeMemoryUsedInBytes -= pOldestSnapshot->sizeInBytes;
+            --pRewindBuffer->keyframeCount;
+        }
+
+        pRewindBuffer->firstSnapshotIndex = ( pRewindBuffer->firstSnapshotIndex + 1u ) % pRewindBuffer->snapshotCapacity;
+        --pRewindBuffer->snapshotCount;
+        ++pRewindBuffer->evictedSnapshotCount;
+    }
+    while( pRewindBuffer->snapshotCount > 0u && getGBRewindSnapshot( pRewindBuffer, 0u )->deltaIndex != 0u );
+
+    if( pRewindBuffer->snapshotCount == 0u )
+    {
+        pRewindBuffer->writeOffset = 0u;
+    }
+}
+
+bool8_t allocateGBRewindSnapshotData( GBRewindBuffer* pRewindBuffer, const uint32_t sizeInBytes, uint32_t* pOutDataOffset )
+{
+    if( sizeInBytes > pRewindBuffer->budgetInBytes )
+    {
+        return 0u;
+    }
+
+    if( pRewindBuffer->snapshotCount == pRewindBuffer->snapshotCapacity )
+    {
+        evictOldestGBRewindSnapshots( pRewindBuffer );
+    }
+
+    //FK: Snapshot data is stored contiguously in a ring, evict the oldest snapshots until the new one fits
+    while( pRewindBuffer->snapshotCount > 0u )
+    {
+        const uint32_t writeOffset  = pRewindBuffer->writeOffset;
+        const uint32_t readOffset   = getGBRewindSnapshot( pRewindBuffer, 0u )->dataOffset;
+
+        if( writeOffset > readOffset )
+        {
+            if( writeOffset + sizeInBytes <= pRewindBuffer->budgetInBytes )
+            {
+                *pOutDataOffset = writeOffset;
+                return 1u;
+            }
+
+            if( sizeInBytes <= readOffset )
+            {
+                *pOutDataOffset = 0u;
+                return 1u;
+            }
+        }
+        else if( writeOffset + sizeInBytes <= readOffset )
+        {
+            *pOutDataOffset = writeOffset;
+            return 1u;
+        }
+
+        evictOldestGBRewindSnapshots( pRewindBuffer );
+    }
+
+    *pOutDataOffset = 0u;
+    return 1u;
+}
+
+size_t compressGBRewindSnapshot( GBRewindBuffer* pRewindBuffer, const bool8_t storeAsDelta )
+{
+    if( storeAsDelta )
+    {
+        xorMemoryBlock( pRewindBuffer->pDeltaRawState, pRewindBuffer->pRawState, pRewindBuffer->pKeyframeRawState, pRewindBuffer->rawStateSizeInBytes );
+        return compressMemoryBlockLZ( pRewindBuffer->pCompressedState, pRewindBuffer->pDeltaRawState, pRewindBuffer->rawStateSizeInBytes );
+    }
+
+    return compressMemoryBlockLZ( pRewindBuffer->pCompressedState, pRewindBuffer->pRawState, pRewindBuffer->rawStateSizeInBytes );
+}
+
+bool8_t pushGBRewindSnapshot( GBRewindBuffer* pRewindBuffer, const GBEmulatorInstance* pEmulatorInstance )
+{
+    const size_t rawStateSizeInBytes = calculateGBEmulatorRawStateSizeInBytes( pEmulatorInstance );
+    RuntimeAssert( rawStateSizeInBytes <= calculateGBEmulatorMaxRawStateSizeInBytes() );
+
+    if( rawStateSizeInBytes != pRewindBuffer->rawStateSizeInBytes )
+    {
+        //FK: Different rom has been loaded, old snapshots are useless now
+        resetGBRewindBuffer( pRewindBuffer );
+        pRewindBuffer->rawStateSizeInBytes = rawStateSizeInBytes;
+    }
+
+    storeGBEmulatorRawState( pEmulatorInstance, pRewindBuffer->pRawState );
+
+    bool8_t storeAsDelta = 0u;
+    uint16_t deltaIndex = 0u;
+    if( pRewindBuffer->snapshotCount > 0u && pRewindBuffer->hasKeyframeRawState )
+    {
+        const GBRewindSnapshot* pNewestSnapshot = getGBRewindSnapshot( pRewindBuffer, pRewindBuffer->snapshotCount - 1u );
+        storeAsDelta = pNewestSnapshot->keyframeSequence == pRewindBuffer->keyframeRawStateSequence && 
+            pNewestSnapshot->deltaIndex + 1u < pRewindBuffer->snapshotsPerKeyframe;
+        deltaIndex = storeAsDelta ? pNewestSnapshot->deltaIndex + 1u : 0u;
+    }
+
+    uint32_t compressedSizeInBytes = castSizeToUint32( compressGBRewindSnapshot( pRewindBuffer, storeAsDelta ) );
+
+    uint32_t dataOffset = 0u;
+    if( !allocateGBRewindSnapshotData( pRewindBuffer, compressedSizeInBytes, &dataOffset ) )
+    {
+        return 0u;
+    }
+
+    if( storeAsDelta && pRewindBuffer->snapshotCount == 0u )
+    {
+        //FK: Keyframe of this delta got evicted to make room, store as keyframe instead
+        storeAsDelta = 0u;
+        deltaIndex = 0u;
+        compressedSizeInBytes = castSizeToUint32( compressGBRewindSnapshot( pRewindBuffer, storeAsDelta ) );
+        if( !allocateGBRewindSnapshotData( pRewindBuffer, compressedSizeInBytes, &dataOffset ) )
+        {
+            return 0u;
+        }
+    }
+
+    memcpy( pRewindBuffer->pSnapshotData + dataOffset, pRewindBuffer->pCompressedState, compressedSizeInBytes );
+
+    const uint32_t sequence = pRewindBuffer->nextSequence++;
+    ++pRewindBuffer->snapshotCount;
+
+    GBRewindSnapshot* pSnapshot = getGBRewindSnapshot( pRewindBuffer, pRewindBuffer->snapshotCount - 1u );
+    pSnapshot->dataOffset       = dataOffset;
+    pSnapshot->sizeInBytes      = compressedSizeInBytes;
+    pSnapshot->sequence         = sequence;
+    pSnapshot->deltaIndex       = deltaIndex;
+
+    pRewindBuffer->writeOffset          = dataOffset + compressedSizeInBytes;
+    pRewindBuffer->memoryUsedInBytes    += compressedSizeInBytes;
+
+    if( storeAsDelta )
+    {
+        pSnapshot->keyframeSequence = pRewindBuffer->keyframeRawStateSequence;
+    }
+    else
+    {
+        pSnapshot->keyframeSequence = sequence;
+        pRewindBuffer->keyframeMemoryUsedInBytes += compressedSizeInBytes;
+        ++pRewindBuffer->keyframeCount;
+
+        //FK: swap raw state and keyframe buffer instead of copying
+        uint8_t* pKeyframeRawState          = pRewindBuffer->pKeyframeRawState;
+        pRewindBuffer->pKeyframeRawState    = pRewindBuffer->pRawState;
+        pRewindBuffer->pRawState            = pKeyframeRawState;
+        pRewindBuffer->keyframeRawStateSequence = sequence;
+        pRewindBuffer->hasKeyframeRawState      = 1u;
+    }
+
+    return 1u;
+}
+
+//FK: Call once per emulated frame (eg: when K15_GB_VBLANK_EVENT_FLAG got raised)
+void updateGBRewindBuffer( GBRewindBuffer* pRewindBuffer, const GBEmulatorInstance* pEmulatorInstance )
+{
+    if( ++pRewindBuffer->frameCounter < pRewindBuffer->framesPerSnapshot )
+    {
+        return;
+    }
+
+    pRewindBuffer->frameCounter = 0u;
+    pushGBRewindSnapshot( pRewindBuffer, pEmulatorInstance );
+}
+
+bool8_t uncompressGBRewindSnapshot( GBRewindBuffer* pRewindBuffer, const GBRewindSnapshot* pSnapshot, uint8_t* pRawStateMemory )
+{
+    const uint8_t* pSnapshotData = pRewindBuffer->pSnapshotData + pSnapshot->dataOffset;
+    return uncompressMemoryBlockLZ( pRawStateMemory, pRewindBuffer->rawStateSizeInBytes, pSnapshotData, pSnapshot->sizeInBytes ) == pRewindBuffer->rawStateSizeInBytes;
+}
+
+//FK: Restores the newest snapshot and removes it from the rewind buffer.
+//    Returns 0 if there's nothing to rewind to.
+bool8_t rewindGBEmulator( GBRewindBuffer* pRewindBuffer, GBEmulatorInstance* pEmulatorInstance )
+{
+    if( pRewindBuffer->snapshotCount == 0u || calculateGBEmulatorRawStateSizeInBytes( pEmulatorInstance ) != pRewindBuffer->rawStateSizeInBytes )
+    {
+        return 0u;
+    }
+
+    const uint32_t newestSnapshotIndex = pRewindBuffer->snapshotCount - 1u;
+    const GBRewindSnapshot* pSnapshot = getGBRewindSnapshot( pRewindBuffer, newestSnapshotIndex );
+
+    if( !pRewindBuffer->hasKeyframeRawState || pRewindBuffer->keyframeRawStateSequence != pSnapshot->keyframeSequence )
+    {
+        const GBRewindSnapshot* pKeyframe = getGBRewindSnapshot( pRewindBuffer, newestSnapshotIndex - pSnapshot->deltaIndex );
+        RuntimeAssert( pKeyframe->sequence == pSnapshot->keyframeSequence );
+
+        pRewindBuffer->hasKeyframeRawState = uncompressGBRewindSnapshot( pRewindBuffer, pKeyframe, pRewindBuffer->pKeyframeRawState );
+        pRewindBuffer->keyframeRawStateSequence = pKeyframe->sequence;
+        if( !pRewindBuffer->hasKeyframeRawState )
+        {
+            return 0u;
+        }
+    }
+
+    const uint8_t* pRawState = pRewindBuffer->pKeyframeRawState;
+    if( pSnapshot->deltaIndex > 0u )
+    {
+        if( !uncompressGBRewindSnapshot( pRewindBuffer, pSnapshot, pRewindBuffer->pDeltaRawState ) )
+        {
+            return 0u;
+        }
+
+        xorMemoryBlock( pRewindBuffer->pRawState, pRewindBuffer->pDeltaRawState, pRewindBuffer->pKeyframeRawState, pRewindBuffer->rawStateSizeInBytes );
+        pRawState = pRewindBuffer->pRawState;
+    }
+
+    loadGBEmulatorRawState( pEmulatorInstance, pRawState );
+
+    pRewindBuffer->memoryUsedInBytes -= pSnapshot->sizeInBytes;
+    if( pSnapshot->deltaIndex == 0u )
+    {
+        pRewindBuffer->keyframeMemoryUsedInBytes -= pSnapshot->sizeInBytes;
+        --pRewindBuffer->keyframeCount;
+    }
+
+    pRewindBuffer->writeOffset  = pSnapshot->dataOffset;
+    pRewindBuffer->frameCounter = 0u;
+    --pRewindBuffer->snapshotCount;
+
+    if( pRewindBuffer->snapshotCount == 0u )
+    {
+        pRewindBuffer->writeOffset = 0u;
+    }
+
+    return 1u;
+}
+
+GBRewindBufferStats getGBRewindBufferStats( const GBRewindBuffer* pRewindBuffer )
+{
+    const uint32_t deltaCount = pRewindBuffer->snapshotCount - pRewindBuffer->keyframeCount;
+    const size_t deltaMemoryUsedInBytes = pRewindBuffer->memoryUsedInBytes - pRewindBuffer->keyframeMemoryUsedInBytes;
+
+    GBRewindBufferStats stats;
+    stats.budgetInBytes                 = pRewindBuffer->budgetInBytes;
+    stats.memoryUsedInBytes             = pRewindBuffer->memoryUsedInBytes;
+    stats.averageSnapshotSizeInBytes    = pRewindBuffer->snapshotCount > 0u ? pRewindBuffer->memoryUsedInBytes / pRewindBuffer->snapshotCount : 0u;
+    stats.averageKeyframeSizeInBytes    = pRewindBuffer->keyframeCount > 0u ? pRewindBuffer->keyframeMemoryUsedInBytes / pRewindBuffer->keyframeCount : 0u;
+    stats.averageDeltaSizeInBytes       = deltaCount > 0u ? deltaMemoryUsedInBytes / deltaCount : 0u;
+    stats.snapshotCount                 = pRewindBuffer->snapshotCount;
+    stats.keyframeCount                 = pRewindBuffer->keyframeCount;
+    stats.rewindableFrameCount          = pRewindBuffer->snapshotCount * pRewindBuffer->framesPerSnapshot;
+    stats.evictedSnapshotCount          = pRewindBuffer->evictedSnapshotCount;
+    return stats;
+}
+
+bool8_t allowReadFromMemoryAddress( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset )
+{
+    //FK: Don't allow VRAM and OAM access while ppu is in mode 3 or 2 (drawing and oam search respectively)
+    if( pMemoryMapper->lcdEnabled )
+    {
+        if ( pMemoryMapper->lcdStatus.mode == 3 )
+        {
+            if( isInOAMAddressRange( addressOffset ) ||
+                isInVideoRamAddressRange( addressOffset ) )
+            {
+                return 0;
+            }
+        }
 
         else if( pMemoryMapper->lcdStatus.mode == 2 )
         {
@@ -1901,7 +3433,8 @@ uint8_t read8BitValueFromMappedMemory( GBMemoryMapper* pMemoryMapper, uint16_t a
 
     pMemoryMapper->memoryAccess = GBMemoryAccess_Read;
     pMemoryMapper->lastAddressReadFrom = addressOffset;
-    return pMemoryMapper->pBaseAddress[addressOffset];
+    pMemoryMapper->joypadReadCount += ( addressOffset == K15_GB_MAPPED_IO_ADDRESS_JOYP );
+    return getMappedMemoryValue( pMemoryMapper, addressOffset );
 }
 
 uint16_t read16BitValueFromMappedMemory( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset )
@@ -1913,11 +3446,6 @@ uint16_t read16BitValueFromMappedMemory( GBMemoryMapper* pMemoryMapper, uint16_t
     return (hs << 8u) | (ls << 0u);
 }
 
-uint8_t* getMappedMemoryAddress( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset)
-{
-    return pMemoryMapper->pBaseAddress + addressOffset;
-}
-
 bool8_t allowWriteToMemoryAddress( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset )
 {
     if( isInIORegisterRange( addressOffset ) )
@@ -1970,20 +3498,8 @@ void write8BitValueToMappedMemory( GBMemoryMapper* pMemoryMapper, uint16_t addre
         return;
     }
    
-    //FK: Save to write immediately to memory
-    pMemoryMapper->pBaseAddress[addressOffset] = value;
-
-    //FK: Echo 8kB internal Ram
-    if( isInWorkRamRange( addressOffset ) )
-    {
-        addressOffset += 0x2000;
-        pMemoryMapper->pBaseAddress[addressOffset] = value;
-    }
-    else if( isInEchoRamRange( addressOffset ) )
-    {
-        addressOffset -= 0x2000;
-        pMemoryMapper->pBaseAddress[addressOffset] = value;
-    }
+    //FK: Save to write immediately to memory (echo ram shares the storage of the work ram)
+    setMappedMemoryValue( pMemoryMapper, addressOffset, value );
 }
 
 void write16BitValueToMappedMemory( GBMemoryMapper* pMemoryMapper, uint16_t addressOffset, uint16_t value )
@@ -2045,19 +3561,13 @@ GBMapCartridgeResult mapCartridgeMemory( GBCartridge* pCartridge, GBMemoryMapper
 
     mapCartridgeRom0Bank( pCartridge, pMemoryMapper, 0 );
     mapCartridgeRom1Bank( pCartridge, pMemoryMapper, 1 );
-
-    if( pCartridge->ramBankCount > 0 )
-    {
-        mapCartridgeRamBank( pCartridge, pMemoryMapper, 0 );
-    }
+    mapCartridgeRamBank( pCartridge, pMemoryMapper, 0 );
 
     return K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY;
 }
 
 void initCpuState( GBMemoryMapper* pMemoryMapper, GBCpuState* pState )
 {
-    patchIOCpuMappedMemoryPointer( pMemoryMapper, pState );
-
     //FK: (Gameboy cpu manual) The GameBoy stack pointer 
     //is initialized to $FFFE on power up but a programmer 
     //should not rely on this setting and rather should 
@@ -2081,11 +3591,13 @@ void initCpuState( GBMemoryMapper* pMemoryMapper, GBCpuState* pState )
     pState->registers.DE            = 0x00C1;
     pState->registers.HL            = 0x8403;
 
+    pState->dmaAddress              = 0;
     pState->dmaCycleCounter         = 0;
     pState->cycleCounter            = 0;
+    pState->totalCycleCounter       = 0u;
 
-    *pState->pIE = 0xF0;
-    *pState->pIF = 0xE1;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IE ) = 0xF0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IF ) = 0xE1;
 
     pState->flags.dma               = 0;
     pState->flags.IME               = 1;
@@ -2097,53 +3609,50 @@ void initCpuState( GBMemoryMapper* pMemoryMapper, GBCpuState* pState )
 
 void resetMemoryMapper( GBMemoryMapper* pMapper )
 {
-    memset(pMapper->pBaseAddress, 0, gbMappedMemorySizeInBytes);
-    memset(pMapper->pBaseAddress + 0xFF00, 0xFF, 0x80); //FK: reset IO ports
+    //FK: Rom reads without a loaded rom return 0 (same as the zeroed memory did before)
+    static const uint8_t gbEmptyRomBank[ gbRomBankSizeInBytes ] = {};
+
+    memset(pMapper->memory, 0, gbMappedMemorySizeInBytes);
+    memset(getMappedMemoryAddress( pMapper, 0xFF00 ), 0xFF, 0x80); //FK: reset IO ports
+
+    pMapper->pRom0Bank          = gbEmptyRomBank;
+    pMapper->pRom1Bank          = gbEmptyRomBank;
+    pMapper->pRamBank           = nullptr;
+    pMapper->ramBankSizeInBytes = 0u;
+    pMapper->joypadReadCount    = 0u;
+    pMapper->joypadWriteCount   = 0u;
 
     pMapper->dmaActive  = 0;
     pMapper->lcdEnabled = 0;
     pMapper->ramEnabled = 0;
 }
 
-void initMemoryMapper( GBMemoryMapper* pMapper, uint8_t* pMemory )
-{
-    pMapper->pBaseAddress           = pMemory;
-    pMapper->pRom0Bank              = pMemory;
-    pMapper->pRom1Bank              = pMemory + 0x4000;
-    pMapper->pVideoRAM              = pMemory + 0x8000;
-    pMapper->pRamBankSwitch         = pMemory + 0xA000;
-    pMapper->pSpriteAttributes      = pMemory + 0xFE00;
-
-    resetMemoryMapper( pMapper );
-}
-
 void initTimerState( GBMemoryMapper* pMemoryMapper, GBTimerState* pTimerState )
 {
-    patchIOTimerMappedMemoryPointer( pMemoryMapper, pTimerState );
-    
     pTimerState->counterFrequencyBit    = K15_GB_COUNTER_FREQUENCY_BIT_00;
     pTimerState->internalDivCounter     = 0u;
     pTimerState->enableCounter          = 0u;
     pTimerState->timerOverflow          = 0u;
 
-    *pTimerState->pDivider      = 0xAB;
-    *pTimerState->pCounter      = 0;
-    *pTimerState->pModulo       = 0;
-    *pTimerState->pControl      = 0xF8;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_DIV )   = 0xAB;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TIMA )  = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TMA )   = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TAC )   = 0xF8;
 }
 
 void initSerialState( GBMemoryMapper* pMemoryMapper, GBSerialState* pSerialState )
 {
-    patchIOSerialMappedMemoryPointer( pMemoryMapper, pSerialState );
-
     pSerialState->cycleCounter          = 0u;
     pSerialState->inByte                = 0xFFu;
     pSerialState->shiftIndex            = 0u;
     pSerialState->initiateTransfer      = 0u;
     pSerialState->useInternalClock      = 0u;
+    pSerialState->linkConnected         = 0u;
+    pSerialState->linkTransferDue       = 0u;
+    pSerialState->transferredByteCount  = 0u;
 
-    *pSerialState->pSerialTransferControl   = 0x7E;
-    *pSerialState->pSerialTransferData      = 0x00;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SC )    = 0x7E;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB )    = 0x00;
 }
 
 void clearGBFrameBuffer( uint8_t* pGBFrameBuffer )
@@ -2159,28 +3668,18 @@ void extractMonochromePaletteFrom8BitValue( uint8_t* pMonochromePalette, uint8_t
     pMonochromePalette[3] = ( value >> 6 ) & 0x3;
 }
 
-void initPpuFrameBuffers( GBPpuState* pPpuState, uint8_t* pMemory )
-{
-    pPpuState->pGBFrameBuffers[ 0 ] = pMemory + 0;
-    pPpuState->pGBFrameBuffers[ 1 ] = pMemory + gbFrameBufferSizeInBytes;
-    clearGBFrameBuffer( pPpuState->pGBFrameBuffers[ 0 ] );
-    clearGBFrameBuffer( pPpuState->pGBFrameBuffers[ 1 ] );
-}
-
 void initPpuState( GBMemoryMapper* pMemoryMapper, GBPpuState* pPpuState )
 {
-    patchIOPpuMappedMemoryPointer( pMemoryMapper, pPpuState );
-
     //FK: set default state of LCDC (taken from bgb)
-    pMemoryMapper->pBaseAddress[ 0xFF40 ] = 0x91;
-    pMemoryMapper->pBaseAddress[ 0xFF41 ] = 0x80;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF40 ) = 0x91;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF41 ) = 0x80;
 
-    *pPpuState->lcdRegisters.pLy  = 0;
-    *pPpuState->lcdRegisters.pLyc = 0;
-    *pPpuState->lcdRegisters.pWx  = 0;
-    *pPpuState->lcdRegisters.pWy  = 0;
-    *pPpuState->lcdRegisters.pScx = 0;
-    *pPpuState->lcdRegisters.pScy = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY )    = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LYC )   = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WX )    = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WY )    = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SCX )   = 0;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SCY )   = 0;
 
     //FK: set default state of palettes (taken from bgb)
     extractMonochromePaletteFrom8BitValue( pPpuState->backgroundMonochromePalette, 0b11100100 );
@@ -2188,6 +3687,7 @@ void initPpuState( GBMemoryMapper* pMemoryMapper, GBPpuState* pPpuState )
     extractMonochromePaletteFrom8BitValue( pPpuState->objectMonochromePlatte + 4,  0b11100100 );
 
     pPpuState->dotCounter = 0;
+    pPpuState->cycleCounter = 0;
     pPpuState->scanlineSpriteCounter = 0;
 
     pPpuState->flags.drawBackground = 1;
@@ -2195,13 +3695,10 @@ void initPpuState( GBMemoryMapper* pMemoryMapper, GBPpuState* pPpuState )
     pPpuState->flags.drawObjects    = 1;
 
     pPpuState->activeFrameBufferIndex = 0;
-
-    clearGBFrameBuffer( pPpuState->pGBFrameBuffers[ pPpuState->activeFrameBufferIndex ] );
 }
 
 void initApuState( GBMemoryMapper* pMemoryMapper, GBApuState* pApuState )
 {
-    patchIOApuMappedMemoryPointer( pMemoryMapper, pApuState );
     pApuState->frameSequencer.clockCounter = 0u;
     pApuState->frameSequencer.cycleCounter = 0u;
 
@@ -2216,39 +3713,54 @@ void initApuState( GBMemoryMapper* pMemoryMapper, GBApuState* pApuState )
     pApuState->waveChannel.samplePosition               = 0u;
     pApuState->waveChannel.lengthTimer                  = 0u;
 
-    pMemoryMapper->pBaseAddress[ 0xFF10 ] = 0x80;
-    pMemoryMapper->pBaseAddress[ 0xFF11 ] = 0xBF;
-    pMemoryMapper->pBaseAddress[ 0xFF12 ] = 0xF3;
-    pMemoryMapper->pBaseAddress[ 0xFF14 ] = 0xBF;
-    pMemoryMapper->pBaseAddress[ 0xFF16 ] = 0x3F;
-    pMemoryMapper->pBaseAddress[ 0xFF17 ] = 0x00;
-    pMemoryMapper->pBaseAddress[ 0xFF19 ] = 0xBF;
-    pMemoryMapper->pBaseAddress[ 0xFF1A ] = 0x7F;
-    pMemoryMapper->pBaseAddress[ 0xFF1C ] = 0x9F;
-    pMemoryMapper->pBaseAddress[ 0xFF1E ] = 0xBF;
-    pMemoryMapper->pBaseAddress[ 0xFF21 ] = 0x00;
-    pMemoryMapper->pBaseAddress[ 0xFF22 ] = 0x00;
-    pMemoryMapper->pBaseAddress[ 0xFF23 ] = 0xBF;
-    pMemoryMapper->pBaseAddress[ 0xFF24 ] = 0x77;
-    pMemoryMapper->pBaseAddress[ 0xFF25 ] = 0xF3;
-    pMemoryMapper->pBaseAddress[ 0xFF26 ] = 0xF1;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF10 ) = 0x80;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF11 ) = 0xBF;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF12 ) = 0xF3;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF14 ) = 0xBF;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF16 ) = 0x3F;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF17 ) = 0x00;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF19 ) = 0xBF;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF1A ) = 0x7F;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF1C ) = 0x9F;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF1E ) = 0xBF;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF21 ) = 0x00;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF22 ) = 0x00;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF23 ) = 0xBF;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF24 ) = 0x77;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF25 ) = 0xF3;
+    *getMappedMemoryAddress( pMemoryMapper, 0xFF26 ) = 0xF1;
+}
+
+//FK: Size of the sub states up to the mapped memory of the memory mapper (see GBEmulatorInstance)
+size_t calculateGBEmulatorSubStateSizeInBytes()
+{
+    return offsetof( GBEmulatorInstance, memoryMapper ) + offsetof( GBMemoryMapper, memory ) - offsetof( GBEmulatorInstance, cpuState );
 }
 
 size_t calculateGBEmulatorMemoryRequirementsInBytes()
 {
-    const size_t memoryRequirementsInBytes = sizeof(GBEmulatorInstance) + sizeof(GBCpuState) + 
-        sizeof(GBMemoryMapper) + sizeof(GBPpuState) + sizeof(GBTimerState) + sizeof(GBCartridge) + 
-        sizeof(GBSerialState) + gbMappedMemorySizeInBytes + ( gbFrameBufferSizeInBytes * gbFrameBufferCount );
+    return sizeof( GBEmulatorInstance );
+}
+
+//FK: Since the instance doesn't contain any pointers into itself, cloning is a plain copy.
+//    The clone shares the rom and cartridge ram memory with the source instance.
+//    The input queue isn't shared since it can only have a single consumer.
+GBEmulatorInstance* cloneGBEmulatorInstance( uint8_t* pEmulatorInstanceMemory, const GBEmulatorInstance* pSourceEmulatorInstance )
+{
+    memcpy( pEmulatorInstanceMemory, pSourceEmulatorInstance, sizeof( GBEmulatorInstance ) );
 
-    return memoryRequirementsInBytes;
+    GBEmulatorInstance* pEmulatorInstance = (GBEmulatorInstance*)pEmulatorInstanceMemory;
+    pEmulatorInstance->pInputQueue          = nullptr;
+    pEmulatorInstance->pSubsystemProfile    = nullptr;
+    return pEmulatorInstance;
 }
 
 void resetGBEmulator( GBEmulatorInstance* pEmulatorInstance )
 {
-    GBMemoryMapper* pMemoryMapper = pEmulatorInstance->pMemoryMapper;
-    GBCartridge* pCartridge = pEmulatorInstance->pCartridge;
+    GBMemoryMapper* pMemoryMapper = &pEmulatorInstance->memoryMapper;
+    GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
 
-    resetMemoryMapper(pEmulatorInstance->pMemoryMapper );
+    resetMemoryMapper(&pEmulatorInstance->memoryMapper );
 
     uint8_t* pRamBaseAddress = pCartridge->pRamBaseAddress;
     if( pCartridge->pRomBaseAddress != nullptr )
@@ -2259,107 +3771,518 @@ void resetGBEmulator( GBEmulatorInstance* pEmulatorInstance )
         mapCartridgeMemory(pCartridge, pMemoryMapper, pCartridge->pRomBaseAddress, pCartridge->pRamBaseAddress );
     }
 
-    initCpuState(pEmulatorInstance->pMemoryMapper, pEmulatorInstance->pCpuState);
-    initPpuState(pEmulatorInstance->pMemoryMapper, pEmulatorInstance->pPpuState);
-    initApuState(pEmulatorInstance->pMemoryMapper, pEmulatorInstance->pApuState);
-    initTimerState(pEmulatorInstance->pMemoryMapper, pEmulatorInstance->pTimerState);
-    initSerialState(pEmulatorInstance->pMemoryMapper, pEmulatorInstance->pSerialState);
+    initCpuState(&pEmulatorInstance->memoryMapper, &pEmulatorInstance->cpuState);
+    initPpuState(&pEmulatorInstance->memoryMapper, &pEmulatorInstance->ppuState);
+    initApuState(&pEmulatorInstance->memoryMapper, &pEmulatorInstance->apuState);
+    initTimerState(&pEmulatorInstance->memoryMapper, &pEmulatorInstance->timerState);
+    initSerialState(&pEmulatorInstance->memoryMapper, &pEmulatorInstance->serialState);
+    memset(&pEmulatorInstance->inputPollState, 0, sizeof(GBInputPollState));
+    clearGBFrameBuffer(pEmulatorInstance->gbFrameBuffers[ pEmulatorInstance->ppuState.activeFrameBufferIndex ]);
+
+    pEmulatorInstance->joypadState.actionButtonMask  = 0;
+    pEmulatorInstance->joypadState.dpadButtonMask    = 0;
+
+    //FK: Reset joypad value
+    *getMappedMemoryAddress( &pEmulatorInstance->memoryMapper, 0xFF00 ) = 0xCF;
+    *getMappedMemoryAddress( &pEmulatorInstance->memoryMapper, 0xFF04 ) = 0x19;
+}
+
+#if K15_ENABLE_EMULATOR_DEBUG_FEATURES
+void setGBEmulatorBreakpoint( GBEmulatorInstance* pEmulatorInstance, uint8_t pauseAtBreakpoint, uint16_t breakpointAddress )
+{
+    pEmulatorInstance->debug.pauseAtBreakpoint = pauseAtBreakpoint;
+    pEmulatorInstance->debug.breakpointAddress = breakpointAddress;
+}
+
+void continueGBEmulatorExecution( GBEmulatorInstance* pEmulatorInstance )
+{
+    pEmulatorInstance->debug.continueExecution = 1;
+}
+
+void pauseGBEmulatorExecution( GBEmulatorInstance* pEmulatorInstance )
+{
+    pEmulatorInstance->debug.pauseExecution = 1;
+}
+
+void runGBEmulatorForOneInstruction( GBEmulatorInstance* pEmulatorInstance )
+{
+    pEmulatorInstance->debug.runForOneInstruction = 1;
+}
+
+void runGBEmulatorForOneFrame( GBEmulatorInstance* pEmulatorInstance )
+{
+    pEmulatorInstance->debug.runSingleFrame = 1;
+}
+#endif
+
+GBEmulatorInstance* createGBEmulatorInstance( uint8_t* pEmulatorInstanceMemory )
+{
+    GBEmulatorInstance* pEmulatorInstance = (GBEmulatorInstance*)pEmulatorInstanceMemory;
+    for( uint32_t frameBufferIndex = 0u; frameBufferIndex < gbFrameBufferCount; ++frameBufferIndex )
+    {
+        clearGBFrameBuffer( pEmulatorInstance->gbFrameBuffers[ frameBufferIndex ] );
+    }
+
+#if K15_ENABLE_EMULATOR_DEBUG_FEATURES
+    pEmulatorInstance->debug.breakpointAddress    = 0x0000;
+    pEmulatorInstance->debug.pauseAtBreakpoint    = 0;
+    pEmulatorInstance->debug.pauseExecution       = 0;
+    pEmulatorInstance->debug.runForOneInstruction = 0;
+    pEmulatorInstance->debug.runSingleFrame       = 0;
+    pEmulatorInstance->debug.continueExecution    = 0;
+    pEmulatorInstance->debug.opcodeHistorySize    = 0;
+    memset( pEmulatorInstance->debug.opcodeHistory, 0, sizeof( pEmulatorInstance->debug.opcodeHistory ) );
+#endif
+
+    //FK: no cartridge loaded yet
+    memset( &pEmulatorInstance->cartridge, 0, sizeof( GBCartridge ) );
+
+    pEmulatorInstance->stateSavedCounter.store( 0u, std::memory_order_relaxed );
+    pEmulatorInstance->reportedStateSavedCounter    = 0u;
+    pEmulatorInstance->skipRendering                = 0u;
+    pEmulatorInstance->pInputQueue                  = nullptr;
+    pEmulatorInstance->pSubsystemProfile            = nullptr;
+    pEmulatorInstance->stopAddress                  = 0x0000;
+    pEmulatorInstance->stopLine                     = 0u;
+
+    resetGBEmulator( pEmulatorInstance );
+    return pEmulatorInstance;
+}
+
+GBMapCartridgeResult loadGBEmulatorRom( GBEmulatorInstance* pEmulator, const uint8_t* pRomMemory, uint8_t* pRamMemory )
+{
+    pEmulator->cartridge.pRomBaseAddress = nullptr;
+
+    resetGBEmulator( pEmulator );
+    return mapCartridgeMemory( &pEmulator->cartridge, &pEmulator->memoryMapper, pRomMemory, pRamMemory );
+}
+
+//FK: Snapshots are meant for workloads that restore states thousands of times per second (eg: search or training).
+//    They are plain copies of the sub states and the writable part of the mapped memory - no rom, no framebuffers, no compression.
+//    A snapshot can be restored into any instance that has the same rom loaded and is only valid for the same emulator build.
+size_t calculateGBEmulatorSnapshotSizeInBytes( const GBEmulatorInstance* pEmulatorInstance )
+{
+    return sizeof( GBEmulatorSnapshotHeader ) + calculateGBEmulatorSubStateSizeInBytes() + gbMappedMemorySizeInBytes + pEmulatorInstance->cartridge.ramSizeInBytes;
+}
+
+//FK: Writes the snapshot header and the sub states, returns the number of bytes written
+size_t snapshotGBEmulatorSubStates( const GBEmulatorInstance* pEmulatorInstance, uint8_t* pSnapshotMemory )
+{
+    RuntimeAssert( isGBEmulatorRomMapped( pEmulatorInstance ) );
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+
+    GBEmulatorSnapshotHeader* pHeader   = ( GBEmulatorSnapshotHeader* )pSnapshotMemory;
+    pHeader->cartridgeRamSizeInBytes    = pCartridge->ramSizeInBytes;
+    pHeader->romGlobalChecksum          = ( uint16_t )( pCartridge->header.checksumHigher << 8 | pCartridge->header.checksumLower );
+    pHeader->romHeaderChecksum          = pCartridge->header.headerChecksum;
+    pHeader->joypadState                = pEmulatorInstance->joypadState;
+    pHeader->flags                      = pEmulatorInstance->flags;
+
+    //FK: The sub states are laid out back to back, starting with the cpu state and ending with the mapped memory
+    const size_t subStateSizeInBytes = calculateGBEmulatorSubStateSizeInBytes();
+    memcpy( pSnapshotMemory + sizeof( GBEmulatorSnapshotHeader ), &pEmulatorInstance->cpuState, subStateSizeInBytes );
+    return sizeof( GBEmulatorSnapshotHeader ) + subStateSizeInBytes;
+}
+
+void snapshotGBEmulator( const GBEmulatorInstance* pEmulatorInstance, uint8_t* pSnapshotMemory )
+{
+    pSnapshotMemory += snapshotGBEmulatorSubStates( pEmulatorInstance, pSnapshotMemory );
+
+    memcpy( pSnapshotMemory, pEmulatorInstance->memoryMapper.memory, gbMappedMemorySizeInBytes );
+    pSnapshotMemory += gbMappedMemorySizeInBytes;
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    if( pCartridge->ramSizeInBytes > 0u )
+    {
+        memcpy( pSnapshotMemory, pCartridge->pRamBaseAddress, pCartridge->ramSizeInBytes );
+    }
+}
+
+//FK: Snapshots are copied into the instance as they are, so the values that get used to map memory or to index arrays are checked first.
+//    This keeps snapshots of untrusted memory (eg: movie keyframes, see k15_gb_movie.h) from pointing the banks outside of the rom/ram.
+bool8_t isGBEmulatorSnapshotSubStateValid( const GBEmulatorInstance* pEmulatorInstance, const uint8_t* pSubStateMemory )
+{
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+
+    GBCartridge snapshotCartridge;
+    GBPpuState snapshotPpuState;
+    memcpy( &snapshotCartridge, pSubStateMemory + offsetof( GBEmulatorInstance, cartridge ) - offsetof( GBEmulatorInstance, cpuState ), sizeof( GBCartridge ) );
+    memcpy( &snapshotPpuState, pSubStateMemory + offsetof( GBEmulatorInstance, ppuState ) - offsetof( GBEmulatorInstance, cpuState ), sizeof( GBPpuState ) );
+
+    if( snapshotCartridge.romSizeInBytes != pCartridge->romSizeInBytes || snapshotCartridge.ramSizeInBytes != pCartridge->ramSizeInBytes ||
+        snapshotCartridge.romBankCount != pCartridge->romBankCount || snapshotCartridge.ramBankCount != pCartridge->ramBankCount ||
+        memcmp( &snapshotCartridge.header, &pCartridge->header, sizeof( GBRomHeader ) ) != 0 )
+    {
+        return 0u;
+    }
+
+    GBMbcStateChunk mbcChunk;
+    storeGBMbcStateChunk( &snapshotCartridge, &mbcChunk );
+    if( !isGBMbcStateChunkValid( pCartridge, &mbcChunk ) || ( pCartridge->ramBankCount == 0u && snapshotCartridge.mappedRamBankNumber != 0u ) )
+    {
+        return 0u;
+    }
+
+    return snapshotPpuState.activeFrameBufferIndex < gbFrameBufferCount && snapshotPpuState.scanlineSpriteCounter <= gbSpritesPerScanline;
+}
+
+//FK: Restores the sub states of a snapshot, the mapped memory and the cartridge ram have to be restored by the caller (only if this succeeded).
+//    Nothing gets restored if the snapshot has been taken with a different rom or contains invalid banks (see isGBEmulatorSnapshotSubStateValid()).
+GBStateLoadResult restoreGBEmulatorSubStates( GBEmulatorInstance* pEmulatorInstance, const GBEmulatorSnapshotHeader* pHeader, const uint8_t* pSubStateMemory )
+{
+    GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+
+    const uint16_t romGlobalChecksum = ( uint16_t )( pCartridge->header.checksumHigher << 8 | pCartridge->header.checksumLower );
+    if( !isGBEmulatorRomMapped( pEmulatorInstance ) || pHeader->romHeaderChecksum != pCartridge->header.headerChecksum || pHeader->romGlobalChecksum != romGlobalChecksum )
+    {
+        return K15_GB_STATE_LOAD_FAILED_WRONG_ROM;
+    }
+
+    if( pHeader->cartridgeRamSizeInBytes != pCartridge->ramSizeInBytes || !isGBEmulatorSnapshotSubStateValid( pEmulatorInstance, pSubStateMemory ) )
+    {
+        return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    //FK: The rom/ram pointers are owned by the host, keep them and point the mapped banks into them again.
+    const uint8_t* pRomBaseAddress          = pCartridge->pRomBaseAddress;
+    uint8_t* pRamBaseAddress                = pCartridge->pRamBaseAddress;
+
+    memcpy( &pEmulatorInstance->cpuState, pSubStateMemory, calculateGBEmulatorSubStateSizeInBytes() );
+
+    pCartridge->pRomBaseAddress             = pRomBaseAddress;
+    pCartridge->pRamBaseAddress             = pRamBaseAddress;
+    remapCartridgeBanks( pCartridge, &pEmulatorInstance->memoryMapper );
+
+    pEmulatorInstance->joypadState  = pHeader->joypadState;
+    pEmulatorInstance->flags        = pHeader->flags;
+    return K15_GB_STATE_LOAD_SUCCESS;
+}
+
+//FK: The framebuffers are not part of the snapshot, they'll contain the restored state after the next vblank.
+GBStateLoadResult restoreGBEmulator( GBEmulatorInstance* pEmulatorInstance, const uint8_t* pSnapshotMemory )
+{
+    const GBEmulatorSnapshotHeader* pHeader = ( const GBEmulatorSnapshotHeader* )pSnapshotMemory;
+    pSnapshotMemory += sizeof( GBEmulatorSnapshotHeader );
+
+    const GBStateLoadResult result = restoreGBEmulatorSubStates( pEmulatorInstance, pHeader, pSnapshotMemory );
+    if( result != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        return result;
+    }
+
+    pSnapshotMemory += calculateGBEmulatorSubStateSizeInBytes();
+
+    memcpy( pEmulatorInstance->memoryMapper.memory, pSnapshotMemory, gbMappedMemorySizeInBytes );
+    pSnapshotMemory += gbMappedMemorySizeInBytes;
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    if( pCartridge->ramSizeInBytes > 0u )
+    {
+        memcpy( pCartridge->pRamBaseAddress, pSnapshotMemory, pCartridge->ramSizeInBytes );
+    }
+
+    return K15_GB_STATE_LOAD_SUCCESS;
+}
+
+uint32_t calculateGBSnapshotStoreHashTableCapacity( const uint32_t pageCapacity )
+{
+    //FK: Keep the load factor of the hash table at or below 50%
+    uint32_t hashTableCapacity = 1u;
+    while( hashTableCapacity < pageCapacity * 2u )
+    {
+        hashTableCapacity <<= 1u;
+    }
+
+    return hashTableCapacity;
+}
+
+size_t calculateGBSnapshotStoreEntrySizeInBytes()
+{
+    const size_t entrySizeInBytes = gbSnapshotStoreMaxPagesPerSnapshot * sizeof( uint32_t ) + sizeof( GBEmulatorSnapshotHeader ) + calculateGBEmulatorSubStateSizeInBytes();
+    return ( entrySizeInBytes + 7u ) & ~( size_t )7u;
+}
+
+//FK: A snapshot of a rom with 8KB cartridge ram needs 10 pages if nothing can be shared, 
+//    so pageCapacity should be somewhere between 2x and 10x the snapshot capacity depending on how similar the snapshots are.
+size_t calculateGBSnapshotStoreMemoryRequirementsInBytes( const uint32_t pageCapacity, const uint32_t snapshotCapacity )
+{
+    const uint32_t hashTableCapacity = calculateGBSnapshotStoreHashTableCapacity( pageCapacity );
+    return sizeof( GBSnapshotStore ) + 64u + ( pageCapacity + 1u ) * gbSnapshotStorePageSizeInBytes + 
+        pageCapacity * ( sizeof( uint64_t ) + sizeof( uint32_t ) * 2u ) + hashTableCapacity * sizeof( uint32_t ) +
+        snapshotCapacity * ( calculateGBSnapshotStoreEntrySizeInBytes() + sizeof( uint32_t ) );
+}
+
+GBSnapshotStore* createGBSnapshotStore( uint8_t* pSnapshotStoreMemory, const uint32_t pageCapacity, const uint32_t snapshotCapacity )
+{
+    RuntimeAssert( pageCapacity > 0u );
+    RuntimeAssert( snapshotCapacity > 0u );
+
+    GBSnapshotStore* pSnapshotStore = ( GBSnapshotStore* )pSnapshotStoreMemory;
+    pSnapshotStore->pageCapacity                = pageCapacity;
+    pSnapshotStore->snapshotCapacity            = snapshotCapacity;
+    pSnapshotStore->hashTableCapacity           = calculateGBSnapshotStoreHashTableCapacity( pageCapacity );
+    pSnapshotStore->snapshotEntrySizeInBytes    = calculateGBSnapshotStoreEntrySizeInBytes();
+
+    //FK: Cache line align the pages
+    const size_t pageOffset = ( ( size_t )( pSnapshotStoreMemory + sizeof( GBSnapshotStore ) ) + 63u ) & ~( size_t )63u;
+    pSnapshotStore->pPages                  = ( uint8_t* )pageOffset;
+    pSnapshotStore->pScratchPage            = pSnapshotStore->pPages + pageCapacity * gbSnapshotStorePageSizeInBytes;
+    pSnapshotStore->pPageHashes             = ( uint64_t* )( pSnapshotStore->pScratchPage + gbSnapshotStorePageSizeInBytes );
+    pSnapshotStore->pSnapshotEntries        = ( uint8_t* )( pSnapshotStore->pPageHashes + pageCapacity );
+    pSnapshotStore->pPageReferenceCounts    = ( uint32_t* )( pSnapshotStore->pSnapshotEntries + snapshotCapacity * pSnapshotStore->snapshotEntrySizeInBytes );
+    pSnapshotStore->pFreePageIndices        = pSnapshotStore->pPageReferenceCounts + pageCapacity;
+    pSnapshotStore->pFreeSnapshotHandles    = pSnapshotStore->pFreePageIndices + pageCapacity;
+    pSnapshotStore->pHashTable              = pSnapshotStore->pFreeSnapshotHandles + snapshotCapacity;
+
+    //FK: Free lists are used as stacks, hand out the lowest indices first
+    for( uint32_t pageIndex = 0u; pageIndex < pageCapacity; ++pageIndex )
+    {
+        pSnapshotStore->pFreePageIndices[ pageIndex ] = pageCapacity - pageIndex - 1u;
+        pSnapshotStore->pPageReferenceCounts[ pageIndex ] = 0u;
+    }
+
+    for( uint32_t handleIndex = 0u; handleIndex < snapshotCapacity; ++handleIndex )
+    {
+        pSnapshotStore->pFreeSnapshotHandles[ handleIndex ] = snapshotCapacity - handleIndex - 1u;
+    }
+
+    memset( pSnapshotStore->pHashTable, 0, pSnapshotStore->hashTableCapacity * sizeof( uint32_t ) );
+
+    pSnapshotStore->freePageCount           = pageCapacity;
+    pSnapshotStore->freeSnapshotHandleCount = snapshotCapacity;
+    pSnapshotStore->referencedPageCount     = 0u;
+    pSnapshotStore->pagesPerSnapshot        = 0u;
+    return pSnapshotStore;
+}
+
+uint64_t calculateGBSnapshotStorePageHash( const uint8_t* pPage )
+{
+    return calculateGBMemoryHash( pPage, gbSnapshotStorePageSizeInBytes );
+}
+
+uint8_t* getGBSnapshotStorePage( const GBSnapshotStore* pSnapshotStore, const uint32_t pageIndex )
+{
+    return pSnapshotStore->pPages + pageIndex * gbSnapshotStorePageSizeInBytes;
+}
+
+//FK: Returns the index of an identical page (reference count gets incremented) or stores the page.
+//    Returns gbInvalidSnapshotStorePageIndex if the page store is full.
+uint32_t addGBSnapshotStorePage( GBSnapshotStore* pSnapshotStore, const uint8_t* pPage )
+{
+    const uint64_t hash = calculateGBSnapshotStorePageHash( pPage );
+    const uint32_t hashTableMask = pSnapshotStore->hashTableCapacity - 1u;
+
+    uint32_t slotIndex = ( uint32_t )hash & hashTableMask;
+    while( pSnapshotStore->pHashTable[ slotIndex ] != 0u )
+    {
+        const uint32_t pageIndex = pSnapshotStore->pHashTable[ slotIndex ] - 1u;
+        if( pSnapshotStore->pPageHashes[ pageIndex ] == hash && 
+            memcmp( getGBSnapshotStorePage( pSnapshotStore, pageIndex ), pPage, gbSnapshotStorePageSizeInBytes ) == 0 )
+        {
+            ++pSnapshotStore->pPageReferenceCounts[ pageIndex ];
+            return pageIndex;
+        }
+
+        slotIndex = ( slotIndex + 1u ) & hashTableMask;
+    }
+
+    if( pSnapshotStore->freePageCount == 0u )
+    {
+        return gbInvalidSnapshotStorePageIndex;
+    }
+
+    const uint32_t pageIndex = pSnapshotStore->pFreePageIndices[ --pSnapshotStore->freePageCount ];
+    memcpy( getGBSnapshotStorePage( pSnapshotStore, pageIndex ), pPage, gbSnapshotStorePageSizeInBytes );
+    pSnapshotStore->pPageHashes[ pageIndex ]            = hash;
+    pSnapshotStore->pPageReferenceCounts[ pageIndex ]   = 1u;
+    pSnapshotStore->pHashTable[ slotIndex ]             = pageIndex + 1u;
+    return pageIndex;
+}
+
+void releaseGBSnapshotStorePage( GBSnapshotStore* pSnapshotStore, const uint32_t pageIndex )
+{
+    RuntimeAssert( pSnapshotStore->pPageReferenceCounts[ pageIndex ] > 0u );
+    if( --pSnapshotStore->pPageReferenceCounts[ pageIndex ] > 0u )
+    {
+        return;
+    }
+
+    const uint32_t hashTableMask = pSnapshotStore->hashTableCapacity - 1u;
+    uint32_t slotIndex = ( uint32_t )pSnapshotStore->pPageHashes[ pageIndex ] & hashTableMask;
+    while( pSnapshotStore->pHashTable[ slotIndex ] != pageIndex + 1u )
+    {
+        slotIndex = ( slotIndex + 1u ) & hashTableMask;
+    }
+
+    //FK: Backward shift deletion - move entries of the same probe sequence into the free slot so lookups don't need tombstones
+    uint32_t nextSlotIndex = slotIndex;
+    while( true )
+    {
+        nextSlotIndex = ( nextSlotIndex + 1u ) & hashTableMask;
+        if( pSnapshotStore->pHashTable[ nextSlotIndex ] == 0u )
+        {
+            break;
+        }
 
-    pEmulatorInstance->joypadState.actionButtonMask  = 0;
-    pEmulatorInstance->joypadState.dpadButtonMask    = 0;
+        const uint32_t homeSlotIndex = ( uint32_t )pSnapshotStore->pPageHashes[ pSnapshotStore->pHashTable[ nextSlotIndex ] - 1u ] & hashTableMask;
+        const uint32_t distanceToHome = ( nextSlotIndex - homeSlotIndex ) & hashTableMask;
+        const uint32_t distanceToFreeSlot = ( nextSlotIndex - slotIndex ) & hashTableMask;
+        if( distanceToHome >= distanceToFreeSlot )
+        {
+            pSnapshotStore->pHashTable[ slotIndex ] = pSnapshotStore->pHashTable[ nextSlotIndex ];
+            slotIndex = nextSlotIndex;
+        }
+    }
 
-    //FK: Reset joypad value
-    pEmulatorInstance->pMemoryMapper->pBaseAddress[0xFF00] = 0xCF;
-    pEmulatorInstance->pMemoryMapper->pBaseAddress[0xFF04] = 0x19;
+    pSnapshotStore->pHashTable[ slotIndex ] = 0u;
+    pSnapshotStore->pFreePageIndices[ pSnapshotStore->freePageCount++ ] = pageIndex;
 }
 
-#if K15_ENABLE_EMULATOR_DEBUG_FEATURES
-void setGBEmulatorBreakpoint( GBEmulatorInstance* pEmulatorInstance, uint8_t pauseAtBreakpoint, uint16_t breakpointAddress )
+uint8_t* getGBSnapshotStoreEntry( const GBSnapshotStore* pSnapshotStore, const GBSnapshotHandle snapshotHandle )
 {
-    pEmulatorInstance->debug.pauseAtBreakpoint = pauseAtBreakpoint;
-    pEmulatorInstance->debug.breakpointAddress = breakpointAddress;
+    RuntimeAssert( snapshotHandle < pSnapshotStore->snapshotCapacity );
+    return pSnapshotStore->pSnapshotEntries + snapshotHandle * pSnapshotStore->snapshotEntrySizeInBytes;
 }
 
-void continueGBEmulatorExecution( GBEmulatorInstance* pEmulatorInstance )
+//FK: Returns the page at the given offset of a memory region, partial pages at the end of the region are padded with zeros using the scratch page
+const uint8_t* getGBSnapshotStoreRegionPage( GBSnapshotStore* pSnapshotStore, const uint8_t* pRegionMemory, const size_t regionSizeInBytes, const size_t offset )
 {
-    pEmulatorInstance->debug.continueExecution = 1;
-}
+    if( offset + gbSnapshotStorePageSizeInBytes <= regionSizeInBytes )
+    {
+        return pRegionMemory + offset;
+    }
 
-void pauseGBEmulatorExecution( GBEmulatorInstance* pEmulatorInstance )
-{
-    pEmulatorInstance->debug.pauseExecution = 1;
+    memset( pSnapshotStore->pScratchPage, 0, gbSnapshotStorePageSizeInBytes );
+    memcpy( pSnapshotStore->pScratchPage, pRegionMemory + offset, regionSizeInBytes - offset );
+    return pSnapshotStore->pScratchPage;
 }
 
-void runGBEmulatorForOneInstruction( GBEmulatorInstance* pEmulatorInstance )
+//FK: Returns the memory of the page with the given index within the snapshot (mapped memory pages first, cartridge ram pages after that)
+const uint8_t* getGBEmulatorSnapshotPageSource( GBSnapshotStore* pSnapshotStore, const GBEmulatorInstance* pEmulatorInstance, const uint32_t snapshotPageIndex )
 {
-    pEmulatorInstance->debug.runForOneInstruction = 1;
+    if( snapshotPageIndex < gbSnapshotStoreMappedMemoryPageCount )
+    {
+        const size_t offset = snapshotPageIndex * gbSnapshotStorePageSizeInBytes;
+        return getGBSnapshotStoreRegionPage( pSnapshotStore, pEmulatorInstance->memoryMapper.memory, gbMappedMemorySizeInBytes, offset );
+    }
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    const size_t ramOffset = ( snapshotPageIndex - gbSnapshotStoreMappedMemoryPageCount ) * gbSnapshotStorePageSizeInBytes;
+    return getGBSnapshotStoreRegionPage( pSnapshotStore, pCartridge->pRamBaseAddress, pCartridge->ramSizeInBytes, ramOffset );
 }
 
-void runGBEmulatorForOneFrame( GBEmulatorInstance* pEmulatorInstance )
+void releaseGBEmulatorSnapshot( GBSnapshotStore* pSnapshotStore, const GBSnapshotHandle snapshotHandle )
 {
-    pEmulatorInstance->debug.runSingleFrame = 1;
+    const uint32_t* pPageIndices = ( const uint32_t* )getGBSnapshotStoreEntry( pSnapshotStore, snapshotHandle );
+    for( uint32_t snapshotPageIndex = 0u; snapshotPageIndex < pSnapshotStore->pagesPerSnapshot; ++snapshotPageIndex )
+    {
+        releaseGBSnapshotStorePage( pSnapshotStore, pPageIndices[ snapshotPageIndex ] );
+    }
+
+    pSnapshotStore->referencedPageCount -= pSnapshotStore->pagesPerSnapshot;
+    pSnapshotStore->pFreeSnapshotHandles[ pSnapshotStore->freeSnapshotHandleCount++ ] = snapshotHandle;
 }
-#endif
 
-GBEmulatorInstance* createGBEmulatorInstance( uint8_t* pEmulatorInstanceMemory )
+//FK: Returns gbInvalidSnapshotHandle if the store is out of snapshot handles or pages, or if the store holds snapshots of an instance
+//    with a different cartridge ram size.
+GBSnapshotHandle storeGBEmulatorSnapshot( GBSnapshotStore* pSnapshotStore, const GBEmulatorInstance* pEmulatorInstance )
 {
-    GBEmulatorInstance* pEmulatorInstance = (GBEmulatorInstance*)pEmulatorInstanceMemory;
-    pEmulatorInstance->pCpuState        = (GBCpuState*)(pEmulatorInstance + 1);
-    pEmulatorInstance->pApuState        = (GBApuState*)(pEmulatorInstance->pCpuState + 1);
-    pEmulatorInstance->pMemoryMapper    = (GBMemoryMapper*)(pEmulatorInstance->pApuState + 1);
-    pEmulatorInstance->pPpuState        = (GBPpuState*)(pEmulatorInstance->pMemoryMapper + 1);
-    pEmulatorInstance->pTimerState      = (GBTimerState*)(pEmulatorInstance->pPpuState + 1);
-    pEmulatorInstance->pSerialState     = (GBSerialState*)(pEmulatorInstance->pTimerState + 1);
-    pEmulatorInstance->pCartridge       = (GBCartridge*)(pEmulatorInstance->pSerialState + 1);
+    const uint32_t pagesPerSnapshot = gbSnapshotStoreMappedMemoryPageCount + ( uint32_t )( ( pEmulatorInstance->cartridge.ramSizeInBytes + gbSnapshotStorePageSizeInBytes - 1u ) / gbSnapshotStorePageSizeInBytes );
+    if( pSnapshotStore->freeSnapshotHandleCount == pSnapshotStore->snapshotCapacity )
+    {
+        pSnapshotStore->pagesPerSnapshot = pagesPerSnapshot;
+    }
 
-    uint8_t* pGBMemory = (uint8_t*)(pEmulatorInstance->pCartridge + 1);
-    initMemoryMapper( pEmulatorInstance->pMemoryMapper, pGBMemory );
+    if( pSnapshotStore->freeSnapshotHandleCount == 0u || pSnapshotStore->pagesPerSnapshot != pagesPerSnapshot )
+    {
+        return gbInvalidSnapshotHandle;
+    }
 
-    uint8_t* pFramebufferMemory = (uint8_t*)(pGBMemory + gbMappedMemorySizeInBytes);
-    initPpuFrameBuffers( pEmulatorInstance->pPpuState, pFramebufferMemory );
+    const GBSnapshotHandle snapshotHandle = pSnapshotStore->pFreeSnapshotHandles[ pSnapshotStore->freeSnapshotHandleCount - 1u ];
+    uint8_t* pEntry = getGBSnapshotStoreEntry( pSnapshotStore, snapshotHandle );
+    uint32_t* pPageIndices = ( uint32_t* )pEntry;
 
-#if K15_ENABLE_EMULATOR_DEBUG_FEATURES
-    pEmulatorInstance->debug.breakpointAddress    = 0x0000;
-    pEmulatorInstance->debug.pauseAtBreakpoint    = 0;
-    pEmulatorInstance->debug.pauseExecution       = 0;
-    pEmulatorInstance->debug.runForOneInstruction = 0;
-    pEmulatorInstance->debug.runSingleFrame       = 0;
-    pEmulatorInstance->debug.continueExecution    = 0;
-    pEmulatorInstance->debug.opcodeHistorySize    = 0;
-    memset( pEmulatorInstance->debug.opcodeHistory, 0, sizeof( pEmulatorInstance->debug.opcodeHistory ) );
-#endif
+    for( uint32_t snapshotPageIndex = 0u; snapshotPageIndex < pagesPerSnapshot; ++snapshotPageIndex )
+    {
+        const uint8_t* pPage = getGBEmulatorSnapshotPageSource( pSnapshotStore, pEmulatorInstance, snapshotPageIndex );
+        pPageIndices[ snapshotPageIndex ] = addGBSnapshotStorePage( pSnapshotStore, pPage );
+        if( pPageIndices[ snapshotPageIndex ] == gbInvalidSnapshotStorePageIndex )
+        {
+            //FK: Out of pages, undo what has been added so far
+            for( uint32_t addedPageIndex = 0u; addedPageIndex < snapshotPageIndex; ++addedPageIndex )
+            {
+                releaseGBSnapshotStorePage( pSnapshotStore, pPageIndices[ addedPageIndex ] );
+            }
 
-    //FK: no cartridge loaded yet
-    memset( pEmulatorInstance->pCartridge, 0, sizeof( GBCartridge ) );
+            return gbInvalidSnapshotHandle;
+        }
+    }
 
-    resetGBEmulator( pEmulatorInstance );
-    return pEmulatorInstance;
+    snapshotGBEmulatorSubStates( pEmulatorInstance, pEntry + gbSnapshotStoreMaxPagesPerSnapshot * sizeof( uint32_t ) );
+
+    --pSnapshotStore->freeSnapshotHandleCount;
+    pSnapshotStore->referencedPageCount += pagesPerSnapshot;
+    return snapshotHandle;
 }
 
-GBMapCartridgeResult loadGBEmulatorRom( GBEmulatorInstance* pEmulator, const uint8_t* pRomMemory, uint8_t* pRamMemory )
+//FK: The framebuffers are not part of the snapshot, they'll contain the restored state after the next vblank.
+GBStateLoadResult restoreGBEmulatorSnapshot( GBSnapshotStore* pSnapshotStore, GBEmulatorInstance* pEmulatorInstance, const GBSnapshotHandle snapshotHandle )
 {
-    pEmulator->pCartridge->pRomBaseAddress = nullptr;
-    pEmulator->pCartridge->mappedRom0BankNumber = 0xFFu;
-    pEmulator->pCartridge->mappedRom1BankNumber = 0xFFu;
-    pEmulator->pCartridge->mappedRamBankNumber  = 0xFFu;
+    const uint8_t* pEntry = getGBSnapshotStoreEntry( pSnapshotStore, snapshotHandle );
+    const uint32_t* pPageIndices = ( const uint32_t* )pEntry;
+    const uint8_t* pSnapshotMemory = pEntry + gbSnapshotStoreMaxPagesPerSnapshot * sizeof( uint32_t );
 
-    resetGBEmulator( pEmulator );
-    return mapCartridgeMemory( pEmulator->pCartridge, pEmulator->pMemoryMapper, pRomMemory, pRamMemory );
+    const GBStateLoadResult result = restoreGBEmulatorSubStates( pEmulatorInstance, ( const GBEmulatorSnapshotHeader* )pSnapshotMemory, pSnapshotMemory + sizeof( GBEmulatorSnapshotHeader ) );
+    if( result != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        return result;
+    }
+
+    const GBCartridge* pCartridge = &pEmulatorInstance->cartridge;
+    for( uint32_t snapshotPageIndex = 0u; snapshotPageIndex < pSnapshotStore->pagesPerSnapshot; ++snapshotPageIndex )
+    {
+        const uint8_t* pPage = getGBSnapshotStorePage( pSnapshotStore, pPageIndices[ snapshotPageIndex ] );
+        if( snapshotPageIndex < gbSnapshotStoreMappedMemoryPageCount )
+        {
+            const size_t offset = snapshotPageIndex * gbSnapshotStorePageSizeInBytes;
+            memcpy( pEmulatorInstance->memoryMapper.memory + offset, pPage, GetMin( gbSnapshotStorePageSizeInBytes, gbMappedMemorySizeInBytes - offset ) );
+        }
+        else
+        {
+            const size_t ramOffset = ( snapshotPageIndex - gbSnapshotStoreMappedMemoryPageCount ) * gbSnapshotStorePageSizeInBytes;
+            memcpy( pCartridge->pRamBaseAddress + ramOffset, pPage, GetMin( gbSnapshotStorePageSizeInBytes, pCartridge->ramSizeInBytes - ramOffset ) );
+        }
+    }
+
+    return K15_GB_STATE_LOAD_SUCCESS;
+}
+
+GBSnapshotStoreStats getGBSnapshotStoreStats( const GBSnapshotStore* pSnapshotStore )
+{
+    GBSnapshotStoreStats stats;
+    stats.pageCapacity          = pSnapshotStore->pageCapacity;
+    stats.snapshotCapacity      = pSnapshotStore->snapshotCapacity;
+    stats.snapshotCount         = pSnapshotStore->snapshotCapacity - pSnapshotStore->freeSnapshotHandleCount;
+    stats.uniquePageCount       = pSnapshotStore->pageCapacity - pSnapshotStore->freePageCount;
+    stats.referencedPageCount   = pSnapshotStore->referencedPageCount;
+    stats.pageMemoryUsedInBytes = stats.uniquePageCount * gbSnapshotStorePageSizeInBytes;
+    stats.snapshotSizeInBytes   = pSnapshotStore->pagesPerSnapshot * gbSnapshotStorePageSizeInBytes + sizeof( GBEmulatorSnapshotHeader ) + calculateGBEmulatorSubStateSizeInBytes();
+    return stats;
 }
 
-uint8_t* getActiveFrameBuffer( GBPpuState* pPpuState )
+uint8_t* getActiveFrameBuffer( GBEmulatorInstance* pEmulatorInstance )
 {
-    return pPpuState->pGBFrameBuffers[ pPpuState->activeFrameBufferIndex ];
+    return pEmulatorInstance->gbFrameBuffers[ pEmulatorInstance->ppuState.activeFrameBufferIndex ];
 }
 
-void pushSpritePixelsToScanline( GBPpuState* pPpuState, uint8_t scanlineYCoordinate )
+void pushSpritePixelsToScanline( GBPpuState* pPpuState, GBMemoryMapper* pMemoryMapper, uint8_t* pActiveFrameBuffer, uint8_t scanlineYCoordinate )
 {
     if( pPpuState->scanlineSpriteCounter == 0 )
     {
         return;
     }
 
-    uint8_t* pActiveFrameBuffer = getActiveFrameBuffer( pPpuState );
     uint8_t* pFrameBufferPixelData = pActiveFrameBuffer + ( gbFrameBufferScanlineSizeInBytes * scanlineYCoordinate );
     for( size_t spriteIndex = 0; spriteIndex < pPpuState->scanlineSpriteCounter; ++spriteIndex )
     {
@@ -2371,11 +4294,11 @@ void pushSpritePixelsToScanline( GBPpuState* pPpuState, uint8_t scanlineYCoordin
         }
 
         //FK: Get pixel data of top most pixel line of current tile
-        const uint8_t* pTileTopPixelData = pPpuState->pTileBlocks[0] + pSprite->tileIndex * gbTileSizeInBytes;
+        const uint8_t* pTileTopPixelData = getTileData( pMemoryMapper, 1 ) + pSprite->tileIndex * gbTileSizeInBytes;
         uint32_t tileScanlineOffset = ( scanlineYCoordinate - pSprite->y + gbSpriteHeight );
         if( pSprite->flags.yflip )
         {
-            const uint8_t objHeight = pPpuState->pLcdControl->objSize == 0 ? 8 : 16;
+            const uint8_t objHeight = getLcdControl( pMemoryMapper )->objSize == 0 ? 8 : 16;
             tileScanlineOffset = ( objHeight - 1 ) - tileScanlineOffset;
         }
 
@@ -2428,9 +4351,9 @@ void pushSpritePixelsToScanline( GBPpuState* pPpuState, uint8_t scanlineYCoordin
 }
 
 template<typename IndexType>
-void pushWindowPixelsToScanline( GBPpuState* pPpuState, const uint8_t* pTileData, uint8_t scanlineYCoordinate, const uint8_t wx, const uint8_t wy )
+void pushWindowPixelsToScanline( GBPpuState* pPpuState, GBMemoryMapper* pMemoryMapper, uint8_t* pActiveFrameBuffer, const uint8_t* pTileData, uint8_t scanlineYCoordinate, const uint8_t wx, const uint8_t wy )
 {
-    const IndexType* pBackgroundTileIds  = (IndexType*)pPpuState->pBackgroundOrWindowTileIds[ pPpuState->pLcdControl->windowTileMapArea ];
+    const IndexType* pBackgroundTileIds  = (const IndexType*)getTileMap( pMemoryMapper, getLcdControl( pMemoryMapper )->windowTileMapArea );
 
     //FK: Calculate the tile row that intersects with the current scanline
     const uint8_t y = scanlineYCoordinate - wy;
@@ -2497,7 +4420,6 @@ void pushWindowPixelsToScanline( GBPpuState* pPpuState, const uint8_t* pTileData
     uint8_t scanlinePixelDataShift = 6 - (wxpos%4) * 2;
     uint8_t scanlinePixelDataIndex = wxpos/4;
 
-    uint8_t* pActiveFrameBuffer = getActiveFrameBuffer( pPpuState );
     uint8_t* pFrameBufferPixelData = pActiveFrameBuffer + ( gbFrameBufferScanlineSizeInBytes * scanlineYCoordinate );
     for( uint8_t scanlineByteIndex = scanlinePixelDataIndex; scanlineByteIndex < gbFrameBufferScanlineSizeInBytes; ++scanlineByteIndex )
     {
@@ -2524,11 +4446,11 @@ void pushWindowPixelsToScanline( GBPpuState* pPpuState, const uint8_t* pTileData
 }
 
 template<typename IndexType>
-void pushBackgroundPixelsToScanline( GBPpuState* pPpuState, const uint8_t* pTileData, uint8_t scanlineYCoordinate )
+void pushBackgroundPixelsToScanline( GBPpuState* pPpuState, GBMemoryMapper* pMemoryMapper, uint8_t* pActiveFrameBuffer, const uint8_t* pTileData, uint8_t scanlineYCoordinate )
 {
-    const IndexType* pBackgroundTileIds  = (IndexType*)pPpuState->pBackgroundOrWindowTileIds[ pPpuState->pLcdControl->bgTileMapArea ];
-    const uint8_t sx = *pPpuState->lcdRegisters.pScx;
-    const uint8_t sy = *pPpuState->lcdRegisters.pScy;
+    const IndexType* pBackgroundTileIds  = (const IndexType*)getTileMap( pMemoryMapper, getLcdControl( pMemoryMapper )->bgTileMapArea );
+    const uint8_t sx = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SCX );
+    const uint8_t sy = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SCY );
 
     //FK: Calculate the tile row that intersects with the current scanline
     const uint8_t y = sy + scanlineYCoordinate;
@@ -2594,7 +4516,6 @@ void pushBackgroundPixelsToScanline( GBPpuState* pPpuState, const uint8_t* pTile
     uint8_t scanlinePixelDataShift = 6 - (sx%4) * 2;
     uint8_t scanlinePixelDataIndex = sx/4;
 
-    uint8_t* pActiveFrameBuffer = getActiveFrameBuffer( pPpuState );
     uint8_t* pFrameBufferPixelData = pActiveFrameBuffer + ( gbFrameBufferScanlineSizeInBytes * scanlineYCoordinate );
     for( uint8_t scanlineByteIndex = 0; scanlineByteIndex < gbFrameBufferScanlineSizeInBytes; ++scanlineByteIndex )
     {
@@ -2625,14 +4546,16 @@ void clearGBFrameBufferScanline( uint8_t* pGBFrameBuffer, uint8_t scanlineYCoord
     memset( pGBFrameBuffer + scanlineYCoordinate * gbFrameBufferScanlineSizeInBytes, 0, gbFrameBufferScanlineSizeInBytes );
 }
 
-void collectScanlineSprites( GBPpuState* pPpuState, uint8_t scanlineYCoordinate )
+void collectScanlineSprites( GBPpuState* pPpuState, GBMemoryMapper* pMemoryMapper, uint8_t scanlineYCoordinate )
 {
-    const uint8_t objHeight = pPpuState->pLcdControl->objSize == 0 ? 8 : 16;
+    const uint8_t objHeight = getLcdControl( pMemoryMapper )->objSize == 0 ? 8 : 16;
+
+    const GBObjectAttributes* pObjectAttributes = getObjectAttributes( pMemoryMapper );
 
     uint8_t spriteCounter = 0;
     for( size_t spriteIndex = 0u; spriteIndex < gbObjectAttributeCapacity; ++spriteIndex )
     {
-        const GBObjectAttributes* pSprite = pPpuState->pOAM + spriteIndex;
+        const GBObjectAttributes* pSprite = pObjectAttributes + spriteIndex;
         if( pSprite->x == 0 || pSprite->y < gbSpriteHeight || pSprite->y > gbVerticalResolutionInPixels + gbSpriteHeight )
         {
             //FK: Sprite is invisible
@@ -2659,72 +4582,72 @@ void collectScanlineSprites( GBPpuState* pPpuState, uint8_t scanlineYCoordinate
 #endif
 }
 
-void drawScanline( GBPpuState* pPpuState, uint8_t scanlineYCoordinate )
+void drawScanline( GBPpuState* pPpuState, GBMemoryMapper* pMemoryMapper, uint8_t* pActiveFrameBuffer, uint8_t scanlineYCoordinate )
 {
-    uint8_t* pActiveFrameBuffer = getActiveFrameBuffer( pPpuState );
     clearGBFrameBufferScanline( pActiveFrameBuffer, scanlineYCoordinate );
 
-    if( pPpuState->pLcdControl->bgEnable )
+    const GBLcdControl* pLcdControl = getLcdControl( pMemoryMapper );
+    if( pLcdControl->bgEnable )
     {
         //FK: Determine tile addressing mode
-        if( !pPpuState->pLcdControl->bgAndWindowTileDataArea )
+        const uint8_t* pTileData = getTileData( pMemoryMapper, pLcdControl->bgAndWindowTileDataArea );
+        if( !pLcdControl->bgAndWindowTileDataArea )
         {
-            const uint8_t* pTileData = pPpuState->pTileBlocks[2];
-            pushBackgroundPixelsToScanline< int8_t >( pPpuState, pTileData, scanlineYCoordinate );
+            pushBackgroundPixelsToScanline< int8_t >( pPpuState, pMemoryMapper, pActiveFrameBuffer, pTileData, scanlineYCoordinate );
         }
         else
         {
-            const uint8_t* pTileData = pPpuState->pTileBlocks[0];
-            pushBackgroundPixelsToScanline< uint8_t >( pPpuState, pTileData, scanlineYCoordinate );
+            pushBackgroundPixelsToScanline< uint8_t >( pPpuState, pMemoryMapper, pActiveFrameBuffer, pTileData, scanlineYCoordinate );
         }
     }
 
-    if( pPpuState->pLcdControl->windowEnable )
+    if( pLcdControl->windowEnable )
     {
-        const uint8_t wy = *pPpuState->lcdRegisters.pWy;
-        const uint8_t wx = *pPpuState->lcdRegisters.pWx;
+        const uint8_t wy = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WY );
+        const uint8_t wx = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WX );
 
         if( wx <= 166 && wy <= 143 && scanlineYCoordinate >= wy )
         {
             //FK: Determine tile addressing mode
-            if( !pPpuState->pLcdControl->bgAndWindowTileDataArea )
+            const uint8_t* pTileData = getTileData( pMemoryMapper, pLcdControl->bgAndWindowTileDataArea );
+            if( !pLcdControl->bgAndWindowTileDataArea )
             {
-                const uint8_t* pTileData = pPpuState->pTileBlocks[2];
-                pushWindowPixelsToScanline< int8_t >( pPpuState, pTileData, scanlineYCoordinate, wx, wy );
+                pushWindowPixelsToScanline< int8_t >( pPpuState, pMemoryMapper, pActiveFrameBuffer, pTileData, scanlineYCoordinate, wx, wy );
             }
             else
             {
-                const uint8_t* pTileData = pPpuState->pTileBlocks[0];
-                pushWindowPixelsToScanline< uint8_t >( pPpuState, pTileData, scanlineYCoordinate, wx, wy );
+                pushWindowPixelsToScanline< uint8_t >( pPpuState, pMemoryMapper, pActiveFrameBuffer, pTileData, scanlineYCoordinate, wx, wy );
             }
         }
     }
 
-    if( pPpuState->pLcdControl->objEnable )
+    if( pLcdControl->objEnable )
     {
-        pushSpritePixelsToScanline( pPpuState, scanlineYCoordinate );
+        pushSpritePixelsToScanline( pPpuState, pMemoryMapper, pActiveFrameBuffer, scanlineYCoordinate );
     }
 }
 
-void triggerInterrupt( GBCpuState* pCpuState, GBCpuInterrupt interruptFlag )
+void triggerInterrupt( GBMemoryMapper* pMemoryMapper, GBCpuInterrupt interruptFlag )
 {
-    *pCpuState->pIF |= (uint8_t)interruptFlag;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IF ) |= (uint8_t)interruptFlag;
 }
 
-void updatePPULcdControl( GBPpuState* pPpuState, GBLcdControl lcdControlValue )
+void updatePPULcdControl( GBEmulatorInstance* pEmulatorInstance, GBLcdControl lcdControlValue )
 {
-    if( lcdControlValue.enable != pPpuState->pLcdControl->enable )
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBLcdControl* pLcdControl       = getLcdControl( pMemoryMapper );
+    if( lcdControlValue.enable != pLcdControl->enable )
     {
         if( !lcdControlValue.enable )
         {
-            clearGBFrameBuffer( pPpuState->pGBFrameBuffers[ pPpuState->activeFrameBufferIndex ] );
-            *pPpuState->lcdRegisters.pLy = 0;
-            pPpuState->lcdRegisters.pStatus->mode = 0;
-            pPpuState->dotCounter = 0;
+            clearGBFrameBuffer( getActiveFrameBuffer( pEmulatorInstance ) );
+            *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY ) = 0;
+            getLcdStatus( pMemoryMapper )->mode = 0;
+            pEmulatorInstance->ppuState.dotCounter = 0;
         }
     }
 
-    *pPpuState->pLcdControl = lcdControlValue;
+    *pLcdControl = lcdControlValue;
 }
 
 uint8_t convertTimerControlFrequencyBit( const uint8_t timerControlValue )
@@ -2746,7 +4669,7 @@ uint8_t convertTimerControlFrequencyBit( const uint8_t timerControlValue )
     return 0;
 }
 
-void tickSerial( GBCpuState* pCpuState, GBSerialState* pSerial, const uint8_t cycleCount )
+void tickSerial( GBSerialState* pSerial, GBMemoryMapper* pMemoryMapper, const uint8_t cycleCount )
 {
     if( !pSerial->initiateTransfer )
     {
@@ -2758,31 +4681,52 @@ void tickSerial( GBCpuState* pCpuState, GBSerialState* pSerial, const uint8_t cy
         return;
     }
 
+    if( pSerial->linkConnected )
+    {
+        //FK: The link cable exchanges SB of both instances once all 8 bits would have been shifted (see runGBLinkCableForCycles())
+        if( pSerial->linkTransferDue )
+        {
+            return;
+        }
+
+        pSerial->cycleCounter += cycleCount;
+        if( pSerial->cycleCounter >= gbSerialClockCyclesPerByteTransfer )
+        {
+            pSerial->cycleCounter -= gbSerialClockCyclesPerByteTransfer;
+            pSerial->linkTransferDue = 1u;
+        }
+
+        return;
+    }
+
     pSerial->cycleCounter += cycleCount;
+
     while( pSerial->cycleCounter >= gbSerialClockCyclesPerBitTransfer )
     {
-        const uint8_t transferData = *pSerial->pSerialTransferData;
+        const uint8_t transferData = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB );
         pSerial->cycleCounter -= gbSerialClockCyclesPerBitTransfer;
 
         const uint8_t outBits = ( transferData << 1 );
         const uint8_t inBits  = pSerial->inByte >> ( 7 - pSerial->shiftIndex );
-        *pSerial->pSerialTransferData = outBits | inBits;
+        *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB ) = outBits | inBits;
 
         ++pSerial->shiftIndex;
         if( pSerial->shiftIndex == 8 )
         {
-            *pSerial->pSerialTransferControl &= ~0x80;
+            *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_SC ) &= ~0x80;
             pSerial->initiateTransfer = 0;
             pSerial->shiftIndex = 0u;
-            triggerInterrupt( pCpuState, SerialInterrupt );
+            ++pSerial->transferredByteCount;
+            triggerInterrupt( pMemoryMapper, SerialInterrupt );
         }
     }
 }
 
-void incrementTimerCounter( GBTimerState* pTimer )
+void incrementTimerCounter( GBTimerState* pTimer, GBMemoryMapper* pMemoryMapper )
 {
-    *pTimer->pCounter += 1;
-    if( *pTimer->pCounter == 0 )
+    uint8_t* pCounter = getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TIMA );
+    *pCounter += 1;
+    if( *pCounter == 0 )
     {
         //FK: Delay interrupt triggering due to obscure timer behavior
         //    https://gbdev.gg8.se/wiki/articles/Timer_Obscure_Behaviour
@@ -2790,12 +4734,12 @@ void incrementTimerCounter( GBTimerState* pTimer )
     }
 }
 
-void updateTimerInternalDivCounterValue( GBTimerState* pTimer, const uint16_t internalDivCounter )
+void updateTimerInternalDivCounterValue( GBTimerState* pTimer, GBMemoryMapper* pMemoryMapper, const uint16_t internalDivCounter )
 {
     const uint16_t newInternalDivCounter = internalDivCounter;
     const uint16_t oldInternalDivCounter = pTimer->internalDivCounter;
     pTimer->internalDivCounter = newInternalDivCounter;
-    *pTimer->pDivider = pTimer->internalDivCounter >> 8;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_DIV ) = pTimer->internalDivCounter >> 8;
 
     if( !pTimer->enableCounter )
     {
@@ -2808,16 +4752,16 @@ void updateTimerInternalDivCounterValue( GBTimerState* pTimer, const uint16_t in
 
     if( fallingEdge )
     {
-        incrementTimerCounter( pTimer );
+        incrementTimerCounter( pTimer, pMemoryMapper );
     }
 }
 
-void tickTimerInternalDivCounterForCycles( GBTimerState* pTimerState, uint8_t cycleCount )
+void tickTimerInternalDivCounterForCycles( GBTimerState* pTimerState, GBMemoryMapper* pMemoryMapper, uint8_t cycleCount )
 {
     const uint16_t oldInternalDivCounter = pTimerState->internalDivCounter;
     const uint16_t newInternalDivCounter = oldInternalDivCounter + cycleCount;
     pTimerState->internalDivCounter = newInternalDivCounter;
-    *pTimerState->pDivider = newInternalDivCounter >> 8;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_DIV ) = newInternalDivCounter >> 8;
 
     if( !pTimerState->enableCounter )
     {
@@ -2838,22 +4782,22 @@ void tickTimerInternalDivCounterForCycles( GBTimerState* pTimerState, uint8_t cy
 
         if( fallingEdge )
         {
-            incrementTimerCounter( pTimerState );
+            incrementTimerCounter( pTimerState, pMemoryMapper );
         }
 
         --cycleCount;
     }
 }
 
-void tickTimer( GBCpuState* pCpuState, GBTimerState* pTimer, const uint8_t cycleCount )
+void tickTimer( GBCpuState* pCpuState, GBTimerState* pTimer, GBMemoryMapper* pMemoryMapper, const uint8_t cycleCount )
 {
     pTimer->timerLoading = 0;
     if( pTimer->timerOverflow )
     {
-        triggerInterrupt( pCpuState, TimerInterrupt );
+        triggerInterrupt( pMemoryMapper, TimerInterrupt );
         pTimer->timerOverflow = 0;
 
-        *pTimer->pCounter = *pTimer->pModulo;
+        *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TIMA ) = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TMA );
         pTimer->timerLoading = 1;
     }
 
@@ -2862,30 +4806,49 @@ void tickTimer( GBCpuState* pCpuState, GBTimerState* pTimer, const uint8_t cycle
         return;
     }
 
-    tickTimerInternalDivCounterForCycles( pTimer, cycleCount );
+    tickTimerInternalDivCounterForCycles( pTimer, pMemoryMapper, cycleCount );
 }
 
-void incrementLy( GBLcdRegisters* pLcdRegisters, uint8_t* pLy )
+void incrementLy( GBMemoryMapper* pMemoryMapper, uint8_t* pLy )
 {
-    GBLcdStatus* pLcdStatus = pLcdRegisters->pStatus;
-    const uint8_t lyc       = *pLcdRegisters->pLyc;
+    GBLcdStatus* pLcdStatus = getLcdStatus( pMemoryMapper );
+    const uint8_t lyc       = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LYC );
 
     *pLy = *pLy + 1;
     pLcdStatus->LycEqLyFlag = ( *pLy == lyc );
 }
 
-void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleCount )
+void finishInputPollFrame( GBEmulatorInstance* pEmulatorInstance )
+{
+    const GBMemoryMapper* pMemoryMapper = &pEmulatorInstance->memoryMapper;
+    GBInputPollState* pInputPollState   = &pEmulatorInstance->inputPollState;
+
+    pInputPollState->lastFrameJoypadReadCount   = pMemoryMapper->joypadReadCount - pInputPollState->frameStartJoypadReadCount;
+    pInputPollState->lastFrameJoypadWriteCount  = pMemoryMapper->joypadWriteCount - pInputPollState->frameStartJoypadWriteCount;
+    pInputPollState->frameStartJoypadReadCount  = pMemoryMapper->joypadReadCount;
+    pInputPollState->frameStartJoypadWriteCount = pMemoryMapper->joypadWriteCount;
+
+    const bool8_t lagFrame = pInputPollState->lastFrameJoypadReadCount == 0u && pInputPollState->lastFrameJoypadWriteCount == 0u;
+    pInputPollState->lagFrameCount += lagFrame;
+    ++pInputPollState->frameCount;
+
+    pEmulatorInstance->flags.lagFrame |= lagFrame;
+}
+
+void tickPPU( GBEmulatorInstance* pEmulatorInstance, const uint8_t cycleCount )
 {
-    if( !pPpuState->pLcdControl->enable )
+    GBPpuState* pPpuState           = &pEmulatorInstance->ppuState;
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    if( !getLcdControl( pMemoryMapper )->enable )
     {
         return;
     }
 
-    GBLcdStatus* pLcdStatus = pPpuState->lcdRegisters.pStatus;
+    GBLcdStatus* pLcdStatus = getLcdStatus( pMemoryMapper );
     pPpuState->cycleCounter += cycleCount;
 
-    uint8_t lcdMode         = pPpuState->lcdRegisters.pStatus->mode;
-    uint8_t* pLy            = pPpuState->lcdRegisters.pLy;
+    uint8_t lcdMode         = pLcdStatus->mode;
+    uint8_t* pLy            = getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY );
     uint16_t lcdDotCounter  = pPpuState->dotCounter;
 
     uint8_t triggerLCDStatInterrupt = 0;
@@ -2893,14 +4856,17 @@ void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleC
 
     if( lcdMode == 2 && lcdDotCounter >= 80 )
     {
-        collectScanlineSprites( pPpuState, *pLy );
+        collectScanlineSprites( pPpuState, pMemoryMapper, *pLy );
         
         lcdDotCounter -= 80;
         lcdMode = 3;
     }
     else if( lcdMode == 3 && lcdDotCounter >= 172 )
     {
-        drawScanline( pPpuState, *pLy );
+        if( !pEmulatorInstance->skipRendering )
+        {
+            drawScanline( pPpuState, pMemoryMapper, getActiveFrameBuffer( pEmulatorInstance ), *pLy );
+        }
 
         lcdDotCounter -= 172;
         lcdMode = 0;
@@ -2908,7 +4874,7 @@ void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleC
     }
     else if( lcdMode == 0 && lcdDotCounter >= 204 )
     {
-        incrementLy( &pPpuState->lcdRegisters, pLy );
+        incrementLy( pMemoryMapper, pLy );
 		if( pLcdStatus->enableLycEqLyInterrupt == 1 && pLcdStatus->LycEqLyFlag )
 		{
 			triggerLCDStatInterrupt = 1;
@@ -2920,10 +4886,11 @@ void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleC
         {
             lcdMode = 1;
             triggerLCDStatInterrupt = pLcdStatus->enableMode1VBlankInterrupt;
-            triggerInterrupt( pCpuState, VBlankInterrupt );
+            triggerInterrupt( pMemoryMapper, VBlankInterrupt );
 
-            //FK: change between index 0 and 1
-            pPpuState->activeFrameBufferIndex = !pPpuState->activeFrameBufferIndex;
+            //FK: change between index 0 and 1 (stays 0 with a single frame buffer)
+            pPpuState->activeFrameBufferIndex = ( pPpuState->activeFrameBufferIndex + 1u ) % gbFrameBufferCount;
+            finishInputPollFrame( pEmulatorInstance );
         }
         else
         {
@@ -2935,7 +4902,7 @@ void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleC
         if( lcdDotCounter >= 456 )
         {
             lcdDotCounter -= 456;
-            incrementLy( &pPpuState->lcdRegisters, pLy );
+            incrementLy( pMemoryMapper, pLy );
             if( *pLy == 154 )
             {
                 *pLy = 0;
@@ -2947,7 +4914,7 @@ void tickPPU( GBCpuState* pCpuState, GBPpuState* pPpuState, const uint8_t cycleC
 
     if( triggerLCDStatInterrupt )
     {
-        triggerInterrupt( pCpuState, LCDStatInterrupt );
+        triggerInterrupt( pMemoryMapper, LCDStatInterrupt );
     }
 
     //FK: update ppu state
@@ -2964,8 +4931,12 @@ void tickDmaState( GBCpuState* pCpuState, GBMemoryMapper* pMemoryMapper, uint8_t
         {
             pCpuState->flags.dma = 0;
 
-            //FK: Copy sprite attributes from dma address to OAM h
-            memcpy( pMemoryMapper->pSpriteAttributes, pMemoryMapper->pBaseAddress + pCpuState->dmaAddress, gbOAMSizeInBytes );
+            //FK: Copy sprite attributes from dma address to OAM (source can be rom, cartridge ram or mapped memory)
+            uint8_t* pObjectAttributeMemory = getMappedMemoryAddress( pMemoryMapper, 0xFE00 );
+            for( uint16_t byteIndex = 0u; byteIndex < gbOAMSizeInBytes; ++byteIndex )
+            {
+                pObjectAttributeMemory[ byteIndex ] = getMappedMemoryValue( pMemoryMapper, pCpuState->dmaAddress + byteIndex );
+            }
         }
     }
 }
@@ -2988,7 +4959,7 @@ uint8_t convertOutputLevelToVolumeShift( const uint8_t outputLevel )
     return 0;
 }
 
-void tickAPU( GBApuState* pApuState, const uint8_t cycleCost )
+void tickAPU( GBApuState* pApuState, const GBMemoryMapper* pMemoryMapper, const uint8_t cycleCost )
 {
     pApuState->frameSequencer.cycleCounter += cycleCost;
     if( pApuState->frameSequencer.cycleCounter >= 512 )
@@ -3040,7 +5011,7 @@ void tickAPU( GBApuState* pApuState, const uint8_t cycleCost )
             cycleCount -= cycleCountTarget;
             ++samplePosition %= 64u;
 
-            const uint8_t* pWaveSample = pApuState->waveChannel.pWavePattern + ( samplePosition << 2 );
+            const uint8_t* pWaveSample = pMemoryMapper->memory + getMappedMemoryOffset( K15_GB_MAPPED_IO_ADDRESS_WAVE ) + ( samplePosition << 2 );
             uint8_t nextWaveSample = *pWaveSample;
             nextWaveSample >>= ( samplePosition % 2 ) * 4 + waveSampleVolumeShift;
             nextWaveSample &= 0xF;
@@ -3055,37 +5026,64 @@ void push16BitValueToStack( GBCpuState* pCpuState, GBMemoryMapper* pMemoryMapper
 {
     pCpuState->registers.SP -= 2;
     
-    uint8_t* pStack = pMemoryMapper->pBaseAddress + pCpuState->registers.SP;
-    pStack[0] = (uint8_t)( value >> 0 );
-    pStack[1] = (uint8_t)( value >> 8 );
+    setMappedMemoryValue( pMemoryMapper, pCpuState->registers.SP + 0, (uint8_t)( value >> 0 ) );
+    setMappedMemoryValue( pMemoryMapper, pCpuState->registers.SP + 1, (uint8_t)( value >> 8 ) );
 }
 
 uint16_t pop16BitValueFromStack( GBCpuState* pCpuState, GBMemoryMapper* pMemoryMapper )
 {
-    uint8_t* pStack = pMemoryMapper->pBaseAddress + pCpuState->registers.SP;
+    const uint16_t value = (uint16_t)getMappedMemoryValue( pMemoryMapper, pCpuState->registers.SP + 0 ) << 0 | 
+                           (uint16_t)getMappedMemoryValue( pMemoryMapper, pCpuState->registers.SP + 1 ) << 8;
     pCpuState->registers.SP += 2;
-
-    const uint16_t value = (uint16_t)pStack[0] << 0 | 
-                           (uint16_t)pStack[1] << 8;
     return value;
 }
 
 void tickSystem( GBEmulatorInstance* pEmulatorInstance, const uint8_t cyclesCount )
 {
-    GBCpuState* pCpuState           = pEmulatorInstance->pCpuState;
-    GBMemoryMapper* pMemoryMapper   = pEmulatorInstance->pMemoryMapper;
-    GBApuState* pApuState           = pEmulatorInstance->pApuState;
-    GBPpuState* pPpuState           = pEmulatorInstance->pPpuState;
-    GBTimerState* pTimerState       = pEmulatorInstance->pTimerState;
-    GBSerialState* pSerialState     = pEmulatorInstance->pSerialState;
+    GBCpuState* pCpuState           = &pEmulatorInstance->cpuState;
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBApuState* pApuState           = &pEmulatorInstance->apuState;
+    GBPpuState* pPpuState           = &pEmulatorInstance->ppuState;
+    GBTimerState* pTimerState       = &pEmulatorInstance->timerState;
+    GBSerialState* pSerialState     = &pEmulatorInstance->serialState;
   
-    tickDmaState( pCpuState, pMemoryMapper, cyclesCount ); 
-    tickPPU( pCpuState, pPpuState, cyclesCount );
-    tickAPU( pApuState, cyclesCount );
-    tickTimer( pCpuState, pTimerState, cyclesCount );
-    tickSerial( pCpuState, pSerialState, cyclesCount );
+    GBSubsystemProfile* pProfile = pEmulatorInstance->pSubsystemProfile;
+    if( pProfile == nullptr )
+    {
+        tickDmaState( pCpuState, pMemoryMapper, cyclesCount ); 
+        tickPPU( pEmulatorInstance, cyclesCount );
+        tickAPU( pApuState, pMemoryMapper, cyclesCount );
+        tickTimer( pCpuState, pTimerState, pMemoryMapper, cyclesCount );
+        tickSerial( pSerialState, pMemoryMapper, cyclesCount );
+    }
+    else
+    {
+        uint64_t* pSubsystemTimestamps = pProfile->subsystemTimestamps;
+        const uint64_t startTimestamp = pProfile->pGetTimestamp();
+        tickDmaState( pCpuState, pMemoryMapper, cyclesCount ); 
+        const uint64_t dmaTimestamp = pProfile->pGetTimestamp();
+        tickPPU( pEmulatorInstance, cyclesCount );
+        const uint64_t ppuTimestamp = pProfile->pGetTimestamp();
+        tickAPU( pApuState, pMemoryMapper, cyclesCount );
+        const uint64_t apuTimestamp = pProfile->pGetTimestamp();
+        tickTimer( pCpuState, pTimerState, pMemoryMapper, cyclesCount );
+        const uint64_t timerTimestamp = pProfile->pGetTimestamp();
+        tickSerial( pSerialState, pMemoryMapper, cyclesCount );
+        const uint64_t serialTimestamp = pProfile->pGetTimestamp();
+
+        ++pProfile->tickCount;
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_DMA ]    += dmaTimestamp - startTimestamp;
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_PPU ]    += ppuTimestamp - dmaTimestamp;
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_APU ]    += apuTimestamp - ppuTimestamp;
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_TIMER ]  += timerTimestamp - apuTimestamp;
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_SERIAL ] += serialTimestamp - timerTimestamp;
+
+        //FK: The instruction time gets added to the cpu in finishSingleInstruction(), so the cpu ends up with everything the subsystems didn't use
+        pSubsystemTimestamps[ K15_GB_SUBSYSTEM_CPU ]    -= serialTimestamp - startTimestamp;
+    }
 
     pCpuState->cycleCounter += cyclesCount;
+    pCpuState->totalCycleCounter += cyclesCount;
     if( pPpuState->cycleCounter >= gbCyclesPerFrame )
     {
         pEmulatorInstance->flags.vblank = 1;
@@ -3096,11 +5094,11 @@ void tickSystem( GBEmulatorInstance* pEmulatorInstance, const uint8_t cyclesCoun
 
 void executePendingInterrupts( GBEmulatorInstance* pEmulatorInstance )
 {
-    GBCpuState* pCpuState           = pEmulatorInstance->pCpuState;
-    GBMemoryMapper* pMemoryMapper   = pEmulatorInstance->pMemoryMapper;
+    GBCpuState* pCpuState           = &pEmulatorInstance->cpuState;
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
 
-    const bool8_t interruptEnable       = *pCpuState->pIE;
-    const uint8_t interruptFlags        = *pCpuState->pIF;
+    const bool8_t interruptEnable       = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IE );
+    const uint8_t interruptFlags        = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IF );
     const uint8_t interruptHandleMask   = ( interruptEnable & interruptFlags );
     if( interruptHandleMask > 0u )
     {
@@ -3114,7 +5112,7 @@ void executePendingInterrupts( GBEmulatorInstance* pEmulatorInstance )
                     push16BitValueToStack(pCpuState, pMemoryMapper, pCpuState->registers.PC);
                     pCpuState->registers.PC = 0x40 + 0x08 * interruptIndex;
 
-                    *pCpuState->pIF &= ~interruptFlag;
+                    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IF ) &= ~interruptFlag;
 
                     pCpuState->flags.IME = 0;
 
@@ -3833,8 +5831,8 @@ uint8_t executeInstruction( GBCpuState* pCpuState, GBMemoryMapper* pMemoryMapper
                 //FK: If interrupts are disabled, halt doesn't suspend operation but it does
                 //    cause the program counter to stop counting for one instruction and thus
                 //    execute the next instruction twice
-                const uint8_t interruptEnable = *pCpuState->pIE;
-                const uint8_t interruptFlags  = *pCpuState->pIF;
+                const uint8_t interruptEnable = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IE );
+                const uint8_t interruptFlags  = *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_IF );
                 if( interruptEnable & interruptFlags & 0x1F )
                 {
                     pCpuState->flags.haltBug = 1;
@@ -4165,6 +6163,7 @@ uint8_t executeInstruction( GBCpuState* pCpuState, GBMemoryMapper* pMemoryMapper
 #if K15_BREAK_ON_UNKNOWN_INSTRUCTION == 1
             DebugBreak();
 #endif
+            break;
     }
 
     return pOpcode->cycleCosts[ opcodeCondition ];
@@ -4436,11 +6435,197 @@ void handleCartridgeRomWrite( GBCartridge* pCartridge, GBMemoryMapper* pMemoryMa
     return;
 }
 
+//FK: The new state is only visible to the game once it writes to JOYP. Use an input queue (see setGBEmulatorInputQueue())
+//    to apply input changes at the cycle they happened.
 void setGBEmulatorJoypadState( GBEmulatorInstance* pEmulatorInstance, GBEmulatorJoypadState joypadState )
 {
     pEmulatorInstance->joypadState.value = joypadState.value;
 }
 
+uint64_t getGBEmulatorCycleCount( const GBEmulatorInstance* pEmulatorInstance )
+{
+    return pEmulatorInstance->cpuState.totalCycleCounter;
+}
+
+size_t calculateGBInputQueueMemoryRequirementsInBytes()
+{
+    return sizeof( GBInputQueue ) + 64u;
+}
+
+//FK: bufferCycleCount is added to events that are pushed using a host timestamp (see pushGBInputEventAtHostTime()). It should be the number
+//    of cycles the host runs in one go (eg: gbCyclesPerFrame if the emulator runs a whole frame per host frame), so that the events
+//    of a slice of host time get applied at the same relative cycles while the emulator runs the next slice.
+GBInputQueue* createGBInputQueue( uint8_t* pInputQueueMemory, const uint64_t bufferCycleCount )
+{
+    GBInputQueue* pInputQueue = ( GBInputQueue* )( ( ( size_t )pInputQueueMemory + 63u ) & ~( size_t )63u );
+    memset( ( void* )pInputQueue, 0, sizeof( GBInputQueue ) );
+
+    pInputQueue->bufferCycleCount = bufferCycleCount;
+    pInputQueue->writeIndex.store( 0u, std::memory_order_relaxed );
+    pInputQueue->readIndex.store( 0u, std::memory_order_relaxed );
+    pInputQueue->hostTimeAtCycleZeroInNanoseconds.store( 0, std::memory_order_relaxed );
+    return pInputQueue;
+}
+
+//FK: Producer only. The cycles of consecutive events can't go backwards, an event with an older cycle gets applied at the cycle of the event before.
+//    Events with cycles the emulator already passed get applied before the next instruction. Returns 0 if the queue is full.
+bool8_t pushGBInputEvent( GBInputQueue* pInputQueue, const uint64_t cycle, const GBEmulatorJoypadState joypadState )
+{
+    const uint32_t writeIndex = pInputQueue->writeIndex.load( std::memory_order_relaxed );
+    if( writeIndex - pInputQueue->readIndex.load( std::memory_order_acquire ) == gbInputQueueCapacity )
+    {
+        return 0u;
+    }
+
+    pInputQueue->lastEventCycle = GetMax( pInputQueue->lastEventCycle, cycle );
+
+    GBInputEvent* pEvent    = pInputQueue->events + ( writeIndex & ( gbInputQueueCapacity - 1u ) );
+    pEvent->cycle           = pInputQueue->lastEventCycle;
+    pEvent->joypadState     = joypadState;
+
+    pInputQueue->writeIndex.store( writeIndex + 1u, std::memory_order_release );
+    return 1u;
+}
+
+//FK: Emulator thread - call before running the next slice of cycles, using the same clock as the producer (in nanoseconds)
+void publishGBInputQueueClock( GBInputQueue* pInputQueue, const uint64_t cycleCount, const int64_t hostTimeInNanoseconds )
+{
+    const int64_t elapsedNanoseconds = ( int64_t )( ( cycleCount / gbCyclesPerSecond ) * 1000000000ull + ( cycleCount % gbCyclesPerSecond ) * 1000000000ull / gbCyclesPerSecond );
+    pInputQueue->hostTimeAtCycleZeroInNanoseconds.store( hostTimeInNanoseconds - elapsedNanoseconds, std::memory_order_release );
+}
+
+uint64_t convertGBInputQueueHostTimeToCycle( const GBInputQueue* pInputQueue, const int64_t hostTimeInNanoseconds )
+{
+    const int64_t elapsedNanoseconds = hostTimeInNanoseconds - pInputQueue->hostTimeAtCycleZeroInNanoseconds.load( std::memory_order_acquire );
+    if( elapsedNanoseconds <= 0 )
+    {
+        return pInputQueue->bufferCycleCount;
+    }
+
+    const uint64_t elapsedCycleCount = ( ( uint64_t )elapsedNanoseconds / 1000000000ull ) * gbCyclesPerSecond + ( ( uint64_t )elapsedNanoseconds % 1000000000ull ) * gbCyclesPerSecond / 1000000000ull;
+    return elapsedCycleCount + pInputQueue->bufferCycleCount;
+}
+
+//FK: Producer only, hostTimeInNanoseconds is the time the input changed (using the clock of publishGBInputQueueClock())
+bool8_t pushGBInputEventAtHostTime( GBInputQueue* pInputQueue, const int64_t hostTimeInNanoseconds, const GBEmulatorJoypadState joypadState )
+{
+    return pushGBInputEvent( pInputQueue, convertGBInputQueueHostTimeToCycle( pInputQueue, hostTimeInNanoseconds ), joypadState );
+}
+
+//FK: The instance consumes the events of the queue at their cycle (nullptr detaches the queue). Only one instance can be attached to a queue.
+void setGBEmulatorInputQueue( GBEmulatorInstance* pEmulatorInstance, GBInputQueue* pInputQueue )
+{
+    pEmulatorInstance->pInputQueue = pInputQueue;
+}
+
+//FK: Measures the cost of a timestamp as the lowest average of a few batches of back to back calls, so that an interrupted batch doesn't count
+uint64_t calibrateGBSubsystemTimestampOverhead( const GBSubsystemTimestampFunction pGetTimestamp )
+{
+    uint64_t timestampOverhead = ~0ull;
+    for( uint32_t batchIndex = 0u; batchIndex < gbSubsystemProfileCalibrationBatchCount; ++batchIndex )
+    {
+        const uint64_t startTimestamp = pGetTimestamp();
+        for( uint32_t timestampIndex = 1u; timestampIndex < gbSubsystemProfileCalibrationBatchSize; ++timestampIndex )
+        {
+            pGetTimestamp();
+        }
+
+        const uint64_t batchOverhead = ( pGetTimestamp() - startTimestamp ) / gbSubsystemProfileCalibrationBatchSize;
+        timestampOverhead = GetMin( timestampOverhead, batchOverhead );
+    }
+
+    return timestampOverhead;
+}
+
+//FK: Times every subsystem with the timestamp function of the profile while attached (nullptr detaches the profile).
+//    pGetTimestamp has to be set, the cost of a timestamp gets measured here (see getGBSubsystemProfileTime()).
+void setGBEmulatorSubsystemProfile( GBEmulatorInstance* pEmulatorInstance, GBSubsystemProfile* pProfile )
+{
+    if( pProfile != nullptr )
+    {
+        pProfile->timestampOverhead = calibrateGBSubsystemTimestampOverhead( pProfile->pGetTimestamp );
+    }
+
+    pEmulatorInstance->pSubsystemProfile = pProfile;
+}
+
+//FK: Time spent in a subsystem without the cost of the timestamps. Every timed interval contains the cost of one timestamp: each tickSystem()
+//    call is one interval per subsystem, the cpu gets one interval per instruction plus the timestamp after the subsystems of each tickSystem() call.
+uint64_t getGBSubsystemProfileTime( const GBSubsystemProfile* pProfile, const GBSubsystem subsystem )
+{
+    const uint64_t intervalCount = subsystem == K15_GB_SUBSYSTEM_CPU ? pProfile->instructionCount + pProfile->tickCount : pProfile->tickCount;
+    const uint64_t timestampOverhead = intervalCount * pProfile->timestampOverhead;
+    const uint64_t subsystemTime = pProfile->subsystemTimestamps[ subsystem ];
+    return subsystemTime > timestampOverhead ? subsystemTime - timestampOverhead : 0u;
+}
+
+const char* getGBSubsystemName( const GBSubsystem subsystem )
+{
+    switch( subsystem )
+    {
+        case K15_GB_SUBSYSTEM_CPU:      return "cpu";
+        case K15_GB_SUBSYSTEM_DMA:      return "dma";
+        case K15_GB_SUBSYSTEM_PPU:      return "ppu";
+        case K15_GB_SUBSYSTEM_APU:      return "apu";
+        case K15_GB_SUBSYSTEM_TIMER:    return "timer";
+        case K15_GB_SUBSYSTEM_SERIAL:   return "serial";
+        default:                        return "unknown";
+    }
+}
+
+//FK: Unlike setGBEmulatorJoypadState() the new state is visible in JOYP right away and pressing a button
+//    of a selected button group raises the joypad interrupt (same as the high to low transition of P10-P13 on hardware)
+void applyGBEmulatorJoypadState( GBEmulatorInstance* pEmulatorInstance, const GBEmulatorJoypadState joypadState )
+{
+    GBMemoryMapper* pMemoryMapper = &pEmulatorInstance->memoryMapper;
+    uint8_t* pJoypadRegister = getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_JOYP );
+
+    const GBEmulatorJoypadState previousJoypadState = fixJoypadState( pEmulatorInstance->joypadState );
+    const GBEmulatorJoypadState newJoypadState      = fixJoypadState( joypadState );
+    const uint8_t pressedActionButtonMask           = newJoypadState.actionButtonMask & ~previousJoypadState.actionButtonMask & 0x0F;
+    const uint8_t pressedDpadButtonMask             = newJoypadState.dpadButtonMask & ~previousJoypadState.dpadButtonMask & 0x0F;
+
+    const bool8_t actionButtonsSelected     = ( *pJoypadRegister & ( 1 << 5 ) ) == 0;
+    const bool8_t directionButtonsSelected  = ( *pJoypadRegister & ( 1 << 4 ) ) == 0;
+    if( ( actionButtonsSelected && pressedActionButtonMask != 0u ) || ( directionButtonsSelected && pressedDpadButtonMask != 0u ) )
+    {
+        triggerInterrupt( pMemoryMapper, JoypadInterrupt );
+    }
+
+    pEmulatorInstance->joypadState.value = joypadState.value;
+    *pJoypadRegister = handleInput( *pJoypadRegister, joypadState );
+}
+
+void applyDueGBInputEvents( GBEmulatorInstance* pEmulatorInstance, GBInputQueue* pInputQueue )
+{
+    const uint32_t writeIndex = pInputQueue->writeIndex.load( std::memory_order_acquire );
+    const uint32_t firstReadIndex = pInputQueue->readIndex.load( std::memory_order_relaxed );
+
+    uint32_t readIndex = firstReadIndex;
+    for( ; readIndex != writeIndex; ++readIndex )
+    {
+        const GBInputEvent* pEvent = pInputQueue->events + ( readIndex & ( gbInputQueueCapacity - 1u ) );
+        if( pEvent->cycle > pEmulatorInstance->cpuState.totalCycleCounter )
+        {
+            break;
+        }
+
+        applyGBEmulatorJoypadState( pEmulatorInstance, pEvent->joypadState );
+    }
+
+    if( readIndex != firstReadIndex )
+    {
+        pInputQueue->readIndex.store( readIndex, std::memory_order_release );
+    }
+}
+
+//FK: With rendering disabled the ppu keeps its timing, interrupts and registers but doesn't draw any scanlines into the framebuffer.
+//    The emulated state stays identical, so this can be used for frames that are never displayed (eg: re-simulating frames after a rollback).
+void setGBEmulatorRenderingEnabled( GBEmulatorInstance* pEmulatorInstance, const bool8_t renderingEnabled )
+{
+    pEmulatorInstance->skipRendering = !renderingEnabled;
+}
+
 void addOpcodeToOpcodeHistory( GBEmulatorInstance* pEmulatorInstance, uint16_t address, uint8_t opcode )
 {
 #if K15_ENABLE_EMULATOR_DEBUG_FEATURES == 0
@@ -4453,7 +6638,7 @@ void addOpcodeToOpcodeHistory( GBEmulatorInstance* pEmulatorInstance, uint16_t a
 
     pEmulatorInstance->debug.opcodeHistory[0].address     = address; 
     pEmulatorInstance->debug.opcodeHistory[0].opcode      = opcode; 
-    pEmulatorInstance->debug.opcodeHistory[0].registers   = pEmulatorInstance->pCpuState->registers; 
+    pEmulatorInstance->debug.opcodeHistory[0].registers   = pEmulatorInstance->cpuState.registers; 
 
     if( pEmulatorInstance->debug.opcodeHistorySize + 1 != gbOpcodeHistoryBufferCapacity )
     {
@@ -4464,8 +6649,8 @@ void addOpcodeToOpcodeHistory( GBEmulatorInstance* pEmulatorInstance, uint16_t a
 
 void handleCartridgeWrites( GBEmulatorInstance* pEmulatorInstance )
 {
-    GBMemoryMapper* pMemoryMapper   = pEmulatorInstance->pMemoryMapper;
-    GBCartridge* pCartridge         = pEmulatorInstance->pCartridge;
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBCartridge* pCartridge         = &pEmulatorInstance->cartridge;
 
     if( isInCartridgeRomAddressRange( pMemoryMapper->lastAddressWrittenTo ) )
     {
@@ -4474,11 +6659,10 @@ void handleCartridgeWrites( GBEmulatorInstance* pEmulatorInstance )
 
     if( isInExternalRamRange( pMemoryMapper->lastAddressWrittenTo ) && pCartridge->ramEnabled )
     {
-        //FK: mirror writes to ram area to emulator ram memory
-        const uint16_t baseAddressOffset = ( pMemoryMapper->lastAddressWrittenTo - 0xA000 ) + pCartridge->mappedRamBankNumber * gbRamBankSizeInBytes;
-        if( baseAddressOffset < pCartridge->ramSizeInBytes )
+        //FK: The write itself already went to the mapped ram bank, just flag the access
+        const uint16_t ramBankOffset = pMemoryMapper->lastAddressWrittenTo - 0xA000;
+        if( ramBankOffset < pMemoryMapper->ramBankSizeInBytes )
         {
-            pCartridge->pRamBaseAddress[ baseAddressOffset ] = pMemoryMapper->lastValueWritten;
             pEmulatorInstance->flags.ramAccessed = 1;
         }
     }
@@ -4512,13 +6696,13 @@ bool8_t isUnmappedIORegisterAddress( const uint16_t address )
 
 void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
 {
-    GBMemoryMapper* pMemoryMapper   = pEmulatorInstance->pMemoryMapper;
-    GBCpuState* pCpuState           = pEmulatorInstance->pCpuState;
-    GBPpuState* pPpuState           = pEmulatorInstance->pPpuState;
-    GBApuState* pApuState           = pEmulatorInstance->pApuState;
-    GBTimerState* pTimerState       = pEmulatorInstance->pTimerState;
-    GBSerialState* pSerialState     = pEmulatorInstance->pSerialState;
-    GBCartridge* pCartridge         = pEmulatorInstance->pCartridge;
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBCpuState* pCpuState           = &pEmulatorInstance->cpuState;
+    GBPpuState* pPpuState           = &pEmulatorInstance->ppuState;
+    GBApuState* pApuState           = &pEmulatorInstance->apuState;
+    GBTimerState* pTimerState       = &pEmulatorInstance->timerState;
+    GBSerialState* pSerialState     = &pEmulatorInstance->serialState;
+    GBCartridge* pCartridge         = &pEmulatorInstance->cartridge;
 
     const uint16_t address = pMemoryMapper->lastAddressWrittenTo;
     if( isUnmappedIORegisterAddress( address ) )
@@ -4535,27 +6719,36 @@ void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
 
     uint8_t memoryValueBitMask      = 0xFF;
     uint8_t newMemoryValue          = pMemoryMapper->lastValueWritten;
-    const uint8_t oldMemoryValue    = pMemoryMapper->pBaseAddress[ address ];
+    uint8_t* pIORegister            = getMappedMemoryAddress( pMemoryMapper, address );
+    const uint8_t oldMemoryValue    = *pIORegister;
 
     switch( address )
     {
         case K15_GB_MAPPED_IO_ADDRESS_JOYP:
         {
             newMemoryValue = handleInput( newMemoryValue, pEmulatorInstance->joypadState );
-            triggerInterrupt( pCpuState, JoypadInterrupt );
+            triggerInterrupt( pMemoryMapper, JoypadInterrupt );
+            ++pMemoryMapper->joypadWriteCount;
             break;
         }
         case K15_GB_MAPPED_IO_ADDRESS_SC:
         {
             memoryValueBitMask = 0b10000001;
+            const uint8_t transferWasInitiated = pSerialState->initiateTransfer;
             pSerialState->initiateTransfer = ( newMemoryValue & 0x80 ) > 0u;
             pSerialState->useInternalClock = ( newMemoryValue & 0x01 ) > 0u;
+
+            //FK: A linked transfer always takes a full byte transfer, the link cable relies on that to schedule both instances
+            if( pSerialState->linkConnected && pSerialState->initiateTransfer && !transferWasInitiated )
+            {
+                pSerialState->cycleCounter = 0u;
+            }
             break;
         }
         case K15_GB_MAPPED_IO_ADDRESS_DIV:
         {
             newMemoryValue = 0x00;
-            updateTimerInternalDivCounterValue( pTimerState, 0u );
+            updateTimerInternalDivCounterValue( pTimerState, pMemoryMapper, 0u );
             break;
         }
         case K15_GB_MAPPED_IO_ADDRESS_TIMA:
@@ -4576,7 +6769,7 @@ void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
             {
                 //FK: If you write to TIMA during the cycle that TMA is being loaded to it, 
                 //    the write will be ignored and TMA value will be written to TIMA instead.
-                *pTimerState->pCounter = newMemoryValue;
+                *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_TIMA ) = newMemoryValue;
                 return;
             }
             break;
@@ -4603,7 +6796,7 @@ void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
 
             if( fallingEdge )
             {
-                incrementTimerCounter( pTimerState );
+                incrementTimerCounter( pTimerState, pMemoryMapper );
             }
             break;
         }
@@ -4672,7 +6865,7 @@ void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
         {
             GBLcdControl lcdControlValue;
             memcpy(&lcdControlValue, &newMemoryValue, sizeof(GBLcdControl) );
-            updatePPULcdControl( pPpuState, lcdControlValue );
+            updatePPULcdControl( pEmulatorInstance, lcdControlValue );
             break;
         }
         case K15_GB_MAPPED_IO_ADDRESS_STAT:
@@ -4710,18 +6903,24 @@ void handleMappedIORegisterWrite( GBEmulatorInstance* pEmulatorInstance )
         }
     }
 
-    pMemoryMapper->pBaseAddress[ address ] = ( newMemoryValue & memoryValueBitMask ) | ( oldMemoryValue & ~memoryValueBitMask );
+    *pIORegister = ( newMemoryValue & memoryValueBitMask ) | ( oldMemoryValue & ~memoryValueBitMask );
 }
 
-uint8_t runSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
+//FK: runSingleInstruction() is split into 3 steps so that hosts can run the execute step differently (see k15_gb_lockstep.h)
+void beginSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
 {
-    GBMemoryMapper* pMemoryMapper   = pEmulatorInstance->pMemoryMapper;
-    GBCpuState* pCpuState           = pEmulatorInstance->pCpuState;
-    GBPpuState* pPpuState           = pEmulatorInstance->pPpuState;
-    GBApuState* pApuState           = pEmulatorInstance->pApuState;
-    GBTimerState* pTimerState       = pEmulatorInstance->pTimerState;
-    GBSerialState* pSerialState     = pEmulatorInstance->pSerialState;
-    GBCartridge* pCartridge         = pEmulatorInstance->pCartridge;
+    GBCpuState* pCpuState = &pEmulatorInstance->cpuState;
+
+    if( pEmulatorInstance->pSubsystemProfile != nullptr )
+    {
+        pEmulatorInstance->pSubsystemProfile->instructionStartTimestamp = pEmulatorInstance->pSubsystemProfile->pGetTimestamp();
+    }
+
+    //FK: Before the interrupts, so a joypad interrupt raised by an input event gets handled right away
+    if( pEmulatorInstance->pInputQueue != nullptr )
+    {
+        applyDueGBInputEvents( pEmulatorInstance, pEmulatorInstance->pInputQueue );
+    }
 
     executePendingInterrupts( pEmulatorInstance );
     if( pCpuState->flags.pendingEI )
@@ -4729,6 +6928,12 @@ uint8_t runSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
         pCpuState->flags.IME        = 1;
         pCpuState->flags.pendingEI  = 0;
     }
+}
+
+uint8_t executeSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
+{
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBCpuState* pCpuState           = &pEmulatorInstance->cpuState;
 
     uint8_t cycleCost = 4u; //FK: Default cycle cost when CPU is halted
 
@@ -4740,12 +6945,19 @@ uint8_t runSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
         //FK: Don't increment PC if entered halt bug state as part of the halt bug emulation
         const uint16_t opcodeAddress    = haltBug ? pCpuState->registers.PC : pCpuState->registers.PC++;
         const uint8_t opcode            = read8BitValueFromMappedMemory( pMemoryMapper, opcodeAddress );
-        const uint8_t opcodeByteCount   = opcode == 0xCB ? cbPrefixedOpcodes[opcode].byteCount : unprefixedOpcodes[opcode].byteCount;
 
         addOpcodeToOpcodeHistory( pEmulatorInstance, opcodeAddress, opcode );
         cycleCost = executeInstruction( pCpuState, pMemoryMapper, opcode );
     }
 
+    return cycleCost;
+}
+
+void finishSingleInstruction( GBEmulatorInstance* pEmulatorInstance, const uint8_t cycleCost )
+{
+    GBMemoryMapper* pMemoryMapper   = &pEmulatorInstance->memoryMapper;
+    GBCpuState* pCpuState           = &pEmulatorInstance->cpuState;
+
     if( pMemoryMapper->memoryAccess == GBMemoryAccess_Written )
     {
         if( isInIORegisterRange( pMemoryMapper->lastAddressWrittenTo ) )
@@ -4761,11 +6973,24 @@ uint8_t runSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
     tickSystem( pEmulatorInstance, cycleCost );
 
     pMemoryMapper->memoryAccess         = GBMemoryAccess_None;
-    pMemoryMapper->lcdStatus            = *pPpuState->lcdRegisters.pStatus;
-    pMemoryMapper->lcdEnabled           = pPpuState->pLcdControl->enable;
+    pMemoryMapper->lcdStatus            = *getLcdStatus( pMemoryMapper );
+    pMemoryMapper->lcdEnabled           = getLcdControl( pMemoryMapper )->enable;
     pMemoryMapper->dmaActive            = pCpuState->flags.dma;
-    pMemoryMapper->ramEnabled           = pEmulatorInstance->pCartridge->ramEnabled;
+    pMemoryMapper->ramEnabled           = pEmulatorInstance->cartridge.ramEnabled;
+
+    GBSubsystemProfile* pProfile = pEmulatorInstance->pSubsystemProfile;
+    if( pProfile != nullptr )
+    {
+        pProfile->subsystemTimestamps[ K15_GB_SUBSYSTEM_CPU ] += pProfile->pGetTimestamp() - pProfile->instructionStartTimestamp;
+        ++pProfile->instructionCount;
+    }
+}
 
+uint8_t runSingleInstruction( GBEmulatorInstance* pEmulatorInstance )
+{
+    beginSingleInstruction( pEmulatorInstance );
+    const uint8_t cycleCost = executeSingleInstruction( pEmulatorInstance );
+    finishSingleInstruction( pEmulatorInstance, cycleCost );
     return cycleCost;
 }
 
@@ -4816,14 +7041,52 @@ void convertGBFrameBufferToRGB8Buffer( uint8_t* pRGBFrameBuffer, const uint8_t*
 
 const uint8_t* getGBEmulatorFrameBuffer( GBEmulatorInstance* pInstance )
 {
-    const uint8_t backBufferIndex = !pInstance->pPpuState->activeFrameBufferIndex;
-    return pInstance->pPpuState->pGBFrameBuffers[ backBufferIndex ];
+    const uint8_t backBufferIndex = ( pInstance->ppuState.activeFrameBufferIndex + 1u ) % gbFrameBufferCount;
+    return pInstance->gbFrameBuffers[ backBufferIndex ];
+}
+
+//FK: Can be called from any thread once a state has been written asynchronously (eg: using storeGBEmulatorStateFromRawState()).
+//    The next call to runGBEmulatorForCycles() will return K15_GB_STATE_SAVED_EVENT_FLAG.
+//    Everything the signaling thread wrote before the call (eg: the result of the save) is visible to the emulator thread once the event is returned.
+void signalGBEmulatorStateSaved( GBEmulatorInstance* pInstance )
+{
+    pInstance->stateSavedCounter.fetch_add( 1u, std::memory_order_release );
+}
+
+GBEmulatorInstanceEventMask collectGBEmulatorAsyncEvents( GBEmulatorInstance* pInstance )
+{
+    GBEmulatorInstanceEventMask eventMask = K15_GB_NO_EVENT_FLAG;
+
+    const uint32_t stateSavedCounter = pInstance->stateSavedCounter.load( std::memory_order_acquire );
+    if( stateSavedCounter != pInstance->reportedStateSavedCounter )
+    {
+        pInstance->reportedStateSavedCounter = stateSavedCounter;
+        eventMask |= K15_GB_STATE_SAVED_EVENT_FLAG;
+    }
+
+    return eventMask;
+}
+
+uint32_t getGBEmulatorJoypadAccessCount( const GBEmulatorInstance* pInstance )
+{
+    return pInstance->memoryMapper.joypadReadCount + pInstance->memoryMapper.joypadWriteCount;
+}
+
+//FK: Events raised by the instructions that ran since the flags got reset, joypadAccessCount is the value of getGBEmulatorJoypadAccessCount() at that point
+GBEmulatorInstanceEventMask collectGBEmulatorRunEvents( GBEmulatorInstance* pInstance, const uint32_t joypadAccessCount )
+{
+    GBEmulatorInstanceEventMask eventMask = pInstance->flags.vblank == 1 ? K15_GB_VBLANK_EVENT_FLAG : K15_GB_NO_EVENT_FLAG;
+    eventMask |= pInstance->flags.lagFrame == 1 ? K15_GB_LAG_FRAME_EVENT_FLAG : K15_GB_NO_EVENT_FLAG;
+    eventMask |= getGBEmulatorJoypadAccessCount( pInstance ) != joypadAccessCount ? K15_GB_INPUT_POLLED_EVENT_FLAG : K15_GB_NO_EVENT_FLAG;
+    eventMask |= collectGBEmulatorAsyncEvents( pInstance );
+    return eventMask;
 }
 
 GBEmulatorInstanceEventMask runGBEmulatorForCycles( GBEmulatorInstance* pInstance, uint32_t cycleCountToRunFor )
 {
-    GBCpuState* pCpuState = pInstance->pCpuState;
-    GBPpuState* pPpuState = pInstance->pPpuState;
+    GBCpuState* pCpuState = &pInstance->cpuState;
+    GBPpuState* pPpuState = &pInstance->ppuState;
+    const uint32_t joypadAccessCount = getGBEmulatorJoypadAccessCount( pInstance );
     
     //FK: reset flags
     pInstance->flags.value = 0;
@@ -4867,7 +7130,7 @@ GBEmulatorInstanceEventMask runGBEmulatorForCycles( GBEmulatorInstance* pInstanc
         localCycleCounter += cycleCount;
 
 #if K15_ENABLE_EMULATOR_DEBUG_FEATURES == 1
-        if( pInstance->debug.pauseAtBreakpoint && pInstance->debug.breakpointAddress == pInstance->pCpuState->registers.PC )
+        if( pInstance->debug.pauseAtBreakpoint && pInstance->debug.breakpointAddress == pInstance->cpuState.registers.PC )
         {
             pInstance->debug.pauseExecution = 1;
             return K15_GB_NO_EVENT_FLAG;
@@ -4875,5 +7138,88 @@ GBEmulatorInstanceEventMask runGBEmulatorForCycles( GBEmulatorInstance* pInstanc
 #endif
     }
 
-    return pInstance->flags.vblank == 1 ? K15_GB_VBLANK_EVENT_FLAG : K15_GB_NO_EVENT_FLAG;
+    return collectGBEmulatorRunEvents( pInstance, joypadAccessCount );
+}
+
+struct GBEmulatorRunResult
+{
+    GBEmulatorStopMask          stopMask;       //FK: All requested conditions that were met by the last instruction
+    GBEmulatorInstanceEventMask eventMask;      //FK: Same as the return value of runGBEmulatorForCycles()
+    uint32_t                    cycleCount;     //FK: Cycles that actually ran
+};
+
+void setGBEmulatorStopAddress( GBEmulatorInstance* pInstance, const uint16_t stopAddress )
+{
+    pInstance->stopAddress = stopAddress;
+}
+
+void setGBEmulatorStopLine( GBEmulatorInstance* pInstance, const uint8_t stopLine )
+{
+    pInstance->stopLine = stopLine;
+}
+
+//FK: Unlike runGBEmulatorForCycles() this stops right after the instruction that met one of the conditions of stopMask (K15_GB_STOP_AT_...),
+//    so hosts can present exactly at the end of a frame and bots can step to the next input poll. maxCycles is always a stop condition,
+//    instructions aren't split so the last one (and an interrupt dispatched before it) can overshoot maxCycles (see GBEmulatorRunResult::cycleCount).
+//    Transfers finished by the link cable happen between instructions and don't stop the instance (see runGBLinkCableForCycles()).
+GBEmulatorRunResult runGBEmulatorUntil( GBEmulatorInstance* pInstance, const GBEmulatorStopMask stopMask, const uint32_t maxCycles )
+{
+    GBCpuState* pCpuState           = &pInstance->cpuState;
+    GBMemoryMapper* pMemoryMapper   = &pInstance->memoryMapper;
+    GBSerialState* pSerialState     = &pInstance->serialState;
+    const uint8_t* pLy              = getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY );
+    const GBEmulatorStopMask activeStopMask = stopMask | K15_GB_STOP_AT_MAX_CYCLES;
+    const uint32_t joypadAccessCount        = getGBEmulatorJoypadAccessCount( pInstance );
+
+    pInstance->flags.value = 0;
+
+    GBEmulatorRunResult result;
+    result.stopMask     = K15_GB_STOP_NONE;
+    result.cycleCount   = 0u;
+
+    while( result.stopMask == K15_GB_STOP_NONE )
+    {
+        const uint8_t ly                        = *pLy;
+        const uint32_t transferredByteCount     = pSerialState->transferredByteCount;
+        const uint32_t joypadReadCount          = pMemoryMapper->joypadReadCount;
+        result.cycleCount += runSingleInstruction( pInstance );
+
+        GBEmulatorStopMask metConditions = K15_GB_STOP_NONE;
+        if( *pLy != ly )
+        {
+            metConditions |= *pLy == 144 ? K15_GB_STOP_AT_VBLANK : K15_GB_STOP_NONE;
+            metConditions |= *pLy == pInstance->stopLine ? K15_GB_STOP_AT_LINE : K15_GB_STOP_NONE;
+        }
+
+        metConditions |= pSerialState->transferredByteCount != transferredByteCount ? K15_GB_STOP_AT_SERIAL_BYTE : K15_GB_STOP_NONE;
+        metConditions |= pMemoryMapper->joypadReadCount != joypadReadCount ? K15_GB_STOP_AT_JOYPAD_READ : K15_GB_STOP_NONE;
+        metConditions |= pCpuState->registers.PC == pInstance->stopAddress && !pCpuState->flags.halt ? K15_GB_STOP_AT_ADDRESS : K15_GB_STOP_NONE;
+        metConditions |= result.cycleCount >= maxCycles ? K15_GB_STOP_AT_MAX_CYCLES : K15_GB_STOP_NONE;
+        result.stopMask = metConditions & activeStopMask;
+    }
+
+    result.eventMask = collectGBEmulatorRunEvents( pInstance, joypadAccessCount );
+    return result;
+}
+
+struct GBInputPollStats
+{
+    uint32_t    frameCount;                 //FK: Finished frames (LY reached 144), frames don't finish while the lcd is disabled
+    uint32_t    lagFrameCount;              //FK: Finished frames in which the game neither read nor wrote JOYP
+    uint32_t    lastFrameJoypadReadCount;
+    uint32_t    lastFrameJoypadWriteCount;
+    bool8_t     lastFrameWasLagFrame;
+};
+
+GBInputPollStats getGBEmulatorInputPollStats( const GBEmulatorInstance* pInstance )
+{
+    const GBInputPollState* pInputPollState = &pInstance->inputPollState;
+
+    GBInputPollStats stats;
+    stats.frameCount                = pInputPollState->frameCount;
+    stats.lagFrameCount             = pInputPollState->lagFrameCount;
+    stats.lastFrameJoypadReadCount  = pInputPollState->lastFrameJoypadReadCount;
+    stats.lastFrameJoypadWriteCount = pInputPollState->lastFrameJoypadWriteCount;
+    stats.lastFrameWasLagFrame      = pInputPollState->frameCount > 0u && pInputPollState->lastFrameJoypadReadCount == 0u && pInputPollState->lastFrameJoypadWriteCount == 0u;
+    return stats;
 }
@@ -0,0 +1,196 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_LINK_CABLE
+#define K15_GB_LINK_CABLE
+
+//FK: Connects the serial ports of two instances in the same process (eg: trading/battling between two games).
+//    The instances don't run in instruction lockstep. Each instance runs on its own for up to gbLinkCableMaxCycleLead cycles ahead of the other,
+//    which is less than the duration of a byte transfer. So whenever one instance finishes an internal clock transfer, the other one can be caught up
+//    to exactly that point in time and the bytes get exchanged. While a transfer is in flight the other instance runs up to the end of that transfer.
+//    Transfers are exchanged a byte at a time: the instance using the internal clock gets the SB value of the other instance if that one waits for an
+//    external clock transfer (SC = 0x80), otherwise it receives 0xFF (no partner ready, same as without a cable).
+
+//FK: Needs to stay below gbSerialClockCyclesPerByteTransfer minus the longest instruction (including interrupt dispatch)
+static constexpr uint32_t gbLinkCableMaxCycleLead = gbSerialClockCyclesPerByteTransfer - 64u;
+
+struct GBLinkCableStats
+{
+    uint64_t    transferCount;              //FK: Transfers started by either instance using the internal clock
+    uint64_t    unansweredTransferCount;    //FK: Transfers where the other instance wasn't waiting for a transfer (received 0xFF)
+    uint64_t    syncCount;                  //FK: Number of times the link cable switched between the instances
+};
+
+struct GBLinkCable
+{
+    GBEmulatorInstance* pInstances[ 2 ];
+    uint32_t            overshootCycles[ 2 ];   //FK: Cycles an instance ran past the end of the last runGBLinkCableForCycles() call
+    GBLinkCableStats    stats;
+};
+
+//FK: Both instances are owned by the caller and should only be run using runGBLinkCableForCycles() while they are connected
+void connectGBLinkCable( GBLinkCable* pLinkCable, GBEmulatorInstance* pFirstInstance, GBEmulatorInstance* pSecondInstance )
+{
+    RuntimeAssert( pFirstInstance != pSecondInstance );
+
+    memset( pLinkCable, 0, sizeof( GBLinkCable ) );
+    pLinkCable->pInstances[ 0 ] = pFirstInstance;
+    pLinkCable->pInstances[ 1 ] = pSecondInstance;
+
+    pFirstInstance->serialState.linkConnected   = 1u;
+    pSecondInstance->serialState.linkConnected  = 1u;
+}
+
+void finishGBLinkCableTransfer( GBEmulatorInstance* pInstance )
+{
+    GBSerialState* pSerialState = &pInstance->serialState;
+    pSerialState->initiateTransfer  = 0u;
+    pSerialState->linkTransferDue   = 0u;
+    pSerialState->shiftIndex        = 0u;
+    ++pSerialState->transferredByteCount;
+
+    *getMappedMemoryAddress( &pInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_SC ) &= ~0x80;
+    triggerInterrupt( &pInstance->memoryMapper, SerialInterrupt );
+}
+
+//FK: pMasterInstance finished shifting a byte using its internal clock, pPartnerInstance has been run up to the same point in time
+void exchangeGBLinkCableBytes( GBLinkCable* pLinkCable, GBEmulatorInstance* pMasterInstance, GBEmulatorInstance* pPartnerInstance )
+{
+    const GBSerialState* pPartnerSerialState = &pPartnerInstance->serialState;
+    const bool8_t partnerIsWaiting = pPartnerSerialState->initiateTransfer && !pPartnerSerialState->useInternalClock;
+
+    uint8_t* pMasterData    = getMappedMemoryAddress( &pMasterInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB );
+    uint8_t* pPartnerData   = getMappedMemoryAddress( &pPartnerInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB );
+    const uint8_t masterByte = *pMasterData;
+
+    *pMasterData = partnerIsWaiting ? *pPartnerData : 0xFFu;
+    if( partnerIsWaiting )
+    {
+        *pPartnerData = masterByte;
+        finishGBLinkCableTransfer( pPartnerInstance );
+    }
+
+    finishGBLinkCableTransfer( pMasterInstance );
+
+    ++pLinkCable->stats.transferCount;
+    pLinkCable->stats.unansweredTransferCount += !partnerIsWaiting;
+}
+
+//FK: Disconnecting in the middle of a transfer finishes the transfer as if there was no partner
+void disconnectGBLinkCable( GBLinkCable* pLinkCable )
+{
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        GBEmulatorInstance* pInstance = pLinkCable->pInstances[ instanceIndex ];
+        if( pInstance->serialState.linkTransferDue )
+        {
+            *getMappedMemoryAddress( &pInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_SB ) = 0xFFu;
+            finishGBLinkCableTransfer( pInstance );
+        }
+
+        pInstance->serialState.linkConnected = 0u;
+    }
+}
+
+//FK: Cycles until the internal clock transfer of the instance is done (0 if there's no such transfer in flight)
+uint32_t calculateGBLinkCableRemainingTransferCycles( const GBEmulatorInstance* pInstance )
+{
+    const GBSerialState* pSerialState = &pInstance->serialState;
+    if( !pSerialState->initiateTransfer || !pSerialState->useInternalClock )
+    {
+        return 0u;
+    }
+
+    return gbSerialClockCyclesPerByteTransfer - GetMin( pSerialState->cycleCounter, gbSerialClockCyclesPerByteTransfer );
+}
+
+uint32_t runGBLinkCableInstanceForCycles( GBEmulatorInstance* pInstance, const uint32_t cycleCountToRunFor )
+{
+    uint32_t cycleCount = 0u;
+    while( cycleCount < cycleCountToRunFor && !pInstance->serialState.linkTransferDue )
+    {
+        cycleCount += runSingleInstruction( pInstance );
+    }
+
+    return cycleCount;
+}
+
+//FK: Runs both instances for the given number of cycles, the event masks of both instances get written to pOutEventMasks
+void runGBLinkCableForCycles( GBLinkCable* pLinkCable, const uint32_t cycleCountToRunFor, GBEmulatorInstanceEventMask* pOutEventMasks )
+{
+    //FK: Cycle count of both instances since the start of this call
+    uint32_t cycleCounts[ 2 ];
+    uint32_t joypadAccessCounts[ 2 ];
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        GBEmulatorInstance* pInstance = pLinkCable->pInstances[ instanceIndex ];
+
+        //FK: A restored snapshot or a reset might have cleared the flag
+        pInstance->serialState.linkConnected = 1u;
+        pInstance->flags.value = 0;
+        cycleCounts[ instanceIndex ] = pLinkCable->overshootCycles[ instanceIndex ];
+        joypadAccessCounts[ instanceIndex ] = getGBEmulatorJoypadAccessCount( pInstance );
+    }
+
+    while( true )
+    {
+        const uint32_t instanceIndex        = cycleCounts[ 0 ] <= cycleCounts[ 1 ] ? 0u : 1u;
+        const uint32_t otherInstanceIndex   = 1u - instanceIndex;
+        GBEmulatorInstance* pInstance       = pLinkCable->pInstances[ instanceIndex ];
+        GBEmulatorInstance* pOtherInstance  = pLinkCable->pInstances[ otherInstanceIndex ];
+
+        //FK: The instance that is behind finished a transfer, the other one is already at (or past) that point in time
+        if( pInstance->serialState.linkTransferDue )
+        {
+            exchangeGBLinkCableBytes( pLinkCable, pInstance, pOtherInstance );
+            continue;
+        }
+
+        uint32_t targetCycleCount = 0u;
+        if( pOtherInstance->serialState.linkTransferDue )
+        {
+            if( cycleCounts[ instanceIndex ] >= cycleCounts[ otherInstanceIndex ] )
+            {
+                exchangeGBLinkCableBytes( pLinkCable, pOtherInstance, pInstance );
+                continue;
+            }
+
+            //FK: Catch up to the end of the transfer of the other instance (even if that's past the end of this call)
+            targetCycleCount = cycleCounts[ otherInstanceIndex ];
+        }
+        else
+        {
+            if( cycleCounts[ instanceIndex ] >= cycleCountToRunFor )
+            {
+                break;
+            }
+
+            targetCycleCount = GetMin( cycleCountToRunFor, cycleCounts[ otherInstanceIndex ] + gbLinkCableMaxCycleLead );
+
+            const uint32_t remainingTransferCycles = calculateGBLinkCableRemainingTransferCycles( pOtherInstance );
+            if( remainingTransferCycles > 0u )
+            {
+                targetCycleCount = GetMin( targetCycleCount, cycleCounts[ otherInstanceIndex ] + remainingTransferCycles );
+            }
+        }
+
+        cycleCounts[ instanceIndex ] += runGBLinkCableInstanceForCycles( pInstance, targetCycleCount - cycleCounts[ instanceIndex ] );
+        ++pLinkCable->stats.syncCount;
+    }
+
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        GBEmulatorInstance* pInstance = pLinkCable->pInstances[ instanceIndex ];
+        pLinkCable->overshootCycles[ instanceIndex ] = cycleCounts[ instanceIndex ] - cycleCountToRunFor;
+
+        pOutEventMasks[ instanceIndex ] = collectGBEmulatorRunEvents( pInstance, joypadAccessCounts[ instanceIndex ] );
+    }
+}
+
+GBLinkCableStats getGBLinkCableStats( const GBLinkCable* pLinkCable )
+{
+    return pLinkCable->stats;
+}
+
+#endif //K15_GB_LINK_CABLE
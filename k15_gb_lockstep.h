@@ -0,0 +1,443 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_LOCKSTEP
+#define K15_GB_LOCKSTEP
+
+//FK: Experimental - Steps K instances of the same rom instruction by instruction.
+//    As long as all lanes are about to execute the same register only opcode at the same PC (eg: LD r, r or ALU ops on registers)
+//    the opcode gets executed once for all lanes on registers stored as struct of arrays. The per lane loops don't contain any branches,
+//    so the compiler can turn them into SIMD code (compile with /arch:AVX2 or -mavx2 to get AVX2).
+//    All other opcodes and lanes that diverged run the regular scalar path. Timers, ppu, apu etc. are always ticked per lane.
+//    The result is bit identical to running the instances on their own.
+
+static constexpr uint32_t gbLockstepMaxLaneCount = 64u;
+
+//FK: Registers indexed by the 3 bit register encoding of the opcodes (B, C, D, E, H, L, (HL), A).
+//    (HL) is never a register only operand, so its slot is used for F.
+enum
+{
+    K15_GB_LOCKSTEP_REGISTER_B = 0,
+    K15_GB_LOCKSTEP_REGISTER_C,
+    K15_GB_LOCKSTEP_REGISTER_D,
+    K15_GB_LOCKSTEP_REGISTER_E,
+    K15_GB_LOCKSTEP_REGISTER_H,
+    K15_GB_LOCKSTEP_REGISTER_L,
+    K15_GB_LOCKSTEP_REGISTER_F,
+    K15_GB_LOCKSTEP_REGISTER_A,
+    K15_GB_LOCKSTEP_REGISTER_COUNT
+};
+
+struct GBLockstepStats
+{
+    uint64_t    stepCount;                  //FK: Instructions every lane executed
+    uint64_t    convergedStepCount;         //FK: Steps where all lanes were at the same PC
+    uint64_t    vectorizedStepCount;        //FK: Converged steps that ran the opcode across all lanes at once
+};
+
+struct GBLockstepGroup
+{
+    alignas( 32 ) uint8_t   registers[ K15_GB_LOCKSTEP_REGISTER_COUNT ][ gbLockstepMaxLaneCount ];
+
+    //FK: Lives behind the group instead of next to the registers. If both arrays are members of the group, g++ 12.2 (-O1 and up)
+    //    lets ivopts address pLanes[ laneIndex ] relative to the registers induction variable with a NULL base, local-pure-const then
+    //    takes that for a NULL dereference ("NULL memory access; terminating BB" in -fdump-tree-local-pure-const2), flags the
+    //    gather/scatter functions as pure and their calls get removed. Any struct with a byte array and a pointer array
+    //    indexed by the same loop counter reproduces it, -fno-ivopts makes it go away. k15_gb_lockstep_benchmark catches it.
+    GBEmulatorInstance**    ppLanes;
+    uint32_t                laneCount;
+    GBLockstepStats         stats;
+};
+
+size_t calculateGBLockstepGroupMemoryRequirementsInBytes()
+{
+    return sizeof( GBLockstepGroup ) + alignof( GBLockstepGroup ) + sizeof( GBEmulatorInstance* ) * gbLockstepMaxLaneCount;
+}
+
+//FK: The instances are owned by the caller, they all need to have the same rom loaded
+GBLockstepGroup* createGBLockstepGroup( uint8_t* pLockstepGroupMemory, GBEmulatorInstance** ppInstances, const uint32_t laneCount )
+{
+    RuntimeAssert( laneCount > 0u && laneCount <= gbLockstepMaxLaneCount );
+
+    const size_t groupOffset = ( ( size_t )pLockstepGroupMemory + alignof( GBLockstepGroup ) - 1u ) & ~( alignof( GBLockstepGroup ) - 1u );
+    GBLockstepGroup* pGroup = ( GBLockstepGroup* )groupOffset;
+    memset( pGroup, 0, sizeof( GBLockstepGroup ) );
+
+    pGroup->ppLanes = ( GBEmulatorInstance** )( pGroup + 1 );
+
+    for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+    {
+        pGroup->ppLanes[ laneIndex ] = ppInstances[ laneIndex ];
+    }
+
+    pGroup->laneCount = laneCount;
+    return pGroup;
+}
+
+bool8_t isGBLockstepVectorOpcode( const uint8_t opcode )
+{
+    const uint8_t registerIndex = opcode & 0x07;
+    const uint8_t targetIndex   = ( opcode >> 3 ) & 0x07;
+
+    //FK: NOP, CPL, SCF, CCF
+    if( opcode == 0x00 || opcode == 0x2F || opcode == 0x37 || opcode == 0x3F )
+    {
+        return 1u;
+    }
+
+    //FK: INC r / DEC r
+    if( opcode < 0x40 )
+    {
+        return ( registerIndex == 0x04 || registerIndex == 0x05 ) && targetIndex != 0x06;
+    }
+
+    //FK: LD r, r
+    if( opcode < 0x80 )
+    {
+        return registerIndex != 0x06 && targetIndex != 0x06;
+    }
+
+    //FK: ADD, ADC, SUB, SBC, AND, XOR, OR, CP with a register operand
+    if( opcode < 0xC0 )
+    {
+        return registerIndex != 0x06;
+    }
+
+    return 0u;
+}
+
+void gatherGBLockstepRegisters( GBLockstepGroup* pGroup )
+{
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        const GBCpuRegisters* pRegisters = &pGroup->ppLanes[ laneIndex ]->cpuState.registers;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_B ][ laneIndex ] = pRegisters->B;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_C ][ laneIndex ] = pRegisters->C;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_D ][ laneIndex ] = pRegisters->D;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_E ][ laneIndex ] = pRegisters->E;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_H ][ laneIndex ] = pRegisters->H;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_L ][ laneIndex ] = pRegisters->L;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_F ][ laneIndex ] = pRegisters->F.value;
+        pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_A ][ laneIndex ] = pRegisters->A;
+    }
+}
+
+void scatterGBLockstepRegisters( GBLockstepGroup* pGroup )
+{
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        GBCpuRegisters* pRegisters = &pGroup->ppLanes[ laneIndex ]->cpuState.registers;
+        pRegisters->B       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_B ][ laneIndex ];
+        pRegisters->C       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_C ][ laneIndex ];
+        pRegisters->D       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_D ][ laneIndex ];
+        pRegisters->E       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_E ][ laneIndex ];
+        pRegisters->H       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_H ][ laneIndex ];
+        pRegisters->L       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_L ][ laneIndex ];
+        pRegisters->F.value = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_F ][ laneIndex ];
+        pRegisters->A       = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_A ][ laneIndex ];
+    }
+}
+
+//FK: Flags need to match executeInstruction() exactly (including the lower nibble of F that some opcodes clear and some keep)
+void executeGBLockstepVectorOpcode( GBLockstepGroup* pGroup, const uint8_t opcode )
+{
+    const uint32_t laneCount = pGroup->laneCount;
+    //FK: F never aliases one of the other registers, A can be the target or the operand of an opcode
+    uint8_t* pA = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_A ];
+    uint8_t* restrict_modifier pF = pGroup->registers[ K15_GB_LOCKSTEP_REGISTER_F ];
+
+    const uint8_t registerIndex = opcode & 0x07;
+    const uint8_t targetIndex   = ( opcode >> 3 ) & 0x07;
+
+    if( opcode == 0x00 )
+    {
+        return;
+    }
+    else if( opcode == 0x2F ) //FK: CPL
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+        {
+            pA[ laneIndex ] = ~pA[ laneIndex ];
+            pF[ laneIndex ] |= 0x60;
+        }
+    }
+    else if( opcode == 0x37 ) //FK: SCF
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+        {
+            pF[ laneIndex ] = ( pF[ laneIndex ] & 0x8F ) | 0x10;
+        }
+    }
+    else if( opcode == 0x3F ) //FK: CCF
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+        {
+            pF[ laneIndex ] = ( pF[ laneIndex ] & 0x9F ) ^ 0x10;
+        }
+    }
+    else if( opcode < 0x40 )
+    {
+        uint8_t* pTarget = pGroup->registers[ targetIndex ];
+        if( registerIndex == 0x04 ) //FK: INC r
+        {
+            for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+            {
+                const uint8_t oldValue = pTarget[ laneIndex ];
+                const uint8_t newValue = oldValue + 1u;
+                pTarget[ laneIndex ] = newValue;
+                pF[ laneIndex ] = ( pF[ laneIndex ] & 0x1F ) | ( ( newValue == 0u ) << 7u ) | ( ( ( oldValue & 0xF0 ) != ( newValue & 0xF0 ) ) << 5u );
+            }
+        }
+        else //FK: DEC r
+        {
+            for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+            {
+                const uint8_t newValue = pTarget[ laneIndex ] - 1u;
+                pTarget[ laneIndex ] = newValue;
+                pF[ laneIndex ] = ( pF[ laneIndex ] & 0x1F ) | ( ( newValue == 0u ) << 7u ) | 0x40 | ( ( ( newValue & 0x0F ) == 0x0F ) << 5u );
+            }
+        }
+    }
+    else if( opcode < 0x80 ) //FK: LD r, r
+    {
+        if( targetIndex != registerIndex )
+        {
+            memcpy( pGroup->registers[ targetIndex ], pGroup->registers[ registerIndex ], laneCount );
+        }
+    }
+    else
+    {
+        const uint8_t* pOperand = pGroup->registers[ registerIndex ];
+        switch( targetIndex )
+        {
+            case 0x00: //FK: ADD
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t accumulator = pA[ laneIndex ];
+                    const uint8_t operand = pOperand[ laneIndex ];
+                    const uint16_t result = accumulator + operand;
+                    pA[ laneIndex ] = ( uint8_t )result;
+                    pF[ laneIndex ] = ( pF[ laneIndex ] & 0x0F ) | ( ( ( uint8_t )result == 0u ) << 7u ) |
+                        ( ( ( ( accumulator & 0x0F ) + ( operand & 0x0F ) ) > 0x0F ) << 5u ) | ( ( result > 0xFF ) << 4u );
+                }
+                break;
+            }
+
+            case 0x01: //FK: ADC
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t accumulator = pA[ laneIndex ];
+                    const uint8_t operand = pOperand[ laneIndex ];
+                    const uint8_t carry = ( pF[ laneIndex ] >> 4u ) & 0x01;
+                    const uint16_t result = accumulator + operand + carry;
+                    pA[ laneIndex ] = ( uint8_t )result;
+                    pF[ laneIndex ] = ( pF[ laneIndex ] & 0x0F ) | ( ( ( uint8_t )result == 0u ) << 7u ) |
+                        ( ( ( ( accumulator & 0x0F ) + ( operand & 0x0F ) + carry ) > 0x0F ) << 5u ) | ( ( result > 0xFF ) << 4u );
+                }
+                break;
+            }
+
+            case 0x02: //FK: SUB
+            case 0x07: //FK: CP
+            {
+                const bool8_t storeResult = targetIndex == 0x02;
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t accumulator = pA[ laneIndex ];
+                    const uint8_t operand = pOperand[ laneIndex ];
+                    const uint8_t result = accumulator - operand;
+                    pA[ laneIndex ] = storeResult ? result : accumulator;
+                    pF[ laneIndex ] = ( pF[ laneIndex ] & 0x0F ) | ( ( result == 0u ) << 7u ) | 0x40 |
+                        ( ( ( accumulator & 0x0F ) < ( operand & 0x0F ) ) << 5u ) | ( ( accumulator < operand ) << 4u );
+                }
+                break;
+            }
+
+            case 0x03: //FK: SBC
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t accumulator = pA[ laneIndex ];
+                    const uint8_t operand = pOperand[ laneIndex ];
+                    const uint8_t carry = ( pF[ laneIndex ] >> 4u ) & 0x01;
+                    const int16_t result = accumulator - operand - carry;
+                    const int16_t resultNibble = ( accumulator & 0x0F ) - ( operand & 0x0F ) - carry;
+                    pA[ laneIndex ] = ( uint8_t )result;
+                    pF[ laneIndex ] = ( pF[ laneIndex ] & 0x0F ) | ( ( ( uint8_t )result == 0u ) << 7u ) | 0x40 |
+                        ( ( resultNibble < 0 ) << 5u ) | ( ( result < 0 ) << 4u );
+                }
+                break;
+            }
+
+            case 0x04: //FK: AND
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t result = pA[ laneIndex ] & pOperand[ laneIndex ];
+                    pA[ laneIndex ] = result;
+                    pF[ laneIndex ] = ( pF[ laneIndex ] & 0x0F ) | ( ( result == 0u ) << 7u ) | 0x20;
+                }
+                break;
+            }
+
+            case 0x05: //FK: XOR
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t result = pA[ laneIndex ] ^ pOperand[ laneIndex ];
+                    pA[ laneIndex ] = result;
+                    pF[ laneIndex ] = ( result == 0u ) << 7u;
+                }
+                break;
+            }
+
+            case 0x06: //FK: OR
+            {
+                for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+                {
+                    const uint8_t result = pA[ laneIndex ] | pOperand[ laneIndex ];
+                    pA[ laneIndex ] = result;
+                    pF[ laneIndex ] = ( result == 0u ) << 7u;
+                }
+                break;
+            }
+        }
+    }
+}
+
+//FK: Reads the opcode without touching the memory access state of the memory mapper
+uint8_t peekGBLockstepOpcode( GBMemoryMapper* pMemoryMapper, const uint16_t address )
+{
+    return allowReadFromMemoryAddress( pMemoryMapper, address ) ? getMappedMemoryValue( pMemoryMapper, address ) : 0xFF;
+}
+
+//FK: Returns 1 if all lanes are about to execute the same vectorizable opcode at the same PC
+bool8_t canStepGBLockstepGroupVectorized( GBLockstepGroup* pGroup, bool8_t* pOutConverged, uint8_t* pOutOpcode )
+{
+    const GBCpuState* pFirstCpuState = &pGroup->ppLanes[ 0 ]->cpuState;
+    const uint16_t programCounter = pFirstCpuState->registers.PC;
+
+    *pOutConverged = 1u;
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        const GBCpuState* pCpuState = &pGroup->ppLanes[ laneIndex ]->cpuState;
+        if( pCpuState->registers.PC != programCounter || pCpuState->flags.halt || pCpuState->flags.haltBug )
+        {
+            *pOutConverged = pCpuState->registers.PC == programCounter;
+            return 0u;
+        }
+    }
+
+    //FK: The opcode can differ between lanes if the code is running from ram
+    const uint8_t opcode = peekGBLockstepOpcode( &pGroup->ppLanes[ 0 ]->memoryMapper, programCounter );
+    if( !isGBLockstepVectorOpcode( opcode ) )
+    {
+        return 0u;
+    }
+
+    for( uint32_t laneIndex = 1u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        if( peekGBLockstepOpcode( &pGroup->ppLanes[ laneIndex ]->memoryMapper, programCounter ) != opcode )
+        {
+            return 0u;
+        }
+    }
+
+    *pOutOpcode = opcode;
+    return 1u;
+}
+
+//FK: Executes a single instruction on every lane, returns the cycle cost of each lane in pOutCycleCosts
+void stepGBLockstepGroup( GBLockstepGroup* pGroup, uint8_t* pOutCycleCosts )
+{
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        beginSingleInstruction( pGroup->ppLanes[ laneIndex ] );
+    }
+
+    bool8_t converged = 0u;
+    uint8_t opcode = 0u;
+    ++pGroup->stats.stepCount;
+
+    if( canStepGBLockstepGroupVectorized( pGroup, &converged, &opcode ) )
+    {
+        gatherGBLockstepRegisters( pGroup );
+        executeGBLockstepVectorOpcode( pGroup, opcode );
+        scatterGBLockstepRegisters( pGroup );
+
+        const uint8_t cycleCost = unprefixedOpcodes[ opcode ].cycleCosts[ 0 ];
+        for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+        {
+            //FK: Same side effects as the opcode fetch of executeSingleInstruction()
+            GBEmulatorInstance* pLane = pGroup->ppLanes[ laneIndex ];
+            const uint16_t opcodeAddress = pLane->cpuState.registers.PC++;
+            pLane->memoryMapper.memoryAccess        = GBMemoryAccess_Read;
+            pLane->memoryMapper.lastAddressReadFrom = opcodeAddress;
+            addOpcodeToOpcodeHistory( pLane, opcodeAddress, opcode );
+
+            finishSingleInstruction( pLane, cycleCost );
+            pOutCycleCosts[ laneIndex ] = cycleCost;
+        }
+
+        ++pGroup->stats.vectorizedStepCount;
+    }
+    else
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+        {
+            GBEmulatorInstance* pLane = pGroup->ppLanes[ laneIndex ];
+            pOutCycleCosts[ laneIndex ] = executeSingleInstruction( pLane );
+            finishSingleInstruction( pLane, pOutCycleCosts[ laneIndex ] );
+        }
+    }
+
+    pGroup->stats.convergedStepCount += converged;
+}
+
+//FK: Equivalent to calling runGBEmulatorForCycles() for each lane. Lanes that diverged can finish at different steps,
+//    the lanes that already ran for cycleCountToRunFor cycles run the scalar path until all lanes are done.
+void runGBLockstepGroupForCycles( GBLockstepGroup* pGroup, const uint32_t cycleCountToRunFor, GBEmulatorInstanceEventMask* pOutEventMasks )
+{
+    uint32_t laneCycleCounters[ gbLockstepMaxLaneCount ];
+    uint32_t laneJoypadAccessCounts[ gbLockstepMaxLaneCount ];
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        pGroup->ppLanes[ laneIndex ]->flags.value = 0;
+        laneCycleCounters[ laneIndex ] = 0u;
+        laneJoypadAccessCounts[ laneIndex ] = getGBEmulatorJoypadAccessCount( pGroup->ppLanes[ laneIndex ] );
+    }
+
+    bool8_t allLanesRunning = 1u;
+    while( allLanesRunning )
+    {
+        uint8_t cycleCosts[ gbLockstepMaxLaneCount ];
+        stepGBLockstepGroup( pGroup, cycleCosts );
+
+        for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+        {
+            laneCycleCounters[ laneIndex ] += cycleCosts[ laneIndex ];
+            allLanesRunning &= laneCycleCounters[ laneIndex ] < cycleCountToRunFor;
+        }
+    }
+
+    for( uint32_t laneIndex = 0u; laneIndex < pGroup->laneCount; ++laneIndex )
+    {
+        GBEmulatorInstance* pLane = pGroup->ppLanes[ laneIndex ];
+        while( laneCycleCounters[ laneIndex ] < cycleCountToRunFor )
+        {
+            laneCycleCounters[ laneIndex ] += runSingleInstruction( pLane );
+        }
+
+        pOutEventMasks[ laneIndex ] = collectGBEmulatorRunEvents( pLane, laneJoypadAccessCounts[ laneIndex ] );
+    }
+}
+
+GBLockstepStats getGBLockstepStats( const GBLockstepGroup* pGroup )
+{
+    return pGroup->stats;
+}
+
+#endif //K15_GB_LOCKSTEP
@@ -0,0 +1,702 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_MOVIE
+#define K15_GB_MOVIE
+
+//FK: Input movies record the joypad state of every frame (a frame being runGBEmulatorForCycles( pInstance, gbCyclesPerFrame )) and play them back.
+//    Layout of a movie (see writeGBMovie()):
+//      GBMovieHeader | start state | input runs | keyframe index | keyframe data | frame hashes
+//    - The start state is a regular save state (see storeGBEmulatorState()). Recording and playback both reset the instance and load it,
+//      so the instance starts from exactly the same state in both cases.
+//    - The joypad state of each frame is stored as a single byte, runs of frames with the same joypad state are stored as a single GBMovieInputRun.
+//    - Every keyframeInterval frames a keyframe gets stored (an LZ compressed snapshot plus the framebuffers) so that seeking only needs to replay
+//      the frames after the nearest keyframe. Just like snapshots, keyframes are only valid for the same emulator build (detected using
+//      keyframeLayoutHash, see calculateGBMovieKeyframeLayoutHash()) - playback of a movie with incompatible keyframes replays from the start state instead.
+//    - Optionally a hash of the framebuffer after each frame is stored, so that playback can verify that it shows the same frames.
+
+static constexpr uint32_t   gbMovieFourCC                   = FourCC( 'K', 'G', 'B', 'M' );
+static constexpr uint32_t   gbMovieVersion                  = 1u;
+static constexpr uint32_t   gbMovieDefaultKeyframeInterval  = 600u; //FK: 10 seconds
+static constexpr uint32_t   gbMovieMaxInputRunFrameCount    = 255u;
+static constexpr uint32_t   gbMovieSeekRenderedFrameCount   = 2u;   //FK: The shown frame starts during the frame before the last one
+
+enum GBMovieLoadResult
+{
+    K15_GB_MOVIE_LOAD_SUCCESS = 0,
+    K15_GB_MOVIE_LOAD_FAILED_OLD_VERSION,
+    K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA,
+    K15_GB_MOVIE_LOAD_FAILED_WRONG_ROM
+};
+
+struct GBMovieHeader
+{
+    uint32_t    fourCC;
+    uint32_t    version;
+    uint64_t    romHash;                    //FK: calculateGBMemoryHash() of the whole rom
+    uint64_t    keyframeLayoutHash;         //FK: calculateGBMovieKeyframeLayoutHash() of the build that recorded the movie
+    uint32_t    romSizeInBytes;
+    uint32_t    frameCount;
+    uint32_t    frameHashCount;             //FK: Either 0 or frameCount
+    uint32_t    inputRunCount;
+    uint32_t    keyframeInterval;
+    uint32_t    keyframeCount;
+    uint32_t    keyframeSizeInBytes;        //FK: Uncompressed size
+    uint32_t    keyframeDataSizeInBytes;
+    uint32_t    startStateSizeInBytes;
+};
+
+struct GBMovieInputRun
+{
+    uint8_t     joypadValue;                //FK: Action buttons in the lower, dpad buttons in the upper 4 bits
+    uint8_t     frameCount;
+};
+
+struct GBMovieKeyframe
+{
+    uint32_t    dataOffset;                 //FK: Relative to the start of the keyframe data
+    uint32_t    sizeInBytes;
+    uint32_t    inputRunIndex;              //FK: Input run of the first frame after the keyframe
+    uint32_t    inputRunFrameIndex;         //FK: Position of that frame within the input run
+};
+
+//FK: View of a movie in memory (see openGBMovie()), the sections aren't necessarily aligned so they get read using memcpy.
+struct GBMovie
+{
+    GBMovieHeader           header;
+    const uint8_t*          pStartState;
+    const GBMovieInputRun*  pInputRuns;
+    const uint8_t*          pKeyframes;
+    const uint8_t*          pKeyframeData;
+    const uint8_t*          pFrameHashes;   //FK: nullptr if the movie doesn't contain frame hashes
+};
+
+struct GBMovieRecorder
+{
+    GBEmulatorInstance*     pInstance;
+    uint64_t*               pFrameHashes;   //FK: nullptr if frame hashes aren't recorded
+    GBMovieKeyframe*        pKeyframes;
+    GBMovieInputRun*        pInputRuns;
+    uint8_t*                pStartState;
+    uint8_t*                pKeyframe;      //FK: Uncompressed keyframe
+    uint8_t*                pKeyframeData;
+
+    uint64_t                romHash;
+    size_t                  keyframeSizeInBytes;
+    size_t                  keyframeDataSizeInBytes;
+    size_t                  startStateSizeInBytes;
+
+    uint32_t                frameCapacity;
+    uint32_t                frameCount;
+    uint32_t                inputRunCount;
+    uint32_t                keyframeInterval;
+    uint32_t                keyframeCount;
+};
+
+struct GBMoviePlayerStats
+{
+    uint32_t    playedFrameCount;           //FK: Frames run by runGBMoviePlayerFrame()
+    uint32_t    replayedFrameCount;         //FK: Frames run while seeking
+    uint32_t    keyframeRestoreCount;
+    uint32_t    verifiedFrameCount;
+    uint32_t    mismatchingFrameCount;
+    uint32_t    firstMismatchingFrameIndex; //FK: Only valid if mismatchingFrameCount > 0
+};
+
+struct GBMoviePlayer
+{
+    GBEmulatorInstance*     pInstance;
+    uint8_t*                pKeyframe;      //FK: Uncompressed keyframe
+    GBMovie                 movie;
+    GBMoviePlayerStats      stats;
+    size_t                  keyframeSizeInBytes;
+    uint32_t                frameIndex;     //FK: Next frame to run
+    uint32_t                inputRunIndex;
+    uint32_t                inputRunFrameIndex;
+    bool8_t                 keyframesUsable;
+    bool8_t                 verifyFrameHashes;
+};
+
+uint8_t packGBMovieJoypadState( const GBEmulatorJoypadState joypadState )
+{
+    return ( uint8_t )( ( joypadState.actionButtonMask & 0x0F ) | ( joypadState.dpadButtonMask << 4u ) );
+}
+
+GBEmulatorJoypadState unpackGBMovieJoypadState( const uint8_t joypadValue )
+{
+    GBEmulatorJoypadState joypadState;
+    joypadState.actionButtonMask    = joypadValue & 0x0F;
+    joypadState.dpadButtonMask      = joypadValue >> 4u;
+    return joypadState;
+}
+
+uint64_t calculateGBMovieRomHash( const GBEmulatorInstance* pInstance )
+{
+    const GBCartridge* pCartridge = &pInstance->cartridge;
+    return calculateGBMemoryHash( pCartridge->pRomBaseAddress, pCartridge->romSizeInBytes );
+}
+
+uint64_t calculateGBMovieFrameHash( GBEmulatorInstance* pInstance )
+{
+    return calculateGBMemoryHash( getGBEmulatorFrameBuffer( pInstance ), gbFrameBufferSizeInBytes );
+}
+
+//FK: A keyframe is a snapshot followed by the framebuffers, so that the frame shown after seeking is correct right away
+size_t calculateGBMovieKeyframeSizeInBytes( const GBEmulatorInstance* pInstance )
+{
+    return calculateGBEmulatorSnapshotSizeInBytes( pInstance ) + sizeof( pInstance->gbFrameBuffers );
+}
+
+//FK: Keyframes are raw snapshots, so they can only be restored by a build with the same layout of the snapshotted structs
+uint64_t calculateGBMovieKeyframeLayoutHash()
+{
+    const uint32_t layout[] =
+    {
+        ( uint32_t )sizeof( void* ),
+        ( uint32_t )sizeof( GBEmulatorSnapshotHeader ),
+        ( uint32_t )offsetof( GBEmulatorInstance, cpuState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, apuState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, ppuState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, timerState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, serialState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, inputPollState ),
+        ( uint32_t )offsetof( GBEmulatorInstance, cartridge ),
+        ( uint32_t )offsetof( GBEmulatorInstance, memoryMapper ),
+        ( uint32_t )offsetof( GBMemoryMapper, memory ),
+        ( uint32_t )calculateGBEmulatorSubStateSizeInBytes(),
+        ( uint32_t )gbMappedMemorySizeInBytes,
+        ( uint32_t )gbFrameBufferCount,
+        ( uint32_t )gbFrameBufferSizeInBytes
+    };
+
+    return calculateGBMemoryHash( ( const uint8_t* )layout, sizeof( layout ) );
+}
+
+bool8_t areGBMovieKeyframesCompatible( const GBMovieHeader* pHeader, const GBEmulatorInstance* pInstance )
+{
+    return pHeader->keyframeLayoutHash == calculateGBMovieKeyframeLayoutHash() && pHeader->keyframeSizeInBytes == calculateGBMovieKeyframeSizeInBytes( pInstance );
+}
+
+uint32_t calculateGBMovieKeyframeCapacity( const uint32_t frameCapacity, const uint32_t keyframeInterval )
+{
+    return frameCapacity / keyframeInterval + 1u;
+}
+
+//FK: Puts the instance into the start state of a movie. Resetting first makes sure that the parts of the instance that aren't part of
+//    save states are the same for recording and playback.
+GBStateLoadResult loadGBMovieStartState( GBEmulatorInstance* pInstance, const uint8_t* pStartState, const size_t startStateSizeInBytes )
+{
+    resetGBEmulator( pInstance );
+    const GBStateLoadResult result = loadGBEmulatorState( pInstance, pStartState, startStateSizeInBytes );
+
+    for( uint32_t frameBufferIndex = 0u; frameBufferIndex < gbFrameBufferCount; ++frameBufferIndex )
+    {
+        clearGBFrameBuffer( pInstance->gbFrameBuffers[ frameBufferIndex ] );
+    }
+
+    pInstance->flags.value = 0;
+    return result;
+}
+
+void storeGBMovieKeyframe( GBEmulatorInstance* pInstance, uint8_t* pKeyframe )
+{
+    const size_t snapshotSizeInBytes = calculateGBEmulatorSnapshotSizeInBytes( pInstance );
+    snapshotGBEmulator( pInstance, pKeyframe );
+    memcpy( pKeyframe + snapshotSizeInBytes, pInstance->gbFrameBuffers, sizeof( pInstance->gbFrameBuffers ) );
+}
+
+GBStateLoadResult restoreGBMovieKeyframe( GBEmulatorInstance* pInstance, const uint8_t* pKeyframe )
+{
+    const size_t snapshotSizeInBytes = calculateGBEmulatorSnapshotSizeInBytes( pInstance );
+    const GBStateLoadResult result = restoreGBEmulator( pInstance, pKeyframe );
+    if( result == K15_GB_STATE_LOAD_SUCCESS )
+    {
+        memcpy( pInstance->gbFrameBuffers, pKeyframe + snapshotSizeInBytes, sizeof( pInstance->gbFrameBuffers ) );
+    }
+
+    return result;
+}
+
+//FK: The instance needs to have its rom loaded. keyframeInterval is in frames.
+size_t calculateGBMovieRecorderMemoryRequirementsInBytes( const GBEmulatorInstance* pInstance, const uint32_t frameCapacity, const uint32_t keyframeInterval, const bool8_t recordFrameHashes )
+{
+    const uint32_t keyframeCapacity = calculateGBMovieKeyframeCapacity( frameCapacity, keyframeInterval );
+    const size_t keyframeSizeInBytes = calculateGBMovieKeyframeSizeInBytes( pInstance );
+    const size_t frameHashesSizeInBytes = recordFrameHashes ? frameCapacity * sizeof( uint64_t ) : 0u;
+
+    return sizeof( GBMovieRecorder ) + frameHashesSizeInBytes + keyframeCapacity * sizeof( GBMovieKeyframe ) + frameCapacity * sizeof( GBMovieInputRun ) +
+        calculateGBEmulatorStateSizeInBytes( pInstance ) + keyframeSizeInBytes + keyframeCapacity * calculateCompressedMemoryBoundLZ( keyframeSizeInBytes );
+}
+
+//FK: Recording starts from the current state of the instance, or from power on if startFromPowerOn is set (the cartridge ram is kept in both cases
+//    and becomes part of the start state). Returns nullptr if the start state couldn't be loaded back into the instance.
+GBMovieRecorder* createGBMovieRecorder( uint8_t* pRecorderMemory, GBEmulatorInstance* pInstance, const uint32_t frameCapacity, const uint32_t keyframeInterval,
+    const bool8_t recordFrameHashes, const bool8_t startFromPowerOn )
+{
+    RuntimeAssert( isGBEmulatorRomMapped( pInstance ) );
+    RuntimeAssert( frameCapacity > 0u );
+    RuntimeAssert( keyframeInterval > 0u );
+
+    const uint32_t keyframeCapacity = calculateGBMovieKeyframeCapacity( frameCapacity, keyframeInterval );
+
+    GBMovieRecorder* pRecorder = ( GBMovieRecorder* )pRecorderMemory;
+    memset( pRecorder, 0, sizeof( GBMovieRecorder ) );
+
+    //FK: Ordered by alignment
+    uint8_t* pMemory = pRecorderMemory + sizeof( GBMovieRecorder );
+    if( recordFrameHashes )
+    {
+        pRecorder->pFrameHashes = ( uint64_t* )pMemory;
+        pMemory += frameCapacity * sizeof( uint64_t );
+    }
+
+    pRecorder->pKeyframes               = ( GBMovieKeyframe* )pMemory;
+    pMemory += keyframeCapacity * sizeof( GBMovieKeyframe );
+
+    pRecorder->pInputRuns               = ( GBMovieInputRun* )pMemory;
+    pMemory += frameCapacity * sizeof( GBMovieInputRun );
+
+    pRecorder->pStartState              = pMemory;
+    pMemory += calculateGBEmulatorStateSizeInBytes( pInstance );
+
+    pRecorder->keyframeSizeInBytes      = calculateGBMovieKeyframeSizeInBytes( pInstance );
+    pRecorder->pKeyframe                = pMemory;
+    pRecorder->pKeyframeData            = pMemory + pRecorder->keyframeSizeInBytes;
+
+    pRecorder->pInstance                = pInstance;
+    pRecorder->romHash                  = calculateGBMovieRomHash( pInstance );
+    pRecorder->frameCapacity            = frameCapacity;
+    pRecorder->keyframeInterval         = keyframeInterval;
+
+    if( startFromPowerOn )
+    {
+        resetGBEmulator( pInstance );
+    }
+
+    pRecorder->startStateSizeInBytes    = storeGBEmulatorState( pInstance, pRecorder->pStartState, calculateGBEmulatorStateSizeInBytes( pInstance ) );
+
+    if( loadGBMovieStartState( pInstance, pRecorder->pStartState, pRecorder->startStateSizeInBytes ) != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        return nullptr;
+    }
+
+    return pRecorder;
+}
+
+bool8_t isGBMovieRecorderFull( const GBMovieRecorder* pRecorder )
+{
+    return pRecorder->frameCount == pRecorder->frameCapacity;
+}
+
+uint32_t getGBMovieRecorderFrameCount( const GBMovieRecorder* pRecorder )
+{
+    return pRecorder->frameCount;
+}
+
+void addGBMovieRecorderInput( GBMovieRecorder* pRecorder, const uint8_t joypadValue )
+{
+    if( pRecorder->inputRunCount > 0u )
+    {
+        GBMovieInputRun* pLastInputRun = pRecorder->pInputRuns + pRecorder->inputRunCount - 1u;
+        if( pLastInputRun->joypadValue == joypadValue && pLastInputRun->frameCount < gbMovieMaxInputRunFrameCount )
+        {
+            ++pLastInputRun->frameCount;
+            return;
+        }
+    }
+
+    GBMovieInputRun* pInputRun = pRecorder->pInputRuns + pRecorder->inputRunCount++;
+    pInputRun->joypadValue  = joypadValue;
+    pInputRun->frameCount   = 1u;
+}
+
+//FK: Called after the input of the first frame after the keyframe got added
+void addGBMovieRecorderKeyframe( GBMovieRecorder* pRecorder )
+{
+    const GBMovieInputRun* pLastInputRun = pRecorder->pInputRuns + pRecorder->inputRunCount - 1u;
+
+    GBMovieKeyframe* pKeyframe = pRecorder->pKeyframes + pRecorder->keyframeCount++;
+    pKeyframe->dataOffset           = ( uint32_t )pRecorder->keyframeDataSizeInBytes;
+    pKeyframe->inputRunIndex        = pRecorder->inputRunCount - 1u;
+    pKeyframe->inputRunFrameIndex   = pLastInputRun->frameCount - 1u;
+
+    storeGBMovieKeyframe( pRecorder->pInstance, pRecorder->pKeyframe );
+    pKeyframe->sizeInBytes = ( uint32_t )compressMemoryBlockLZ( pRecorder->pKeyframeData + pKeyframe->dataOffset, pRecorder->pKeyframe, pRecorder->keyframeSizeInBytes );
+    pRecorder->keyframeDataSizeInBytes += pKeyframe->sizeInBytes;
+}
+
+//FK: Call instead of runGBEmulatorForCycles( pInstance, gbCyclesPerFrame ), returns its event mask.
+//    Only the joypad state passed here is recorded (an input queue set using setGBEmulatorInputQueue() would break playback).
+GBEmulatorInstanceEventMask runGBMovieRecorderFrame( GBMovieRecorder* pRecorder, const GBEmulatorJoypadState joypadState )
+{
+    RuntimeAssert( !isGBMovieRecorderFull( pRecorder ) );
+    RuntimeAssert( pRecorder->pInstance->pInputQueue == nullptr );
+
+    GBEmulatorInstance* pInstance = pRecorder->pInstance;
+    const uint8_t joypadValue = packGBMovieJoypadState( joypadState );
+    addGBMovieRecorderInput( pRecorder, joypadValue );
+
+    if( pRecorder->frameCount % pRecorder->keyframeInterval == 0u )
+    {
+        addGBMovieRecorderKeyframe( pRecorder );
+    }
+
+    //FK: Only the recorded buttons are applied, so that recording and playback see the exact same joypad state
+    setGBEmulatorJoypadState( pInstance, unpackGBMovieJoypadState( joypadValue ) );
+
+    const GBEmulatorInstanceEventMask eventMask = runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+    if( pRecorder->pFrameHashes != nullptr )
+    {
+        pRecorder->pFrameHashes[ pRecorder->frameCount ] = calculateGBMovieFrameHash( pInstance );
+    }
+
+    ++pRecorder->frameCount;
+    return eventMask;
+}
+
+size_t calculateGBMovieSizeInBytes( const GBMovieRecorder* pRecorder )
+{
+    const size_t frameHashesSizeInBytes = pRecorder->pFrameHashes != nullptr ? pRecorder->frameCount * sizeof( uint64_t ) : 0u;
+    return sizeof( GBMovieHeader ) + pRecorder->startStateSizeInBytes + pRecorder->inputRunCount * sizeof( GBMovieInputRun ) +
+        pRecorder->keyframeCount * sizeof( GBMovieKeyframe ) + pRecorder->keyframeDataSizeInBytes + frameHashesSizeInBytes;
+}
+
+//FK: Writes the frames recorded so far, pMovieMemory has to be able to hold calculateGBMovieSizeInBytes() bytes. Returns the number of bytes written.
+//    Recording can continue afterwards.
+size_t writeGBMovie( const GBMovieRecorder* pRecorder, uint8_t* pMovieMemory )
+{
+    GBMovieHeader header;
+    memset( &header, 0, sizeof( header ) );
+    header.fourCC                   = gbMovieFourCC;
+    header.version                  = gbMovieVersion;
+    header.romHash                  = pRecorder->romHash;
+    header.keyframeLayoutHash       = calculateGBMovieKeyframeLayoutHash();
+    header.romSizeInBytes           = pRecorder->pInstance->cartridge.romSizeInBytes;
+    header.frameCount               = pRecorder->frameCount;
+    header.frameHashCount           = pRecorder->pFrameHashes != nullptr ? pRecorder->frameCount : 0u;
+    header.inputRunCount            = pRecorder->inputRunCount;
+    header.keyframeInterval         = pRecorder->keyframeInterval;
+    header.keyframeCount            = pRecorder->keyframeCount;
+    header.keyframeSizeInBytes      = ( uint32_t )pRecorder->keyframeSizeInBytes;
+    header.keyframeDataSizeInBytes  = ( uint32_t )pRecorder->keyframeDataSizeInBytes;
+    header.startStateSizeInBytes    = ( uint32_t )pRecorder->startStateSizeInBytes;
+
+    uint8_t* pMovieMemoryStart = pMovieMemory;
+    memcpy( pMovieMemory, &header, sizeof( header ) );
+    pMovieMemory += sizeof( header );
+
+    memcpy( pMovieMemory, pRecorder->pStartState, pRecorder->startStateSizeInBytes );
+    pMovieMemory += pRecorder->startStateSizeInBytes;
+
+    memcpy( pMovieMemory, pRecorder->pInputRuns, header.inputRunCount * sizeof( GBMovieInputRun ) );
+    pMovieMemory += header.inputRunCount * sizeof( GBMovieInputRun );
+
+    memcpy( pMovieMemory, pRecorder->pKeyframes, header.keyframeCount * sizeof( GBMovieKeyframe ) );
+    pMovieMemory += header.keyframeCount * sizeof( GBMovieKeyframe );
+
+    memcpy( pMovieMemory, pRecorder->pKeyframeData, header.keyframeDataSizeInBytes );
+    pMovieMemory += header.keyframeDataSizeInBytes;
+
+    if( header.frameHashCount > 0u )
+    {
+        memcpy( pMovieMemory, pRecorder->pFrameHashes, header.frameHashCount * sizeof( uint64_t ) );
+        pMovieMemory += header.frameHashCount * sizeof( uint64_t );
+    }
+
+    return ( size_t )( pMovieMemory - pMovieMemoryStart );
+}
+
+GBMovieKeyframe getGBMovieKeyframe( const GBMovie* pMovie, const uint32_t keyframeIndex )
+{
+    GBMovieKeyframe keyframe;
+    memcpy( &keyframe, pMovie->pKeyframes + keyframeIndex * sizeof( GBMovieKeyframe ), sizeof( GBMovieKeyframe ) );
+    return keyframe;
+}
+
+GBMovieLoadResult convertGBStateLoadResultToGBMovieLoadResult( const GBStateLoadResult result )
+{
+    switch( result )
+    {
+        case K15_GB_STATE_LOAD_SUCCESS:
+            return K15_GB_MOVIE_LOAD_SUCCESS;
+        case K15_GB_STATE_LOAD_FAILED_OLD_VERSION:
+            return K15_GB_MOVIE_LOAD_FAILED_OLD_VERSION;
+        case K15_GB_STATE_LOAD_FAILED_WRONG_ROM:
+            return K15_GB_MOVIE_LOAD_FAILED_WRONG_ROM;
+        default:
+            return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+}
+
+//FK: Every keyframe has to lie within the keyframe data and point to the input run position of frame keyframeIndex * keyframeInterval.
+//    The compressed data is only checked if the keyframes can be restored by this build (see areGBMovieKeyframesCompatible()).
+bool8_t validateGBMovieKeyframes( const GBMovie* pMovie, const GBEmulatorInstance* pInstance )
+{
+    const GBMovieHeader* pHeader = &pMovie->header;
+    const bool8_t keyframesCompatible = areGBMovieKeyframesCompatible( pHeader, pInstance );
+
+    uint32_t inputRunIndex = 0u;
+    uint64_t inputRunStartFrameIndex = 0u;
+    for( uint32_t keyframeIndex = 0u; keyframeIndex < pHeader->keyframeCount; ++keyframeIndex )
+    {
+        const GBMovieKeyframe keyframe = getGBMovieKeyframe( pMovie, keyframeIndex );
+        if( keyframe.dataOffset > pHeader->keyframeDataSizeInBytes || keyframe.sizeInBytes > pHeader->keyframeDataSizeInBytes - keyframe.dataOffset ||
+            keyframe.inputRunIndex >= pHeader->inputRunCount || keyframe.inputRunIndex < inputRunIndex )
+        {
+            return 0u;
+        }
+
+        while( inputRunIndex < keyframe.inputRunIndex )
+        {
+            inputRunStartFrameIndex += pMovie->pInputRuns[ inputRunIndex++ ].frameCount;
+        }
+
+        if( keyframe.inputRunFrameIndex >= pMovie->pInputRuns[ inputRunIndex ].frameCount ||
+            inputRunStartFrameIndex + keyframe.inputRunFrameIndex != ( uint64_t )keyframeIndex * pHeader->keyframeInterval )
+        {
+            return 0u;
+        }
+
+        if( keyframesCompatible && calculateUncompressedMemoryBlockSizeLZ( pMovie->pKeyframeData + keyframe.dataOffset, keyframe.sizeInBytes, pHeader->keyframeSizeInBytes ) != pHeader->keyframeSizeInBytes )
+        {
+            return 0u;
+        }
+    }
+
+    return 1u;
+}
+
+//FK: Checks the movie against the rom loaded by pInstance. pMovieMemory is untrusted (eg: a file from disk), the sections, input runs, keyframe index
+//    and the start state (see validateGBEmulatorState()) get validated here. The contents of a keyframe get validated when seeking restores it
+//    (see isGBEmulatorSnapshotSubStateValid()), since that needs the uncompressed keyframe. pMovieMemory is referenced by pOutMovie and has to stay
+//    alive as long as the movie is used.
+GBMovieLoadResult openGBMovie( GBMovie* pOutMovie, const uint8_t* pMovieMemory, const size_t movieSizeInBytes, const GBEmulatorInstance* pInstance )
+{
+    RuntimeAssert( isGBEmulatorRomMapped( pInstance ) );
+
+    if( movieSizeInBytes < sizeof( GBMovieHeader ) )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    GBMovieHeader header;
+    memcpy( &header, pMovieMemory, sizeof( header ) );
+    if( header.fourCC != gbMovieFourCC )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    if( header.version < gbMovieVersion )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_OLD_VERSION;
+    }
+
+    const uint64_t sectionSizeInBytes = ( uint64_t )header.startStateSizeInBytes + ( uint64_t )header.inputRunCount * sizeof( GBMovieInputRun ) +
+        ( uint64_t )header.keyframeCount * sizeof( GBMovieKeyframe ) + header.keyframeDataSizeInBytes + ( uint64_t )header.frameHashCount * sizeof( uint64_t );
+    if( header.version != gbMovieVersion || sizeof( GBMovieHeader ) + sectionSizeInBytes > movieSizeInBytes || header.startStateSizeInBytes == 0u ||
+        header.keyframeInterval == 0u || ( header.frameHashCount != 0u && header.frameHashCount != header.frameCount ) )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    if( header.romSizeInBytes != pInstance->cartridge.romSizeInBytes || header.romHash != calculateGBMovieRomHash( pInstance ) )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_WRONG_ROM;
+    }
+
+    pOutMovie->header           = header;
+    pOutMovie->pStartState      = pMovieMemory + sizeof( GBMovieHeader );
+    pOutMovie->pInputRuns       = ( const GBMovieInputRun* )( pOutMovie->pStartState + header.startStateSizeInBytes );
+    pOutMovie->pKeyframes       = ( const uint8_t* )( pOutMovie->pInputRuns + header.inputRunCount );
+    pOutMovie->pKeyframeData    = pOutMovie->pKeyframes + header.keyframeCount * sizeof( GBMovieKeyframe );
+    pOutMovie->pFrameHashes     = header.frameHashCount > 0u ? pOutMovie->pKeyframeData + header.keyframeDataSizeInBytes : nullptr;
+
+    //FK: The frame count of the runs has to match the frame count of the header, otherwise playback would read past the input runs.
+    //    Empty runs are never written and would make playback skip the run without running a frame.
+    uint64_t inputFrameCount = 0u;
+    for( uint32_t inputRunIndex = 0u; inputRunIndex < header.inputRunCount; ++inputRunIndex )
+    {
+        const uint8_t inputRunFrameCount = pOutMovie->pInputRuns[ inputRunIndex ].frameCount;
+        if( inputRunFrameCount == 0u )
+        {
+            return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        }
+
+        inputFrameCount += inputRunFrameCount;
+    }
+
+    if( inputFrameCount != header.frameCount || !validateGBMovieKeyframes( pOutMovie, pInstance ) )
+    {
+        return K15_GB_MOVIE_LOAD_FAILED_INCOMPATIBLE_DATA;
+    }
+
+    return convertGBStateLoadResultToGBMovieLoadResult( validateGBEmulatorState( pInstance, pOutMovie->pStartState, header.startStateSizeInBytes ) );
+}
+
+uint64_t getGBMovieFrameHash( const GBMovie* pMovie, const uint32_t frameIndex )
+{
+    uint64_t frameHash;
+    memcpy( &frameHash, pMovie->pFrameHashes + frameIndex * sizeof( uint64_t ), sizeof( uint64_t ) );
+    return frameHash;
+}
+
+//FK: Writes the joypad state of every frame, pOutJoypadStates needs to be able to hold header.frameCount entries
+void unpackGBMovieInput( const GBMovie* pMovie, GBEmulatorJoypadState* pOutJoypadStates )
+{
+    for( uint32_t inputRunIndex = 0u; inputRunIndex < pMovie->header.inputRunCount; ++inputRunIndex )
+    {
+        const GBMovieInputRun inputRun = pMovie->pInputRuns[ inputRunIndex ];
+        for( uint32_t frameIndex = 0u; frameIndex < inputRun.frameCount; ++frameIndex )
+        {
+            *pOutJoypadStates++ = unpackGBMovieJoypadState( inputRun.joypadValue );
+        }
+    }
+}
+
+//FK: The instance needs to have the rom of the movie loaded
+size_t calculateGBMoviePlayerMemoryRequirementsInBytes( const GBEmulatorInstance* pInstance )
+{
+    return sizeof( GBMoviePlayer ) + calculateGBMovieKeyframeSizeInBytes( pInstance );
+}
+
+//FK: Puts pInstance into the start state of the movie. The movie has to be opened using openGBMovie() with the same instance.
+//    *ppOutPlayer is only valid if K15_GB_STATE_LOAD_SUCCESS is returned.
+GBStateLoadResult createGBMoviePlayer( GBMoviePlayer** ppOutPlayer, uint8_t* pPlayerMemory, GBEmulatorInstance* pInstance, const GBMovie* pMovie )
+{
+    GBMoviePlayer* pPlayer = ( GBMoviePlayer* )pPlayerMemory;
+    memset( pPlayer, 0, sizeof( GBMoviePlayer ) );
+
+    pPlayer->pInstance              = pInstance;
+    pPlayer->pKeyframe              = pPlayerMemory + sizeof( GBMoviePlayer );
+    pPlayer->movie                  = *pMovie;
+    pPlayer->keyframeSizeInBytes    = calculateGBMovieKeyframeSizeInBytes( pInstance );
+    pPlayer->keyframesUsable        = pMovie->header.keyframeCount > 0u && areGBMovieKeyframesCompatible( &pMovie->header, pInstance );
+
+    *ppOutPlayer = pPlayer;
+    return loadGBMovieStartState( pInstance, pMovie->pStartState, pMovie->header.startStateSizeInBytes );
+}
+
+//FK: Compares the framebuffer after each frame run by runGBMoviePlayerFrame() with the recorded hash (see getGBMoviePlayerStats()).
+//    Returns 0 if the movie doesn't contain frame hashes.
+bool8_t setGBMoviePlayerVerificationEnabled( GBMoviePlayer* pPlayer, const bool8_t verifyFrameHashes )
+{
+    pPlayer->verifyFrameHashes = verifyFrameHashes && pPlayer->movie.pFrameHashes != nullptr;
+    return pPlayer->verifyFrameHashes == verifyFrameHashes;
+}
+
+bool8_t isGBMoviePlayerFinished( const GBMoviePlayer* pPlayer )
+{
+    return pPlayer->frameIndex == pPlayer->movie.header.frameCount;
+}
+
+uint32_t getGBMoviePlayerFrameIndex( const GBMoviePlayer* pPlayer )
+{
+    return pPlayer->frameIndex;
+}
+
+GBEmulatorInstanceEventMask runGBMoviePlayerInstanceFrame( GBMoviePlayer* pPlayer )
+{
+    RuntimeAssert( !isGBMoviePlayerFinished( pPlayer ) );
+
+    const GBMovieInputRun inputRun = pPlayer->movie.pInputRuns[ pPlayer->inputRunIndex ];
+    setGBEmulatorJoypadState( pPlayer->pInstance, unpackGBMovieJoypadState( inputRun.joypadValue ) );
+
+    const GBEmulatorInstanceEventMask eventMask = runGBEmulatorForCycles( pPlayer->pInstance, gbCyclesPerFrame );
+    ++pPlayer->frameIndex;
+    if( ++pPlayer->inputRunFrameIndex == inputRun.frameCount )
+    {
+        ++pPlayer->inputRunIndex;
+        pPlayer->inputRunFrameIndex = 0u;
+    }
+
+    return eventMask;
+}
+
+//FK: Call instead of runGBEmulatorForCycles( pInstance, gbCyclesPerFrame ), returns its event mask
+GBEmulatorInstanceEventMask runGBMoviePlayerFrame( GBMoviePlayer* pPlayer )
+{
+    const uint32_t frameIndex = pPlayer->frameIndex;
+    const GBEmulatorInstanceEventMask eventMask = runGBMoviePlayerInstanceFrame( pPlayer );
+    ++pPlayer->stats.playedFrameCount;
+
+    if( pPlayer->verifyFrameHashes )
+    {
+        GBMoviePlayerStats* pStats = &pPlayer->stats;
+        if( calculateGBMovieFrameHash( pPlayer->pInstance ) != getGBMovieFrameHash( &pPlayer->movie, frameIndex ) )
+        {
+            pStats->firstMismatchingFrameIndex = pStats->mismatchingFrameCount == 0u ? frameIndex : pStats->firstMismatchingFrameIndex;
+            ++pStats->mismatchingFrameCount;
+        }
+
+        ++pStats->verifiedFrameCount;
+    }
+
+    return eventMask;
+}
+
+//FK: After seeking, frameIndex is the next frame to run (frameCount seeks to the end of the movie). Restores the nearest keyframe
+//    before frameIndex (or the start state) and replays the frames after it with rendering disabled - except for the last few frames, so the
+//    framebuffer shows the same frame as if the movie had been played up to frameIndex.
+//    Seeking forward without passing a keyframe just replays from the current frame. Returns the result of restoring the keyframe or the start state,
+//    a keyframe that can't be restored leaves the instance and the player untouched.
+GBStateLoadResult seekGBMoviePlayer( GBMoviePlayer* pPlayer, const uint32_t frameIndex )
+{
+    const GBMovie* pMovie = &pPlayer->movie;
+    RuntimeAssert( frameIndex <= pMovie->header.frameCount );
+
+    GBEmulatorInstance* pInstance = pPlayer->pInstance;
+    uint32_t keyframeIndex = frameIndex / pMovie->header.keyframeInterval;
+    keyframeIndex = keyframeIndex < pMovie->header.keyframeCount ? keyframeIndex : pMovie->header.keyframeCount - 1u;
+
+    const uint32_t keyframeFrameIndex = pPlayer->keyframesUsable ? keyframeIndex * pMovie->header.keyframeInterval : 0u;
+    const bool8_t restoreKeyframe = frameIndex < pPlayer->frameIndex || keyframeFrameIndex > pPlayer->frameIndex;
+    if( restoreKeyframe && pPlayer->keyframesUsable )
+    {
+        const GBMovieKeyframe keyframe = getGBMovieKeyframe( pMovie, keyframeIndex );
+        if( uncompressMemoryBlockLZ( pPlayer->pKeyframe, pPlayer->keyframeSizeInBytes, pMovie->pKeyframeData + keyframe.dataOffset, keyframe.sizeInBytes ) != pPlayer->keyframeSizeInBytes )
+        {
+            return K15_GB_STATE_LOAD_FAILED_INCOMPATIBLE_DATA;
+        }
+
+        const GBStateLoadResult result = restoreGBMovieKeyframe( pInstance, pPlayer->pKeyframe );
+        if( result != K15_GB_STATE_LOAD_SUCCESS )
+        {
+            return result;
+        }
+
+        pPlayer->frameIndex         = keyframeFrameIndex;
+        pPlayer->inputRunIndex      = keyframe.inputRunIndex;
+        pPlayer->inputRunFrameIndex = keyframe.inputRunFrameIndex;
+        ++pPlayer->stats.keyframeRestoreCount;
+    }
+    else if( restoreKeyframe )
+    {
+        const GBStateLoadResult result = loadGBMovieStartState( pInstance, pMovie->pStartState, pMovie->header.startStateSizeInBytes );
+        if( result != K15_GB_STATE_LOAD_SUCCESS )
+        {
+            return result;
+        }
+
+        pPlayer->frameIndex         = 0u;
+        pPlayer->inputRunIndex      = 0u;
+        pPlayer->inputRunFrameIndex = 0u;
+    }
+
+    while( pPlayer->frameIndex < frameIndex )
+    {
+        setGBEmulatorRenderingEnabled( pInstance, frameIndex - pPlayer->frameIndex <= gbMovieSeekRenderedFrameCount );
+        runGBMoviePlayerInstanceFrame( pPlayer );
+        ++pPlayer->stats.replayedFrameCount;
+    }
+
+    setGBEmulatorRenderingEnabled( pInstance, 1u );
+    return K15_GB_STATE_LOAD_SUCCESS;
+}
+
+GBMoviePlayerStats getGBMoviePlayerStats( const GBMoviePlayer* pPlayer )
+{
+    return pPlayer->stats;
+}
+
+#endif //K15_GB_MOVIE
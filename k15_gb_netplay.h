@@ -0,0 +1,642 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_NETPLAY
+#define K15_GB_NETPLAY
+
+#include <new>
+
+#include "k15_gb_link_cable.h"
+
+//FK: Rollback netplay for two players. Every player has its own gameboy, both gameboys are connected using the link cable
+//    and both peers simulate both gameboys. Local input gets applied right away (optionally delayed by a few frames), the input of the
+//    remote player is predicted by repeating the last input that has been received. Once the actual remote input for a frame arrives and
+//    it differs from the prediction, both instances are restored to the snapshot of that frame and re-simulated up to the current frame
+//    with rendering disabled. Checksums of confirmed frames are exchanged to detect desyncs.
+//
+//    Input only comes from advanceGBNetplayFrame(), the instances can't have an input queue attached (see setGBEmulatorInputQueue()) -
+//    its events would neither reach the remote peer nor survive a rollback.
+//
+//    The session itself doesn't do any networking - writeGBNetplayPacket() and receiveGBNetplayPacket() produce and consume packets.
+//    On Linux/macOS there's a small UDP transport at the end of this file that can also inject latency, jitter and packet loss.
+
+static constexpr uint32_t   gbNetplayPlayerCount                = 2u;
+static constexpr uint32_t   gbNetplayMaxRollbackFrameCount      = 16u;
+static constexpr uint32_t   gbNetplayMaxInputDelayFrameCount    = 8u;
+static constexpr uint32_t   gbNetplayFrameHistorySize           = 64u;      //FK: Needs to be a power of 2
+static constexpr uint32_t   gbNetplayMaxInputsPerPacket         = 32u;
+static constexpr uint32_t   gbNetplayPacketMagic                = FourCC( 'K', 'G', 'N', 'P' );
+static constexpr uint32_t   gbNetplayInvalidFrameIndex          = 0xFFFFFFFFu;
+static constexpr uint32_t   gbNetplayPacketHeaderSizeInBytes    = 4u * sizeof( uint32_t ) + sizeof( uint64_t ) + sizeof( uint8_t );
+static constexpr uint32_t   gbNetplayMaxPacketSizeInBytes       = gbNetplayPacketHeaderSizeInBytes + gbNetplayMaxInputsPerPacket;
+
+enum GBNetplayAdvanceResult : uint8_t
+{
+    K15_GB_NETPLAY_FRAME_ADVANCED = 0,
+    K15_GB_NETPLAY_WAITING_FOR_REMOTE       //FK: The remote player is too far behind, the local input of this call has been ignored
+};
+
+struct GBNetplaySettings
+{
+    uint32_t maxRollbackFrameCount      = 8u;   //FK: Frames the local player may run ahead of the last confirmed remote input
+    uint32_t inputDelayFrameCount       = 0u;   //FK: Local input gets applied this many frames later (fewer rollbacks, more latency)
+    uint32_t checksumInterval           = 4u;   //FK: Every n-th confirmed frame gets checksummed
+};
+
+struct GBNetplayStats
+{
+    uint64_t    rollbackCount;
+    uint64_t    resimulatedFrameCount;
+    uint64_t    waitingFrameCount;          //FK: Calls to advanceGBNetplayFrame() that returned K15_GB_NETPLAY_WAITING_FOR_REMOTE
+    uint64_t    comparedChecksumCount;
+    uint32_t    maxRollbackFrameCount;      //FK: Deepest rollback so far
+};
+
+//FK: Content of a packet. On the wire the members are stored in this order without padding, all values little endian
+//    (see writeGBNetplayPacket()), only the inputs that are in use get sent.
+struct GBNetplayPacket
+{
+    uint32_t    magic;
+    uint32_t    firstInputFrameIndex;       //FK: Frame of inputs[ 0 ]
+    uint32_t    ackFrameCount;              //FK: Number of frames the sender has received input for
+    uint32_t    checksumFrameIndex;         //FK: gbNetplayInvalidFrameIndex if there's no checksum yet
+    uint64_t    checksum;
+    uint8_t     inputCount;
+    uint8_t     inputs[ gbNetplayMaxInputsPerPacket ];     //FK: Same bit layout as the buttons of advanceGBNetplayFrame()
+};
+
+//FK: Start of every frame snapshot, followed by the snapshots of both instances
+struct GBNetplayFrameSnapshotHeader
+{
+    uint32_t    overshootCycles[ gbNetplayPlayerCount ];
+    uint64_t    checksum;                   //FK: Only calculated for frames that get checksummed (see checksumInterval)
+};
+
+struct GBNetplaySession
+{
+    GBEmulatorInstance*     pInstances[ gbNetplayPlayerCount ];
+    GBLinkCable             linkCable;
+    GBNetplaySettings       settings;
+    GBNetplayStats          stats;
+
+    uint8_t*                pSnapshotMemory;
+    size_t                  instanceSnapshotSizeInBytes[ gbNetplayPlayerCount ];
+    size_t                  frameSnapshotSizeInBytes;
+    uint32_t                snapshotCount;
+
+    uint32_t                localPlayerIndex;
+    uint32_t                frameIndex;                 //FK: Next frame to simulate
+    uint32_t                localInputFrameCount;       //FK: Number of frames with local input (frameIndex + inputDelayFrameCount)
+    uint32_t                remoteInputFrameCount;      //FK: Number of frames with remote input (received without gaps)
+    uint32_t                remoteAckFrameCount;        //FK: Number of frames of local input the remote player has received
+    uint32_t                rollbackFrameIndex;         //FK: First frame that has been simulated with a wrong prediction (frameIndex if there's none)
+    uint32_t                nextChecksumFrameIndex;
+    uint32_t                lastChecksumFrameIndex;
+    uint32_t                desyncFrameIndex;
+
+    uint8_t                 inputs[ gbNetplayPlayerCount ][ gbNetplayFrameHistorySize ];
+    uint8_t                 simulatedRemoteInputs[ gbNetplayFrameHistorySize ];     //FK: Remote input a frame has been simulated with
+    uint32_t                checksumFrameIndices[ gbNetplayFrameHistorySize ];
+    uint64_t                checksums[ gbNetplayFrameHistorySize ];
+    uint32_t                remoteChecksumFrameIndices[ gbNetplayFrameHistorySize ];
+    uint64_t                remoteChecksums[ gbNetplayFrameHistorySize ];
+};
+
+GBEmulatorJoypadState convertGBNetplayButtonsToJoypadState( const uint8_t buttons )
+{
+    GBEmulatorJoypadState joypadState;
+    joypadState.actionButtonMask    = buttons & 0x0F;
+    joypadState.dpadButtonMask      = buttons >> 4;
+    return joypadState;
+}
+
+//FK: Both instances need to have their rom loaded. The snapshot of a frame contains both instances and the link cable.
+size_t calculateGBNetplayFrameSnapshotSizeInBytes( GBEmulatorInstance* const* ppInstances )
+{
+    size_t frameSnapshotSizeInBytes = sizeof( GBNetplayFrameSnapshotHeader );
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        frameSnapshotSizeInBytes += calculateGBEmulatorSnapshotSizeInBytes( ppInstances[ playerIndex ] );
+    }
+
+    //FK: Keep every snapshot 64 byte aligned
+    return ( frameSnapshotSizeInBytes + 63u ) & ~( size_t )63u;
+}
+
+size_t calculateGBNetplaySessionMemoryRequirementsInBytes( GBEmulatorInstance* const* ppInstances, const GBNetplaySettings* pSettings )
+{
+    const uint32_t snapshotCount = pSettings->maxRollbackFrameCount + 1u;
+    return sizeof( GBNetplaySession ) + 64u + calculateGBNetplayFrameSnapshotSizeInBytes( ppInstances ) * snapshotCount;
+}
+
+//FK: Both peers have to create the session with the same roms loaded into the same instance order (instance 0 is player 0)
+//    and with the same settings. The instances get connected using the link cable of the session.
+GBNetplaySession* createGBNetplaySession( uint8_t* pSessionMemory, GBEmulatorInstance* const* ppInstances, const uint32_t localPlayerIndex, const GBNetplaySettings* pSettings )
+{
+    RuntimeAssert( localPlayerIndex < gbNetplayPlayerCount );
+    RuntimeAssert( pSettings->maxRollbackFrameCount > 0u && pSettings->maxRollbackFrameCount <= gbNetplayMaxRollbackFrameCount );
+    RuntimeAssert( pSettings->inputDelayFrameCount <= gbNetplayMaxInputDelayFrameCount );
+    RuntimeAssert( pSettings->checksumInterval > 0u );
+
+    GBNetplaySession* pSession = new( pSessionMemory ) GBNetplaySession();
+
+    const size_t snapshotOffset = ( ( size_t )( pSession + 1 ) + 63u ) & ~( size_t )63u;
+    pSession->pSnapshotMemory           = ( uint8_t* )snapshotOffset;
+    pSession->frameSnapshotSizeInBytes  = calculateGBNetplayFrameSnapshotSizeInBytes( ppInstances );
+    pSession->snapshotCount             = pSettings->maxRollbackFrameCount + 1u;
+    pSession->settings                  = *pSettings;
+    pSession->localPlayerIndex          = localPlayerIndex;
+    pSession->desyncFrameIndex          = gbNetplayInvalidFrameIndex;
+    pSession->lastChecksumFrameIndex    = gbNetplayInvalidFrameIndex;
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        pSession->pInstances[ playerIndex ] = ppInstances[ playerIndex ];
+        pSession->instanceSnapshotSizeInBytes[ playerIndex ] = calculateGBEmulatorSnapshotSizeInBytes( ppInstances[ playerIndex ] );
+    }
+
+    for( uint32_t historyIndex = 0u; historyIndex < gbNetplayFrameHistorySize; ++historyIndex )
+    {
+        pSession->checksumFrameIndices[ historyIndex ]          = gbNetplayInvalidFrameIndex;
+        pSession->remoteChecksumFrameIndices[ historyIndex ]    = gbNetplayInvalidFrameIndex;
+    }
+
+    //FK: The first frames don't have any local input because of the input delay
+    pSession->localInputFrameCount = pSettings->inputDelayFrameCount;
+
+    connectGBLinkCable( &pSession->linkCable, ppInstances[ 0 ], ppInstances[ 1 ] );
+    return pSession;
+}
+
+uint8_t* getGBNetplayFrameSnapshot( GBNetplaySession* pSession, const uint32_t frameIndex )
+{
+    return pSession->pSnapshotMemory + ( frameIndex % pSession->snapshotCount ) * pSession->frameSnapshotSizeInBytes;
+}
+
+//FK: Checksum of the current state of both instances at the start of frameIndex. Uses the state hashes (see calculateGBEmulatorStateHash()),
+//    so it only covers values that are the same on both peers and not the rom/ram pointers or padding of the peer.
+uint64_t calculateGBNetplayFrameChecksum( const GBNetplaySession* pSession, const uint32_t frameIndex )
+{
+    uint64_t values[ 1u + gbNetplayPlayerCount * 2u ];
+    values[ 0 ] = frameIndex;
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        GBStateHash stateHash;
+        calculateGBEmulatorStateHash( pSession->pInstances[ playerIndex ], &stateHash );
+        values[ 1u + playerIndex * 2u ] = pSession->linkCable.overshootCycles[ playerIndex ];
+        values[ 2u + playerIndex * 2u ] = stateHash.hash;
+    }
+
+    return calculateGBMemoryHash( ( const uint8_t* )values, sizeof( values ) );
+}
+
+void snapshotGBNetplayFrame( GBNetplaySession* pSession, const uint32_t frameIndex )
+{
+    uint8_t* pFrameSnapshot = getGBNetplayFrameSnapshot( pSession, frameIndex );
+
+    GBNetplayFrameSnapshotHeader* pHeader = ( GBNetplayFrameSnapshotHeader* )pFrameSnapshot;
+    memcpy( pHeader->overshootCycles, pSession->linkCable.overshootCycles, sizeof( pHeader->overshootCycles ) );
+    pHeader->checksum = frameIndex % pSession->settings.checksumInterval == 0u ? calculateGBNetplayFrameChecksum( pSession, frameIndex ) : 0u;
+    pFrameSnapshot += sizeof( GBNetplayFrameSnapshotHeader );
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        snapshotGBEmulator( pSession->pInstances[ playerIndex ], pFrameSnapshot );
+        pFrameSnapshot += pSession->instanceSnapshotSizeInBytes[ playerIndex ];
+    }
+}
+
+void restoreGBNetplayFrame( GBNetplaySession* pSession, const uint32_t frameIndex )
+{
+    const uint8_t* pFrameSnapshot = getGBNetplayFrameSnapshot( pSession, frameIndex );
+
+    const GBNetplayFrameSnapshotHeader* pHeader = ( const GBNetplayFrameSnapshotHeader* )pFrameSnapshot;
+    memcpy( pSession->linkCable.overshootCycles, pHeader->overshootCycles, sizeof( pSession->linkCable.overshootCycles ) );
+    pFrameSnapshot += sizeof( GBNetplayFrameSnapshotHeader );
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        restoreGBEmulator( pSession->pInstances[ playerIndex ], pFrameSnapshot );
+        pFrameSnapshot += pSession->instanceSnapshotSizeInBytes[ playerIndex ];
+    }
+}
+
+void compareGBNetplayChecksums( GBNetplaySession* pSession, const uint32_t historyIndex )
+{
+    if( pSession->checksumFrameIndices[ historyIndex ] == gbNetplayInvalidFrameIndex || pSession->checksumFrameIndices[ historyIndex ] != pSession->remoteChecksumFrameIndices[ historyIndex ] )
+    {
+        return;
+    }
+
+    ++pSession->stats.comparedChecksumCount;
+    if( pSession->checksums[ historyIndex ] != pSession->remoteChecksums[ historyIndex ] && pSession->desyncFrameIndex == gbNetplayInvalidFrameIndex )
+    {
+        pSession->desyncFrameIndex = pSession->checksumFrameIndices[ historyIndex ];
+    }
+}
+
+uint8_t getGBNetplayRemoteInput( const GBNetplaySession* pSession, const uint32_t frameIndex )
+{
+    const uint32_t remotePlayerIndex = 1u - pSession->localPlayerIndex;
+    if( frameIndex < pSession->remoteInputFrameCount )
+    {
+        return pSession->inputs[ remotePlayerIndex ][ frameIndex % gbNetplayFrameHistorySize ];
+    }
+
+    //FK: Prediction - the remote player keeps pressing whatever was pressed last
+    return pSession->remoteInputFrameCount > 0u ? pSession->inputs[ remotePlayerIndex ][ ( pSession->remoteInputFrameCount - 1u ) % gbNetplayFrameHistorySize ] : 0u;
+}
+
+void simulateGBNetplayFrame( GBNetplaySession* pSession, const uint32_t frameIndex, GBEmulatorInstanceEventMask* pOutEventMasks )
+{
+    const uint32_t historyIndex         = frameIndex % gbNetplayFrameHistorySize;
+    const uint32_t remotePlayerIndex    = 1u - pSession->localPlayerIndex;
+    const uint8_t remoteInput           = getGBNetplayRemoteInput( pSession, frameIndex );
+    pSession->simulatedRemoteInputs[ historyIndex ] = remoteInput;
+
+    setGBEmulatorJoypadState( pSession->pInstances[ pSession->localPlayerIndex ], convertGBNetplayButtonsToJoypadState( pSession->inputs[ pSession->localPlayerIndex ][ historyIndex ] ) );
+    setGBEmulatorJoypadState( pSession->pInstances[ remotePlayerIndex ], convertGBNetplayButtonsToJoypadState( remoteInput ) );
+    runGBLinkCableForCycles( &pSession->linkCable, gbCyclesPerFrame, pOutEventMasks );
+}
+
+void rollbackGBNetplaySession( GBNetplaySession* pSession )
+{
+    const uint32_t rollbackFrameCount = pSession->frameIndex - pSession->rollbackFrameIndex;
+    restoreGBNetplayFrame( pSession, pSession->rollbackFrameIndex );
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        setGBEmulatorRenderingEnabled( pSession->pInstances[ playerIndex ], 0u );
+    }
+
+    GBEmulatorInstanceEventMask eventMasks[ gbNetplayPlayerCount ];
+    for( uint32_t frameIndex = pSession->rollbackFrameIndex; frameIndex < pSession->frameIndex; ++frameIndex )
+    {
+        //FK: The snapshot of the first frame is still valid, only the inputs after it have changed
+        if( frameIndex != pSession->rollbackFrameIndex )
+        {
+            snapshotGBNetplayFrame( pSession, frameIndex );
+        }
+
+        simulateGBNetplayFrame( pSession, frameIndex, eventMasks );
+    }
+
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        setGBEmulatorRenderingEnabled( pSession->pInstances[ playerIndex ], 1u );
+    }
+
+    ++pSession->stats.rollbackCount;
+    pSession->stats.resimulatedFrameCount += rollbackFrameCount;
+    pSession->stats.maxRollbackFrameCount = GetMax( pSession->stats.maxRollbackFrameCount, rollbackFrameCount );
+    pSession->rollbackFrameIndex = pSession->frameIndex;
+}
+
+//FK: Frames whose start state only depends on confirmed inputs never change anymore
+void updateGBNetplayChecksums( GBNetplaySession* pSession )
+{
+    const uint32_t confirmedFrameCount = GetMin( pSession->remoteInputFrameCount, pSession->frameIndex );
+    for( ; pSession->nextChecksumFrameIndex < confirmedFrameCount; ++pSession->nextChecksumFrameIndex )
+    {
+        const uint32_t frameIndex = pSession->nextChecksumFrameIndex;
+        if( frameIndex % pSession->settings.checksumInterval != 0u || frameIndex + pSession->snapshotCount < pSession->frameIndex )
+        {
+            continue;
+        }
+
+        const uint32_t historyIndex = frameIndex % gbNetplayFrameHistorySize;
+        pSession->checksumFrameIndices[ historyIndex ]  = frameIndex;
+        pSession->checksums[ historyIndex ]             = ( ( const GBNetplayFrameSnapshotHeader* )getGBNetplayFrameSnapshot( pSession, frameIndex ) )->checksum;
+        pSession->lastChecksumFrameIndex                = frameIndex;
+        compareGBNetplayChecksums( pSession, historyIndex );
+    }
+}
+
+//FK: Call once per host frame with the buttons of the local player (same bit layout as GBEnvironmentAction: a, b, select, start, right, left, up, down).
+//    pOutEventMasks receives the event masks of both instances for the new frame.
+GBNetplayAdvanceResult advanceGBNetplayFrame( GBNetplaySession* pSession, const uint8_t localButtons, GBEmulatorInstanceEventMask* pOutEventMasks )
+{
+    RuntimeAssert( pSession->pInstances[ 0 ]->pInputQueue == nullptr && pSession->pInstances[ 1 ]->pInputQueue == nullptr );
+
+    if( pSession->rollbackFrameIndex < pSession->frameIndex )
+    {
+        rollbackGBNetplaySession( pSession );
+    }
+
+    //FK: Also wait if the remote player didn't acknowledge the local inputs for so long that they would drop out of the history
+    if( pSession->frameIndex >= pSession->remoteInputFrameCount + pSession->settings.maxRollbackFrameCount ||
+        pSession->localInputFrameCount - pSession->remoteAckFrameCount >= gbNetplayFrameHistorySize )
+    {
+        ++pSession->stats.waitingFrameCount;
+        return K15_GB_NETPLAY_WAITING_FOR_REMOTE;
+    }
+
+    pSession->inputs[ pSession->localPlayerIndex ][ pSession->localInputFrameCount % gbNetplayFrameHistorySize ] = localButtons;
+    ++pSession->localInputFrameCount;
+
+    snapshotGBNetplayFrame( pSession, pSession->frameIndex );
+    simulateGBNetplayFrame( pSession, pSession->frameIndex, pOutEventMasks );
+
+    ++pSession->frameIndex;
+    pSession->rollbackFrameIndex = pSession->frameIndex;
+
+    updateGBNetplayChecksums( pSession );
+    return K15_GB_NETPLAY_FRAME_ADVANCED;
+}
+
+//FK: Packet values are written byte by byte in little endian order, independent of the endianness of the host
+void writeGBNetplayPacketValue( uint8_t** ppPacketData, const uint64_t value, const uint32_t sizeInBytes )
+{
+    for( uint32_t byteIndex = 0u; byteIndex < sizeInBytes; ++byteIndex )
+    {
+        ( *ppPacketData )[ byteIndex ] = ( uint8_t )( value >> ( byteIndex * 8u ) );
+    }
+
+    *ppPacketData += sizeInBytes;
+}
+
+uint64_t readGBNetplayPacketValue( const uint8_t** ppPacketData, const uint32_t sizeInBytes )
+{
+    uint64_t value = 0u;
+    for( uint32_t byteIndex = 0u; byteIndex < sizeInBytes; ++byteIndex )
+    {
+        value |= ( uint64_t )( *ppPacketData )[ byteIndex ] << ( byteIndex * 8u );
+    }
+
+    *ppPacketData += sizeInBytes;
+    return value;
+}
+
+//FK: Writes up to gbNetplayMaxPacketSizeInBytes bytes to pOutPacketData and returns the number of bytes written. Contains all local inputs
+//    the remote player hasn't acknowledged yet (so lost packets don't have to be resent) and the checksum of the last confirmed frame.
+uint32_t writeGBNetplayPacket( const GBNetplaySession* pSession, uint8_t* pOutPacketData )
+{
+    const uint32_t inputCount = GetMin( pSession->localInputFrameCount - pSession->remoteAckFrameCount, gbNetplayMaxInputsPerPacket );
+    const uint64_t checksum = pSession->lastChecksumFrameIndex != gbNetplayInvalidFrameIndex ? pSession->checksums[ pSession->lastChecksumFrameIndex % gbNetplayFrameHistorySize ] : 0u;
+
+    uint8_t* pPacketData = pOutPacketData;
+    writeGBNetplayPacketValue( &pPacketData, gbNetplayPacketMagic, sizeof( uint32_t ) );
+    writeGBNetplayPacketValue( &pPacketData, pSession->remoteAckFrameCount, sizeof( uint32_t ) );       //FK: firstInputFrameIndex
+    writeGBNetplayPacketValue( &pPacketData, pSession->remoteInputFrameCount, sizeof( uint32_t ) );     //FK: ackFrameCount
+    writeGBNetplayPacketValue( &pPacketData, pSession->lastChecksumFrameIndex, sizeof( uint32_t ) );
+    writeGBNetplayPacketValue( &pPacketData, checksum, sizeof( uint64_t ) );
+    writeGBNetplayPacketValue( &pPacketData, inputCount, sizeof( uint8_t ) );
+
+    for( uint32_t inputIndex = 0u; inputIndex < inputCount; ++inputIndex )
+    {
+        const uint32_t frameIndex = pSession->remoteAckFrameCount + inputIndex;
+        *pPacketData++ = pSession->inputs[ pSession->localPlayerIndex ][ frameIndex % gbNetplayFrameHistorySize ];
+    }
+
+    return ( uint32_t )( pPacketData - pOutPacketData );
+}
+
+//FK: Returns 0 if the packet is invalid. Packets may arrive out of order or twice.
+bool8_t receiveGBNetplayPacket( GBNetplaySession* pSession, const uint8_t* pPacketData, const uint32_t packetSizeInBytes )
+{
+    if( packetSizeInBytes < gbNetplayPacketHeaderSizeInBytes || packetSizeInBytes > gbNetplayMaxPacketSizeInBytes )
+    {
+        return 0u;
+    }
+
+    GBNetplayPacket packet;
+    packet.magic                = ( uint32_t )readGBNetplayPacketValue( &pPacketData, sizeof( uint32_t ) );
+    packet.firstInputFrameIndex = ( uint32_t )readGBNetplayPacketValue( &pPacketData, sizeof( uint32_t ) );
+    packet.ackFrameCount        = ( uint32_t )readGBNetplayPacketValue( &pPacketData, sizeof( uint32_t ) );
+    packet.checksumFrameIndex   = ( uint32_t )readGBNetplayPacketValue( &pPacketData, sizeof( uint32_t ) );
+    packet.checksum             = readGBNetplayPacketValue( &pPacketData, sizeof( uint64_t ) );
+    packet.inputCount           = ( uint8_t )readGBNetplayPacketValue( &pPacketData, sizeof( uint8_t ) );
+
+    if( packet.magic != gbNetplayPacketMagic || packet.inputCount > gbNetplayMaxInputsPerPacket || gbNetplayPacketHeaderSizeInBytes + packet.inputCount > packetSizeInBytes )
+    {
+        return 0u;
+    }
+
+    memcpy( packet.inputs, pPacketData, packet.inputCount );
+
+    const uint32_t remotePlayerIndex = 1u - pSession->localPlayerIndex;
+    for( uint32_t inputIndex = 0u; inputIndex < packet.inputCount; ++inputIndex )
+    {
+        //FK: Only take inputs that close the gap, the remote player can't be further ahead than the frame history
+        const uint32_t frameIndex = packet.firstInputFrameIndex + inputIndex;
+        if( frameIndex != pSession->remoteInputFrameCount || frameIndex >= pSession->frameIndex + gbNetplayFrameHistorySize - gbNetplayMaxRollbackFrameCount )
+        {
+            continue;
+        }
+
+        const uint32_t historyIndex = frameIndex % gbNetplayFrameHistorySize;
+        const uint8_t input = packet.inputs[ inputIndex ];
+        pSession->inputs[ remotePlayerIndex ][ historyIndex ] = input;
+        ++pSession->remoteInputFrameCount;
+
+        if( frameIndex < pSession->frameIndex && pSession->simulatedRemoteInputs[ historyIndex ] != input )
+        {
+            pSession->rollbackFrameIndex = GetMin( pSession->rollbackFrameIndex, frameIndex );
+        }
+    }
+
+    if( packet.ackFrameCount > pSession->remoteAckFrameCount && packet.ackFrameCount <= pSession->localInputFrameCount )
+    {
+        pSession->remoteAckFrameCount = packet.ackFrameCount;
+    }
+
+    if( packet.checksumFrameIndex != gbNetplayInvalidFrameIndex )
+    {
+        const uint32_t historyIndex = packet.checksumFrameIndex % gbNetplayFrameHistorySize;
+        pSession->remoteChecksumFrameIndices[ historyIndex ]    = packet.checksumFrameIndex;
+        pSession->remoteChecksums[ historyIndex ]               = packet.checksum;
+        compareGBNetplayChecksums( pSession, historyIndex );
+    }
+
+    return 1u;
+}
+
+//FK: Returns gbNetplayInvalidFrameIndex as long as all compared checksums matched
+uint32_t getGBNetplayDesyncFrameIndex( const GBNetplaySession* pSession )
+{
+    return pSession->desyncFrameIndex;
+}
+
+GBNetplayStats getGBNetplayStats( const GBNetplaySession* pSession )
+{
+    return pSession->stats;
+}
+
+#if defined( __linux__ ) || defined( __APPLE__ )
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static constexpr uint32_t gbNetplayUdpMaxDelayedPacketCount = 64u;
+
+struct GBNetplayUdpDelayedPacket
+{
+    uint64_t        sendTimeInNanoseconds;
+    uint32_t        sizeInBytes;
+    uint8_t         packetData[ gbNetplayMaxPacketSizeInBytes ];
+};
+
+struct GBNetplayUdpTransport
+{
+    int                         socketHandle;
+    sockaddr_in                 remoteAddress;
+
+    //FK: Simulated network conditions of outgoing packets (see setGBNetplayUdpTransportConditions())
+    uint32_t                    latencyInMilliseconds;
+    uint32_t                    jitterInMilliseconds;
+    uint32_t                    packetLossPercentage;
+    uint64_t                    randomState;
+
+    uint32_t                    delayedPacketCount;
+    GBNetplayUdpDelayedPacket   delayedPackets[ gbNetplayUdpMaxDelayedPacketCount ];
+
+    uint64_t                    sentPacketCount;
+    uint64_t                    droppedPacketCount;
+    uint64_t                    receivedPacketCount;
+};
+
+uint64_t getGBNetplayTimeInNanoseconds()
+{
+    timespec time;
+    clock_gettime( CLOCK_MONOTONIC, &time );
+    return ( uint64_t )time.tv_sec * 1000000000ull + ( uint64_t )time.tv_nsec;
+}
+
+//FK: Binds a non blocking UDP socket to localPort and sends to the IPv4 address pRemoteAddress:remotePort. Returns 0 on failure.
+bool8_t openGBNetplayUdpTransport( GBNetplayUdpTransport* pTransport, const uint16_t localPort, const char* pRemoteAddress, const uint16_t remotePort )
+{
+    memset( pTransport, 0, sizeof( GBNetplayUdpTransport ) );
+    pTransport->randomState = 0x9E3779B97F4A7C15ull;
+
+    pTransport->remoteAddress.sin_family    = AF_INET;
+    pTransport->remoteAddress.sin_port      = htons( remotePort );
+    if( inet_pton( AF_INET, pRemoteAddress, &pTransport->remoteAddress.sin_addr ) != 1 )
+    {
+        return 0u;
+    }
+
+    pTransport->socketHandle = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( pTransport->socketHandle < 0 )
+    {
+        return 0u;
+    }
+
+    sockaddr_in localAddress;
+    memset( &localAddress, 0, sizeof( localAddress ) );
+    localAddress.sin_family         = AF_INET;
+    localAddress.sin_port           = htons( localPort );
+    localAddress.sin_addr.s_addr    = htonl( INADDR_ANY );
+
+    if( bind( pTransport->socketHandle, ( const sockaddr* )&localAddress, sizeof( localAddress ) ) != 0 ||
+        fcntl( pTransport->socketHandle, F_SETFL, fcntl( pTransport->socketHandle, F_GETFL, 0 ) | O_NONBLOCK ) != 0 )
+    {
+        close( pTransport->socketHandle );
+        return 0u;
+    }
+
+    return 1u;
+}
+
+void closeGBNetplayUdpTransport( GBNetplayUdpTransport* pTransport )
+{
+    close( pTransport->socketHandle );
+}
+
+//FK: For testing over loopback - every outgoing packet gets delayed by latency +/- jitter and dropped with the given probability
+void setGBNetplayUdpTransportConditions( GBNetplayUdpTransport* pTransport, const uint32_t latencyInMilliseconds, const uint32_t jitterInMilliseconds, const uint32_t packetLossPercentage, const uint64_t seed )
+{
+    pTransport->latencyInMilliseconds   = latencyInMilliseconds;
+    pTransport->jitterInMilliseconds    = GetMin( jitterInMilliseconds, latencyInMilliseconds );
+    pTransport->packetLossPercentage    = GetMin( packetLossPercentage, 100u );
+    pTransport->randomState             = seed;
+}
+
+uint32_t getNextGBNetplayRandomValue( GBNetplayUdpTransport* pTransport )
+{
+    //FK: splitmix64
+    uint64_t value = ( pTransport->randomState += 0x9E3779B97F4A7C15ull );
+    value = ( value ^ ( value >> 30u ) ) * 0xBF58476D1CE4E5B9ull;
+    value = ( value ^ ( value >> 27u ) ) * 0x94D049BB133111EBull;
+    return ( uint32_t )( ( value ^ ( value >> 31u ) ) >> 32u );
+}
+
+void sendGBNetplayUdpPacket( GBNetplayUdpTransport* pTransport, const uint8_t* pPacketData, const uint32_t packetSizeInBytes )
+{
+    sendto( pTransport->socketHandle, pPacketData, packetSizeInBytes, 0, ( const sockaddr* )&pTransport->remoteAddress, sizeof( pTransport->remoteAddress ) );
+    ++pTransport->sentPacketCount;
+}
+
+//FK: Sends the current packet of the session (call once per host frame, after advanceGBNetplayFrame())
+void sendGBNetplayUdpTransport( GBNetplayUdpTransport* pTransport, const GBNetplaySession* pSession )
+{
+    uint8_t packetData[ gbNetplayMaxPacketSizeInBytes ];
+    const uint32_t packetSizeInBytes = writeGBNetplayPacket( pSession, packetData );
+
+    if( pTransport->packetLossPercentage > 0u && getNextGBNetplayRandomValue( pTransport ) % 100u < pTransport->packetLossPercentage )
+    {
+        ++pTransport->droppedPacketCount;
+        return;
+    }
+
+    if( pTransport->latencyInMilliseconds == 0u )
+    {
+        sendGBNetplayUdpPacket( pTransport, packetData, packetSizeInBytes );
+        return;
+    }
+
+    if( pTransport->delayedPacketCount == gbNetplayUdpMaxDelayedPacketCount )
+    {
+        ++pTransport->droppedPacketCount;
+        return;
+    }
+
+    uint64_t delayInMilliseconds = pTransport->latencyInMilliseconds;
+    if( pTransport->jitterInMilliseconds > 0u )
+    {
+        delayInMilliseconds += getNextGBNetplayRandomValue( pTransport ) % ( 2u * pTransport->jitterInMilliseconds + 1u );
+        delayInMilliseconds -= pTransport->jitterInMilliseconds;
+    }
+
+    GBNetplayUdpDelayedPacket* pDelayedPacket = pTransport->delayedPackets + pTransport->delayedPacketCount++;
+    pDelayedPacket->sendTimeInNanoseconds   = getGBNetplayTimeInNanoseconds() + delayInMilliseconds * 1000000ull;
+    pDelayedPacket->sizeInBytes             = packetSizeInBytes;
+    memcpy( pDelayedPacket->packetData, packetData, packetSizeInBytes );
+}
+
+//FK: Sends delayed packets that are due and feeds all received packets into the session (call once per host frame, before advanceGBNetplayFrame())
+void pollGBNetplayUdpTransport( GBNetplayUdpTransport* pTransport, GBNetplaySession* pSession )
+{
+    const uint64_t timeInNanoseconds = getGBNetplayTimeInNanoseconds();
+    for( uint32_t packetIndex = 0u; packetIndex < pTransport->delayedPacketCount; )
+    {
+        GBNetplayUdpDelayedPacket* pDelayedPacket = pTransport->delayedPackets + packetIndex;
+        if( pDelayedPacket->sendTimeInNanoseconds > timeInNanoseconds )
+        {
+            ++packetIndex;
+            continue;
+        }
+
+        sendGBNetplayUdpPacket( pTransport, pDelayedPacket->packetData, pDelayedPacket->sizeInBytes );
+        *pDelayedPacket = pTransport->delayedPackets[ --pTransport->delayedPacketCount ];
+    }
+
+    uint8_t packetData[ gbNetplayMaxPacketSizeInBytes ];
+    while( true )
+    {
+        const ssize_t packetSizeInBytes = recv( pTransport->socketHandle, packetData, sizeof( packetData ), 0 );
+        if( packetSizeInBytes <= 0 )
+        {
+            break;
+        }
+
+        pTransport->receivedPacketCount += receiveGBNetplayPacket( pSession, packetData, ( uint32_t )packetSizeInBytes );
+    }
+}
+#endif //defined( __linux__ ) || defined( __APPLE__ )
+
+#endif //K15_GB_NETPLAY
@@ -0,0 +1,480 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_OBSERVATION
+#define K15_GB_OBSERVATION
+
+//FK: Kernels that turn the packed 2bpp framebuffer straight into a cropped and downsampled 8bit grayscale image (eg: 84x84 or 80x72 for RL agents).
+//    Every observation pixel is the average of the framebuffer pixels it covers, optionally the framebuffer gets max-pooled
+//    with the previous framebuffer first (to get rid of sprite flicker).
+//    The SIMD path gets picked at compile time (AVX2 with /arch:AVX2 or -mavx2, SSE2 on x64), all paths produce the same result.
+
+#if defined( __AVX2__ )
+#   define K15_GB_OBSERVATION_AVX2 1
+#   include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#   define K15_GB_OBSERVATION_SSE2 1
+#   include <emmintrin.h>
+#endif
+
+#if defined( K15_GB_OBSERVATION_AVX2 ) || defined( K15_GB_OBSERVATION_SSE2 )
+#   define K15_GB_OBSERVATION_SIMD 1
+#else
+#   define K15_GB_OBSERVATION_SIMD 0
+#endif
+
+static constexpr uint32_t   gbObservationMaxDimension           = 255u;
+static constexpr uint32_t   gbObservationRowPaddingInBytes      = 32u;     //FK: SIMD loads/stores may run past the end of a row
+static constexpr uint32_t   gbObservationReciprocalShift        = 40u;
+static constexpr uint32_t   gbObservationShadeTableSize         = 64u;     //FK: Max color index sum (+1) that gets looked up instead of calculated
+
+struct GBObservationPlan
+{
+    uint8_t     cropX;
+    uint8_t     cropY;
+    uint8_t     cropWidth;
+    uint8_t     cropHeight;
+    uint8_t     width;
+    uint8_t     height;
+    uint8_t     minColumnWidth;
+    uint8_t     minRowHeight;
+    bool8_t     isHalfResolution;       //FK: Every observation pixel covers exactly 2x2 framebuffer pixels (eg: 80x72), gets its own fast path
+
+    //FK: Padded with zeros so SIMD code can read past the last column
+    uint8_t     columnStarts[ gbObservationMaxDimension + gbObservationRowPaddingInBytes ];     //FK: Framebuffer x of the first pixel covered by an observation column
+    uint8_t     columnWidths[ gbObservationMaxDimension + gbObservationRowPaddingInBytes ];
+    uint8_t     rowStarts[ gbObservationMaxDimension ];
+    uint8_t     rowHeights[ gbObservationMaxDimension ];
+
+    //FK: ceil(2^40 / pixel count), indexed by [rowHeight - minRowHeight][columnWidth - minColumnWidth].
+    //    The widths/heights of a plan only differ by 1 at most, so there are at most 4 different pixel counts.
+    uint64_t    reciprocals[ 2 ][ 2 ];
+
+    //FK: Only if every observation pixel covers so few framebuffer pixels that all color index sums fit into the table (eg: 84x84)
+    bool8_t     hasShadeTable;
+    uint8_t     shadeTable[ 2 ][ 2 ][ gbObservationShadeTableSize ];
+};
+
+//FK: The average shade of pixelCount pixels whose color indices add up to colorIndexSum.
+//    Color index 0 is white (255), 3 is black (0) - 255 - ceil(85 * colorIndexSum / pixelCount).
+uint8_t calculateGBObservationShade( const uint32_t colorIndexSum, const uint32_t pixelCount, const uint64_t reciprocal )
+{
+    const uint64_t numerator = 85u * colorIndexSum + pixelCount - 1u;
+    return ( uint8_t )( 255u - ( uint32_t )( ( numerator * reciprocal ) >> gbObservationReciprocalShift ) );
+}
+
+//FK: A crop width/height of 0 means 'up to the right/bottom edge of the framebuffer'
+GBObservationPlan createGBObservationPlan( uint8_t cropX, uint8_t cropY, uint8_t cropWidth, uint8_t cropHeight, const uint8_t width, const uint8_t height )
+{
+    RuntimeAssert( cropX < gbHorizontalResolutionInPixels && cropY < gbVerticalResolutionInPixels );
+    RuntimeAssert( width > 0u && height > 0u );
+
+    if( cropWidth == 0u || cropX + cropWidth > gbHorizontalResolutionInPixels )
+    {
+        cropWidth = ( uint8_t )( gbHorizontalResolutionInPixels - cropX );
+    }
+
+    if( cropHeight == 0u || cropY + cropHeight > gbVerticalResolutionInPixels )
+    {
+        cropHeight = ( uint8_t )( gbVerticalResolutionInPixels - cropY );
+    }
+
+    GBObservationPlan plan = {};
+    plan.cropX              = cropX;
+    plan.cropY              = cropY;
+    plan.cropWidth          = cropWidth;
+    plan.cropHeight         = cropHeight;
+    plan.width              = width;
+    plan.height             = height;
+    plan.minColumnWidth     = 0xFF;
+    plan.minRowHeight       = 0xFF;
+    plan.isHalfResolution   = cropWidth == width * 2u && cropHeight == height * 2u;
+
+    for( uint32_t x = 0u; x < width; ++x )
+    {
+        const uint32_t startX   = cropX + x * cropWidth / width;
+        const uint32_t endX     = GetMax( startX + 1u, cropX + ( x + 1u ) * cropWidth / width );
+        plan.columnStarts[ x ]  = ( uint8_t )startX;
+        plan.columnWidths[ x ]  = ( uint8_t )( endX - startX );
+        plan.minColumnWidth     = GetMin( plan.minColumnWidth, plan.columnWidths[ x ] );
+    }
+
+    for( uint32_t y = 0u; y < height; ++y )
+    {
+        const uint32_t startY   = cropY + y * cropHeight / height;
+        const uint32_t endY     = GetMax( startY + 1u, cropY + ( y + 1u ) * cropHeight / height );
+        plan.rowStarts[ y ]     = ( uint8_t )startY;
+        plan.rowHeights[ y ]    = ( uint8_t )( endY - startY );
+        plan.minRowHeight       = GetMin( plan.minRowHeight, plan.rowHeights[ y ] );
+    }
+
+    const uint32_t maxPixelCount = ( plan.minRowHeight + 1u ) * ( plan.minColumnWidth + 1u );
+    plan.hasShadeTable = maxPixelCount * 3u < gbObservationShadeTableSize;
+
+    for( uint32_t rowHeightIndex = 0u; rowHeightIndex < 2u; ++rowHeightIndex )
+    {
+        for( uint32_t columnWidthIndex = 0u; columnWidthIndex < 2u; ++columnWidthIndex )
+        {
+            const uint64_t pixelCount = ( uint64_t )( plan.minRowHeight + rowHeightIndex ) * ( plan.minColumnWidth + columnWidthIndex );
+            plan.reciprocals[ rowHeightIndex ][ columnWidthIndex ] = ( ( 1ull << gbObservationReciprocalShift ) + pixelCount - 1u ) / pixelCount;
+
+            for( uint32_t colorIndexSum = 0u; colorIndexSum < gbObservationShadeTableSize; ++colorIndexSum )
+            {
+                plan.shadeTable[ rowHeightIndex ][ columnWidthIndex ][ colorIndexSum ] = plan.hasShadeTable && colorIndexSum <= pixelCount * 3u ?
+                    calculateGBObservationShade( colorIndexSum, ( uint32_t )pixelCount, plan.reciprocals[ rowHeightIndex ][ columnWidthIndex ] ) : 0u;
+            }
+        }
+    }
+
+    return plan;
+}
+
+size_t calculateGBObservationSizeInBytes( const GBObservationPlan* pPlan )
+{
+    return ( size_t )pPlan->width * pPlan->height;
+}
+
+//FK: Unpacks a framebuffer row into one color index (0-3) per pixel
+void unpackGBFrameBufferRowScalar( const uint8_t* restrict_modifier pFrameBufferRow, uint8_t* restrict_modifier pColorIndices )
+{
+    for( uint32_t byteIndex = 0u; byteIndex < gbFrameBufferScanlineSizeInBytes; ++byteIndex )
+    {
+        const uint8_t pixels = pFrameBufferRow[ byteIndex ];
+        pColorIndices[ byteIndex * 4u + 0u ] = ( pixels >> 6u ) & 0x3;
+        pColorIndices[ byteIndex * 4u + 1u ] = ( pixels >> 4u ) & 0x3;
+        pColorIndices[ byteIndex * 4u + 2u ] = ( pixels >> 2u ) & 0x3;
+        pColorIndices[ byteIndex * 4u + 3u ] = ( pixels >> 0u ) & 0x3;
+    }
+}
+
+void maxPoolGBColorIndicesScalar( uint8_t* restrict_modifier pColorIndices, const uint8_t* restrict_modifier pPreviousColorIndices )
+{
+    //FK: The brightest pixel wins, which is the lowest color index
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; ++x )
+    {
+        pColorIndices[ x ] = GetMin( pColorIndices[ x ], pPreviousColorIndices[ x ] );
+    }
+}
+
+void writeGBObservationHalfResolutionRowScalar( const GBObservationPlan* pPlan, const uint8_t* pColorIndices0, const uint8_t* pColorIndices1, uint8_t* pObservationRow )
+{
+    const uint8_t* pFirstColorIndex0 = pColorIndices0 + pPlan->cropX;
+    const uint8_t* pFirstColorIndex1 = pColorIndices1 + pPlan->cropX;
+    for( uint32_t x = 0u; x < pPlan->width; ++x )
+    {
+        const uint32_t colorIndexSum = pFirstColorIndex0[ x * 2u ] + pFirstColorIndex0[ x * 2u + 1u ] + pFirstColorIndex1[ x * 2u ] + pFirstColorIndex1[ x * 2u + 1u ];
+        pObservationRow[ x ] = ( uint8_t )( 255u - ( 85u * colorIndexSum + 3u ) / 4u );
+    }
+}
+
+void addGBColorIndicesToColumnSumsScalar( const uint8_t* restrict_modifier pColorIndices, uint16_t* restrict_modifier pColumnSums )
+{
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; ++x )
+    {
+        pColumnSums[ x ] += pColorIndices[ x ];
+    }
+}
+
+//FK: Prefix sums of the column sums, so every observation pixel is a single subtraction regardless of its width
+void calculateGBColumnPrefixSumsScalar( const uint16_t* restrict_modifier pColumnSums, uint32_t* restrict_modifier pColumnPrefixSums )
+{
+    pColumnPrefixSums[ 0 ] = 0u;
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; ++x )
+    {
+        pColumnPrefixSums[ x + 1u ] = pColumnPrefixSums[ x ] + pColumnSums[ x ];
+    }
+}
+
+void writeGBObservationRowScalar( const GBObservationPlan* pPlan, const uint32_t* pColumnPrefixSums, const uint32_t rowHeight, uint8_t* pObservationRow )
+{
+    const uint32_t rowHeightIndex = rowHeight - pPlan->minRowHeight;
+    if( pPlan->hasShadeTable )
+    {
+        for( uint32_t x = 0u; x < pPlan->width; ++x )
+        {
+            const uint32_t startX           = pPlan->columnStarts[ x ];
+            const uint32_t columnWidth      = pPlan->columnWidths[ x ];
+            const uint32_t colorIndexSum    = pColumnPrefixSums[ startX + columnWidth ] - pColumnPrefixSums[ startX ];
+            pObservationRow[ x ] = pPlan->shadeTable[ rowHeightIndex ][ columnWidth - pPlan->minColumnWidth ][ colorIndexSum ];
+        }
+
+        return;
+    }
+
+    for( uint32_t x = 0u; x < pPlan->width; ++x )
+    {
+        const uint32_t startX           = pPlan->columnStarts[ x ];
+        const uint32_t columnWidth      = pPlan->columnWidths[ x ];
+        const uint32_t colorIndexSum    = pColumnPrefixSums[ startX + columnWidth ] - pColumnPrefixSums[ startX ];
+        pObservationRow[ x ] = calculateGBObservationShade( colorIndexSum, columnWidth * rowHeight, pPlan->reciprocals[ rowHeightIndex ][ columnWidth - pPlan->minColumnWidth ] );
+    }
+}
+
+#if K15_GB_OBSERVATION_SIMD
+//FK: Spreads the 4 pixels of the framebuffer byte in each 32bit lane into the 4 bytes of the lane (first pixel in the lowest byte)
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+__m256i spreadGBFrameBufferPixels( const __m256i pixels )
+{
+    const __m256i spreadPixels = _mm256_or_si256( _mm256_or_si256( _mm256_srli_epi32( pixels, 6 ), _mm256_slli_epi32( pixels, 4 ) ),
+        _mm256_or_si256( _mm256_slli_epi32( pixels, 14 ), _mm256_slli_epi32( pixels, 24 ) ) );
+    return _mm256_and_si256( spreadPixels, _mm256_set1_epi32( 0x03030303 ) );
+}
+#   else
+__m128i spreadGBFrameBufferPixels( const __m128i pixels )
+{
+    const __m128i spreadPixels = _mm_or_si128( _mm_or_si128( _mm_srli_epi32( pixels, 6 ), _mm_slli_epi32( pixels, 4 ) ),
+        _mm_or_si128( _mm_slli_epi32( pixels, 14 ), _mm_slli_epi32( pixels, 24 ) ) );
+    return _mm_and_si128( spreadPixels, _mm_set1_epi32( 0x03030303 ) );
+}
+#   endif
+
+void unpackGBFrameBufferRowSimd( const uint8_t* restrict_modifier pFrameBufferRow, uint8_t* restrict_modifier pColorIndices )
+{
+    //FK: 8 framebuffer bytes (32 pixels) per iteration, a row is 40 bytes
+    for( uint32_t byteIndex = 0u; byteIndex < gbFrameBufferScanlineSizeInBytes; byteIndex += 8u )
+    {
+        const __m128i pixels = _mm_loadl_epi64( ( const __m128i* )( pFrameBufferRow + byteIndex ) );
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+        _mm256_storeu_si256( ( __m256i* )( pColorIndices + byteIndex * 4u ), spreadGBFrameBufferPixels( _mm256_cvtepu8_epi32( pixels ) ) );
+#   else
+        const __m128i zero          = _mm_setzero_si128();
+        const __m128i pixels16      = _mm_unpacklo_epi8( pixels, zero );
+        _mm_storeu_si128( ( __m128i* )( pColorIndices + byteIndex * 4u + 0u ), spreadGBFrameBufferPixels( _mm_unpacklo_epi16( pixels16, zero ) ) );
+        _mm_storeu_si128( ( __m128i* )( pColorIndices + byteIndex * 4u + 16u ), spreadGBFrameBufferPixels( _mm_unpackhi_epi16( pixels16, zero ) ) );
+#   endif
+    }
+}
+
+void maxPoolGBColorIndicesSimd( uint8_t* restrict_modifier pColorIndices, const uint8_t* restrict_modifier pPreviousColorIndices )
+{
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; x += 32u )
+    {
+        const __m256i colorIndices          = _mm256_loadu_si256( ( const __m256i* )( pColorIndices + x ) );
+        const __m256i previousColorIndices  = _mm256_loadu_si256( ( const __m256i* )( pPreviousColorIndices + x ) );
+        _mm256_storeu_si256( ( __m256i* )( pColorIndices + x ), _mm256_min_epu8( colorIndices, previousColorIndices ) );
+    }
+#   else
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; x += 16u )
+    {
+        const __m128i colorIndices          = _mm_loadu_si128( ( const __m128i* )( pColorIndices + x ) );
+        const __m128i previousColorIndices  = _mm_loadu_si128( ( const __m128i* )( pPreviousColorIndices + x ) );
+        _mm_storeu_si128( ( __m128i* )( pColorIndices + x ), _mm_min_epu8( colorIndices, previousColorIndices ) );
+    }
+#   endif
+}
+
+void writeGBObservationHalfResolutionRowSimd( const GBObservationPlan* pPlan, const uint8_t* pColorIndices0, const uint8_t* pColorIndices1, uint8_t* pObservationRow )
+{
+    //FK: Sums of 2x2 color indices are <= 12, shade = 255 - (85 * sum + 3) / 4
+    const uint8_t* pFirstColorIndex0 = pColorIndices0 + pPlan->cropX;
+    const uint8_t* pFirstColorIndex1 = pColorIndices1 + pPlan->cropX;
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+    const __m256i lowByteMask   = _mm256_set1_epi16( 0x00FF );
+    const __m256i shadeFactor   = _mm256_set1_epi16( 85 );
+    const __m256i shadeRounding = _mm256_set1_epi16( 3 );
+    const __m256i white         = _mm256_set1_epi16( 255 );
+    for( uint32_t x = 0u; x < pPlan->width; x += 16u )
+    {
+        const __m256i rowSums   = _mm256_add_epi8( _mm256_loadu_si256( ( const __m256i* )( pFirstColorIndex0 + x * 2u ) ), _mm256_loadu_si256( ( const __m256i* )( pFirstColorIndex1 + x * 2u ) ) );
+        const __m256i sums      = _mm256_add_epi16( _mm256_and_si256( rowSums, lowByteMask ), _mm256_srli_epi16( rowSums, 8 ) );
+        const __m256i shades    = _mm256_sub_epi16( white, _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( sums, shadeFactor ), shadeRounding ), 2 ) );
+        const __m256i packedShades = _mm256_permute4x64_epi64( _mm256_packus_epi16( shades, shades ), 0x08 );
+        _mm_storeu_si128( ( __m128i* )( pObservationRow + x ), _mm256_castsi256_si128( packedShades ) );
+    }
+#   else
+    const __m128i lowByteMask   = _mm_set1_epi16( 0x00FF );
+    const __m128i shadeFactor   = _mm_set1_epi16( 85 );
+    const __m128i shadeRounding = _mm_set1_epi16( 3 );
+    const __m128i white         = _mm_set1_epi16( 255 );
+    for( uint32_t x = 0u; x < pPlan->width; x += 8u )
+    {
+        const __m128i rowSums   = _mm_add_epi8( _mm_loadu_si128( ( const __m128i* )( pFirstColorIndex0 + x * 2u ) ), _mm_loadu_si128( ( const __m128i* )( pFirstColorIndex1 + x * 2u ) ) );
+        const __m128i sums      = _mm_add_epi16( _mm_and_si128( rowSums, lowByteMask ), _mm_srli_epi16( rowSums, 8 ) );
+        const __m128i shades    = _mm_sub_epi16( white, _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( sums, shadeFactor ), shadeRounding ), 2 ) );
+        _mm_storel_epi64( ( __m128i* )( pObservationRow + x ), _mm_packus_epi16( shades, shades ) );
+    }
+#   endif
+}
+
+void addGBColorIndicesToColumnSumsSimd( const uint8_t* restrict_modifier pColorIndices, uint16_t* restrict_modifier pColumnSums )
+{
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; x += 16u )
+    {
+        const __m128i colorIndices = _mm_loadu_si128( ( const __m128i* )( pColorIndices + x ) );
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+        const __m256i columnSums = _mm256_loadu_si256( ( const __m256i* )( pColumnSums + x ) );
+        _mm256_storeu_si256( ( __m256i* )( pColumnSums + x ), _mm256_add_epi16( columnSums, _mm256_cvtepu8_epi16( colorIndices ) ) );
+#   else
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i columnSums0 = _mm_loadu_si128( ( const __m128i* )( pColumnSums + x + 0u ) );
+        const __m128i columnSums1 = _mm_loadu_si128( ( const __m128i* )( pColumnSums + x + 8u ) );
+        _mm_storeu_si128( ( __m128i* )( pColumnSums + x + 0u ), _mm_add_epi16( columnSums0, _mm_unpacklo_epi8( colorIndices, zero ) ) );
+        _mm_storeu_si128( ( __m128i* )( pColumnSums + x + 8u ), _mm_add_epi16( columnSums1, _mm_unpackhi_epi8( colorIndices, zero ) ) );
+#   endif
+    }
+}
+
+void calculateGBColumnPrefixSumsSimd( const uint16_t* restrict_modifier pColumnSums, uint32_t* restrict_modifier pColumnPrefixSums )
+{
+    //FK: Prefix sum of 4 lanes at a time, the carry is the last prefix sum of the previous 4 lanes
+    const __m128i zero  = _mm_setzero_si128();
+    __m128i carry       = zero;
+    pColumnPrefixSums[ 0 ] = 0u;
+    for( uint32_t x = 0u; x < gbHorizontalResolutionInPixels; x += 8u )
+    {
+        const __m128i columnSums = _mm_loadu_si128( ( const __m128i* )( pColumnSums + x ) );
+        __m128i prefixSums[ 2 ] = { _mm_unpacklo_epi16( columnSums, zero ), _mm_unpackhi_epi16( columnSums, zero ) };
+        for( uint32_t halfIndex = 0u; halfIndex < 2u; ++halfIndex )
+        {
+            __m128i prefixSum = prefixSums[ halfIndex ];
+            prefixSum = _mm_add_epi32( prefixSum, _mm_slli_si128( prefixSum, 4 ) );
+            prefixSum = _mm_add_epi32( prefixSum, _mm_slli_si128( prefixSum, 8 ) );
+            prefixSum = _mm_add_epi32( prefixSum, carry );
+            carry = _mm_shuffle_epi32( prefixSum, 0xFF );
+            _mm_storeu_si128( ( __m128i* )( pColumnPrefixSums + x + halfIndex * 4u + 1u ), prefixSum );
+        }
+    }
+}
+
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+void writeGBObservationRowSimd( const GBObservationPlan* pPlan, const uint32_t* pColumnPrefixSums, const uint32_t rowHeight, uint8_t* pObservationRow )
+{
+    //FK: 255 - ceil(85 * sum / pixelCount) in float is exact - 85 * sum stays below 2^24 and the quotient is never closer than 1/pixelCount to an integer
+    //    without being one. Padding columns have a width of 0 and produce garbage that doesn't get stored.
+    const __m256i rowHeights    = _mm256_set1_epi32( ( int )rowHeight );
+    const __m256i shadeFactor   = _mm256_set1_epi32( 85 );
+    const __m256i white         = _mm256_set1_epi32( 255 );
+    const __m256i lowDwords     = _mm256_setr_epi32( 0, 4, 0, 0, 0, 0, 0, 0 );
+    for( uint32_t x = 0u; x < pPlan->width; x += 8u )
+    {
+        const __m256i startX        = _mm256_cvtepu8_epi32( _mm_loadl_epi64( ( const __m128i* )( pPlan->columnStarts + x ) ) );
+        const __m256i columnWidths  = _mm256_cvtepu8_epi32( _mm_loadl_epi64( ( const __m128i* )( pPlan->columnWidths + x ) ) );
+        const __m256i endX          = _mm256_add_epi32( startX, columnWidths );
+        const __m256i sums          = _mm256_sub_epi32( _mm256_i32gather_epi32( ( const int* )pColumnPrefixSums, endX, 4 ), _mm256_i32gather_epi32( ( const int* )pColumnPrefixSums, startX, 4 ) );
+        const __m256 pixelCounts    = _mm256_cvtepi32_ps( _mm256_mullo_epi32( columnWidths, rowHeights ) );
+        const __m256 darkness       = _mm256_ceil_ps( _mm256_div_ps( _mm256_cvtepi32_ps( _mm256_mullo_epi32( sums, shadeFactor ) ), pixelCounts ) );
+        const __m256i shades        = _mm256_sub_epi32( white, _mm256_cvttps_epi32( darkness ) );
+        const __m256i packedShades  = _mm256_packus_epi16( _mm256_packus_epi32( shades, shades ), white );
+        _mm_storel_epi64( ( __m128i* )( pObservationRow + x ), _mm256_castsi256_si128( _mm256_permutevar8x32_epi32( packedShades, lowDwords ) ) );
+    }
+}
+#   endif
+#endif //K15_GB_OBSERVATION_SIMD
+
+//FK: Unpacks framebuffer row y, max-pooled with the same row of the previous framebuffer if there is one
+void unpackGBObservationRow( const uint8_t* pFrameBuffer, const uint8_t* pPreviousFrameBuffer, const uint32_t y, uint8_t* pColorIndices, uint8_t* pPreviousColorIndices, const bool8_t useSimd )
+{
+    const size_t rowOffset = y * gbFrameBufferScanlineSizeInBytes;
+#if K15_GB_OBSERVATION_SIMD
+    if( useSimd )
+    {
+        unpackGBFrameBufferRowSimd( pFrameBuffer + rowOffset, pColorIndices );
+        if( pPreviousFrameBuffer != nullptr )
+        {
+            unpackGBFrameBufferRowSimd( pPreviousFrameBuffer + rowOffset, pPreviousColorIndices );
+            maxPoolGBColorIndicesSimd( pColorIndices, pPreviousColorIndices );
+        }
+        return;
+    }
+#else
+    K15_UNUSED_VAR( useSimd );
+#endif
+
+    unpackGBFrameBufferRowScalar( pFrameBuffer + rowOffset, pColorIndices );
+    if( pPreviousFrameBuffer != nullptr )
+    {
+        unpackGBFrameBufferRowScalar( pPreviousFrameBuffer + rowOffset, pPreviousColorIndices );
+        maxPoolGBColorIndicesScalar( pColorIndices, pPreviousColorIndices );
+    }
+}
+
+void writeGBObservationRows( const GBObservationPlan* pPlan, const uint8_t* pFrameBuffer, const uint8_t* pPreviousFrameBuffer,
+    uint8_t* pObservation, uint8_t* pObservationMirror, const bool8_t useSimd )
+{
+    uint8_t colorIndices[ 2 ][ gbHorizontalResolutionInPixels + gbObservationRowPaddingInBytes ] = {};
+    uint8_t previousColorIndices[ gbHorizontalResolutionInPixels + gbObservationRowPaddingInBytes ];
+    uint16_t columnSums[ gbHorizontalResolutionInPixels + gbObservationRowPaddingInBytes ];
+    uint8_t observationRow[ gbObservationMaxDimension + gbObservationRowPaddingInBytes ];
+
+    for( uint32_t y = 0u; y < pPlan->height; ++y )
+    {
+        const uint32_t startY       = pPlan->rowStarts[ y ];
+        const uint32_t rowHeight    = pPlan->rowHeights[ y ];
+
+        if( pPlan->isHalfResolution )
+        {
+            unpackGBObservationRow( pFrameBuffer, pPreviousFrameBuffer, startY + 0u, colorIndices[ 0 ], previousColorIndices, useSimd );
+            unpackGBObservationRow( pFrameBuffer, pPreviousFrameBuffer, startY + 1u, colorIndices[ 1 ], previousColorIndices, useSimd );
+
+#if K15_GB_OBSERVATION_SIMD
+            if( useSimd )
+            {
+                writeGBObservationHalfResolutionRowSimd( pPlan, colorIndices[ 0 ], colorIndices[ 1 ], observationRow );
+            }
+            else
+#endif
+            {
+                writeGBObservationHalfResolutionRowScalar( pPlan, colorIndices[ 0 ], colorIndices[ 1 ], observationRow );
+            }
+        }
+        else
+        {
+            memset( columnSums, 0, sizeof( columnSums ) );
+            for( uint32_t rowIndex = 0u; rowIndex < rowHeight; ++rowIndex )
+            {
+                unpackGBObservationRow( pFrameBuffer, pPreviousFrameBuffer, startY + rowIndex, colorIndices[ 0 ], previousColorIndices, useSimd );
+#if K15_GB_OBSERVATION_SIMD
+                if( useSimd )
+                {
+                    addGBColorIndicesToColumnSumsSimd( colorIndices[ 0 ], columnSums );
+                    continue;
+                }
+#endif
+                addGBColorIndicesToColumnSumsScalar( colorIndices[ 0 ], columnSums );
+            }
+
+            uint32_t columnPrefixSums[ gbHorizontalResolutionInPixels + gbObservationRowPaddingInBytes ];
+#if K15_GB_OBSERVATION_SIMD
+            if( useSimd )
+            {
+                calculateGBColumnPrefixSumsSimd( columnSums, columnPrefixSums );
+#   if defined( K15_GB_OBSERVATION_AVX2 )
+                writeGBObservationRowSimd( pPlan, columnPrefixSums, rowHeight, observationRow );
+#   else
+                //FK: No gather in SSE2
+                writeGBObservationRowScalar( pPlan, columnPrefixSums, rowHeight, observationRow );
+#   endif
+            }
+            else
+#endif
+            {
+                calculateGBColumnPrefixSumsScalar( columnSums, columnPrefixSums );
+                writeGBObservationRowScalar( pPlan, columnPrefixSums, rowHeight, observationRow );
+            }
+        }
+
+        memcpy( pObservation + y * pPlan->width, observationRow, pPlan->width );
+        if( pObservationMirror != nullptr )
+        {
+            memcpy( pObservationMirror + y * pPlan->width, observationRow, pPlan->width );
+        }
+    }
+}
+
+//FK: Writes the grayscale observation of pFrameBuffer to pObservation (calculateGBObservationSizeInBytes() bytes).
+//    pPreviousFrameBuffer is optional, if set the framebuffers get max-pooled before downsampling.
+//    pObservationMirror is optional, the observation additionally gets written there (see the frame stack of k15_gb_rl_env.h).
+void writeGBObservation( const GBObservationPlan* pPlan, const uint8_t* pFrameBuffer, const uint8_t* pPreviousFrameBuffer, uint8_t* pObservation, uint8_t* pObservationMirror )
+{
+    writeGBObservationRows( pPlan, pFrameBuffer, pPreviousFrameBuffer, pObservation, pObservationMirror, K15_GB_OBSERVATION_SIMD );
+}
+
+//FK: Same as writeGBObservation(), but never uses SIMD (for reference and benchmarks)
+void writeGBObservationScalar( const GBObservationPlan* pPlan, const uint8_t* pFrameBuffer, const uint8_t* pPreviousFrameBuffer, uint8_t* pObservation, uint8_t* pObservationMirror )
+{
+    writeGBObservationRows( pPlan, pFrameBuffer, pPreviousFrameBuffer, pObservation, pObservationMirror, 0u );
+}
+
+#endif //K15_GB_OBSERVATION
@@ -0,0 +1,246 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_PROCESS_FARM
+#define K15_GB_PROCESS_FARM
+
+//FK: Linux only - Runs rollouts of a warmed-up emulator instance in forked worker processes.
+//    The instance, the rom and the cartridge ram of the parent process are shared copy-on-write with every worker,
+//    so the workers neither load the rom nor boot the game, they start right at the state of the warmed-up instance
+//    and only the few pages that a worker writes to get copied.
+//    Every worker runs its own input stream and writes its results into a shared memory mapping.
+
+#ifndef __linux__
+#   error "The process farm is only available on Linux"
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+static constexpr uint32_t   gbProcessFarmMaxWorkerCount             = 1024u;
+static constexpr size_t     gbProcessFarmResultAlignment            = 64u;      //FK: No two workers write to the same cache line
+static constexpr size_t     gbProcessFarmWorkRamSizeInBytes         = 0x2000u;
+
+//FK: Gets called after every frame of a rollout, the returned rewards are summed up
+typedef float ( *GBProcessFarmRewardFunction )( const GBEmulatorInstance* pEmulatorInstance, uint32_t workerIndex, uint32_t frameIndex, void* pUserData );
+
+struct GBProcessFarmWorkerResult
+{
+    uint64_t    spinUpTimeInNanoseconds;    //FK: Time between the start of the farm and the worker starting its rollout
+    uint64_t    privateMemoryInBytes;       //FK: Memory that is private to the worker process at the end of the rollout (copied on write or allocated)
+    uint64_t    finalFrameBufferHash;
+    double      reward;
+    uint32_t    frameCount;
+    uint32_t    vblankCount;
+    bool8_t     finished;                   //FK: 0 if the worker process crashed or couldn't be spawned
+    uint8_t     workRam[ gbProcessFarmWorkRamSizeInBytes ];     //FK: 0xC000-0xDFFF at the end of the rollout
+
+    //FK: Followed by a frame buffer hash for each frame of the rollout (see getGBProcessFarmFrameBufferHashes())
+};
+
+struct GBProcessFarm
+{
+    uint8_t*    pResultMemory;              //FK: MAP_SHARED mapping, written by the workers
+    pid_t*      pWorkerProcessIds;
+    size_t      resultStrideInBytes;
+    size_t      resultMemorySizeInBytes;
+    uint32_t    workerCount;
+    uint32_t    frameCount;
+};
+
+size_t calculateGBProcessFarmMemoryRequirementsInBytes( const uint32_t workerCount )
+{
+    return sizeof( GBProcessFarm ) + workerCount * sizeof( pid_t );
+}
+
+size_t calculateGBProcessFarmResultStrideInBytes( const uint32_t frameCount )
+{
+    const size_t resultSizeInBytes = sizeof( GBProcessFarmWorkerResult ) + frameCount * sizeof( uint64_t );
+    return ( resultSizeInBytes + gbProcessFarmResultAlignment - 1u ) & ~( gbProcessFarmResultAlignment - 1u );
+}
+
+uint64_t getGBProcessFarmTimeInNanoseconds()
+{
+    timespec time;
+    clock_gettime( CLOCK_MONOTONIC, &time );
+    return ( uint64_t )time.tv_sec * 1000000000ull + ( uint64_t )time.tv_nsec;
+}
+
+//FK: Returns the memory that is only mapped by the calling process (Private_Clean + Private_Dirty), 0 if /proc/self/smaps_rollup isn't available
+size_t getGBProcessFarmPrivateMemoryInBytes()
+{
+    FILE* pSmapsFile = fopen( "/proc/self/smaps_rollup", "r" );
+    if( pSmapsFile == nullptr )
+    {
+        return 0u;
+    }
+
+    size_t privateMemoryInKbytes = 0u;
+    char line[ 256 ];
+    while( fgets( line, sizeof( line ), pSmapsFile ) != nullptr )
+    {
+        unsigned long long sizeInKbytes = 0u;
+        if( sscanf( line, "Private_Clean: %llu kB", &sizeInKbytes ) == 1 ||
+            sscanf( line, "Private_Dirty: %llu kB", &sizeInKbytes ) == 1 )
+        {
+            privateMemoryInKbytes += ( size_t )sizeInKbytes;
+        }
+    }
+
+    fclose( pSmapsFile );
+    return Kbyte( privateMemoryInKbytes );
+}
+
+uint64_t calculateGBProcessFarmFrameBufferHash( const uint8_t* pFrameBuffer )
+{
+    //FK: FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for( size_t byteIndex = 0u; byteIndex < gbFrameBufferSizeInBytes; ++byteIndex )
+    {
+        hash = ( hash ^ pFrameBuffer[ byteIndex ] ) * 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+//FK: Returns nullptr if the shared result memory couldn't be mapped
+GBProcessFarm* createGBProcessFarm( uint8_t* pProcessFarmMemory, const uint32_t workerCount, const uint32_t frameCount )
+{
+    RuntimeAssert( workerCount > 0u && workerCount <= gbProcessFarmMaxWorkerCount );
+
+    GBProcessFarm* pProcessFarm = ( GBProcessFarm* )pProcessFarmMemory;
+    pProcessFarm->pWorkerProcessIds         = ( pid_t* )( pProcessFarm + 1 );
+    pProcessFarm->workerCount               = workerCount;
+    pProcessFarm->frameCount                = frameCount;
+    pProcessFarm->resultStrideInBytes       = calculateGBProcessFarmResultStrideInBytes( frameCount );
+    pProcessFarm->resultMemorySizeInBytes   = workerCount * pProcessFarm->resultStrideInBytes;
+
+    void* pResultMemory = mmap( nullptr, pProcessFarm->resultMemorySizeInBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+    if( pResultMemory == MAP_FAILED )
+    {
+        return nullptr;
+    }
+
+    pProcessFarm->pResultMemory = ( uint8_t* )pResultMemory;
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        pProcessFarm->pWorkerProcessIds[ workerIndex ] = -1;
+    }
+
+    return pProcessFarm;
+}
+
+GBProcessFarmWorkerResult* getGBProcessFarmWorkerResult( GBProcessFarm* pProcessFarm, const uint32_t workerIndex )
+{
+    RuntimeAssert( workerIndex < pProcessFarm->workerCount );
+    return ( GBProcessFarmWorkerResult* )( pProcessFarm->pResultMemory + workerIndex * pProcessFarm->resultStrideInBytes );
+}
+
+uint64_t* getGBProcessFarmFrameBufferHashes( GBProcessFarm* pProcessFarm, const uint32_t workerIndex )
+{
+    return ( uint64_t* )( getGBProcessFarmWorkerResult( pProcessFarm, workerIndex ) + 1 );
+}
+
+//FK: Runs the rollout of a single worker, gets called inside of the worker process.
+//    pInputs contains frameCount joypad states for every worker (worker after worker).
+void runGBProcessFarmWorker( GBProcessFarm* pProcessFarm, GBEmulatorInstance* pEmulatorInstance, const uint32_t workerIndex, const GBEmulatorJoypadState* pInputs,
+    GBProcessFarmRewardFunction rewardFunction, void* pUserData, const uint64_t farmStartTimeInNanoseconds )
+{
+    GBProcessFarmWorkerResult* pResult  = getGBProcessFarmWorkerResult( pProcessFarm, workerIndex );
+    uint64_t* pFrameBufferHashes        = getGBProcessFarmFrameBufferHashes( pProcessFarm, workerIndex );
+    pResult->spinUpTimeInNanoseconds    = getGBProcessFarmTimeInNanoseconds() - farmStartTimeInNanoseconds;
+
+    const GBEmulatorJoypadState* pWorkerInputs = pInputs + workerIndex * pProcessFarm->frameCount;
+    for( uint32_t frameIndex = 0u; frameIndex < pProcessFarm->frameCount; ++frameIndex )
+    {
+        setGBEmulatorJoypadState( pEmulatorInstance, pWorkerInputs[ frameIndex ] );
+        const GBEmulatorInstanceEventMask eventMask = runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        if( eventMask & K15_GB_VBLANK_EVENT_FLAG )
+        {
+            ++pResult->vblankCount;
+        }
+
+        pFrameBufferHashes[ frameIndex ] = calculateGBProcessFarmFrameBufferHash( getGBEmulatorFrameBuffer( pEmulatorInstance ) );
+        if( rewardFunction != nullptr )
+        {
+            pResult->reward += rewardFunction( pEmulatorInstance, workerIndex, frameIndex, pUserData );
+        }
+
+        ++pResult->frameCount;
+    }
+
+    pResult->finalFrameBufferHash = pProcessFarm->frameCount > 0u ? pFrameBufferHashes[ pProcessFarm->frameCount - 1u ] : 0u;
+    memcpy( pResult->workRam, getMappedMemoryAddress( &pEmulatorInstance->memoryMapper, 0xC000 ), gbProcessFarmWorkRamSizeInBytes );
+
+    pResult->privateMemoryInBytes   = getGBProcessFarmPrivateMemoryInBytes();
+    pResult->finished               = 1u;
+}
+
+//FK: Waits for all spawned workers, returns the number of workers that finished their rollout
+uint32_t waitForGBProcessFarmWorkers( GBProcessFarm* pProcessFarm )
+{
+    uint32_t finishedWorkerCount = 0u;
+    for( uint32_t workerIndex = 0u; workerIndex < pProcessFarm->workerCount; ++workerIndex )
+    {
+        const pid_t workerProcessId = pProcessFarm->pWorkerProcessIds[ workerIndex ];
+        if( workerProcessId <= 0 )
+        {
+            continue;
+        }
+
+        int status = 0;
+        pid_t waitResult = waitpid( workerProcessId, &status, 0 );
+        while( waitResult < 0 && errno == EINTR )
+        {
+            waitResult = waitpid( workerProcessId, &status, 0 );
+        }
+
+        pProcessFarm->pWorkerProcessIds[ workerIndex ] = -1;
+        const bool8_t exitedNormally = waitResult == workerProcessId && WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+        finishedWorkerCount += exitedNormally && getGBProcessFarmWorkerResult( pProcessFarm, workerIndex )->finished;
+    }
+
+    return finishedWorkerCount;
+}
+
+//FK: Forks workerCount worker processes from the calling process, each one runs frameCount frames starting at the current state of pEmulatorInstance
+//    using its own input stream (see runGBProcessFarmWorker()). Blocks until all workers exited and returns the number of workers that finished.
+//    The instance of the calling process doesn't get modified. Don't call while other threads of the process (eg: a batch runner) are running.
+uint32_t runGBProcessFarm( GBProcessFarm* pProcessFarm, GBEmulatorInstance* pEmulatorInstance, const GBEmulatorJoypadState* pInputs,
+    GBProcessFarmRewardFunction rewardFunction, void* pUserData )
+{
+    RuntimeAssert( isGBEmulatorRomMapped( pEmulatorInstance ) );
+    memset( pProcessFarm->pResultMemory, 0, pProcessFarm->resultMemorySizeInBytes );
+
+    //FK: Buffered output would otherwise be written by the parent and by every worker
+    fflush( nullptr );
+
+    const uint64_t farmStartTimeInNanoseconds = getGBProcessFarmTimeInNanoseconds();
+    for( uint32_t workerIndex = 0u; workerIndex < pProcessFarm->workerCount; ++workerIndex )
+    {
+        const pid_t workerProcessId = fork();
+        if( workerProcessId == 0 )
+        {
+            runGBProcessFarmWorker( pProcessFarm, pEmulatorInstance, workerIndex, pInputs, rewardFunction, pUserData, farmStartTimeInNanoseconds );
+            _exit( 0 );
+        }
+
+        pProcessFarm->pWorkerProcessIds[ workerIndex ] = workerProcessId;
+    }
+
+    return waitForGBProcessFarmWorkers( pProcessFarm );
+}
+
+void destroyGBProcessFarm( GBProcessFarm* pProcessFarm )
+{
+    munmap( pProcessFarm->pResultMemory, pProcessFarm->resultMemorySizeInBytes );
+    pProcessFarm->pResultMemory = nullptr;
+}
+
+#endif //K15_GB_PROCESS_FARM
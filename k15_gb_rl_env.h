@@ -0,0 +1,501 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_RL_ENV
+#define K15_GB_RL_ENV
+
+//FK: Reinforcement learning environment on top of a batch of emulator instances that run the same rom.
+//    resetGBEnvironment() puts every instance back to the start state, stepGBEnvironment() applies one action per instance,
+//    holds it for a number of frames and writes the observations, the selected ram bytes and the done flags of the whole batch
+//    straight into host provided buffers (eg: the memory of a numpy array), instance after instance - no per instance copies.
+//    The entry points that bindings need (settings, create, start state, reset, step, destroy) have C linkage and only take POD types,
+//    so a shared library that includes this file can be loaded from other languages as is (eg: python ctypes/cffi).
+
+#include "k15_gb_observation.h"
+
+static constexpr uint32_t   gbEnvironmentMaxRamAddressCount         = 64u;
+static constexpr uint32_t   gbEnvironmentMaxFrameStackSize          = 16u;
+static constexpr size_t     gbEnvironmentInstanceAlignment          = 64u;
+
+typedef uint8_t GBEnvironmentAction;
+typedef uint8_t GBEnvironmentDoneMask;
+
+//FK: An action is the joypad state of one instance, one bit per button
+enum
+{
+    K15_GB_ENVIRONMENT_ACTION_A_FLAG        = 0x01,
+    K15_GB_ENVIRONMENT_ACTION_B_FLAG        = 0x02,
+    K15_GB_ENVIRONMENT_ACTION_SELECT_FLAG   = 0x04,
+    K15_GB_ENVIRONMENT_ACTION_START_FLAG    = 0x08,
+    K15_GB_ENVIRONMENT_ACTION_RIGHT_FLAG    = 0x10,
+    K15_GB_ENVIRONMENT_ACTION_LEFT_FLAG     = 0x20,
+    K15_GB_ENVIRONMENT_ACTION_UP_FLAG       = 0x40,
+    K15_GB_ENVIRONMENT_ACTION_DOWN_FLAG     = 0x80,
+};
+
+enum
+{
+    K15_GB_ENVIRONMENT_RUNNING              = 0x00,
+    K15_GB_ENVIRONMENT_TERMINATED_FLAG      = 0x01,    //FK: The done function reported the end of the episode
+    K15_GB_ENVIRONMENT_TRUNCATED_FLAG       = 0x02,    //FK: The episode reached maxEpisodeFrameCount
+};
+
+enum GBEnvironmentObservationMode : uint8_t
+{
+    K15_GB_ENVIRONMENT_OBSERVATION_FRAME_BUFFER = 0,   //FK: The 160x144 framebuffer as is (2bpp, 4 pixels per byte - see gbFrameBufferSizeInBytes)
+    K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE,          //FK: 8bit grayscale of the crop rectangle, downsampled to observationWidth x observationHeight
+    K15_GB_ENVIRONMENT_OBSERVATION_RAM_ONLY            //FK: No image, only the selected ram bytes
+};
+
+//FK: Gets called after every frame, return 1 to end the episode of the instance
+typedef bool8_t ( *GBEnvironmentDoneFunction )( const GBEmulatorInstance* pEmulatorInstance, uint32_t instanceIndex, void* pUserData );
+
+//FK: Plain struct with a C compatible layout, initialize it with initGBEnvironmentSettings() and change what's needed
+struct GBEnvironmentSettings
+{
+    uint8_t                         observationMode;        //FK: GBEnvironmentObservationMode
+
+    //FK: Grayscale only, a crop width/height of 0 means 'up to the right/bottom edge of the framebuffer'
+    uint8_t                         cropX;
+    uint8_t                         cropY;
+    uint8_t                         cropWidth;
+    uint8_t                         cropHeight;
+    uint8_t                         observationWidth;
+    uint8_t                         observationHeight;
+    bool8_t                         maxPoolFrames;          //FK: Grayscale only, max-pool the last two frames of a step before downsampling (gets rid of sprite flicker)
+
+    //FK: Image modes only, the observation of an instance contains the last frameStackSize frames (see getGBEnvironmentFrameStackOffset())
+    uint8_t                         frameStackSize;
+
+    bool8_t                         autoReset;              //FK: Instances that are done get reset at the start of the next step
+    uint32_t                        maxEpisodeFrameCount;   //FK: 0 = no limit
+    uint32_t                        maxNoopFrameCount;      //FK: After a reset every instance runs [0, maxNoopFrameCount] frames without input (seed dependent) so that the episodes don't all start at the same state
+    uint32_t                        maxLagFrameSkipCount;   //FK: Frames that finished a lag frame (K15_GB_LAG_FRAME_EVENT_FLAG) don't count towards framesToHold, up to this many per step (0 = every frame counts)
+
+    GBEnvironmentDoneFunction       doneFunction;
+    void*                           pUserData;
+
+    //FK: Bytes that get copied into the ram values after every step (eg: player position, lives, score)
+    uint16_t                        ramAddresses[ gbEnvironmentMaxRamAddressCount ];
+    uint32_t                        ramAddressCount;
+};
+
+//FK: Host provided memory that the results of a reset/step get written to
+struct GBEnvironmentBuffers
+{
+    uint8_t*                pObservations;      //FK: instanceCount * calculateGBEnvironmentObservationSizeInBytes() bytes, can be nullptr
+    uint8_t*                pRamValues;         //FK: instanceCount * ramAddressCount bytes, can be nullptr
+    GBEnvironmentDoneMask*  pDoneMasks;         //FK: instanceCount bytes, can be nullptr
+    uint32_t*               pLagFrameCounts;    //FK: instanceCount values, lag frames that got skipped during the step, can be nullptr
+};
+
+struct GBEnvironmentEpisode
+{
+    uint64_t                randomState;
+    uint32_t                frameCount;
+    uint32_t                stepLagFrameCount;
+    GBEnvironmentDoneMask   doneMask;
+};
+
+struct GBEnvironment
+{
+    GBEnvironmentSettings   settings;
+    GBObservationPlan       observationPlan;
+    uint8_t*                pInstanceMemory;
+    uint8_t*                pCartridgeRamMemory;
+    GBEmulatorInstance*     pStagingInstance;           //FK: Start states get loaded into this instance first, see setGBEnvironmentStartState()
+    uint8_t*                pStartSnapshot;
+    uint8_t*                pPreviousFrameBuffers;      //FK: Only if maxPoolFrames is set
+    GBEnvironmentEpisode*   pEpisodes;
+    size_t                  instanceStrideInBytes;
+    size_t                  cartridgeRamSizeInBytes;
+    size_t                  startSnapshotSizeInBytes;
+    size_t                  frameSizeInBytes;
+    size_t                  observationSizeInBytes;
+    uint32_t                instanceCount;
+    uint32_t                frameStackHeadIndex;
+    uint8_t                 startFrameBuffer[ gbFrameBufferSizeInBytes ];   //FK: Framebuffers are not part of snapshots
+};
+
+//FK: 84x84 grayscale, a single frame per observation, auto reset and no episode limit
+extern "C" void initGBEnvironmentSettings( GBEnvironmentSettings* pOutSettings )
+{
+    memset( pOutSettings, 0, sizeof( GBEnvironmentSettings ) );
+    pOutSettings->observationMode   = K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE;
+    pOutSettings->observationWidth  = 84u;
+    pOutSettings->observationHeight = 84u;
+    pOutSettings->frameStackSize    = 1u;
+    pOutSettings->autoReset         = 1u;
+}
+
+size_t calculateGBEnvironmentFrameSizeInBytes( const GBEnvironmentSettings* pSettings )
+{
+    switch( pSettings->observationMode )
+    {
+        case K15_GB_ENVIRONMENT_OBSERVATION_FRAME_BUFFER:
+            return gbFrameBufferSizeInBytes;
+        case K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE:
+            return ( size_t )pSettings->observationWidth * pSettings->observationHeight;
+        case K15_GB_ENVIRONMENT_OBSERVATION_RAM_ONLY:
+            return 0u;
+    }
+
+    IllegalCodePath();
+    return 0u;
+}
+
+//FK: A frame stack of N frames is stored as a ring of 2N frames where every frame gets written twice (to slot i and i + N),
+//    so the last N frames are always contiguous and in order without moving the older frames around.
+uint32_t calculateGBEnvironmentFrameStackSlotCount( const GBEnvironmentSettings* pSettings )
+{
+    return pSettings->frameStackSize > 1u ? pSettings->frameStackSize * 2u : 1u;
+}
+
+extern "C" size_t calculateGBEnvironmentObservationSizeInBytes( const GBEnvironmentSettings* pSettings )
+{
+    return calculateGBEnvironmentFrameSizeInBytes( pSettings ) * calculateGBEnvironmentFrameStackSlotCount( pSettings );
+}
+
+size_t calculateGBEnvironmentInstanceStrideInBytes()
+{
+    return ( calculateGBEmulatorMemoryRequirementsInBytes() + gbEnvironmentInstanceAlignment - 1u ) & ~( gbEnvironmentInstanceAlignment - 1u );
+}
+
+size_t calculateGBEnvironmentCartridgeRamSizeInBytes( const uint8_t* pRomData )
+{
+    return mapRamSizeToByteSize( getGBRomHeader( pRomData ).ramSize );
+}
+
+size_t calculateGBEnvironmentStartSnapshotSizeInBytes( const uint8_t* pRomData )
+{
+    //FK: Same as calculateGBEmulatorSnapshotSizeInBytes(), but without an instance
+    return sizeof( GBEmulatorSnapshotHeader ) + calculateGBEmulatorSubStateSizeInBytes() + gbMappedMemorySizeInBytes + calculateGBEnvironmentCartridgeRamSizeInBytes( pRomData );
+}
+
+extern "C" size_t calculateGBEnvironmentMemoryRequirementsInBytes( const uint8_t* pRomData, const uint32_t instanceCount, const GBEnvironmentSettings* pSettings )
+{
+    const size_t previousFrameBufferSizeInBytes = pSettings->maxPoolFrames ? gbFrameBufferSizeInBytes : 0u;
+    return sizeof( GBEnvironment ) + gbEnvironmentInstanceAlignment +
+        ( instanceCount + 1u ) * ( calculateGBEnvironmentInstanceStrideInBytes() + calculateGBEnvironmentCartridgeRamSizeInBytes( pRomData ) ) +
+        instanceCount * ( sizeof( GBEnvironmentEpisode ) + previousFrameBufferSizeInBytes ) +
+        calculateGBEnvironmentStartSnapshotSizeInBytes( pRomData );
+}
+
+//FK: Index of the frame stack slot that contains the oldest of the last frameStackSize frames,
+//    so the stacked frames of instance i start at pObservations + i * observationSize + offset * frameSize.
+//    The offset is the same for all instances of the environment and changes after every step.
+extern "C" uint32_t getGBEnvironmentFrameStackOffset( const GBEnvironment* pEnvironment )
+{
+    return pEnvironment->settings.frameStackSize > 1u ? pEnvironment->frameStackHeadIndex + 1u : 0u;
+}
+
+GBEmulatorInstance* getGBEnvironmentInstance( const GBEnvironment* pEnvironment, const uint32_t instanceIndex )
+{
+    RuntimeAssert( instanceIndex < pEnvironment->instanceCount );
+    return ( GBEmulatorInstance* )( pEnvironment->pInstanceMemory + instanceIndex * pEnvironment->instanceStrideInBytes );
+}
+
+//FK: The current state of pSourceInstance (which has to have the same rom loaded) becomes the state that instances get reset to
+void setGBEnvironmentStartInstance( GBEnvironment* pEnvironment, const GBEmulatorInstance* pSourceInstance )
+{
+    RuntimeAssert( calculateGBEmulatorSnapshotSizeInBytes( pSourceInstance ) == pEnvironment->startSnapshotSizeInBytes );
+
+    snapshotGBEmulator( pSourceInstance, pEnvironment->pStartSnapshot );
+    memcpy( pEnvironment->startFrameBuffer, getGBEmulatorFrameBuffer( ( GBEmulatorInstance* )pSourceInstance ), gbFrameBufferSizeInBytes );
+}
+
+//FK: Loads a state (see storeGBEmulatorState()) and makes it the state that instances get reset to.
+//    The state is loaded into a staging instance, so neither the running instances nor the previous start state change if the load fails.
+//    The framebuffer of the start state is cleared since states don't contain framebuffers,
+//    use setGBEnvironmentStartInstance() with an instance that ran for a frame if the first observation matters.
+extern "C" GBStateLoadResult setGBEnvironmentStartState( GBEnvironment* pEnvironment, const uint8_t* pStateMemory, const size_t stateMemorySizeInBytes )
+{
+    const GBStateLoadResult loadResult = loadGBEmulatorState( pEnvironment->pStagingInstance, pStateMemory, stateMemorySizeInBytes );
+    if( loadResult != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        return loadResult;
+    }
+
+    setGBEnvironmentStartInstance( pEnvironment, pEnvironment->pStagingInstance );
+    memset( pEnvironment->startFrameBuffer, 0, gbFrameBufferSizeInBytes );
+    return K15_GB_STATE_LOAD_SUCCESS;
+}
+
+//FK: Returns nullptr if the cartridge type of the rom is not supported.
+//    The rom memory is owned by the host and shared by all instances, the start state is the power on state of the rom.
+extern "C" GBEnvironment* createGBEnvironment( uint8_t* pEnvironmentMemory, const uint8_t* pRomData, const uint32_t instanceCount, const GBEnvironmentSettings* pSettings )
+{
+    RuntimeAssert( instanceCount > 0u );
+    RuntimeAssert( pSettings->ramAddressCount <= gbEnvironmentMaxRamAddressCount );
+    RuntimeAssert( pSettings->frameStackSize > 0u && pSettings->frameStackSize <= gbEnvironmentMaxFrameStackSize );
+    RuntimeAssert( !pSettings->maxPoolFrames || pSettings->observationMode == K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE );
+
+    GBEnvironment* pEnvironment = ( GBEnvironment* )pEnvironmentMemory;
+    pEnvironment->settings                  = *pSettings;
+    pEnvironment->instanceCount             = instanceCount;
+    pEnvironment->instanceStrideInBytes     = calculateGBEnvironmentInstanceStrideInBytes();
+    pEnvironment->cartridgeRamSizeInBytes   = calculateGBEnvironmentCartridgeRamSizeInBytes( pRomData );
+    pEnvironment->startSnapshotSizeInBytes  = calculateGBEnvironmentStartSnapshotSizeInBytes( pRomData );
+    pEnvironment->frameSizeInBytes          = calculateGBEnvironmentFrameSizeInBytes( pSettings );
+    pEnvironment->observationSizeInBytes    = calculateGBEnvironmentObservationSizeInBytes( pSettings );
+    pEnvironment->frameStackHeadIndex       = 0u;
+
+    if( pSettings->observationMode == K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE )
+    {
+        pEnvironment->observationPlan = createGBObservationPlan( pSettings->cropX, pSettings->cropY, pSettings->cropWidth, pSettings->cropHeight,
+            pSettings->observationWidth, pSettings->observationHeight );
+    }
+
+    const uintptr_t instanceMemoryAddress = ( uintptr_t )( pEnvironment + 1 );
+    pEnvironment->pInstanceMemory       = ( uint8_t* )( ( instanceMemoryAddress + gbEnvironmentInstanceAlignment - 1u ) & ~( uintptr_t )( gbEnvironmentInstanceAlignment - 1u ) );
+    pEnvironment->pCartridgeRamMemory   = pEnvironment->pInstanceMemory + ( instanceCount + 1u ) * pEnvironment->instanceStrideInBytes;
+    pEnvironment->pEpisodes             = ( GBEnvironmentEpisode* )( pEnvironment->pCartridgeRamMemory + ( instanceCount + 1u ) * pEnvironment->cartridgeRamSizeInBytes );
+    pEnvironment->pStartSnapshot        = ( uint8_t* )( pEnvironment->pEpisodes + instanceCount );
+    pEnvironment->pPreviousFrameBuffers = pSettings->maxPoolFrames ? pEnvironment->pStartSnapshot + pEnvironment->startSnapshotSizeInBytes : nullptr;
+
+    //FK: The instance after the last one is the staging instance, it has its own cartridge ram
+    for( uint32_t instanceIndex = 0u; instanceIndex <= instanceCount; ++instanceIndex )
+    {
+        uint8_t* pCartridgeRam = pEnvironment->cartridgeRamSizeInBytes > 0u ? pEnvironment->pCartridgeRamMemory + instanceIndex * pEnvironment->cartridgeRamSizeInBytes : nullptr;
+        GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pEnvironment->pInstanceMemory + instanceIndex * pEnvironment->instanceStrideInBytes );
+        if( loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRam ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+        {
+            return nullptr;
+        }
+
+        if( instanceIndex < instanceCount )
+        {
+            memset( &pEnvironment->pEpisodes[ instanceIndex ], 0, sizeof( GBEnvironmentEpisode ) );
+        }
+    }
+
+    pEnvironment->pStagingInstance = ( GBEmulatorInstance* )( pEnvironment->pInstanceMemory + instanceCount * pEnvironment->instanceStrideInBytes );
+
+    setGBEnvironmentStartInstance( pEnvironment, getGBEnvironmentInstance( pEnvironment, 0u ) );
+    return pEnvironment;
+}
+
+uint64_t getNextGBEnvironmentRandomValue( uint64_t* pRandomState )
+{
+    //FK: splitmix64
+    uint64_t value = ( *pRandomState += 0x9E3779B97F4A7C15ull );
+    value = ( value ^ ( value >> 30u ) ) * 0xBF58476D1CE4E5B9ull;
+    value = ( value ^ ( value >> 27u ) ) * 0x94D049BB133111EBull;
+    return value ^ ( value >> 31u );
+}
+
+uint8_t* getGBEnvironmentPreviousFrameBuffer( const GBEnvironment* pEnvironment, const uint32_t instanceIndex )
+{
+    return pEnvironment->pPreviousFrameBuffers != nullptr ? pEnvironment->pPreviousFrameBuffers + instanceIndex * gbFrameBufferSizeInBytes : nullptr;
+}
+
+//FK: Writes the current frame into the frame stack slots of the stack head, fillFrameStack writes it into every slot (after a reset)
+void writeGBEnvironmentObservation( const GBEnvironment* pEnvironment, const uint32_t instanceIndex, uint8_t* pObservation, const bool8_t fillFrameStack )
+{
+    const GBEnvironmentSettings* pSettings  = &pEnvironment->settings;
+    const size_t frameSizeInBytes           = pEnvironment->frameSizeInBytes;
+    const uint8_t* pFrameBuffer             = getGBEmulatorFrameBuffer( getGBEnvironmentInstance( pEnvironment, instanceIndex ) );
+
+    uint8_t* pFrame         = pObservation;
+    uint8_t* pFrameMirror   = nullptr;
+    if( pSettings->frameStackSize > 1u )
+    {
+        pFrame          = pObservation + pEnvironment->frameStackHeadIndex * frameSizeInBytes;
+        pFrameMirror    = pFrame + pSettings->frameStackSize * frameSizeInBytes;
+    }
+
+    if( pSettings->observationMode == K15_GB_ENVIRONMENT_OBSERVATION_FRAME_BUFFER )
+    {
+        memcpy( pFrame, pFrameBuffer, frameSizeInBytes );
+        if( pFrameMirror != nullptr )
+        {
+            memcpy( pFrameMirror, pFrameBuffer, frameSizeInBytes );
+        }
+    }
+    else
+    {
+        writeGBObservation( &pEnvironment->observationPlan, pFrameBuffer, getGBEnvironmentPreviousFrameBuffer( pEnvironment, instanceIndex ), pFrame, pFrameMirror );
+    }
+
+    if( fillFrameStack && pFrameMirror != nullptr )
+    {
+        const uint32_t slotCount = calculateGBEnvironmentFrameStackSlotCount( pSettings );
+        for( uint32_t slotIndex = 0u; slotIndex < slotCount; ++slotIndex )
+        {
+            uint8_t* pSlot = pObservation + slotIndex * frameSizeInBytes;
+            if( pSlot != pFrame && pSlot != pFrameMirror )
+            {
+                memcpy( pSlot, pFrame, frameSizeInBytes );
+            }
+        }
+    }
+}
+
+void writeGBEnvironmentResults( const GBEnvironment* pEnvironment, const uint32_t instanceIndex, const GBEnvironmentBuffers* pBuffers, const bool8_t fillFrameStack )
+{
+    const GBEnvironmentSettings* pSettings  = &pEnvironment->settings;
+    GBEmulatorInstance* pEmulatorInstance   = getGBEnvironmentInstance( pEnvironment, instanceIndex );
+
+    if( pBuffers->pObservations != nullptr && pEnvironment->observationSizeInBytes > 0u )
+    {
+        writeGBEnvironmentObservation( pEnvironment, instanceIndex, pBuffers->pObservations + instanceIndex * pEnvironment->observationSizeInBytes, fillFrameStack );
+    }
+
+    if( pBuffers->pRamValues != nullptr )
+    {
+        uint8_t* pRamValues = pBuffers->pRamValues + instanceIndex * pSettings->ramAddressCount;
+        for( uint32_t ramAddressIndex = 0u; ramAddressIndex < pSettings->ramAddressCount; ++ramAddressIndex )
+        {
+            pRamValues[ ramAddressIndex ] = getMappedMemoryValue( &pEmulatorInstance->memoryMapper, pSettings->ramAddresses[ ramAddressIndex ] );
+        }
+    }
+
+    if( pBuffers->pDoneMasks != nullptr )
+    {
+        pBuffers->pDoneMasks[ instanceIndex ] = pEnvironment->pEpisodes[ instanceIndex ].doneMask;
+    }
+
+    if( pBuffers->pLagFrameCounts != nullptr )
+    {
+        pBuffers->pLagFrameCounts[ instanceIndex ] = pEnvironment->pEpisodes[ instanceIndex ].stepLagFrameCount;
+    }
+}
+
+//FK: Runs a single frame with the current joypad state of the instance and updates the done mask of its episode
+GBEmulatorInstanceEventMask runGBEnvironmentFrame( GBEnvironment* pEnvironment, const uint32_t instanceIndex )
+{
+    const GBEnvironmentSettings* pSettings  = &pEnvironment->settings;
+    GBEnvironmentEpisode* pEpisode          = &pEnvironment->pEpisodes[ instanceIndex ];
+    GBEmulatorInstance* pEmulatorInstance   = getGBEnvironmentInstance( pEnvironment, instanceIndex );
+
+    uint8_t* pPreviousFrameBuffer = getGBEnvironmentPreviousFrameBuffer( pEnvironment, instanceIndex );
+    if( pPreviousFrameBuffer != nullptr )
+    {
+        memcpy( pPreviousFrameBuffer, getGBEmulatorFrameBuffer( pEmulatorInstance ), gbFrameBufferSizeInBytes );
+    }
+
+    const GBEmulatorInstanceEventMask eventMask = runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    ++pEpisode->frameCount;
+
+    if( pSettings->doneFunction != nullptr && pSettings->doneFunction( pEmulatorInstance, instanceIndex, pSettings->pUserData ) )
+    {
+        pEpisode->doneMask |= K15_GB_ENVIRONMENT_TERMINATED_FLAG;
+    }
+
+    if( pSettings->maxEpisodeFrameCount > 0u && pEpisode->frameCount >= pSettings->maxEpisodeFrameCount )
+    {
+        pEpisode->doneMask |= K15_GB_ENVIRONMENT_TRUNCATED_FLAG;
+    }
+
+    return eventMask;
+}
+
+//FK: Restores the start state and runs the random number of noop frames, the episode continues its random sequence
+void resetGBEnvironmentInstance( GBEnvironment* pEnvironment, const uint32_t instanceIndex )
+{
+    GBEnvironmentEpisode* pEpisode          = &pEnvironment->pEpisodes[ instanceIndex ];
+    GBEmulatorInstance* pEmulatorInstance   = getGBEnvironmentInstance( pEnvironment, instanceIndex );
+
+    restoreGBEmulator( pEmulatorInstance, pEnvironment->pStartSnapshot );
+    for( uint32_t frameBufferIndex = 0u; frameBufferIndex < gbFrameBufferCount; ++frameBufferIndex )
+    {
+        memcpy( pEmulatorInstance->gbFrameBuffers[ frameBufferIndex ], pEnvironment->startFrameBuffer, gbFrameBufferSizeInBytes );
+    }
+
+    uint8_t* pPreviousFrameBuffer = getGBEnvironmentPreviousFrameBuffer( pEnvironment, instanceIndex );
+    if( pPreviousFrameBuffer != nullptr )
+    {
+        memcpy( pPreviousFrameBuffer, pEnvironment->startFrameBuffer, gbFrameBufferSizeInBytes );
+    }
+
+    pEpisode->frameCount        = 0u;
+    pEpisode->stepLagFrameCount = 0u;
+    pEpisode->doneMask          = K15_GB_ENVIRONMENT_RUNNING;
+
+    const uint32_t maxNoopFrameCount = pEnvironment->settings.maxNoopFrameCount;
+    if( maxNoopFrameCount > 0u )
+    {
+        const uint32_t noopFrameCount = ( uint32_t )( getNextGBEnvironmentRandomValue( &pEpisode->randomState ) % ( maxNoopFrameCount + 1u ) );
+        setGBEmulatorJoypadState( pEmulatorInstance, GBEmulatorJoypadState() );
+        for( uint32_t frameIndex = 0u; frameIndex < noopFrameCount; ++frameIndex )
+        {
+            runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        }
+    }
+}
+
+//FK: Resets every instance of the batch to the start state and writes the first observations.
+//    Every instance gets its own random sequence derived from seed, so the same seed results in the same episodes.
+extern "C" void resetGBEnvironment( GBEnvironment* pEnvironment, const uint64_t seed, const GBEnvironmentBuffers* pBuffers )
+{
+    RuntimeAssert( pEnvironment->instanceCount > 0u );
+
+    for( uint32_t instanceIndex = 0u; instanceIndex < pEnvironment->instanceCount; ++instanceIndex )
+    {
+        uint64_t instanceSeed = seed + instanceIndex;
+        pEnvironment->pEpisodes[ instanceIndex ].randomState = getNextGBEnvironmentRandomValue( &instanceSeed );
+
+        resetGBEnvironmentInstance( pEnvironment, instanceIndex );
+        writeGBEnvironmentResults( pEnvironment, instanceIndex, pBuffers, 1u );
+    }
+}
+
+//FK: Sets the joypad state of every instance to its action (pActions contains one action per instance) and runs framesToHold frames.
+//    An instance stops early once its episode is done. With autoReset enabled, instances that were done after the previous step
+//    get reset first, so the observation of a step that reported done is still the last observation of the episode.
+//    With maxLagFrameSkipCount set, lag frames get run in addition to framesToHold (see GBEnvironmentBuffers::pLagFrameCounts).
+extern "C" void stepGBEnvironment( GBEnvironment* pEnvironment, const GBEnvironmentAction* pActions, const uint32_t framesToHold, const GBEnvironmentBuffers* pBuffers )
+{
+    RuntimeAssert( pEnvironment->instanceCount > 0u );
+
+    if( pEnvironment->settings.frameStackSize > 1u )
+    {
+        pEnvironment->frameStackHeadIndex = ( pEnvironment->frameStackHeadIndex + 1u ) % pEnvironment->settings.frameStackSize;
+    }
+
+    for( uint32_t instanceIndex = 0u; instanceIndex < pEnvironment->instanceCount; ++instanceIndex )
+    {
+        GBEnvironmentEpisode* pEpisode = &pEnvironment->pEpisodes[ instanceIndex ];
+        if( pEpisode->doneMask != K15_GB_ENVIRONMENT_RUNNING && pEnvironment->settings.autoReset )
+        {
+            //FK: The first frame of the new episode fills the whole frame stack
+            resetGBEnvironmentInstance( pEnvironment, instanceIndex );
+            writeGBEnvironmentResults( pEnvironment, instanceIndex, pBuffers, 1u );
+        }
+
+        GBEmulatorJoypadState joypadState;
+        joypadState.actionButtonMask    = pActions[ instanceIndex ] & 0x0F;
+        joypadState.dpadButtonMask      = pActions[ instanceIndex ] >> 4;
+
+        GBEmulatorInstance* pEmulatorInstance = getGBEnvironmentInstance( pEnvironment, instanceIndex );
+        setGBEmulatorJoypadState( pEmulatorInstance, joypadState );
+
+        const uint32_t maxLagFrameSkipCount = pEnvironment->settings.maxLagFrameSkipCount;
+        pEpisode->stepLagFrameCount = 0u;
+
+        uint32_t frameIndex = 0u;
+        while( frameIndex < framesToHold && pEpisode->doneMask == K15_GB_ENVIRONMENT_RUNNING )
+        {
+            const GBEmulatorInstanceEventMask eventMask = runGBEnvironmentFrame( pEnvironment, instanceIndex );
+            if( ( eventMask & K15_GB_LAG_FRAME_EVENT_FLAG ) != 0u && pEpisode->stepLagFrameCount < maxLagFrameSkipCount )
+            {
+                ++pEpisode->stepLagFrameCount;
+                continue;
+            }
+
+            ++frameIndex;
+        }
+
+        writeGBEnvironmentResults( pEnvironment, instanceIndex, pBuffers, 0u );
+    }
+}
+
+//FK: The environment memory is owned by the host, so there's nothing to release - this only invalidates the environment
+//    (reset/step assert afterwards), the memory can be freed or reused once it returns
+extern "C" void destroyGBEnvironment( GBEnvironment* pEnvironment )
+{
+    memset( pEnvironment, 0, sizeof( GBEnvironment ) );
+}
+
+#endif //K15_GB_RL_ENV
@@ -0,0 +1,206 @@
+#ifndef K15_GB_EMULATOR
+#   error "Include this file *after* 'k15_gb_emulator.h'"
+#endif
+
+#ifndef K15_GB_RUN_AHEAD
+#define K15_GB_RUN_AHEAD
+
+//FK: Run-ahead hides the input lag of games that only react to input a few frames after reading it.
+//    Every host frame the instance runs the actual frame, takes a snapshot, runs N more frames with the same input, shows the last of them and goes back
+//    to the snapshot. Only the scanlines of the shown frame get drawn, all other frames run with rendering disabled (see setGBEmulatorRenderingEnabled()).
+//    Optionally the speculative frames can run on a second instance, so the instance itself never gets restored.
+//    An input queue (see setGBEmulatorInputQueue()) only gets consumed by the actual frame, the speculative frames run with the queue detached
+//    and repeat the joypad state the actual frame ended with - otherwise their events would be lost when the snapshot gets restored.
+
+enum GBRunAheadRenderState : uint8_t
+{
+    K15_GB_RUN_AHEAD_WAIT_FOR_SHOWN_FRAME = 0,
+    K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME,
+    K15_GB_RUN_AHEAD_SHOWN_FRAME_DONE
+};
+
+struct GBRunAheadStats
+{
+    uint64_t    frameCount;
+    uint64_t    speculativeFrameCount;
+};
+
+struct GBRunAhead
+{
+    GBEmulatorInstance*     pInstance;
+    GBEmulatorInstance*     pSpeculativeInstance;   //FK: Either pInstance or the second instance
+    uint8_t*                pSnapshotMemory;
+    uint64_t                hostFrameCycleCount;        //FK: Cycles run during the current host frame by the actual and the speculative frames
+    uint64_t                frameFinishedCycleCount;    //FK: hostFrameCycleCount when the last frame of this host frame got finished, 0 if there's none (or the lcd got enabled since)
+    uint32_t                runAheadFrameCount;
+    GBRunAheadRenderState   renderState;
+    GBRunAheadStats         stats;
+    uint8_t                 frameBuffer[ gbFrameBufferSizeInBytes ];    //FK: Shown frame, same format as getGBEmulatorFrameBuffer()
+};
+
+//FK: The instance needs to have its rom loaded
+size_t calculateGBRunAheadMemoryRequirementsInBytes( const GBEmulatorInstance* pInstance )
+{
+    return sizeof( GBRunAhead ) + 64u + calculateGBEmulatorSnapshotSizeInBytes( pInstance );
+}
+
+//FK: pSecondInstance is optional (nullptr restores the snapshot into pInstance after the speculative frames).
+//    If used, it needs to have the same rom loaded as pInstance and its own cartridge ram.
+GBRunAhead* createGBRunAhead( uint8_t* pRunAheadMemory, GBEmulatorInstance* pInstance, GBEmulatorInstance* pSecondInstance, const uint32_t runAheadFrameCount )
+{
+    RuntimeAssert( pInstance != pSecondInstance );
+    RuntimeAssert( isGBEmulatorRomMapped( pInstance ) );
+
+    GBRunAhead* pRunAhead = ( GBRunAhead* )pRunAheadMemory;
+    memset( pRunAhead, 0, sizeof( GBRunAhead ) );
+
+    pRunAhead->pInstance            = pInstance;
+    pRunAhead->pSpeculativeInstance = pSecondInstance != nullptr ? pSecondInstance : pInstance;
+    pRunAhead->pSnapshotMemory      = ( uint8_t* )( ( ( size_t )( pRunAhead + 1 ) + 63u ) & ~( size_t )63u );
+    pRunAhead->runAheadFrameCount   = runAheadFrameCount;
+    memcpy( pRunAhead->frameBuffer, getGBEmulatorFrameBuffer( pInstance ), gbFrameBufferSizeInBytes );
+    return pRunAhead;
+}
+
+//FK: 0 disables run-ahead (the instance runs and renders as usual)
+void setGBRunAheadFrameCount( GBRunAhead* pRunAhead, const uint32_t runAheadFrameCount )
+{
+    pRunAhead->runAheadFrameCount = runAheadFrameCount;
+}
+
+//FK: Runs a frame the same way runGBEmulatorForCycles() does. The shown frame is the last one that gets finished (LY reaches 144) in the last frame
+//    of this host frame, so drawing starts at the last lcd vblank (or when the lcd gets enabled) of the frame before that.
+//    frameIndex is the frame within the current host frame (0 is the actual frame).
+void runGBRunAheadInstanceFrame( GBRunAhead* pRunAhead, GBEmulatorInstance* pInstance, const uint32_t frameIndex )
+{
+    GBMemoryMapper* pMemoryMapper = &pInstance->memoryMapper;
+    const uint8_t* pLy = getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY );
+    const uint32_t runAheadFrameCount = pRunAhead->runAheadFrameCount;
+    const bool8_t lookForShownFrame = frameIndex + 1u >= runAheadFrameCount;
+
+    uint32_t cycleCount = 0u;
+    while( cycleCount < gbCyclesPerFrame )
+    {
+        if( !lookForShownFrame )
+        {
+            cycleCount += runSingleInstruction( pInstance );
+            continue;
+        }
+
+        const uint8_t ly = *pLy;
+        const uint8_t lcdEnabled = getLcdControl( pMemoryMapper )->enable;
+        const uint32_t instructionStartCycleCount = cycleCount;
+        cycleCount += runSingleInstruction( pInstance );
+
+        const bool8_t frameFinished = *pLy == 144 && ly != 144;
+        const bool8_t lcdGotEnabled = !lcdEnabled && getLcdControl( pMemoryMapper )->enable;
+        if( !frameFinished && !lcdGotEnabled )
+        {
+            continue;
+        }
+
+        //FK: Length of the ppu frame that just got finished (0 if unknown), the next frame will take as long unless the lcd gets enabled in between
+        const uint64_t frameFinishedCycleCount = pRunAhead->hostFrameCycleCount + cycleCount;
+        const uint64_t ppuFrameCycleCount = frameFinished && pRunAhead->frameFinishedCycleCount > 0u ? frameFinishedCycleCount - pRunAhead->frameFinishedCycleCount : 0u;
+        pRunAhead->frameFinishedCycleCount = frameFinished ? frameFinishedCycleCount : 0u;
+
+        if( pRunAhead->renderState == K15_GB_RUN_AHEAD_WAIT_FOR_SHOWN_FRAME )
+        {
+            pRunAhead->renderState = K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME;
+            setGBEmulatorRenderingEnabled( pInstance, 1u );
+        }
+        else if( frameFinished && pRunAhead->renderState == K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME && frameIndex == runAheadFrameCount )
+        {
+            memcpy( pRunAhead->frameBuffer, getGBEmulatorFrameBuffer( pInstance ), gbFrameBufferSizeInBytes );
+
+            //FK: Keep drawing if the next frame could still get finished before the last instruction of this frame starts (at gbCyclesPerFrame),
+            //    the later frame is the shown one then. Both cycle counts are only known up to the length of an instruction (< 256 cycles).
+            //    Without run-ahead every frame gets shown.
+            if( runAheadFrameCount > 0u && ppuFrameCycleCount > 0u && instructionStartCycleCount + ppuFrameCycleCount >= gbCyclesPerFrame + 2u * 0xFFu )
+            {
+                pRunAhead->renderState = K15_GB_RUN_AHEAD_SHOWN_FRAME_DONE;
+                setGBEmulatorRenderingEnabled( pInstance, 0u );
+            }
+        }
+        else if( lcdGotEnabled && pRunAhead->renderState == K15_GB_RUN_AHEAD_SHOWN_FRAME_DONE && frameIndex == runAheadFrameCount )
+        {
+            //FK: The lcd got disabled after the shown frame, the frame that starts now gets shown if it gets finished in this frame
+            pRunAhead->renderState = K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME;
+            setGBEmulatorRenderingEnabled( pInstance, 1u );
+        }
+    }
+
+    pRunAhead->hostFrameCycleCount += cycleCount;
+}
+
+//FK: Call once per host frame instead of runGBEmulatorForCycles( pInstance, gbCyclesPerFrame ). Returns the event mask of the actual frame,
+//    the frame to show is available using getGBRunAheadFrameBuffer() afterwards.
+GBEmulatorInstanceEventMask runGBRunAheadFrame( GBRunAhead* pRunAhead, GBEmulatorJoypadState joypadState )
+{
+    GBEmulatorInstance* pInstance = pRunAhead->pInstance;
+    GBEmulatorInstance* pSpeculativeInstance = pRunAhead->pSpeculativeInstance;
+    const uint32_t runAheadFrameCount = pRunAhead->runAheadFrameCount;
+
+    pRunAhead->renderState = runAheadFrameCount > 0u ? K15_GB_RUN_AHEAD_WAIT_FOR_SHOWN_FRAME : K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME;
+    pRunAhead->hostFrameCycleCount      = 0u;
+    pRunAhead->frameFinishedCycleCount  = 0u;
+    setGBEmulatorRenderingEnabled( pInstance, runAheadFrameCount == 0u );
+    setGBEmulatorJoypadState( pInstance, joypadState );
+
+    const uint32_t joypadAccessCount = getGBEmulatorJoypadAccessCount( pInstance );
+    pInstance->flags.value = 0;
+    runGBRunAheadInstanceFrame( pRunAhead, pInstance, 0u );
+
+    const GBEmulatorInstanceEventMask eventMask = collectGBEmulatorRunEvents( pInstance, joypadAccessCount );
+    ++pRunAhead->stats.frameCount;
+
+    if( runAheadFrameCount == 0u )
+    {
+        return eventMask;
+    }
+
+    snapshotGBEmulator( pInstance, pRunAhead->pSnapshotMemory );
+    if( pSpeculativeInstance != pInstance )
+    {
+        restoreGBEmulator( pSpeculativeInstance, pRunAhead->pSnapshotMemory );
+        setGBEmulatorRenderingEnabled( pSpeculativeInstance, pRunAhead->renderState == K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME );
+
+        //FK: The shown frame started during the actual frame, continue drawing it on the second instance
+        if( pRunAhead->renderState == K15_GB_RUN_AHEAD_RENDER_SHOWN_FRAME )
+        {
+            memcpy( pSpeculativeInstance->gbFrameBuffers, pInstance->gbFrameBuffers, sizeof( pInstance->gbFrameBuffers ) );
+        }
+    }
+
+    GBInputQueue* pInputQueue = pSpeculativeInstance->pInputQueue;
+    setGBEmulatorInputQueue( pSpeculativeInstance, nullptr );
+
+    for( uint32_t frameIndex = 1u; frameIndex <= runAheadFrameCount; ++frameIndex )
+    {
+        runGBRunAheadInstanceFrame( pRunAhead, pSpeculativeInstance, frameIndex );
+    }
+
+    setGBEmulatorInputQueue( pSpeculativeInstance, pInputQueue );
+
+    if( pSpeculativeInstance == pInstance )
+    {
+        restoreGBEmulator( pInstance, pRunAhead->pSnapshotMemory );
+    }
+
+    setGBEmulatorRenderingEnabled( pInstance, 1u );
+    setGBEmulatorRenderingEnabled( pSpeculativeInstance, 1u );
+    pRunAhead->stats.speculativeFrameCount += runAheadFrameCount;
+    return eventMask;
+}
+
+const uint8_t* getGBRunAheadFrameBuffer( const GBRunAhead* pRunAhead )
+{
+    return pRunAhead->frameBuffer;
+}
+
+GBRunAheadStats getGBRunAheadStats( const GBRunAhead* pRunAhead )
+{
+    return pRunAhead->stats;
+}
+
+#endif //K15_GB_RUN_AHEAD
@@ -0,0 +1,341 @@
+#ifndef K15_GB_SHARED_CHANNEL
+#define K15_GB_SHARED_CHANNEL
+
+//FK: Linux only - Shared memory channel between an emulator process and an external controller process (bots, tools, training code).
+//    The emulator publishes the framebuffer and a few ram windows into a shm_open() mapping after every frame and waits for the input
+//    of the controller before running the next frame. Both handshakes are futex words inside of the mapping, so there is
+//    no serialization, no socket and no copy besides the framebuffer/ram copy into the mapping.
+//
+//    This header is plain C and doesn't need 'k15_gb_emulator.h' - controllers include it on its own.
+//    Include it *after* 'k15_gb_emulator.h' to additionally get the emulator side (publishGBSharedChannelFrame() and waitForGBSharedChannelInput()).
+
+#ifndef __linux__
+#   error "The shared channel is only available on Linux"
+#endif
+
+//FK: syscall(), ftruncate() and clock_gettime() are not declared in strict C modes otherwise
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define K15_GB_SHARED_CHANNEL_MAGIC                     0x4B314743u     //FK: 'K1GC'
+#define K15_GB_SHARED_CHANNEL_VERSION                   1u
+#define K15_GB_SHARED_CHANNEL_FRAME_BUFFER_SIZE         5760u           //FK: 160x144 pixels, 2bpp
+#define K15_GB_SHARED_CHANNEL_MAX_RAM_WINDOW_COUNT      16u
+#define K15_GB_SHARED_CHANNEL_CACHE_LINE_SIZE           64u
+
+//FK: Number of times a wait checks the futex word before going to sleep, tune down when controller and emulator share a core
+#ifndef K15_GB_SHARED_CHANNEL_SPIN_COUNT
+#   define K15_GB_SHARED_CHANNEL_SPIN_COUNT             4096u
+#endif
+
+//FK: Input buttons (same bit layout as the actions of k15_gb_rl_env.h)
+enum
+{
+    K15_GB_SHARED_CHANNEL_A_FLAG        = 0x01,
+    K15_GB_SHARED_CHANNEL_B_FLAG        = 0x02,
+    K15_GB_SHARED_CHANNEL_SELECT_FLAG   = 0x04,
+    K15_GB_SHARED_CHANNEL_START_FLAG    = 0x08,
+    K15_GB_SHARED_CHANNEL_RIGHT_FLAG    = 0x10,
+    K15_GB_SHARED_CHANNEL_LEFT_FLAG     = 0x20,
+    K15_GB_SHARED_CHANNEL_UP_FLAG       = 0x40,
+    K15_GB_SHARED_CHANNEL_DOWN_FLAG     = 0x80
+};
+
+typedef struct GBSharedChannelRamWindow
+{
+    uint16_t    address;            //FK: Gameboy address of the first byte
+    uint16_t    sizeInBytes;
+    uint32_t    offset;             //FK: Offset of the window data relative to the start of the channel
+} GBSharedChannelRamWindow;
+
+//FK: Layout of the shared mapping, the framebuffer and the ram windows follow right after.
+//    Every futex word sits on its own cache line so the two processes don't write to the same line.
+typedef struct GBSharedChannel
+{
+    uint32_t                    magic;
+    uint32_t                    version;
+    uint32_t                    sizeInBytes;
+    uint32_t                    ramWindowCount;
+    uint32_t                    frameBufferOffset;
+    uint32_t                    closed;             //FK: Set by the emulator side when it shuts down the channel
+    GBSharedChannelRamWindow    ramWindows[ K15_GB_SHARED_CHANNEL_MAX_RAM_WINDOW_COUNT ];
+
+    //FK: Written by the emulator side - incremented after a frame has been published
+    uint32_t                    frameSequence;
+    uint32_t                    paddingFrameSequence;
+    uint64_t                    frameIndex;
+    uint64_t                    frameTimestampInNanoseconds;    //FK: CLOCK_MONOTONIC time of the publish
+    uint8_t                     paddingFrame[ K15_GB_SHARED_CHANNEL_CACHE_LINE_SIZE - 24u ];
+
+    //FK: Written by the controller side - set to the frame sequence the input belongs to after the input has been written
+    uint32_t                    inputSequence;
+    uint8_t                     buttons;
+    uint8_t                     paddingInput[ K15_GB_SHARED_CHANNEL_CACHE_LINE_SIZE - 5u ];
+} GBSharedChannel;
+
+uint64_t getGBSharedChannelTimeInNanoseconds( void )
+{
+    struct timespec time;
+    clock_gettime( CLOCK_MONOTONIC, &time );
+    return ( uint64_t )time.tv_sec * 1000000000ull + ( uint64_t )time.tv_nsec;
+}
+
+uint32_t calculateGBSharedChannelSizeInBytes( const uint16_t* pRamWindowSizesInBytes, const uint32_t ramWindowCount )
+{
+    uint32_t sizeInBytes = ( uint32_t )sizeof( GBSharedChannel ) + K15_GB_SHARED_CHANNEL_FRAME_BUFFER_SIZE;
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < ramWindowCount; ++ramWindowIndex )
+    {
+        sizeInBytes += pRamWindowSizesInBytes[ ramWindowIndex ];
+    }
+
+    return sizeInBytes;
+}
+
+void wakeGBSharedChannelWaiters( uint32_t* pFutexWord )
+{
+    syscall( SYS_futex, pFutexWord, FUTEX_WAKE, 1, NULL, NULL, 0 );
+}
+
+//FK: Waits until *pFutexWord != unexpectedValue or the channel got closed. Spins for a bit before sleeping on the futex.
+//    Returns the new value, unexpectedValue on timeout or when the channel got closed. A timeout of 0 waits forever.
+uint32_t waitForGBSharedChannelChange( GBSharedChannel* pChannel, uint32_t* pFutexWord, const uint32_t unexpectedValue, const uint64_t timeoutInNanoseconds )
+{
+    for( uint32_t spinIndex = 0u; spinIndex < K15_GB_SHARED_CHANNEL_SPIN_COUNT; ++spinIndex )
+    {
+        const uint32_t value = __atomic_load_n( pFutexWord, __ATOMIC_ACQUIRE );
+        if( value != unexpectedValue )
+        {
+            return value;
+        }
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+        __builtin_ia32_pause();
+#endif
+    }
+
+    const uint64_t startTimeInNanoseconds = getGBSharedChannelTimeInNanoseconds();
+    while( __atomic_load_n( &pChannel->closed, __ATOMIC_ACQUIRE ) == 0u )
+    {
+        const uint32_t value = __atomic_load_n( pFutexWord, __ATOMIC_ACQUIRE );
+        if( value != unexpectedValue )
+        {
+            return value;
+        }
+
+        struct timespec timeout = { 0, 0 };
+        struct timespec* pTimeout = NULL;
+        if( timeoutInNanoseconds > 0u )
+        {
+            const uint64_t elapsedTimeInNanoseconds = getGBSharedChannelTimeInNanoseconds() - startTimeInNanoseconds;
+            if( elapsedTimeInNanoseconds >= timeoutInNanoseconds )
+            {
+                break;
+            }
+
+            const uint64_t remainingTimeInNanoseconds = timeoutInNanoseconds - elapsedTimeInNanoseconds;
+            timeout.tv_sec  = ( time_t )( remainingTimeInNanoseconds / 1000000000ull );
+            timeout.tv_nsec = ( long )( remainingTimeInNanoseconds % 1000000000ull );
+            pTimeout = &timeout;
+        }
+
+        //FK: Returns right away with EAGAIN if the value changed in the meantime
+        syscall( SYS_futex, pFutexWord, FUTEX_WAIT, unexpectedValue, pTimeout, NULL, 0 );
+    }
+
+    return __atomic_load_n( pFutexWord, __ATOMIC_ACQUIRE );
+}
+
+const uint8_t* getGBSharedChannelFrameBuffer( const GBSharedChannel* pChannel )
+{
+    return ( const uint8_t* )pChannel + pChannel->frameBufferOffset;
+}
+
+const uint8_t* getGBSharedChannelRamWindow( const GBSharedChannel* pChannel, const uint32_t ramWindowIndex )
+{
+    return ramWindowIndex < pChannel->ramWindowCount ? ( const uint8_t* )pChannel + pChannel->ramWindows[ ramWindowIndex ].offset : NULL;
+}
+
+//FK: Emulator side - creates (or recreates) the shared memory object 'pName' (eg: "/k15_gb_channel") with the given ram windows.
+//    Returns NULL if the shared memory couldn't be created.
+GBSharedChannel* createGBSharedChannel( const char* pName, const uint16_t* pRamWindowAddresses, const uint16_t* pRamWindowSizesInBytes, uint32_t ramWindowCount )
+{
+    if( ramWindowCount > K15_GB_SHARED_CHANNEL_MAX_RAM_WINDOW_COUNT )
+    {
+        return NULL;
+    }
+
+    const uint32_t sizeInBytes = calculateGBSharedChannelSizeInBytes( pRamWindowSizesInBytes, ramWindowCount );
+    shm_unlink( pName );
+
+    const int sharedMemoryFileDescriptor = shm_open( pName, O_CREAT | O_EXCL | O_RDWR, 0600 );
+    if( sharedMemoryFileDescriptor < 0 )
+    {
+        return NULL;
+    }
+
+    if( ftruncate( sharedMemoryFileDescriptor, sizeInBytes ) != 0 )
+    {
+        close( sharedMemoryFileDescriptor );
+        shm_unlink( pName );
+        return NULL;
+    }
+
+    void* pMemory = mmap( NULL, sizeInBytes, PROT_READ | PROT_WRITE, MAP_SHARED, sharedMemoryFileDescriptor, 0 );
+    close( sharedMemoryFileDescriptor );
+    if( pMemory == MAP_FAILED )
+    {
+        shm_unlink( pName );
+        return NULL;
+    }
+
+    //FK: ftruncate() zeroed the memory
+    GBSharedChannel* pChannel       = ( GBSharedChannel* )pMemory;
+    pChannel->version               = K15_GB_SHARED_CHANNEL_VERSION;
+    pChannel->sizeInBytes           = sizeInBytes;
+    pChannel->ramWindowCount        = ramWindowCount;
+    pChannel->frameBufferOffset     = ( uint32_t )sizeof( GBSharedChannel );
+
+    uint32_t ramWindowOffset = pChannel->frameBufferOffset + K15_GB_SHARED_CHANNEL_FRAME_BUFFER_SIZE;
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < ramWindowCount; ++ramWindowIndex )
+    {
+        pChannel->ramWindows[ ramWindowIndex ].address      = pRamWindowAddresses[ ramWindowIndex ];
+        pChannel->ramWindows[ ramWindowIndex ].sizeInBytes  = pRamWindowSizesInBytes[ ramWindowIndex ];
+        pChannel->ramWindows[ ramWindowIndex ].offset       = ramWindowOffset;
+        ramWindowOffset += pRamWindowSizesInBytes[ ramWindowIndex ];
+    }
+
+    //FK: Controllers only accept the channel once the magic is there
+    __atomic_store_n( &pChannel->magic, K15_GB_SHARED_CHANNEL_MAGIC, __ATOMIC_RELEASE );
+    return pChannel;
+}
+
+//FK: Emulator side - wakes up the controller (its waits return), unmaps the channel and removes the shared memory object
+void destroyGBSharedChannel( GBSharedChannel* pChannel, const char* pName )
+{
+    __atomic_store_n( &pChannel->closed, 1u, __ATOMIC_RELEASE );
+    wakeGBSharedChannelWaiters( &pChannel->frameSequence );
+    wakeGBSharedChannelWaiters( &pChannel->inputSequence );
+
+    munmap( pChannel, pChannel->sizeInBytes );
+    shm_unlink( pName );
+}
+
+//FK: Controller side - maps the channel created by the emulator process, returns NULL if it doesn't exist (yet)
+GBSharedChannel* openGBSharedChannel( const char* pName )
+{
+    const int sharedMemoryFileDescriptor = shm_open( pName, O_RDWR, 0600 );
+    if( sharedMemoryFileDescriptor < 0 )
+    {
+        return NULL;
+    }
+
+    struct stat sharedMemoryStat;
+    if( fstat( sharedMemoryFileDescriptor, &sharedMemoryStat ) != 0 || ( size_t )sharedMemoryStat.st_size < sizeof( GBSharedChannel ) )
+    {
+        close( sharedMemoryFileDescriptor );
+        return NULL;
+    }
+
+    void* pMemory = mmap( NULL, ( size_t )sharedMemoryStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, sharedMemoryFileDescriptor, 0 );
+    close( sharedMemoryFileDescriptor );
+    if( pMemory == MAP_FAILED )
+    {
+        return NULL;
+    }
+
+    GBSharedChannel* pChannel = ( GBSharedChannel* )pMemory;
+    if( __atomic_load_n( &pChannel->magic, __ATOMIC_ACQUIRE ) != K15_GB_SHARED_CHANNEL_MAGIC || pChannel->version != K15_GB_SHARED_CHANNEL_VERSION )
+    {
+        munmap( pMemory, ( size_t )sharedMemoryStat.st_size );
+        return NULL;
+    }
+
+    return pChannel;
+}
+
+//FK: Controller side
+void closeGBSharedChannel( GBSharedChannel* pChannel )
+{
+    munmap( pChannel, pChannel->sizeInBytes );
+}
+
+//FK: Controller side - waits for a frame newer than lastFrameSequence, returns its sequence (lastFrameSequence on timeout or when the channel got closed).
+//    The framebuffer and the ram windows stay untouched until the input for that frame got submitted.
+uint32_t waitForGBSharedChannelFrame( GBSharedChannel* pChannel, const uint32_t lastFrameSequence, const uint64_t timeoutInNanoseconds )
+{
+    return waitForGBSharedChannelChange( pChannel, &pChannel->frameSequence, lastFrameSequence, timeoutInNanoseconds );
+}
+
+//FK: Controller side - sets the buttons that the emulator uses for the frame after frameSequence and lets the emulator continue
+void submitGBSharedChannelInput( GBSharedChannel* pChannel, const uint8_t buttons, const uint32_t frameSequence )
+{
+    pChannel->buttons = buttons;
+    __atomic_store_n( &pChannel->inputSequence, frameSequence, __ATOMIC_RELEASE );
+    wakeGBSharedChannelWaiters( &pChannel->inputSequence );
+}
+
+#ifdef K15_GB_EMULATOR
+static_assert( K15_GB_SHARED_CHANNEL_FRAME_BUFFER_SIZE == gbFrameBufferSizeInBytes, "Framebuffer size of the shared channel doesn't match" );
+
+//FK: Emulator side - copies the framebuffer and the ram windows into the channel and wakes up the controller.
+//    Returns the sequence of the published frame.
+uint32_t publishGBSharedChannelFrame( GBSharedChannel* pChannel, GBEmulatorInstance* pEmulatorInstance )
+{
+    uint8_t* pChannelMemory = ( uint8_t* )pChannel;
+    memcpy( pChannelMemory + pChannel->frameBufferOffset, getGBEmulatorFrameBuffer( pEmulatorInstance ), gbFrameBufferSizeInBytes );
+
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < pChannel->ramWindowCount; ++ramWindowIndex )
+    {
+        const GBSharedChannelRamWindow* pRamWindow = pChannel->ramWindows + ramWindowIndex;
+        for( uint32_t byteIndex = 0u; byteIndex < pRamWindow->sizeInBytes; ++byteIndex )
+        {
+            pChannelMemory[ pRamWindow->offset + byteIndex ] = getMappedMemoryValue( &pEmulatorInstance->memoryMapper, ( uint16_t )( pRamWindow->address + byteIndex ) );
+        }
+    }
+
+    ++pChannel->frameIndex;
+    pChannel->frameTimestampInNanoseconds = getGBSharedChannelTimeInNanoseconds();
+
+    const uint32_t frameSequence = pChannel->frameSequence + 1u;
+    __atomic_store_n( &pChannel->frameSequence, frameSequence, __ATOMIC_RELEASE );
+    wakeGBSharedChannelWaiters( &pChannel->frameSequence );
+    return frameSequence;
+}
+
+//FK: Emulator side - waits until the controller submitted the input for the last published frame and sets it as the joypad state.
+//    Returns 0 on timeout (a timeout of 0 waits forever), the joypad state stays untouched in that case.
+bool8_t waitForGBSharedChannelInput( GBSharedChannel* pChannel, GBEmulatorInstance* pEmulatorInstance, const uint64_t timeoutInNanoseconds )
+{
+    const uint32_t frameSequence = __atomic_load_n( &pChannel->frameSequence, __ATOMIC_RELAXED );
+    uint32_t inputSequence = __atomic_load_n( &pChannel->inputSequence, __ATOMIC_ACQUIRE );
+    if( inputSequence != frameSequence )
+    {
+        inputSequence = waitForGBSharedChannelChange( pChannel, &pChannel->inputSequence, inputSequence, timeoutInNanoseconds );
+    }
+
+    if( inputSequence != frameSequence )
+    {
+        return 0u;
+    }
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.actionButtonMask    = pChannel->buttons & 0x0F;
+    joypadState.dpadButtonMask      = pChannel->buttons >> 4;
+    setGBEmulatorJoypadState( pEmulatorInstance, joypadState );
+    return 1u;
+}
+#endif //K15_GB_EMULATOR
+
+#endif //K15_GB_SHARED_CHANNEL
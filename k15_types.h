@@ -9,8 +9,9 @@
 #   define BreakPointHook()         __nop()
 #   define DebugBreak               __debugbreak
 #else
+#   include <signal.h>
 #   define BreakPointHook()
-#   define DebugBreak
+#   define DebugBreak()             raise( SIGTRAP )
 #endif
 
 #define K15_UNUSED_VAR(x) (void)x
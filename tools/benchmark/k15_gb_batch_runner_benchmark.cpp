@@ -0,0 +1,109 @@
+//FK: Measures how the aggregate emulation speed of the batch runner scales with the number of worker threads.
+//    Build (from the repository root):
+//      cl /nologo /O2 /EHsc /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_batch_runner_benchmark.cpp
+//    Usage:
+//      k15_gb_batch_runner_benchmark <rom file> [instances per worker] [frames per batch] [batch count] [max worker count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_batch_runner.h"
+
+static constexpr uint32_t gbBenchmarkDefaultInstancesPerWorker  = 4u;
+static constexpr uint32_t gbBenchmarkDefaultFramesPerBatch      = 10u;
+static constexpr uint32_t gbBenchmarkDefaultBatchCount          = 30u;
+
+//FK: Returns the aggregate number of emulated frames per second, instance count grows with the worker count (weak scaling)
+double measureGBBatchRunnerFramesPerSecond( const uint8_t* pRomData, const uint32_t workerCount, const uint32_t instancesPerWorker,
+    const uint32_t framesPerBatch, const uint32_t batchCount, uint64_t* pOutStolenInstanceCount )
+{
+    const uint32_t instanceCount = workerCount * instancesPerWorker;
+    uint8_t* pBatchRunnerMemory = ( uint8_t* )malloc( calculateGBBatchRunnerMemoryRequirementsInBytes( workerCount, instanceCount ) );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( instanceCount, gbMaxRamSizeInBytes );
+    uint32_t* pCycleBudgets = ( uint32_t* )malloc( instanceCount * sizeof( uint32_t ) );
+    GBEmulatorInstanceEventMask* pEventMasks = ( GBEmulatorInstanceEventMask* )malloc( instanceCount * sizeof( GBEmulatorInstanceEventMask ) );
+
+    GBBatchRunner* pBatchRunner = createGBBatchRunner( pBatchRunnerMemory, workerCount, instanceCount );
+    for( uint32_t instanceIndex = 0u; instanceIndex < instanceCount; ++instanceIndex )
+    {
+        loadGBEmulatorRom( getGBBatchRunnerInstance( pBatchRunner, instanceIndex ), pRomData, pCartridgeRamMemory + instanceIndex * gbMaxRamSizeInBytes );
+        pCycleBudgets[ instanceIndex ] = framesPerBatch * gbCyclesPerFrame;
+    }
+
+    //FK: Warmup
+    runGBBatch( pBatchRunner, pCycleBudgets, pEventMasks );
+
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t batchIndex = 0u; batchIndex < batchCount; ++batchIndex )
+    {
+        runGBBatch( pBatchRunner, pCycleBudgets, pEventMasks );
+    }
+    const double elapsedSeconds = getElapsedSeconds( startTime );
+
+    *pOutStolenInstanceCount = getGBBatchRunnerStats( pBatchRunner ).stolenInstanceCount;
+    destroyGBBatchRunner( pBatchRunner );
+
+    free( pEventMasks );
+    free( pCycleBudgets );
+    free( pCartridgeRamMemory );
+    free( pBatchRunnerMemory );
+
+    return ( double )instanceCount * framesPerBatch * batchCount / elapsedSeconds;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [instances per worker] [frames per batch] [batch count] [max worker count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t instancesPerWorker   = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultInstancesPerWorker;
+    const uint32_t framesPerBatch       = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultFramesPerBatch;
+    const uint32_t batchCount           = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : gbBenchmarkDefaultBatchCount;
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    const uint32_t coreCount = argc > 5 ? ( uint32_t )strtoul( argv[ 5 ], nullptr, 10 ) : getGBBatchRunnerDefaultWorkerCount();
+    if( coreCount == 0u || coreCount > gbBatchRunnerMaxWorkerCount )
+    {
+        printf( "Max worker count needs to be between 1 and %u\n", gbBatchRunnerMaxWorkerCount );
+        return 1;
+    }
+
+    //FK: The rom is shared by all instances, so the instance stride is the whole per-instance cost (plus the cartridge ram)
+    const size_t instanceStrideInBytes = calculateGBBatchRunnerInstanceStrideInBytes();
+    printf( "max workers: %u, %u instances per worker, %u frames per batch, %u batches\n", coreCount, instancesPerWorker, framesPerBatch, batchCount );
+    printf( "instance:    %zu bytes (%zu bytes stride, %.0f instances per GB)\n", calculateGBEmulatorMemoryRequirementsInBytes(), instanceStrideInBytes, ( double )Mbyte( 1024 ) / instanceStrideInBytes );
+    printf( "workers  instances  frames/s      speedup  efficiency  stolen\n" );
+
+    double singleWorkerFramesPerSecond = 0.0;
+    uint32_t workerCount = 1u;
+    while( true )
+    {
+        uint64_t stolenInstanceCount = 0u;
+        const double framesPerSecond = measureGBBatchRunnerFramesPerSecond( pRomData, workerCount, instancesPerWorker, framesPerBatch, batchCount, &stolenInstanceCount );
+        if( workerCount == 1u )
+        {
+            singleWorkerFramesPerSecond = framesPerSecond;
+        }
+
+        const double speedup = framesPerSecond / singleWorkerFramesPerSecond;
+        printf( "%7u  %9u  %12.0f  %6.2fx  %9.0f%%  %6llu\n", workerCount, workerCount * instancesPerWorker, framesPerSecond,
+            speedup, speedup / workerCount * 100.0, ( unsigned long long )stolenInstanceCount );
+
+        if( workerCount == coreCount )
+        {
+            break;
+        }
+
+        workerCount = GetMin( workerCount * 2u, coreCount );
+    }
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+//FK: Measures the overhead of the input queue and compares its input latency against polling the last joypad state once per frame.
+//    An input thread changes the joypad state at a fixed rate and pushes every change with its host timestamp, while the emulator runs in real time
+//    in slices of a frame. Frame polling is evaluated on the same input changes (changes that get overwritten before the next frame are lost).
+//    Finally the recorded events get replayed without threads, which has to reproduce the exact same state.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_input_queue_benchmark.cpp
+//    Usage:
+//      k15_gb_input_queue_benchmark <rom file> [seconds] [slices per frame] [input changes per second]
+
+#include <thread>
+
+#include "../k15_gb_tool_common.h"
+
+static constexpr uint32_t gbBenchmarkDefaultSeconds             = 3u;
+static constexpr uint32_t gbBenchmarkDefaultSliceCount          = 4u;
+static constexpr uint32_t gbBenchmarkDefaultInputChangeRate     = 250u;
+static constexpr uint32_t gbBenchmarkOverheadFrameCount         = 600u;
+static constexpr uint32_t gbBenchmarkOverheadEventsPerFrame     = 16u;
+
+struct InputChange
+{
+    int64_t                 hostTimeInNanoseconds;
+    uint64_t                cycle;
+    GBEmulatorJoypadState   joypadState;
+};
+
+int64_t getHostTimeInNanoseconds()
+{
+    return ( int64_t )std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+void sleepUntilHostTime( const int64_t hostTimeInNanoseconds )
+{
+    std::this_thread::sleep_until( std::chrono::steady_clock::time_point( std::chrono::nanoseconds( hostTimeInNanoseconds ) ) );
+}
+
+GBEmulatorJoypadState getInputChangeJoypadState( const uint32_t changeIndex )
+{
+    uint32_t value = 0x9E3779B9u ^ changeIndex * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory );
+    return pInstance;
+}
+
+void runInputThread( GBInputQueue* pInputQueue, InputChange* pInputChanges, const uint32_t inputChangeCount, const int64_t startTimeInNanoseconds, const uint32_t inputChangeRate )
+{
+    for( uint32_t changeIndex = 0u; changeIndex < inputChangeCount; ++changeIndex )
+    {
+        sleepUntilHostTime( startTimeInNanoseconds + ( int64_t )changeIndex * 1000000000ll / inputChangeRate );
+
+        InputChange* pInputChange = pInputChanges + changeIndex;
+        pInputChange->hostTimeInNanoseconds = getHostTimeInNanoseconds();
+        pInputChange->cycle                 = convertGBInputQueueHostTimeToCycle( pInputQueue, pInputChange->hostTimeInNanoseconds );
+        pInputChange->joypadState           = getInputChangeJoypadState( changeIndex );
+
+        while( !pushGBInputEvent( pInputQueue, pInputChange->cycle, pInputChange->joypadState ) )
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [seconds] [slices per frame] [input changes per second]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t seconds          = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultSeconds;
+    const uint32_t sliceCount       = argc > 3 ? GetMax( 1u, ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) ) : gbBenchmarkDefaultSliceCount;
+    const uint32_t inputChangeRate  = argc > 4 ? GetMax( 1u, ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) ) : gbBenchmarkDefaultInputChangeRate;
+
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    GBEmulatorInstance* pStartInstance = createInstance( pRomData );
+    uint8_t* pStartSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pStartInstance ) );
+    snapshotGBEmulator( pStartInstance, pStartSnapshot );
+
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+    uint8_t* pInputQueueMemory = ( uint8_t* )malloc( calculateGBInputQueueMemoryRequirementsInBytes() );
+    const uint32_t sliceCycleCount = gbCyclesPerFrame / sliceCount;
+
+    //FK: Overhead - the same frames without a queue and with a queue that applies an event every 1/16th of a frame
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkOverheadFrameCount; ++frameIndex )
+    {
+        setGBEmulatorJoypadState( pInstance, getInputChangeJoypadState( frameIndex ) );
+        runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+    }
+    const double withoutQueueSeconds = getElapsedSeconds( startTime );
+
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    GBInputQueue* pInputQueue = createGBInputQueue( pInputQueueMemory, 0u );
+    setGBEmulatorInputQueue( pInstance, pInputQueue );
+    startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkOverheadFrameCount; ++frameIndex )
+    {
+        const uint64_t frameStartCycle = getGBEmulatorCycleCount( pInstance );
+        for( uint32_t eventIndex = 0u; eventIndex < gbBenchmarkOverheadEventsPerFrame; ++eventIndex )
+        {
+            const uint64_t cycle = frameStartCycle + eventIndex * ( gbCyclesPerFrame / gbBenchmarkOverheadEventsPerFrame );
+            pushGBInputEvent( pInputQueue, cycle, getInputChangeJoypadState( frameIndex * gbBenchmarkOverheadEventsPerFrame + eventIndex ) );
+        }
+
+        runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+    }
+    const double withQueueSeconds = getElapsedSeconds( startTime );
+
+    //FK: Real time - the emulator runs a slice of a frame per 1/(60*slice count) seconds, the input thread pushes changes with their host time
+    const uint32_t frameCount       = seconds * gbEmulatorFrameRate;
+    const uint32_t inputChangeCount = seconds * inputChangeRate;
+    InputChange* pInputChanges      = ( InputChange* )calloc( inputChangeCount, sizeof( InputChange ) );
+    int64_t* pFrameStartTimes       = ( int64_t* )malloc( ( frameCount + 1u ) * sizeof( int64_t ) );
+    int64_t* pFrameEndTimes         = ( int64_t* )malloc( ( frameCount + 1u ) * sizeof( int64_t ) );
+    const int64_t sliceTimeInNanoseconds = 1000000000ll / ( gbEmulatorFrameRate * sliceCount );
+
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    pInputQueue = createGBInputQueue( pInputQueueMemory, sliceCycleCount );
+    setGBEmulatorInputQueue( pInstance, pInputQueue );
+
+    const int64_t startTimeInNanoseconds = getHostTimeInNanoseconds() + 10000000ll;
+    publishGBInputQueueClock( pInputQueue, getGBEmulatorCycleCount( pInstance ), startTimeInNanoseconds );
+    std::thread inputThread( runInputThread, pInputQueue, pInputChanges, inputChangeCount, startTimeInNanoseconds + sliceTimeInNanoseconds / 3, inputChangeRate );
+
+    double totalQueueLatencyInMilliseconds = 0.0;
+    double maxQueueLatencyInMilliseconds = 0.0;
+    uint64_t maxLateCycleCount = 0u;
+    uint32_t lateEventCount = 0u;
+    uint32_t appliedEventCount = 0u;
+
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t sliceIndex = 0u; sliceIndex < sliceCount; ++sliceIndex )
+        {
+            const int64_t sliceStartTime = startTimeInNanoseconds + ( int64_t )( frameIndex * sliceCount + sliceIndex ) * sliceTimeInNanoseconds;
+            sleepUntilHostTime( sliceStartTime );
+
+            const uint64_t sliceStartCycle = getGBEmulatorCycleCount( pInstance );
+            publishGBInputQueueClock( pInputQueue, sliceStartCycle, getHostTimeInNanoseconds() );
+            if( sliceIndex == 0u )
+            {
+                pFrameStartTimes[ frameIndex ] = getHostTimeInNanoseconds();
+            }
+
+            runGBEmulatorForCycles( pInstance, sliceCycleCount );
+
+            //FK: Events get applied before the first instruction at or after their cycle
+            const int64_t sliceEndTime = getHostTimeInNanoseconds();
+            const uint32_t readIndex = pInputQueue->readIndex.load( std::memory_order_acquire );
+            for( ; appliedEventCount < readIndex; ++appliedEventCount )
+            {
+                const InputChange* pInputChange = pInputChanges + appliedEventCount;
+                const double latencyInMilliseconds = ( double )( sliceEndTime - pInputChange->hostTimeInNanoseconds ) / 1000000.0;
+                totalQueueLatencyInMilliseconds += latencyInMilliseconds;
+                maxQueueLatencyInMilliseconds = GetMax( maxQueueLatencyInMilliseconds, latencyInMilliseconds );
+
+                if( pInputChange->cycle < sliceStartCycle )
+                {
+                    ++lateEventCount;
+                    maxLateCycleCount = GetMax( maxLateCycleCount, sliceStartCycle - pInputChange->cycle );
+                }
+            }
+        }
+
+        pFrameEndTimes[ frameIndex ] = getHostTimeInNanoseconds();
+    }
+
+    inputThread.join();
+    const uint32_t queuedEventCount = inputChangeCount - appliedEventCount;
+
+    //FK: Frame polling on the same input changes - a change is seen at the start of the next frame unless another change happened before that
+    double totalPollingLatencyInMilliseconds = 0.0;
+    double maxPollingLatencyInMilliseconds = 0.0;
+    uint32_t polledChangeCount = 0u;
+    uint32_t lostChangeCount = 0u;
+    uint32_t frameIndex = 0u;
+    for( uint32_t changeIndex = 0u; changeIndex < inputChangeCount; ++changeIndex )
+    {
+        const int64_t changeTime = pInputChanges[ changeIndex ].hostTimeInNanoseconds;
+        while( frameIndex < frameCount && pFrameStartTimes[ frameIndex ] < changeTime )
+        {
+            ++frameIndex;
+        }
+
+        if( frameIndex == frameCount )
+        {
+            break;
+        }
+
+        if( changeIndex + 1u < inputChangeCount && pInputChanges[ changeIndex + 1u ].hostTimeInNanoseconds <= pFrameStartTimes[ frameIndex ] )
+        {
+            ++lostChangeCount;
+            continue;
+        }
+
+        const double latencyInMilliseconds = ( double )( pFrameEndTimes[ frameIndex ] - changeTime ) / 1000000.0;
+        totalPollingLatencyInMilliseconds += latencyInMilliseconds;
+        maxPollingLatencyInMilliseconds = GetMax( maxPollingLatencyInMilliseconds, latencyInMilliseconds );
+        ++polledChangeCount;
+    }
+
+    //FK: Replay of the recorded events without threads and without host timestamps, using the same slices
+    GBEmulatorInstance* pReplayInstance = createInstance( pRomData );
+    restoreGBEmulator( pReplayInstance, pStartSnapshot );
+    GBInputQueue* pReplayInputQueue = createGBInputQueue( ( uint8_t* )malloc( calculateGBInputQueueMemoryRequirementsInBytes() ), 0u );
+    setGBEmulatorInputQueue( pReplayInstance, pReplayInputQueue );
+
+    uint32_t replayedEventCount = 0u;
+    for( uint32_t sliceIndex = 0u; sliceIndex < frameCount * sliceCount; ++sliceIndex )
+    {
+        while( replayedEventCount < inputChangeCount && pushGBInputEvent( pReplayInputQueue, pInputChanges[ replayedEventCount ].cycle, pInputChanges[ replayedEventCount ].joypadState ) )
+        {
+            ++replayedEventCount;
+        }
+
+        runGBEmulatorForCycles( pReplayInstance, sliceCycleCount );
+    }
+
+    const bool8_t replayMatches = instancesMatch( pInstance, pReplayInstance );
+    const double hostFrameMilliseconds = 1000.0 / gbEmulatorFrameRate;
+
+    printf( "overhead:        %.0f frames/s without queue, %.0f frames/s with queue (%u events per frame, %+.1f%%)\n", gbBenchmarkOverheadFrameCount / withoutQueueSeconds,
+        gbBenchmarkOverheadFrameCount / withQueueSeconds, gbBenchmarkOverheadEventsPerFrame, ( withQueueSeconds / withoutQueueSeconds - 1.0 ) * 100.0 );
+    printf( "real time:       %u s, %u slices per %.1f ms frame, %u input changes per second\n", seconds, sliceCount, hostFrameMilliseconds, inputChangeRate );
+    printf( "input queue:     latency avg %.2f ms / max %.2f ms, %u of %u changes applied at their cycle (%u late by up to %llu cycles), %u still queued at the end\n",
+        appliedEventCount > 0u ? totalQueueLatencyInMilliseconds / appliedEventCount : 0.0, maxQueueLatencyInMilliseconds, appliedEventCount - lateEventCount, appliedEventCount,
+        lateEventCount, ( unsigned long long )maxLateCycleCount, queuedEventCount );
+    printf( "frame polling:   latency avg %.2f ms / max %.2f ms, %u of %u changes lost (overwritten before the next frame)\n",
+        polledChangeCount > 0u ? totalPollingLatencyInMilliseconds / polledChangeCount : 0.0, maxPollingLatencyInMilliseconds, lostChangeCount, polledChangeCount + lostChangeCount );
+    printf( "correctness:     %s (replaying the recorded events %s the state of the real time run)\n", replayMatches ? "ok" : "FAILED", replayMatches ? "reproduces" : "doesn't reproduce" );
+    return replayMatches ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+//FK: Reports how many frames of a rom are lag frames (the game neither reads nor writes JOYP) and what skipping them in the
+//    reinforcement learning environment costs and saves: steps per second, frames per step and steps whose action the game never saw.
+//    Also checks the lag frame detection against a single instruction loop and that the batch runner skips the same frames as the environment.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_lag_frame_benchmark.cpp
+//    Usage:
+//      k15_gb_lag_frame_benchmark <rom file> [frame count] [max lag frame skip count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_rl_env.h"
+#include "../../k15_gb_batch_runner.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount              = 3000u;
+static constexpr uint32_t gbBenchmarkDefaultMaxLagFrameSkipCount    = 8u;
+static constexpr uint32_t gbBenchmarkWarmupFrameCount               = 120u;
+static constexpr uint32_t gbBenchmarkInstanceCount                  = 16u;
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory );
+    return pInstance;
+}
+
+GBEnvironmentAction getStepAction( const uint32_t stepIndex, const uint32_t instanceIndex )
+{
+    uint32_t value = 0x9E3779B9u ^ ( stepIndex / 4u ) * 0x85EBCA6Bu ^ instanceIndex * 0xC2B2AE35u;
+    value ^= value >> 15u;
+    return ( GBEnvironmentAction )value;
+}
+
+struct EnvironmentResult
+{
+    double      stepsPerSecond;
+    uint64_t    frameCount;
+    uint64_t    lagFrameCount;
+    uint32_t    unseenActionCount;
+};
+
+//FK: Steps the environment holding every action for a single frame. An action is unseen if the game didn't poll the joypad during the step.
+EnvironmentResult measureEnvironment( const uint8_t* pRomData, const GBEmulatorInstance* pStartInstance, const uint32_t stepCount, const uint32_t maxLagFrameSkipCount,
+    uint8_t* pOutFirstInstanceSnapshot )
+{
+    GBEnvironmentSettings settings;
+    initGBEnvironmentSettings( &settings );
+    settings.observationMode        = K15_GB_ENVIRONMENT_OBSERVATION_RAM_ONLY;
+    settings.autoReset              = 0u;
+    settings.maxLagFrameSkipCount   = maxLagFrameSkipCount;
+
+    uint8_t* pEnvironmentMemory = ( uint8_t* )malloc( calculateGBEnvironmentMemoryRequirementsInBytes( pRomData, gbBenchmarkInstanceCount, &settings ) );
+    GBEnvironment* pEnvironment = createGBEnvironment( pEnvironmentMemory, pRomData, gbBenchmarkInstanceCount, &settings );
+    setGBEnvironmentStartInstance( pEnvironment, pStartInstance );
+
+    uint32_t lagFrameCounts[ gbBenchmarkInstanceCount ];
+    uint32_t joypadAccessCounts[ gbBenchmarkInstanceCount ];
+    GBEnvironmentAction actions[ gbBenchmarkInstanceCount ];
+    GBEnvironmentBuffers buffers;
+    buffers.pObservations   = nullptr;
+    buffers.pRamValues      = nullptr;
+    buffers.pDoneMasks      = nullptr;
+    buffers.pLagFrameCounts = lagFrameCounts;
+
+    resetGBEnvironment( pEnvironment, 0x4B3135ull, &buffers );
+
+    EnvironmentResult result;
+    result.frameCount           = 0u;
+    result.lagFrameCount        = 0u;
+    result.unseenActionCount    = 0u;
+
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t stepIndex = 0u; stepIndex < stepCount; ++stepIndex )
+    {
+        for( uint32_t instanceIndex = 0u; instanceIndex < gbBenchmarkInstanceCount; ++instanceIndex )
+        {
+            actions[ instanceIndex ] = getStepAction( stepIndex, instanceIndex );
+            joypadAccessCounts[ instanceIndex ] = getGBEmulatorJoypadAccessCount( getGBEnvironmentInstance( pEnvironment, instanceIndex ) );
+        }
+
+        stepGBEnvironment( pEnvironment, actions, 1u, &buffers );
+
+        for( uint32_t instanceIndex = 0u; instanceIndex < gbBenchmarkInstanceCount; ++instanceIndex )
+        {
+            const uint32_t joypadAccessCount = getGBEmulatorJoypadAccessCount( getGBEnvironmentInstance( pEnvironment, instanceIndex ) );
+            result.unseenActionCount    += joypadAccessCount == joypadAccessCounts[ instanceIndex ];
+            result.lagFrameCount        += lagFrameCounts[ instanceIndex ];
+            result.frameCount           += 1u + lagFrameCounts[ instanceIndex ];
+        }
+    }
+    result.stepsPerSecond = ( double )stepCount * gbBenchmarkInstanceCount / getElapsedSeconds( startTime );
+
+    //FK: The instance lives in (and points into) the environment memory, so only its state leaves the function
+    snapshotGBEmulator( getGBEnvironmentInstance( pEnvironment, 0u ), pOutFirstInstanceSnapshot );
+    destroyGBEnvironment( pEnvironment );
+    free( pEnvironmentMemory );
+    return result;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [frame count] [max lag frame skip count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount           = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+    const uint32_t maxLagFrameSkipCount = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultMaxLagFrameSkipCount;
+
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    GBEmulatorInstance* pStartInstance = createInstance( pRomData );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pStartInstance, gbCyclesPerFrame );
+    }
+
+    uint8_t* pStartSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pStartInstance ) );
+    snapshotGBEmulator( pStartInstance, pStartSnapshot );
+
+    //FK: Lag frames of the rom, the reference counts JOYP accesses of every frame (LY reaching 144) itself
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+    GBEmulatorInstance* pReferenceInstance = createInstance( pRomData );
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    restoreGBEmulator( pReferenceInstance, pStartSnapshot );
+
+    const GBInputPollStats startStats = getGBEmulatorInputPollStats( pInstance );
+    uint32_t mismatchCount = 0u;
+    uint32_t referenceLagFrameCount = 0u;
+    uint32_t lagFrameRunLength = 0u;
+    uint32_t longestLagFrameRunLength = 0u;
+    uint64_t polledFrameJoypadAccessCount = 0u;
+    uint32_t referenceJoypadAccessCount = getGBEmulatorJoypadAccessCount( pReferenceInstance );
+
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        const GBEmulatorRunResult result = runGBEmulatorUntil( pInstance, K15_GB_STOP_AT_VBLANK, 2u * gbCyclesPerFrame );
+        const GBInputPollStats stats = getGBEmulatorInputPollStats( pInstance );
+
+        while( true )
+        {
+            const uint8_t ly = *getMappedMemoryAddress( &pReferenceInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY );
+            runSingleInstruction( pReferenceInstance );
+            if( ly != 144 && *getMappedMemoryAddress( &pReferenceInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY ) == 144 )
+            {
+                break;
+            }
+        }
+
+        const uint32_t joypadAccessCount = getGBEmulatorJoypadAccessCount( pReferenceInstance );
+        const bool8_t referenceLagFrame = joypadAccessCount == referenceJoypadAccessCount;
+        referenceLagFrameCount += referenceLagFrame;
+        referenceJoypadAccessCount = joypadAccessCount;
+
+        mismatchCount += stats.lastFrameWasLagFrame != referenceLagFrame;
+        mismatchCount += ( ( result.eventMask & K15_GB_LAG_FRAME_EVENT_FLAG ) != 0u ) != referenceLagFrame;
+
+        lagFrameRunLength = stats.lastFrameWasLagFrame ? lagFrameRunLength + 1u : 0u;
+        longestLagFrameRunLength = GetMax( longestLagFrameRunLength, lagFrameRunLength );
+        polledFrameJoypadAccessCount += stats.lastFrameJoypadReadCount + stats.lastFrameJoypadWriteCount;
+    }
+
+    const GBInputPollStats stats = getGBEmulatorInputPollStats( pInstance );
+    const uint32_t lagFrameCount = stats.lagFrameCount - startStats.lagFrameCount;
+    mismatchCount += stats.frameCount - startStats.frameCount != frameCount;
+    mismatchCount += lagFrameCount != referenceLagFrameCount;
+
+    //FK: Environment with and without skipping lag frames
+    const uint32_t stepCount = frameCount / 4u;
+    uint8_t* pEnvironmentSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pStartInstance ) );
+    const EnvironmentResult withoutSkipping = measureEnvironment( pRomData, pStartInstance, stepCount, 0u, pEnvironmentSnapshot );
+    const EnvironmentResult withSkipping    = measureEnvironment( pRomData, pStartInstance, stepCount, maxLagFrameSkipCount, pEnvironmentSnapshot );
+
+    GBEmulatorInstance* pEnvironmentInstance = createInstance( pRomData );
+    restoreGBEmulator( pEnvironmentInstance, pEnvironmentSnapshot );
+
+    //FK: The batch runner has to skip the same frames as the environment did for its first instance
+    uint8_t* pBatchRunnerMemory = ( uint8_t* )malloc( calculateGBBatchRunnerMemoryRequirementsInBytes( 1u, 1u ) );
+    GBBatchRunner* pBatchRunner = createGBBatchRunner( pBatchRunnerMemory, 1u, 1u );
+    GBEmulatorInstance* pBatchInstance = getGBBatchRunnerInstance( pBatchRunner, 0u );
+    loadGBEmulatorRom( pBatchInstance, pRomData, ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes ) );
+    restoreGBEmulator( pBatchInstance, pStartSnapshot );
+    setGBBatchRunnerMaxLagFrameSkipCount( pBatchRunner, maxLagFrameSkipCount );
+
+    const uint32_t cycleBudget = gbCyclesPerFrame;
+    GBEmulatorInstanceEventMask eventMask = K15_GB_NO_EVENT_FLAG;
+    for( uint32_t stepIndex = 0u; stepIndex < stepCount; ++stepIndex )
+    {
+        const GBEnvironmentAction action = getStepAction( stepIndex, 0u );
+        GBEmulatorJoypadState joypadState;
+        joypadState.actionButtonMask    = action & 0x0F;
+        joypadState.dpadButtonMask      = action >> 4;
+        setGBEmulatorJoypadState( pBatchInstance, joypadState );
+        runGBBatch( pBatchRunner, &cycleBudget, &eventMask );
+    }
+
+    const bool8_t batchMatches = instancesMatch( pBatchInstance, pEnvironmentInstance );
+    const uint64_t batchSkippedLagFrameCount = getGBBatchRunnerStats( pBatchRunner ).skippedLagFrameCount;
+    mismatchCount += !batchMatches;
+    destroyGBBatchRunner( pBatchRunner );
+
+    const uint32_t polledFrameCount = frameCount - lagFrameCount;
+    const uint32_t actionCount = stepCount * gbBenchmarkInstanceCount;
+    printf( "frames:              %u\n", frameCount );
+    printf( "lag frames:          %u (%.1f%%), longest run %u frames, %.1f JOYP accesses per polled frame\n", lagFrameCount,
+        ( double )lagFrameCount / frameCount * 100.0, longestLagFrameRunLength, polledFrameCount > 0u ? ( double )polledFrameJoypadAccessCount / polledFrameCount : 0.0 );
+    printf( "environment:         %u instances, %u steps holding each action for 1 frame\n", gbBenchmarkInstanceCount, stepCount );
+    printf( "  without skipping:  %.0f steps/s, %.2f frames per step, %u of %u actions unseen by the game\n", withoutSkipping.stepsPerSecond,
+        ( double )withoutSkipping.frameCount / actionCount, withoutSkipping.unseenActionCount, actionCount );
+    printf( "  skipping up to %u: %.0f steps/s, %.2f frames per step, %u of %u actions unseen by the game (%llu lag frames skipped)\n", maxLagFrameSkipCount,
+        withSkipping.stepsPerSecond, ( double )withSkipping.frameCount / actionCount, withSkipping.unseenActionCount, actionCount, ( unsigned long long )withSkipping.lagFrameCount );
+    printf( "batch runner:        %llu lag frames skipped, state %s the environment\n", ( unsigned long long )batchSkippedLagFrameCount, batchMatches ? "matches" : "differs from" );
+    printf( "correctness:         %s (%u mismatches against the single instruction loop and the environment)\n", mismatchCount == 0u ? "ok" : "FAILED", mismatchCount );
+    return mismatchCount == 0u ? 0 : 1;
+}
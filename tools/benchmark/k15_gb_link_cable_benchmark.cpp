@@ -0,0 +1,155 @@
+//FK: Runs two instances connected by a link cable and compares the throughput against running both instances unconnected
+//    and against a naive link that runs both instances in instruction lockstep (always stepping the instance that is behind by one instruction).
+//    Also reports the number of transfers and how often the link cable had to switch between the instances per frame.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_link_cable_benchmark.cpp
+//    Usage:
+//      k15_gb_link_cable_benchmark <rom file> [rom file of the second instance] [frame count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_link_cable.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount = 1200u;
+
+//FK: Every instance gets its own input sequence, derived from the instance index and frame index
+GBEmulatorJoypadState getInstanceJoypadState( const uint32_t instanceIndex, const uint32_t frameIndex )
+{
+    uint32_t value = ( instanceIndex + 1u ) * 0x9E3779B9u ^ ( frameIndex / 8u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+void createInstancePair( const uint8_t* const* ppRomData, GBEmulatorInstance** ppOutInstances )
+{
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+        uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+        ppOutInstances[ instanceIndex ] = createGBEmulatorInstance( pInstanceMemory );
+        loadGBEmulatorRom( ppOutInstances[ instanceIndex ], ppRomData[ instanceIndex ], pCartridgeRamMemory );
+    }
+}
+
+//FK: Baseline - same transfer semantics as the link cable, but the instances never get more than one instruction apart
+void runInstructionLockstepLinkForCycles( GBLinkCable* pLinkCable, const uint32_t cycleCountToRunFor )
+{
+    uint32_t cycleCounts[ 2 ] = { pLinkCable->overshootCycles[ 0 ], pLinkCable->overshootCycles[ 1 ] };
+    while( cycleCounts[ 0 ] < cycleCountToRunFor || cycleCounts[ 1 ] < cycleCountToRunFor )
+    {
+        const uint32_t instanceIndex = cycleCounts[ 0 ] <= cycleCounts[ 1 ] ? 0u : 1u;
+        GBEmulatorInstance* pInstance = pLinkCable->pInstances[ instanceIndex ];
+        if( pInstance->serialState.linkTransferDue )
+        {
+            exchangeGBLinkCableBytes( pLinkCable, pInstance, pLinkCable->pInstances[ 1u - instanceIndex ] );
+            continue;
+        }
+
+        cycleCounts[ instanceIndex ] += runSingleInstruction( pInstance );
+        ++pLinkCable->stats.syncCount;
+    }
+
+    pLinkCable->overshootCycles[ 0 ] = cycleCounts[ 0 ] - cycleCountToRunFor;
+    pLinkCable->overshootCycles[ 1 ] = cycleCounts[ 1 ] - cycleCountToRunFor;
+}
+
+uint32_t countMismatchingInstances( GBEmulatorInstance* const* ppInstances, GBEmulatorInstance* const* ppOtherInstances )
+{
+    uint32_t mismatchingInstanceCount = 0u;
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        mismatchingInstanceCount += !instancesMatch( ppInstances[ instanceIndex ], ppOtherInstances[ instanceIndex ], InstanceCompare_MappedMemory | InstanceCompare_FrameBuffers );
+    }
+
+    return mismatchingInstanceCount;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [rom file of the second instance] [frame count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const char* pRomFilePaths[ 2 ] = { argv[ 1 ], argc > 2 ? argv[ 2 ] : argv[ 1 ] };
+    const uint32_t frameCount = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+
+    const uint8_t* pRomData[ 2 ];
+    for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+    {
+        size_t romSizeInBytes = 0u;
+        pRomData[ instanceIndex ] = readFile( pRomFilePaths[ instanceIndex ], &romSizeInBytes );
+        if( pRomData[ instanceIndex ] == nullptr || !isValidGBRomData( pRomData[ instanceIndex ], ( uint32_t )romSizeInBytes ) )
+        {
+            printf( "Could not load rom '%s'\n", pRomFilePaths[ instanceIndex ] );
+            return 1;
+        }
+    }
+
+    GBEmulatorInstance* pUnconnectedInstances[ 2 ];
+    GBEmulatorInstance* pLinkedInstances[ 2 ];
+    GBEmulatorInstance* pLockstepInstances[ 2 ];
+    createInstancePair( pRomData, pUnconnectedInstances );
+    createInstancePair( pRomData, pLinkedInstances );
+    createInstancePair( pRomData, pLockstepInstances );
+
+    GBLinkCable linkCable;
+    GBLinkCable lockstepLinkCable;
+    connectGBLinkCable( &linkCable, pLinkedInstances[ 0 ], pLinkedInstances[ 1 ] );
+    connectGBLinkCable( &lockstepLinkCable, pLockstepInstances[ 0 ], pLockstepInstances[ 1 ] );
+
+    const std::chrono::high_resolution_clock::time_point unconnectedStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+        {
+            setGBEmulatorJoypadState( pUnconnectedInstances[ instanceIndex ], getInstanceJoypadState( instanceIndex, frameIndex ) );
+            runGBEmulatorForCycles( pUnconnectedInstances[ instanceIndex ], gbCyclesPerFrame );
+        }
+    }
+    const double unconnectedSeconds = getElapsedSeconds( unconnectedStartTime );
+
+    const std::chrono::high_resolution_clock::time_point linkedStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+        {
+            setGBEmulatorJoypadState( pLinkedInstances[ instanceIndex ], getInstanceJoypadState( instanceIndex, frameIndex ) );
+        }
+
+        GBEmulatorInstanceEventMask eventMasks[ 2 ];
+        runGBLinkCableForCycles( &linkCable, gbCyclesPerFrame, eventMasks );
+    }
+    const double linkedSeconds = getElapsedSeconds( linkedStartTime );
+
+    const std::chrono::high_resolution_clock::time_point lockstepStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t instanceIndex = 0u; instanceIndex < 2u; ++instanceIndex )
+        {
+            setGBEmulatorJoypadState( pLockstepInstances[ instanceIndex ], getInstanceJoypadState( instanceIndex, frameIndex ) );
+        }
+
+        runInstructionLockstepLinkForCycles( &lockstepLinkCable, gbCyclesPerFrame );
+    }
+    const double lockstepSeconds = getElapsedSeconds( lockstepStartTime );
+
+    //FK: Only informational - the link cable may see the partner up to an instruction later than the lockstep link
+    const uint32_t mismatchingInstanceCount = countMismatchingInstances( pLinkedInstances, pLockstepInstances );
+
+    const GBLinkCableStats stats = getGBLinkCableStats( &linkCable );
+    const GBLinkCableStats lockstepStats = getGBLinkCableStats( &lockstepLinkCable );
+    const double totalFrameCount = 2.0 * frameCount;
+
+    printf( "instances:             2, %u frames per instance\n", frameCount );
+    printf( "unconnected:           %.0f frames/s\n", totalFrameCount / unconnectedSeconds );
+    printf( "link cable:            %.0f frames/s (%.2fx of unconnected)\n", totalFrameCount / linkedSeconds, unconnectedSeconds / linkedSeconds );
+    printf( "instruction lockstep:  %.0f frames/s (%.2fx of unconnected)\n", totalFrameCount / lockstepSeconds, unconnectedSeconds / lockstepSeconds );
+    printf( "transfers:             %llu (%llu unanswered)\n", ( unsigned long long )stats.transferCount, ( unsigned long long )stats.unansweredTransferCount );
+    printf( "switches per frame:    %.1f (instruction lockstep: %.1f)\n", ( double )stats.syncCount / frameCount, ( double )lockstepStats.syncCount / frameCount );
+    printf( "same as lockstep:      %s (%u of 2 instances differ)\n", mismatchingInstanceCount == 0u ? "yes" : "no", mismatchingInstanceCount );
+    return 0;
+}
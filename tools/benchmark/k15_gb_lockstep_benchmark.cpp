@@ -0,0 +1,131 @@
+//FK: Runs K instances of the same rom with different joypad input once one after another and once as a lockstep group
+//    and reports the throughput of both, how often the lanes were converged/vectorized and whether the results are identical.
+//    Build (from the repository root, add /arch:AVX2 to let the compiler use AVX2 for the lane loops):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_lockstep_benchmark.cpp
+//    Usage:
+//      k15_gb_lockstep_benchmark <rom file> [lane count] [frame count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_lockstep.h"
+
+static constexpr uint32_t gbBenchmarkDefaultLaneCount   = 16u;
+static constexpr uint32_t gbBenchmarkDefaultFrameCount  = 600u;
+
+//FK: Every lane gets its own input sequence, derived from the lane index and frame index
+GBEmulatorJoypadState getLaneJoypadState( const uint32_t laneIndex, const uint32_t frameIndex )
+{
+    uint32_t value = ( laneIndex + 1u ) * 0x9E3779B9u ^ ( frameIndex / 8u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+GBEmulatorInstance** createLaneInstances( const uint8_t* pRomData, const uint32_t laneCount, uint8_t** ppOutInstanceMemory, uint8_t** ppOutCartridgeRamMemory )
+{
+    const size_t instanceSizeInBytes = calculateGBEmulatorMemoryRequirementsInBytes();
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( instanceSizeInBytes * laneCount );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( laneCount, gbMaxRamSizeInBytes );
+    GBEmulatorInstance** ppInstances = ( GBEmulatorInstance** )malloc( laneCount * sizeof( GBEmulatorInstance* ) );
+
+    for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+    {
+        ppInstances[ laneIndex ] = createGBEmulatorInstance( pInstanceMemory + laneIndex * instanceSizeInBytes );
+        loadGBEmulatorRom( ppInstances[ laneIndex ], pRomData, pCartridgeRamMemory + laneIndex * gbMaxRamSizeInBytes );
+    }
+
+    *ppOutInstanceMemory = pInstanceMemory;
+    *ppOutCartridgeRamMemory = pCartridgeRamMemory;
+    return ppInstances;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [lane count] [frame count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t laneCount    = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultLaneCount;
+    const uint32_t frameCount   = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+    if( laneCount == 0u || laneCount > gbLockstepMaxLaneCount )
+    {
+        printf( "Lane count needs to be between 1 and %u\n", gbLockstepMaxLaneCount );
+        return 1;
+    }
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    uint8_t* pScalarInstanceMemory = nullptr;
+    uint8_t* pScalarCartridgeRamMemory = nullptr;
+    GBEmulatorInstance** ppScalarInstances = createLaneInstances( pRomData, laneCount, &pScalarInstanceMemory, &pScalarCartridgeRamMemory );
+
+    uint8_t* pLockstepInstanceMemory = nullptr;
+    uint8_t* pLockstepCartridgeRamMemory = nullptr;
+    GBEmulatorInstance** ppLockstepInstances = createLaneInstances( pRomData, laneCount, &pLockstepInstanceMemory, &pLockstepCartridgeRamMemory );
+
+    uint8_t* pLockstepGroupMemory = ( uint8_t* )malloc( calculateGBLockstepGroupMemoryRequirementsInBytes() );
+    GBLockstepGroup* pLockstepGroup = createGBLockstepGroup( pLockstepGroupMemory, ppLockstepInstances, laneCount );
+
+    GBEmulatorInstanceEventMask* pScalarEventMasks = ( GBEmulatorInstanceEventMask* )malloc( laneCount * frameCount * sizeof( GBEmulatorInstanceEventMask ) );
+    GBEmulatorInstanceEventMask* pLockstepEventMasks = ( GBEmulatorInstanceEventMask* )malloc( laneCount * frameCount * sizeof( GBEmulatorInstanceEventMask ) );
+
+    const std::chrono::high_resolution_clock::time_point scalarStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+        {
+            setGBEmulatorJoypadState( ppScalarInstances[ laneIndex ], getLaneJoypadState( laneIndex, frameIndex ) );
+            pScalarEventMasks[ frameIndex * laneCount + laneIndex ] = runGBEmulatorForCycles( ppScalarInstances[ laneIndex ], gbCyclesPerFrame );
+        }
+    }
+    const double scalarSeconds = getElapsedSeconds( scalarStartTime );
+
+    const std::chrono::high_resolution_clock::time_point lockstepStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+        {
+            setGBEmulatorJoypadState( ppLockstepInstances[ laneIndex ], getLaneJoypadState( laneIndex, frameIndex ) );
+        }
+
+        runGBLockstepGroupForCycles( pLockstepGroup, gbCyclesPerFrame, pLockstepEventMasks + frameIndex * laneCount );
+    }
+    const double lockstepSeconds = getElapsedSeconds( lockstepStartTime );
+
+    uint32_t mismatchingLaneCount = 0u;
+    for( uint32_t laneIndex = 0u; laneIndex < laneCount; ++laneIndex )
+    {
+        const GBEmulatorInstance* pScalarInstance = ppScalarInstances[ laneIndex ];
+        const GBEmulatorInstance* pLockstepInstance = ppLockstepInstances[ laneIndex ];
+
+        bool8_t lanesMatch = instancesMatch( pScalarInstance, pLockstepInstance, InstanceCompare_SubStates | InstanceCompare_MappedMemory | InstanceCompare_FrameBuffers | InstanceCompare_CartridgeRam );
+
+        for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+        {
+            lanesMatch &= pScalarEventMasks[ frameIndex * laneCount + laneIndex ] == pLockstepEventMasks[ frameIndex * laneCount + laneIndex ];
+        }
+
+        mismatchingLaneCount += !lanesMatch;
+    }
+
+    const GBLockstepStats stats = getGBLockstepStats( pLockstepGroup );
+    const double totalFrameCount = ( double )laneCount * frameCount;
+
+    printf( "lanes:            %u, %u frames per lane\n", laneCount, frameCount );
+    printf( "scalar:           %.0f frames/s\n", totalFrameCount / scalarSeconds );
+    printf( "lockstep:         %.0f frames/s (%.2fx)\n", totalFrameCount / lockstepSeconds, scalarSeconds / lockstepSeconds );
+    printf( "converged steps:  %.1f%%\n", ( double )stats.convergedStepCount / ( double )stats.stepCount * 100.0 );
+    printf( "vectorized steps: %.1f%%\n", ( double )stats.vectorizedStepCount / ( double )stats.stepCount * 100.0 );
+    printf( "correctness:      %s (%u of %u lanes differ from the scalar run)\n", mismatchingLaneCount == 0u ? "ok" : "FAILED", mismatchingLaneCount, laneCount );
+
+    return mismatchingLaneCount == 0u ? 0 : 1;
+}
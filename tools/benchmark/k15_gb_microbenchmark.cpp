@@ -0,0 +1,874 @@
+//FK: Microbenchmarks of the hot paths of the core: executeInstruction() per opcode class, drawScanline() for background/window/sprite mixes,
+//    tickSystem(), rom bank switching, storeGBEmulatorState()/loadGBEmulatorState(), zip/gzip decompression and framebuffer conversion.
+//    Every benchmark gets calibrated to ~1ms per repetition, warmed up and then repeated; the median, p99 and minimum time per operation get reported.
+//    Results can be written as json and compared against a stored baseline json, benchmarks slower than the threshold are flagged as regressions.
+//    The zip and gzip archives get compressed from the rom by the benchmark itself (fixed huffman deflate), so no extra files are needed.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_microbenchmark.cpp
+//    Usage:
+//      k15_gb_microbenchmark <rom file> [-json <output file>] [-baseline <json file>] [-threshold <percent>] [-repetitions <count>] [-filter <substring>]
+//    Returns 1 if any benchmark regressed compared to the baseline.
+
+#define K15_BREAK_ON_UNKNOWN_INSTRUCTION    0
+#define K15_BREAK_ON_ILLEGAL_INSTRUCTION    0
+
+#include <algorithm>
+
+#include "../k15_gb_tool_common.h"
+
+static constexpr uint32_t   gbMicrobenchmarkDefaultRepetitionCount  = 100u;
+static constexpr uint32_t   gbMicrobenchmarkWarmupRepetitionCount   = 5u;
+static constexpr uint32_t   gbMicrobenchmarkMaxRepetitionCount      = 10000u;
+static constexpr double     gbMicrobenchmarkTargetSeconds           = 0.001;
+static constexpr double     gbMicrobenchmarkDefaultThreshold        = 10.0;
+static constexpr uint32_t   gbMicrobenchmarkMaxBenchmarkCount       = 64u;
+static constexpr uint32_t   gbMicrobenchmarkWarmupFrameCount        = 300u;
+
+//FK: Registers get reset before every instruction so that every instruction of a class runs with the same operands
+static constexpr uint16_t   gbMicrobenchmarkInstructionAddress      = 0xC000;
+static constexpr uint16_t   gbMicrobenchmarkOperandAddress          = 0xC100;   //FK: Target of (HL), (BC), (DE) and a16 operands
+static constexpr uint16_t   gbMicrobenchmarkStackAddress            = 0xDFF0;
+
+enum OpcodeClass : uint8_t
+{
+    OpcodeClass_RegisterLoads = 0,
+    OpcodeClass_MemoryLoads,
+    OpcodeClass_Alu8Bit,
+    OpcodeClass_IncDec8Bit,
+    OpcodeClass_Alu16Bit,
+    OpcodeClass_Stack,
+    OpcodeClass_ControlFlow,
+    OpcodeClass_Misc,
+    OpcodeClass_CbShifts,
+    OpcodeClass_CbBits,
+
+    OpcodeClass_Count,
+    OpcodeClass_None = 0xFF
+};
+
+static const char* pOpcodeClassNames[] = {
+    "execute: register loads",
+    "execute: memory loads",
+    "execute: 8-bit alu",
+    "execute: 8-bit inc/dec",
+    "execute: 16-bit alu",
+    "execute: push/pop",
+    "execute: jumps/calls/returns",
+    "execute: misc (rotates, daa, flags)",
+    "execute: cb rotates/shifts/swap",
+    "execute: cb bit/res/set",
+};
+
+enum ScanlineMix : uint8_t
+{
+    ScanlineMix_Background = 0,
+    ScanlineMix_BackgroundWindow,
+    ScanlineMix_BackgroundSprites,
+    ScanlineMix_BackgroundWindowSprites,
+
+    ScanlineMix_Count
+};
+
+static const char* pScanlineMixNames[] = {
+    "drawScanline: background",
+    "drawScanline: background+window",
+    "drawScanline: background+sprites",
+    "drawScanline: background+window+sprites",
+};
+
+struct OpcodeClassOpcodes
+{
+    uint8_t     opcodes[ 256 ];
+    uint32_t    opcodeCount;
+};
+
+struct MicrobenchmarkContext
+{
+    GBEmulatorInstance* pInstance;          //FK: Ran the rom for a couple of frames
+    GBEmulatorInstance* pScratchInstance;   //FK: Used by the benchmarks that mess with the state
+    uint8_t*            pStateMemory;
+    size_t              stateSizeInBytes;
+    const uint8_t*      pRomData;
+    uint32_t            romSizeInBytes;
+    uint8_t*            pZipData;
+    uint32_t            zipSizeInBytes;
+    uint8_t*            pGZipData;
+    uint32_t            gzipSizeInBytes;
+    uint8_t*            pUncompressBuffer;
+    uint8_t*            pRGBFrameBuffer;
+    uint32_t            scanlineIndex;
+    uint64_t            sink;               //FK: Keeps the compiler from optimizing the benchmarked calls away
+    OpcodeClassOpcodes  opcodeClasses[ OpcodeClass_Count ];
+};
+
+typedef void ( *MicrobenchmarkFunction )( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter );
+
+struct Microbenchmark
+{
+    const char*             pName;
+    MicrobenchmarkFunction  pFunction;
+    uint32_t                parameter;
+    uint32_t                bytesPerOperation;  //FK: Only set for benchmarks with a meaningful throughput (eg: decompression)
+};
+
+struct MicrobenchmarkResult
+{
+    double      medianNanoseconds;
+    double      p99Nanoseconds;
+    double      minNanoseconds;
+    uint32_t    operationsPerRepetition;
+};
+
+struct DeflateBitWriter
+{
+    uint8_t*    pData;
+    uint32_t    byteCount;
+    uint32_t    bitBuffer;
+    uint32_t    bitCount;
+};
+
+//FK: Classified by mnemonic, HALT, STOP, PREFIX and the illegal opcodes aren't benchmarked
+OpcodeClass getOpcodeClass( const char* pMnemonic )
+{
+    const char* pOperands = strchr( pMnemonic, ' ' );
+    const size_t mnemonicLength = pOperands == nullptr ? strlen( pMnemonic ) : ( size_t )( pOperands - pMnemonic );
+    #define K15_IS_MNEMONIC( name ) ( mnemonicLength == sizeof( name ) - 1u && strncmp( pMnemonic, name, mnemonicLength ) == 0 )
+
+    const bool8_t isMemoryOperand   = strchr( pMnemonic, '(' ) != nullptr;
+    const bool8_t is16BitOperand    = pOperands != nullptr && strlen( pOperands + 1 ) == 2u && !isMemoryOperand;
+
+    OpcodeClass opcodeClass = OpcodeClass_None;
+    if( K15_IS_MNEMONIC( "LD" ) || K15_IS_MNEMONIC( "LDH" ) )
+    {
+        opcodeClass = isMemoryOperand ? OpcodeClass_MemoryLoads : OpcodeClass_RegisterLoads;
+    }
+    else if( K15_IS_MNEMONIC( "INC" ) || K15_IS_MNEMONIC( "DEC" ) )
+    {
+        opcodeClass = is16BitOperand ? OpcodeClass_Alu16Bit : OpcodeClass_IncDec8Bit;
+    }
+    else if( K15_IS_MNEMONIC( "ADD" ) )
+    {
+        opcodeClass = strncmp( pOperands + 1, "A ", 2 ) == 0 ? OpcodeClass_Alu8Bit : OpcodeClass_Alu16Bit;
+    }
+    else if( K15_IS_MNEMONIC( "ADC" ) || K15_IS_MNEMONIC( "SUB" ) || K15_IS_MNEMONIC( "SBC" ) || K15_IS_MNEMONIC( "AND" ) ||
+             K15_IS_MNEMONIC( "XOR" ) || K15_IS_MNEMONIC( "OR" ) || K15_IS_MNEMONIC( "CP" ) )
+    {
+        opcodeClass = OpcodeClass_Alu8Bit;
+    }
+    else if( K15_IS_MNEMONIC( "PUSH" ) || K15_IS_MNEMONIC( "POP" ) )
+    {
+        opcodeClass = OpcodeClass_Stack;
+    }
+    else if( K15_IS_MNEMONIC( "JP" ) || K15_IS_MNEMONIC( "JR" ) || K15_IS_MNEMONIC( "CALL" ) || K15_IS_MNEMONIC( "RET" ) ||
+             K15_IS_MNEMONIC( "RETI" ) || K15_IS_MNEMONIC( "RST" ) )
+    {
+        opcodeClass = OpcodeClass_ControlFlow;
+    }
+    else if( K15_IS_MNEMONIC( "NOP" ) || K15_IS_MNEMONIC( "RLCA" ) || K15_IS_MNEMONIC( "RRCA" ) || K15_IS_MNEMONIC( "RLA" ) ||
+             K15_IS_MNEMONIC( "RRA" ) || K15_IS_MNEMONIC( "DAA" ) || K15_IS_MNEMONIC( "CPL" ) || K15_IS_MNEMONIC( "SCF" ) ||
+             K15_IS_MNEMONIC( "CCF" ) || K15_IS_MNEMONIC( "DI" ) || K15_IS_MNEMONIC( "EI" ) )
+    {
+        opcodeClass = OpcodeClass_Misc;
+    }
+
+    #undef K15_IS_MNEMONIC
+    return opcodeClass;
+}
+
+void initializeOpcodeClasses( OpcodeClassOpcodes* pOpcodeClasses )
+{
+    memset( pOpcodeClasses, 0, sizeof( OpcodeClassOpcodes ) * OpcodeClass_Count );
+    for( uint32_t opcode = 0u; opcode < 256u; ++opcode )
+    {
+        const OpcodeClass opcodeClass = getOpcodeClass( unprefixedOpcodes[ opcode ].pMnemonic );
+        if( opcodeClass != OpcodeClass_None )
+        {
+            OpcodeClassOpcodes* pOpcodeClass = pOpcodeClasses + opcodeClass;
+            pOpcodeClass->opcodes[ pOpcodeClass->opcodeCount++ ] = ( uint8_t )opcode;
+        }
+
+        //FK: 0x00-0x3F are rotates, shifts and swap, the rest bit, res and set
+        OpcodeClassOpcodes* pCbOpcodeClass = pOpcodeClasses + ( opcode < 0x40 ? OpcodeClass_CbShifts : OpcodeClass_CbBits );
+        pCbOpcodeClass->opcodes[ pCbOpcodeClass->opcodeCount++ ] = ( uint8_t )opcode;
+    }
+}
+
+void runInstructions( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t opcodeClass )
+{
+    const OpcodeClassOpcodes* pOpcodeClass = pContext->opcodeClasses + opcodeClass;
+    const bool8_t isCbOpcodeClass = opcodeClass == OpcodeClass_CbShifts || opcodeClass == OpcodeClass_CbBits;
+
+    GBCpuState* pCpuState           = &pContext->pScratchInstance->cpuState;
+    GBMemoryMapper* pMemoryMapper   = &pContext->pScratchInstance->memoryMapper;
+    uint8_t* pOperands              = getMappedMemoryAddress( pMemoryMapper, gbMicrobenchmarkInstructionAddress + 1u );
+
+    //FK: d8/r8 operands are 0, d16/a16 operands point to the operand address
+    pOperands[ 0 ] = ( uint8_t )( gbMicrobenchmarkOperandAddress & 0xFF );
+    pOperands[ 1 ] = ( uint8_t )( gbMicrobenchmarkOperandAddress >> 8 );
+
+    uint64_t cycleCount = 0u;
+    uint32_t opcodeIndex = 0u;
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        pCpuState->registers.PC = gbMicrobenchmarkInstructionAddress + 1u;
+        pCpuState->registers.SP = gbMicrobenchmarkStackAddress;
+        pCpuState->registers.BC = gbMicrobenchmarkOperandAddress;
+        pCpuState->registers.DE = gbMicrobenchmarkOperandAddress;
+        pCpuState->registers.HL = gbMicrobenchmarkOperandAddress;
+
+        const uint8_t opcode = pOpcodeClass->opcodes[ opcodeIndex ];
+        if( isCbOpcodeClass )
+        {
+            pOperands[ 0 ] = opcode;
+        }
+
+        cycleCount += executeInstruction( pCpuState, pMemoryMapper, isCbOpcodeClass ? 0xCB : opcode );
+        opcodeIndex = opcodeIndex + 1u == pOpcodeClass->opcodeCount ? 0u : opcodeIndex + 1u;
+    }
+
+    pContext->sink += cycleCount;
+}
+
+void initializeScanlineMix( MicrobenchmarkContext* pContext, const ScanlineMix scanlineMix )
+{
+    GBMemoryMapper* pMemoryMapper = &pContext->pScratchInstance->memoryMapper;
+
+    GBLcdControl* pLcdControl = getLcdControl( pMemoryMapper );
+    pLcdControl->enable                     = 1;
+    pLcdControl->bgEnable                   = 1;
+    pLcdControl->bgTileMapArea              = 0;
+    pLcdControl->bgAndWindowTileDataArea    = 1;
+    pLcdControl->windowTileMapArea          = 1;
+    pLcdControl->objSize                    = 1;
+    pLcdControl->windowEnable               = scanlineMix == ScanlineMix_BackgroundWindow || scanlineMix == ScanlineMix_BackgroundWindowSprites;
+    pLcdControl->objEnable                  = scanlineMix == ScanlineMix_BackgroundSprites || scanlineMix == ScanlineMix_BackgroundWindowSprites;
+
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WX ) = 7u + 40u;
+    *getMappedMemoryAddress( pMemoryMapper, K15_GB_MAPPED_IO_ADDRESS_WY ) = 32u;
+}
+
+void runScanlines( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t scanlineMix )
+{
+    GBEmulatorInstance* pInstance   = pContext->pScratchInstance;
+    GBPpuState* pPpuState           = &pInstance->ppuState;
+    GBMemoryMapper* pMemoryMapper   = &pInstance->memoryMapper;
+    uint8_t* pFrameBuffer           = pInstance->gbFrameBuffers[ 0 ];
+    const bool8_t drawSprites       = scanlineMix == ScanlineMix_BackgroundSprites || scanlineMix == ScanlineMix_BackgroundWindowSprites;
+
+    initializeScanlineMix( pContext, ( ScanlineMix )scanlineMix );
+
+    uint32_t scanlineIndex = pContext->scanlineIndex;
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        //FK: The sprites of the scanline get collected during the oam scan, so that's part of drawing sprites
+        if( drawSprites )
+        {
+            collectScanlineSprites( pPpuState, pMemoryMapper, ( uint8_t )scanlineIndex );
+        }
+
+        drawScanline( pPpuState, pMemoryMapper, pFrameBuffer, ( uint8_t )scanlineIndex );
+        scanlineIndex = scanlineIndex + 1u == gbVerticalResolutionInPixels ? 0u : scanlineIndex + 1u;
+    }
+
+    pContext->scanlineIndex = scanlineIndex;
+    pContext->sink += pFrameBuffer[ 0 ];
+}
+
+void runTickSystem( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        tickSystem( pContext->pInstance, 4u );
+    }
+
+    pContext->sink += pContext->pInstance->ppuState.cycleCounter;
+}
+
+void runBankSwitches( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    GBEmulatorInstance* pInstance   = pContext->pScratchInstance;
+    GBMemoryMapper* pMemoryMapper   = &pInstance->memoryMapper;
+    const uint32_t romBankCount     = pInstance->cartridge.romBankCount > 1u ? pInstance->cartridge.romBankCount : 2u;
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        const uint8_t romBankNumber = ( uint8_t )( 1u + operationIndex % ( romBankCount - 1u ) );
+        write8BitValueToMappedMemory( pMemoryMapper, 0x2000, romBankNumber );
+        handleCartridgeWrites( pInstance );
+    }
+
+    pContext->sink += getMappedMemoryValue( pMemoryMapper, 0x4000 );
+}
+
+void runStoreStates( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        pContext->sink += storeGBEmulatorState( pContext->pInstance, pContext->pStateMemory, pContext->stateSizeInBytes );
+    }
+}
+
+void runLoadStates( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        pContext->sink += loadGBEmulatorState( pContext->pScratchInstance, pContext->pStateMemory, pContext->stateSizeInBytes );
+    }
+}
+
+void runZipDecompression( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        ZipArchive zipArchive;
+        openZipArchive( &zipArchive, pContext->pZipData, pContext->zipSizeInBytes );
+
+        const ZipArchiveEntry romEntry = findFirstRomEntryInZipArchive( &zipArchive );
+        uint32_t romSizeInBytes = 0u;
+        uncompressZipArchiveEntry( &zipArchive, &romEntry, pContext->pUncompressBuffer, &romSizeInBytes, gbMaxRomSizeInBytes );
+        pContext->sink += romSizeInBytes;
+    }
+}
+
+void runGZipDecompression( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        GZipData gzipData;
+        openGZipData( &gzipData, pContext->pGZipData, pContext->gzipSizeInBytes );
+
+        uint32_t romSizeInBytes = 0u;
+        uncompressGZipData( &gzipData, pContext->pUncompressBuffer, &romSizeInBytes, gbMaxRomSizeInBytes );
+        pContext->sink += romSizeInBytes;
+    }
+}
+
+void runFrameBufferConversions( MicrobenchmarkContext* pContext, const uint32_t operationCount, const uint32_t parameter )
+{
+    K15_UNUSED_VAR( parameter );
+
+    const uint8_t* pFrameBuffer = getGBEmulatorFrameBuffer( pContext->pInstance );
+    for( uint32_t operationIndex = 0u; operationIndex < operationCount; ++operationIndex )
+    {
+        convertGBFrameBufferToRGB8Buffer( pContext->pRGBFrameBuffer, pFrameBuffer );
+    }
+
+    pContext->sink += pContext->pRGBFrameBuffer[ 0 ];
+}
+
+void writeDeflateBits( DeflateBitWriter* pWriter, const uint32_t value, const uint32_t bitCount )
+{
+    pWriter->bitBuffer |= value << pWriter->bitCount;
+    pWriter->bitCount += bitCount;
+    while( pWriter->bitCount >= 8u )
+    {
+        pWriter->pData[ pWriter->byteCount++ ] = ( uint8_t )pWriter->bitBuffer;
+        pWriter->bitBuffer >>= 8u;
+        pWriter->bitCount -= 8u;
+    }
+}
+
+//FK: Huffman codes are stored starting with their most significant bit
+void writeDeflateCode( DeflateBitWriter* pWriter, const uint32_t code, const uint32_t bitCount )
+{
+    uint32_t reversedCode = 0u;
+    for( uint32_t bitIndex = 0u; bitIndex < bitCount; ++bitIndex )
+    {
+        reversedCode |= ( ( code >> bitIndex ) & 1u ) << ( bitCount - 1u - bitIndex );
+    }
+
+    writeDeflateBits( pWriter, reversedCode, bitCount );
+}
+
+void writeFixedHuffmanLiteralOrLength( DeflateBitWriter* pWriter, const uint32_t symbol )
+{
+    if( symbol < 144u )         writeDeflateCode( pWriter, 0x30u + symbol, 8u );
+    else if( symbol < 256u )    writeDeflateCode( pWriter, 0x190u + symbol - 144u, 9u );
+    else if( symbol < 280u )    writeDeflateCode( pWriter, symbol - 256u, 7u );
+    else                        writeDeflateCode( pWriter, 0xC0u + symbol - 280u, 8u );
+}
+
+//FK: Single fixed huffman block with greedy matches, good enough to exercise the literal, length and distance paths of the decoder.
+//    pCompressedData needs to be at least uncompressedSizeInBytes * 9 / 8 + 16 bytes big.
+uint32_t compressDeflateFixedHuffman( const uint8_t* pData, const uint32_t dataSizeInBytes, uint8_t* pCompressedData )
+{
+    static const uint16_t lengthBases[]         = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint8_t  lengthExtraBits[]     = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const uint16_t distanceBases[]       = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const uint8_t  distanceExtraBits[]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    static constexpr uint32_t hashTableSize     = 1u << 15u;
+    static constexpr uint32_t windowSizeInBytes = 32768u;
+    static constexpr uint32_t maxMatchLength    = 258u;
+
+    int32_t* pHashTable = ( int32_t* )malloc( hashTableSize * sizeof( int32_t ) );
+    memset( pHashTable, 0xFF, hashTableSize * sizeof( int32_t ) );
+
+    DeflateBitWriter writer = { pCompressedData, 0u, 0u, 0u };
+    writeDeflateBits( &writer, 1u, 1u ); //FK: Last block
+    writeDeflateBits( &writer, 1u, 2u ); //FK: Fixed huffman codes
+
+    uint32_t position = 0u;
+    while( position < dataSizeInBytes )
+    {
+        uint32_t matchLength = 0u;
+        uint32_t matchDistance = 0u;
+        if( position + 3u <= dataSizeInBytes )
+        {
+            const uint32_t hash = ( ( pData[ position ] << 16u | pData[ position + 1u ] << 8u | pData[ position + 2u ] ) * 2654435761u ) >> 17u;
+            const int32_t candidatePosition = pHashTable[ hash ];
+            pHashTable[ hash ] = ( int32_t )position;
+
+            if( candidatePosition >= 0 && position - ( uint32_t )candidatePosition <= windowSizeInBytes )
+            {
+                const uint32_t maxLength = GetMin( maxMatchLength, dataSizeInBytes - position );
+                while( matchLength < maxLength && pData[ candidatePosition + matchLength ] == pData[ position + matchLength ] )
+                {
+                    ++matchLength;
+                }
+
+                matchDistance = position - ( uint32_t )candidatePosition;
+            }
+        }
+
+        if( matchLength < 3u )
+        {
+            writeFixedHuffmanLiteralOrLength( &writer, pData[ position ] );
+            ++position;
+            continue;
+        }
+
+        uint32_t lengthIndex = 28u;
+        while( lengthBases[ lengthIndex ] > matchLength )
+        {
+            --lengthIndex;
+        }
+
+        uint32_t distanceIndex = 29u;
+        while( distanceBases[ distanceIndex ] > matchDistance )
+        {
+            --distanceIndex;
+        }
+
+        writeFixedHuffmanLiteralOrLength( &writer, 257u + lengthIndex );
+        writeDeflateBits( &writer, matchLength - lengthBases[ lengthIndex ], lengthExtraBits[ lengthIndex ] );
+        writeDeflateCode( &writer, distanceIndex, 5u );
+        writeDeflateBits( &writer, matchDistance - distanceBases[ distanceIndex ], distanceExtraBits[ distanceIndex ] );
+        position += matchLength;
+    }
+
+    writeFixedHuffmanLiteralOrLength( &writer, 256u ); //FK: End of block
+    writeDeflateBits( &writer, 0u, 7u ); //FK: Flush the last byte
+
+    free( pHashTable );
+    return writer.byteCount;
+}
+
+void writeUint16( uint8_t* pData, const uint16_t value )
+{
+    memcpy( pData, &value, sizeof( value ) );
+}
+
+void writeUint32( uint8_t* pData, const uint32_t value )
+{
+    memcpy( pData, &value, sizeof( value ) );
+}
+
+//FK: Header, file name, deflate stream, crc32 and size
+uint32_t createGZipData( const uint8_t* pData, const uint32_t dataSizeInBytes, uint8_t* pGZipData )
+{
+    static const uint8_t header[] = { 0x1F, 0x8B, 8u, 0x08 /* FNAME */, 0u, 0u, 0u, 0u, 0u, 0xFF };
+    static const char fileName[] = "benchmark.gb";
+
+    uint32_t offset = 0u;
+    memcpy( pGZipData, header, sizeof( header ) );
+    offset += sizeof( header );
+    memcpy( pGZipData + offset, fileName, sizeof( fileName ) );
+    offset += sizeof( fileName );
+    offset += compressDeflateFixedHuffman( pData, dataSizeInBytes, pGZipData + offset );
+
+    writeUint32( pGZipData + offset + 0u, ( uint32_t )mz_crc32( MZ_CRC32_INIT, pData, dataSizeInBytes ) );
+    writeUint32( pGZipData + offset + 4u, dataSizeInBytes );
+    return offset + 8u;
+}
+
+//FK: Local file header, deflate stream, central directory with a single entry and the end of central directory record
+uint32_t createZipData( const uint8_t* pData, const uint32_t dataSizeInBytes, uint8_t* pZipData )
+{
+    static const char fileName[] = "benchmark.gb";
+    const uint16_t fileNameLength = ( uint16_t )( sizeof( fileName ) - 1u );
+    const uint32_t romCrc32 = ( uint32_t )mz_crc32( MZ_CRC32_INIT, pData, dataSizeInBytes );
+
+    const uint32_t compressedSizeInBytes = compressDeflateFixedHuffman( pData, dataSizeInBytes, pZipData + 30u + fileNameLength );
+    memset( pZipData, 0, 30u );
+    writeUint32( pZipData + 0u, 0x04034B50 );
+    writeUint16( pZipData + 4u, 20u );
+    writeUint16( pZipData + 8u, 8u );
+    writeUint32( pZipData + 14u, romCrc32 );
+    writeUint32( pZipData + 18u, compressedSizeInBytes );
+    writeUint32( pZipData + 22u, dataSizeInBytes );
+    writeUint16( pZipData + 26u, fileNameLength );
+    memcpy( pZipData + 30u, fileName, fileNameLength );
+
+    const uint32_t centralDirectoryOffset = 30u + fileNameLength + compressedSizeInBytes;
+    uint8_t* pCentralDirectory = pZipData + centralDirectoryOffset;
+    memset( pCentralDirectory, 0, 46u );
+    writeUint32( pCentralDirectory + 0u, 0x02014B50 );
+    writeUint16( pCentralDirectory + 4u, 20u );
+    writeUint16( pCentralDirectory + 6u, 20u );
+    writeUint16( pCentralDirectory + 10u, 8u );
+    writeUint32( pCentralDirectory + 16u, romCrc32 );
+    writeUint32( pCentralDirectory + 20u, compressedSizeInBytes );
+    writeUint32( pCentralDirectory + 24u, dataSizeInBytes );
+    writeUint16( pCentralDirectory + 28u, fileNameLength );
+    memcpy( pCentralDirectory + 46u, fileName, fileNameLength );
+
+    const uint32_t centralDirectorySizeInBytes = 46u + fileNameLength;
+    uint8_t* pEndOfCentralDirectory = pCentralDirectory + centralDirectorySizeInBytes;
+    memset( pEndOfCentralDirectory, 0, 22u );
+    writeUint32( pEndOfCentralDirectory + 0u, 0x06054B50 );
+    writeUint16( pEndOfCentralDirectory + 8u, 1u );
+    writeUint16( pEndOfCentralDirectory + 10u, 1u );
+    writeUint32( pEndOfCentralDirectory + 12u, centralDirectorySizeInBytes );
+    writeUint32( pEndOfCentralDirectory + 16u, centralDirectoryOffset );
+    return centralDirectoryOffset + centralDirectorySizeInBytes + 22u;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    if( loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        free( pCartridgeRamMemory );
+        free( pInstanceMemory );
+        return nullptr;
+    }
+
+    return pInstance;
+}
+
+//FK: Random tiles and tile maps and 40 8x16 sprites spread over the screen for the drawScanline() benchmarks
+void initializeScratchVideoRam( GBEmulatorInstance* pInstance )
+{
+    GBMemoryMapper* pMemoryMapper = &pInstance->memoryMapper;
+
+    uint32_t value = 0x4B3135u;
+    for( uint32_t address = 0x8000; address < 0xA000; ++address )
+    {
+        value = value * 1664525u + 1013904223u;
+        *getMappedMemoryAddress( pMemoryMapper, ( uint16_t )address ) = ( uint8_t )( value >> 24u );
+    }
+
+    for( uint32_t spriteIndex = 0u; spriteIndex < gbObjectAttributeCapacity; ++spriteIndex )
+    {
+        uint8_t* pSprite = getMappedMemoryAddress( pMemoryMapper, ( uint16_t )( 0xFE00 + spriteIndex * 4u ) );
+        pSprite[ 0 ] = ( uint8_t )( 16u + ( spriteIndex * 37u ) % gbVerticalResolutionInPixels );
+        pSprite[ 1 ] = ( uint8_t )( 8u + ( spriteIndex * 53u ) % gbHorizontalResolutionInPixels );
+        pSprite[ 2 ] = ( uint8_t )( spriteIndex * 2u );
+        pSprite[ 3 ] = ( uint8_t )( ( spriteIndex & 3u ) << 5u );
+    }
+}
+
+MicrobenchmarkResult runMicrobenchmark( MicrobenchmarkContext* pContext, const Microbenchmark* pMicrobenchmark, const uint32_t repetitionCount, double* pSamples )
+{
+    //FK: Double the operations until a repetition takes long enough to be timed reliably, this warms up the caches and branch predictors as well
+    uint32_t operationCount = 1u;
+    while( true )
+    {
+        const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+        pMicrobenchmark->pFunction( pContext, operationCount, pMicrobenchmark->parameter );
+        if( getElapsedSeconds( startTime ) >= gbMicrobenchmarkTargetSeconds || operationCount >= ( 1u << 30u ) )
+        {
+            break;
+        }
+
+        operationCount *= 2u;
+    }
+
+    for( uint32_t repetitionIndex = 0u; repetitionIndex < gbMicrobenchmarkWarmupRepetitionCount; ++repetitionIndex )
+    {
+        pMicrobenchmark->pFunction( pContext, operationCount, pMicrobenchmark->parameter );
+    }
+
+    for( uint32_t repetitionIndex = 0u; repetitionIndex < repetitionCount; ++repetitionIndex )
+    {
+        const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+        pMicrobenchmark->pFunction( pContext, operationCount, pMicrobenchmark->parameter );
+        pSamples[ repetitionIndex ] = getElapsedSeconds( startTime ) * 1e9 / ( double )operationCount;
+    }
+
+    std::sort( pSamples, pSamples + repetitionCount );
+
+    //FK: Nearest rank
+    const uint32_t p99Index = ( uint32_t )( ( repetitionCount * 99u + 99u ) / 100u ) - 1u;
+
+    MicrobenchmarkResult result;
+    result.medianNanoseconds        = ( pSamples[ ( repetitionCount - 1u ) / 2u ] + pSamples[ repetitionCount / 2u ] ) * 0.5;
+    result.p99Nanoseconds           = pSamples[ p99Index ];
+    result.minNanoseconds           = pSamples[ 0 ];
+    result.operationsPerRepetition  = operationCount;
+    return result;
+}
+
+bool8_t writeJson( const char* pJsonFilePath, const char* pRomFilePath, const uint32_t repetitionCount, const Microbenchmark* pMicrobenchmarks,
+    const MicrobenchmarkResult* pResults, const bool8_t* pRan, const uint32_t microbenchmarkCount )
+{
+    FILE* pJsonFile = fopen( pJsonFilePath, "w" );
+    if( pJsonFile == nullptr )
+    {
+        return 0u;
+    }
+
+    fprintf( pJsonFile, "{\n  \"version\": 1,\n  \"rom\": \"" );
+    for( const char* pChar = pRomFilePath; *pChar != 0; ++pChar )
+    {
+        fprintf( pJsonFile, ( *pChar == '"' || *pChar == '\\' ) ? "\\%c" : "%c", *pChar );
+    }
+
+    fprintf( pJsonFile, "\",\n  \"repetitions\": %u,\n  \"benchmarks\": [", repetitionCount );
+
+    bool8_t first = 1u;
+    for( uint32_t microbenchmarkIndex = 0u; microbenchmarkIndex < microbenchmarkCount; ++microbenchmarkIndex )
+    {
+        if( !pRan[ microbenchmarkIndex ] )
+        {
+            continue;
+        }
+
+        const MicrobenchmarkResult* pResult = pResults + microbenchmarkIndex;
+        fprintf( pJsonFile, "%s\n    { \"name\": \"%s\", \"medianNanoseconds\": %.3f, \"p99Nanoseconds\": %.3f, \"minNanoseconds\": %.3f, "
+            "\"operationsPerRepetition\": %u, \"bytesPerOperation\": %u }", first ? "" : ",", pMicrobenchmarks[ microbenchmarkIndex ].pName,
+            pResult->medianNanoseconds, pResult->p99Nanoseconds, pResult->minNanoseconds, pResult->operationsPerRepetition,
+            pMicrobenchmarks[ microbenchmarkIndex ].bytesPerOperation );
+        first = 0u;
+    }
+
+    fprintf( pJsonFile, "\n  ]\n}\n" );
+    fclose( pJsonFile );
+    return 1u;
+}
+
+//FK: Only understands the files written by writeJson(), returns a negative value if the benchmark isn't part of the baseline
+double findBaselineMedianNanoseconds( const char* pBaselineJson, const char* pName )
+{
+    char nameKey[ 128 ];
+    snprintf( nameKey, sizeof( nameKey ), "\"name\": \"%s\"", pName );
+
+    const char* pEntry = strstr( pBaselineJson, nameKey );
+    if( pEntry == nullptr )
+    {
+        return -1.0;
+    }
+
+    const char* pMedian = strstr( pEntry, "\"medianNanoseconds\":" );
+    const char* pEntryEnd = strchr( pEntry, '}' );
+    if( pMedian == nullptr || pEntryEnd == nullptr || pMedian > pEntryEnd )
+    {
+        return -1.0;
+    }
+
+    return atof( pMedian + strlen( "\"medianNanoseconds\":" ) );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [-json <output file>] [-baseline <json file>] [-threshold <percent>] [-repetitions <count>] [-filter <substring>]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const char* pRomFilePath    = argv[ 1 ];
+    const char* pJsonFilePath   = nullptr;
+    const char* pBaselinePath   = nullptr;
+    const char* pFilter         = nullptr;
+    double threshold            = gbMicrobenchmarkDefaultThreshold;
+    uint32_t repetitionCount    = gbMicrobenchmarkDefaultRepetitionCount;
+
+    for( int argIndex = 2; argIndex + 1 < argc; argIndex += 2 )
+    {
+        const char* pArgument   = argv[ argIndex ];
+        const char* pValue      = argv[ argIndex + 1 ];
+        if( strcmp( pArgument, "-json" ) == 0 )                 pJsonFilePath   = pValue;
+        else if( strcmp( pArgument, "-baseline" ) == 0 )        pBaselinePath   = pValue;
+        else if( strcmp( pArgument, "-threshold" ) == 0 )       threshold       = atof( pValue );
+        else if( strcmp( pArgument, "-repetitions" ) == 0 )     repetitionCount = ( uint32_t )strtoul( pValue, nullptr, 10 );
+        else if( strcmp( pArgument, "-filter" ) == 0 )          pFilter         = pValue;
+        else
+        {
+            printf( "Unknown argument '%s'\n", pArgument );
+            return 1;
+        }
+    }
+
+    repetitionCount = GetMax( 1u, GetMin( repetitionCount, gbMicrobenchmarkMaxRepetitionCount ) );
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( pRomFilePath, &romSizeInBytes );
+    if( pRomData == nullptr || !isGBRomData( pRomData, romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", pRomFilePath );
+        return 1;
+    }
+
+    char* pBaselineJson = nullptr;
+    if( pBaselinePath != nullptr )
+    {
+        size_t baselineSizeInBytes = 0u;
+        uint8_t* pBaselineData = readFile( pBaselinePath, &baselineSizeInBytes );
+        if( pBaselineData == nullptr )
+        {
+            printf( "Could not read baseline '%s'\n", pBaselinePath );
+            return 1;
+        }
+
+        pBaselineJson = ( char* )realloc( pBaselineData, baselineSizeInBytes + 1u );
+        pBaselineJson[ baselineSizeInBytes ] = 0;
+    }
+
+    MicrobenchmarkContext* pContext = ( MicrobenchmarkContext* )calloc( 1u, sizeof( MicrobenchmarkContext ) );
+    pContext->pRomData          = pRomData;
+    pContext->romSizeInBytes    = ( uint32_t )romSizeInBytes;
+    pContext->pInstance         = createInstance( pRomData );
+    pContext->pScratchInstance  = createInstance( pRomData );
+    if( pContext->pInstance == nullptr || pContext->pScratchInstance == nullptr )
+    {
+        printf( "Could not map the cartridge of '%s'\n", pRomFilePath );
+        return 1;
+    }
+
+    for( uint32_t frameIndex = 0u; frameIndex < gbMicrobenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pContext->pInstance, gbCyclesPerFrame );
+        runGBEmulatorForCycles( pContext->pScratchInstance, gbCyclesPerFrame );
+    }
+
+    initializeScratchVideoRam( pContext->pScratchInstance );
+    initializeOpcodeClasses( pContext->opcodeClasses );
+
+    pContext->stateSizeInBytes  = calculateGBEmulatorStateSizeInBytes( pContext->pInstance );
+    pContext->pStateMemory      = ( uint8_t* )malloc( pContext->stateSizeInBytes );
+    pContext->pUncompressBuffer = ( uint8_t* )malloc( gbMaxRomSizeInBytes );
+    pContext->pRGBFrameBuffer   = ( uint8_t* )malloc( gbHorizontalResolutionInPixels * gbVerticalResolutionInPixels * 3u );
+    pContext->pZipData          = ( uint8_t* )malloc( romSizeInBytes * 9u / 8u + 256u );
+    pContext->pGZipData         = ( uint8_t* )malloc( romSizeInBytes * 9u / 8u + 256u );
+    pContext->zipSizeInBytes    = createZipData( pRomData, ( uint32_t )romSizeInBytes, pContext->pZipData );
+    pContext->gzipSizeInBytes   = createGZipData( pRomData, ( uint32_t )romSizeInBytes, pContext->pGZipData );
+    storeGBEmulatorState( pContext->pInstance, pContext->pStateMemory, pContext->stateSizeInBytes );
+
+    //FK: Check that the benchmarked paths actually work before timing them
+    bool8_t correct = 1u;
+    {
+        memset( pContext->pUncompressBuffer, 0, romSizeInBytes );
+        runZipDecompression( pContext, 1u, 0u );
+        correct &= memcmp( pContext->pUncompressBuffer, pRomData, romSizeInBytes ) == 0;
+
+        memset( pContext->pUncompressBuffer, 0, romSizeInBytes );
+        runGZipDecompression( pContext, 1u, 0u );
+        correct &= memcmp( pContext->pUncompressBuffer, pRomData, romSizeInBytes ) == 0;
+
+        GBStateHash stateHash;
+        GBStateHash loadedStateHash;
+        calculateGBEmulatorStateHash( pContext->pInstance, &stateHash );
+        correct &= loadGBEmulatorState( pContext->pScratchInstance, pContext->pStateMemory, pContext->stateSizeInBytes ) == K15_GB_STATE_LOAD_SUCCESS;
+        calculateGBEmulatorStateHash( pContext->pScratchInstance, &loadedStateHash );
+        correct &= stateHash.hash == loadedStateHash.hash;
+        initializeScratchVideoRam( pContext->pScratchInstance );
+    }
+
+    Microbenchmark microbenchmarks[ gbMicrobenchmarkMaxBenchmarkCount ];
+    uint32_t microbenchmarkCount = 0u;
+    for( uint32_t opcodeClass = 0u; opcodeClass < OpcodeClass_Count; ++opcodeClass )
+    {
+        microbenchmarks[ microbenchmarkCount++ ] = { pOpcodeClassNames[ opcodeClass ], runInstructions, opcodeClass, 0u };
+    }
+
+    for( uint32_t scanlineMix = 0u; scanlineMix < ScanlineMix_Count; ++scanlineMix )
+    {
+        microbenchmarks[ microbenchmarkCount++ ] = { pScanlineMixNames[ scanlineMix ], runScanlines, scanlineMix, 0u };
+    }
+
+    microbenchmarks[ microbenchmarkCount++ ] = { "tickSystem (4 cycles)",           runTickSystem,              0u, 0u };
+    microbenchmarks[ microbenchmarkCount++ ] = { "rom bank switch",                 runBankSwitches,            0u, 0u };
+    microbenchmarks[ microbenchmarkCount++ ] = { "storeGBEmulatorState",            runStoreStates,             0u, ( uint32_t )pContext->stateSizeInBytes };
+    microbenchmarks[ microbenchmarkCount++ ] = { "loadGBEmulatorState",             runLoadStates,              0u, ( uint32_t )pContext->stateSizeInBytes };
+    microbenchmarks[ microbenchmarkCount++ ] = { "zip decompression (rom)",         runZipDecompression,        0u, ( uint32_t )romSizeInBytes };
+    microbenchmarks[ microbenchmarkCount++ ] = { "gzip decompression (rom)",        runGZipDecompression,       0u, ( uint32_t )romSizeInBytes };
+    microbenchmarks[ microbenchmarkCount++ ] = { "convertGBFrameBufferToRGB8Buffer", runFrameBufferConversions, 0u, 0u };
+
+    const GBRomHeader romHeader = getGBRomHeader( pRomData );
+    printf( "rom:          %.16s (mbc type 0x%02X, %u rom banks)\n", ( const char* )romHeader.gameTitle, romHeader.cartridgeType, pContext->pScratchInstance->cartridge.romBankCount );
+    printf( "repetitions:  %u (after %u warmup repetitions), ~%.0f us per repetition\n", repetitionCount, gbMicrobenchmarkWarmupRepetitionCount, gbMicrobenchmarkTargetSeconds * 1e6 );
+    printf( "%-42s %12s %12s %12s %10s", "benchmark", "median ns", "p99 ns", "min ns", "MB/s" );
+    printf( pBaselineJson != nullptr ? " %12s %8s\n" : "\n", "baseline ns", "change" );
+
+    MicrobenchmarkResult results[ gbMicrobenchmarkMaxBenchmarkCount ];
+    bool8_t ran[ gbMicrobenchmarkMaxBenchmarkCount ] = {};
+    double* pSamples = ( double* )malloc( repetitionCount * sizeof( double ) );
+    uint32_t regressionCount = 0u;
+    for( uint32_t microbenchmarkIndex = 0u; microbenchmarkIndex < microbenchmarkCount; ++microbenchmarkIndex )
+    {
+        const Microbenchmark* pMicrobenchmark = microbenchmarks + microbenchmarkIndex;
+        if( pFilter != nullptr && strstr( pMicrobenchmark->pName, pFilter ) == nullptr )
+        {
+            continue;
+        }
+
+        const MicrobenchmarkResult result = runMicrobenchmark( pContext, pMicrobenchmark, repetitionCount, pSamples );
+        results[ microbenchmarkIndex ] = result;
+        ran[ microbenchmarkIndex ] = 1u;
+
+        char throughput[ 32 ] = "";
+        if( pMicrobenchmark->bytesPerOperation > 0u )
+        {
+            snprintf( throughput, sizeof( throughput ), "%.1f", ( double )pMicrobenchmark->bytesPerOperation / result.medianNanoseconds * 1e9 / Mbyte( 1 ) );
+        }
+
+        printf( "%-42s %12.2f %12.2f %12.2f %10s", pMicrobenchmark->pName, result.medianNanoseconds, result.p99Nanoseconds, result.minNanoseconds, throughput );
+        if( pBaselineJson != nullptr )
+        {
+            const double baselineMedianNanoseconds = findBaselineMedianNanoseconds( pBaselineJson, pMicrobenchmark->pName );
+            if( baselineMedianNanoseconds > 0.0 )
+            {
+                const double change = ( result.medianNanoseconds / baselineMedianNanoseconds - 1.0 ) * 100.0;
+                const bool8_t regressed = change > threshold;
+                regressionCount += regressed;
+                printf( " %12.2f %+7.1f%%%s", baselineMedianNanoseconds, change, regressed ? "  REGRESSION" : ( change < -threshold ? "  faster" : "" ) );
+            }
+            else
+            {
+                printf( " %12s %8s", "-", "new" );
+            }
+        }
+
+        printf( "\n" );
+    }
+
+    if( pJsonFilePath != nullptr && !writeJson( pJsonFilePath, pRomFilePath, repetitionCount, microbenchmarks, results, ran, microbenchmarkCount ) )
+    {
+        printf( "Could not write '%s'\n", pJsonFilePath );
+        correct = 0u;
+    }
+
+    if( pBaselineJson != nullptr )
+    {
+        printf( "baseline:     %u regression(s) slower than %.1f %% compared to '%s'\n", regressionCount, threshold, pBaselinePath );
+    }
+
+    printf( "correctness:  %s (zip/gzip round trip of the rom, save state round trip)\n", correct ? "ok" : "FAILED" );
+    printf( "(sink %llu)\n", ( unsigned long long )pContext->sink );
+    return correct && regressionCount == 0u ? 0 : 1;
+}
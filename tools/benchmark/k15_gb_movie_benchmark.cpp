@@ -0,0 +1,203 @@
+//FK: Records an input movie, reports its size and the cost of recording and playback and compares seeking using the keyframe index
+//    against seeking by replaying from the start state. Plays the movie back on a second instance with frame hash verification enabled
+//    and checks the shown frame after every seek against the recorded frame hashes.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_movie_benchmark.cpp
+//    Usage:
+//      k15_gb_movie_benchmark <rom file> [frame count] [keyframe interval] [seek count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_movie.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount  = 7200u;
+static constexpr uint32_t gbBenchmarkDefaultSeekCount   = 64u;
+static constexpr uint32_t gbBenchmarkWarmupFrameCount   = 300u;
+
+//FK: Buttons are held for a couple of frames like a player would, so the input runs have a realistic length
+GBEmulatorJoypadState getFrameJoypadState( const uint32_t frameIndex )
+{
+    uint32_t value = 0x9E3779B9u ^ ( frameIndex / 12u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+uint32_t getRandomValue( uint32_t* pState )
+{
+    uint32_t value = *pState;
+    value ^= value << 13u;
+    value ^= value >> 17u;
+    value ^= value << 5u;
+    *pState = value;
+    return value;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory );
+    return pInstance;
+}
+
+uint8_t* recordMovie( GBEmulatorInstance* pInstance, const uint8_t* pStartSnapshot, const uint32_t frameCount, const uint32_t keyframeInterval, size_t* pOutMovieSizeInBytes, double* pOutSeconds )
+{
+    restoreGBEmulator( pInstance, pStartSnapshot );
+
+    uint8_t* pRecorderMemory = ( uint8_t* )malloc( calculateGBMovieRecorderMemoryRequirementsInBytes( pInstance, frameCount, keyframeInterval, 1u ) );
+    GBMovieRecorder* pRecorder = createGBMovieRecorder( pRecorderMemory, pInstance, frameCount, keyframeInterval, 1u, 0u );
+    if( pRecorder == nullptr )
+    {
+        free( pRecorderMemory );
+        return nullptr;
+    }
+
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        runGBMovieRecorderFrame( pRecorder, getFrameJoypadState( frameIndex ) );
+    }
+    *pOutSeconds = getElapsedSeconds( startTime );
+
+    uint8_t* pMovieMemory = ( uint8_t* )malloc( calculateGBMovieSizeInBytes( pRecorder ) );
+    *pOutMovieSizeInBytes = writeGBMovie( pRecorder, pMovieMemory );
+    free( pRecorderMemory );
+    return pMovieMemory;
+}
+
+//FK: Seeks to random frames, returns the number of seeks after which the shown frame didn't match the recorded frame
+uint32_t runSeeks( GBMoviePlayer* pPlayer, const GBMovie* pMovie, const uint32_t seekCount, double* pOutSeconds )
+{
+    uint32_t randomState = 0x2545F491u;
+    uint32_t mismatchingSeekCount = 0u;
+    double seconds = 0.0;
+    for( uint32_t seekIndex = 0u; seekIndex < seekCount; ++seekIndex )
+    {
+        const uint32_t frameIndex = 1u + getRandomValue( &randomState ) % pMovie->header.frameCount;
+
+        const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+        const GBStateLoadResult result = seekGBMoviePlayer( pPlayer, frameIndex );
+        seconds += getElapsedSeconds( startTime );
+
+        mismatchingSeekCount += result != K15_GB_STATE_LOAD_SUCCESS || calculateGBMovieFrameHash( pPlayer->pInstance ) != getGBMovieFrameHash( pMovie, frameIndex - 1u );
+    }
+
+    *pOutSeconds = seconds;
+    return mismatchingSeekCount;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [frame count] [keyframe interval] [seek count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount       = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+    const uint32_t keyframeInterval = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbMovieDefaultKeyframeInterval;
+    const uint32_t seekCount        = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : gbBenchmarkDefaultSeekCount;
+
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) || frameCount == 0u || keyframeInterval == 0u )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    //FK: Record from a state past the boot sequence, so the start state isn't trivial
+    GBEmulatorInstance* pRecordInstance = createInstance( pRomData );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        setGBEmulatorJoypadState( pRecordInstance, getFrameJoypadState( frameIndex ) );
+        runGBEmulatorForCycles( pRecordInstance, gbCyclesPerFrame );
+    }
+
+    uint8_t* pStartSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pRecordInstance ) );
+    snapshotGBEmulator( pRecordInstance, pStartSnapshot );
+
+    const std::chrono::high_resolution_clock::time_point plainStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        setGBEmulatorJoypadState( pRecordInstance, getFrameJoypadState( frameIndex ) );
+        runGBEmulatorForCycles( pRecordInstance, gbCyclesPerFrame );
+    }
+    const double plainSeconds = getElapsedSeconds( plainStartTime );
+
+    //FK: The second movie only has a keyframe at the start, so seeking has to replay from there
+    size_t movieSizeInBytes = 0u;
+    size_t startOnlyMovieSizeInBytes = 0u;
+    double recordSeconds = 0.0;
+    double startOnlyRecordSeconds = 0.0;
+    const uint8_t* pMovieMemory = recordMovie( pRecordInstance, pStartSnapshot, frameCount, keyframeInterval, &movieSizeInBytes, &recordSeconds );
+    const uint8_t* pStartOnlyMovieMemory = recordMovie( pRecordInstance, pStartSnapshot, frameCount, frameCount, &startOnlyMovieSizeInBytes, &startOnlyRecordSeconds );
+
+    GBEmulatorInstance* pPlayInstance = createInstance( pRomData );
+    GBMovie movie;
+    GBMovie startOnlyMovie;
+    if( pMovieMemory == nullptr || pStartOnlyMovieMemory == nullptr ||
+        openGBMovie( &movie, pMovieMemory, movieSizeInBytes, pPlayInstance ) != K15_GB_MOVIE_LOAD_SUCCESS ||
+        openGBMovie( &startOnlyMovie, pStartOnlyMovieMemory, startOnlyMovieSizeInBytes, pPlayInstance ) != K15_GB_MOVIE_LOAD_SUCCESS )
+    {
+        printf( "correctness: FAILED (could not open the recorded movie)\n" );
+        return 1;
+    }
+
+    uint8_t* pPlayerMemory = ( uint8_t* )malloc( calculateGBMoviePlayerMemoryRequirementsInBytes( pPlayInstance ) );
+    GBMoviePlayer* pPlayer = nullptr;
+    if( createGBMoviePlayer( &pPlayer, pPlayerMemory, pPlayInstance, &movie ) != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        printf( "correctness: FAILED (could not load the start state of the recorded movie)\n" );
+        return 1;
+    }
+
+    setGBMoviePlayerVerificationEnabled( pPlayer, 1u );
+
+    const std::chrono::high_resolution_clock::time_point playStartTime = std::chrono::high_resolution_clock::now();
+    while( !isGBMoviePlayerFinished( pPlayer ) )
+    {
+        runGBMoviePlayerFrame( pPlayer );
+    }
+    const double playSeconds = getElapsedSeconds( playStartTime );
+    const GBMoviePlayerStats playStats = getGBMoviePlayerStats( pPlayer );
+
+    double seekSeconds = 0.0;
+    double startOnlySeekSeconds = 0.0;
+    uint32_t mismatchingSeekCount = runSeeks( pPlayer, &movie, seekCount, &seekSeconds );
+    const GBMoviePlayerStats seekStats = getGBMoviePlayerStats( pPlayer );
+
+    GBMoviePlayer* pStartOnlyPlayer = nullptr;
+    if( createGBMoviePlayer( &pStartOnlyPlayer, pPlayerMemory, pPlayInstance, &startOnlyMovie ) != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        printf( "correctness: FAILED (could not load the start state of the recorded movie)\n" );
+        return 1;
+    }
+
+    mismatchingSeekCount += runSeeks( pStartOnlyPlayer, &startOnlyMovie, seekCount, &startOnlySeekSeconds );
+    const GBMoviePlayerStats startOnlySeekStats = getGBMoviePlayerStats( pStartOnlyPlayer );
+
+    const GBMovieHeader* pHeader = &movie.header;
+    printf( "frames:         %u (keyframe every %u frames)\n", frameCount, keyframeInterval );
+    printf( "movie size:     %zu bytes (start state %u, %u input runs %zu, %u keyframes %u, frame hashes %zu)\n", movieSizeInBytes, pHeader->startStateSizeInBytes,
+        pHeader->inputRunCount, pHeader->inputRunCount * sizeof( GBMovieInputRun ), pHeader->keyframeCount, pHeader->keyframeDataSizeInBytes, pHeader->frameHashCount * sizeof( uint64_t ) );
+    printf( "plain:          %8.0f frames/s\n", frameCount / plainSeconds );
+    printf( "record:         %8.0f frames/s (%8.0f frames/s with a single keyframe)\n", frameCount / recordSeconds, frameCount / startOnlyRecordSeconds );
+    printf( "play + verify:  %8.0f frames/s\n", frameCount / playSeconds );
+    printf( "seek keyframes: %8.3f ms per seek (%.1f frames replayed per seek)\n", seekSeconds / seekCount * 1000.0,
+        ( double )( seekStats.replayedFrameCount - playStats.replayedFrameCount ) / seekCount );
+    printf( "seek replay:    %8.3f ms per seek (%.1f frames replayed per seek)\n", startOnlySeekSeconds / seekCount * 1000.0,
+        ( double )startOnlySeekStats.replayedFrameCount / seekCount );
+
+    const bool8_t correct = playStats.verifiedFrameCount == frameCount && playStats.mismatchingFrameCount == 0u && mismatchingSeekCount == 0u;
+    printf( "correctness: %s (%u of %u played frames differ from the recording", correct ? "ok" : "FAILED", playStats.mismatchingFrameCount, playStats.verifiedFrameCount );
+    if( playStats.mismatchingFrameCount > 0u )
+    {
+        printf( ", first one is frame %u", playStats.firstMismatchingFrameIndex );
+    }
+    printf( ", %u of %u seeks show a different frame)\n", mismatchingSeekCount, seekCount * 2u );
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+//FK: Linux/macOS only - Measures the cost of a rollback and runs a rollback netplay session between two local processes over UDP loopback.
+//    First the snapshot/restore cost of a netplay frame and the cost of re-simulating N frames (rendering disabled) are measured in this process.
+//    Then two player processes get forked that play the same session at 60 frames per second with scripted inputs. Outgoing packets can be
+//    delayed and dropped to simulate a real connection. At the end both players report the checksum of their final state, which has to match.
+//    Build (from the repository root):
+//      g++ -std=c++11 -O2 -DK15_RELEASE_BUILD -Iwin32 tools/benchmark/k15_gb_netplay_benchmark.cpp -o k15_gb_netplay_benchmark
+//    Usage:
+//      k15_gb_netplay_benchmark <rom file> [frame count] [latency in ms] [jitter in ms] [packet loss in percent] [max rollback frames] [rom file of player 2]
+
+#include <sys/wait.h>
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_netplay.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount          = 300u;
+static constexpr uint32_t gbBenchmarkRollbackMeasureCount       = 100u;
+static constexpr uint32_t gbBenchmarkLingerFrameCount           = 60u;     //FK: Frames a player keeps sending after it's done, so the last acks arrive
+static constexpr uint64_t gbBenchmarkFrameTimeInNanoseconds     = 1000000000ull / gbEmulatorFrameRate;
+static constexpr uint64_t gbBenchmarkTimeoutInNanoseconds       = 10000000000ull;
+
+//FK: Every player holds its buttons for a few frames, the players change their buttons at different rates so predictions fail regularly
+uint8_t getPlayerButtons( const uint32_t playerIndex, const uint32_t frameIndex )
+{
+    uint32_t value = ( playerIndex + 1u ) * 0x9E3779B9u ^ ( frameIndex / ( 5u + playerIndex * 2u ) ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+    return ( uint8_t )value;
+}
+
+struct GBNetplayPlayerResult
+{
+    uint64_t        finalChecksum;
+    uint32_t        finalFrameIndex;
+    uint32_t        desyncFrameIndex;
+    GBNetplayStats  stats;
+    double          averageAdvanceMilliseconds;
+    double          maxAdvanceMilliseconds;
+    double          maxRollbackMilliseconds;
+    uint64_t        droppedPacketCount;
+    uint8_t         timedOut;
+};
+
+GBNetplaySession* createNetplaySession( const uint8_t* const* ppRomData, const uint32_t localPlayerIndex, const GBNetplaySettings* pSettings )
+{
+    GBEmulatorInstance* pInstances[ gbNetplayPlayerCount ];
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+        uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+        pInstances[ playerIndex ] = createGBEmulatorInstance( pInstanceMemory );
+        loadGBEmulatorRom( pInstances[ playerIndex ], ppRomData[ playerIndex ], pCartridgeRamMemory );
+    }
+
+    uint8_t* pSessionMemory = ( uint8_t* )malloc( calculateGBNetplaySessionMemoryRequirementsInBytes( pInstances, pSettings ) );
+    return createGBNetplaySession( pSessionMemory, pInstances, localPlayerIndex, pSettings );
+}
+
+//FK: Rollbacks of the given depth without any networking - both players' inputs are fed directly into the session
+void measureRollbackCost( const uint8_t* const* ppRomData, const GBNetplaySettings* pSettings )
+{
+    GBNetplaySession* pSession = createNetplaySession( ppRomData, 0u, pSettings );
+    GBEmulatorInstanceEventMask eventMasks[ gbNetplayPlayerCount ];
+
+    //FK: Boot the game for a bit so the measurements aren't done on the boot screen
+    for( uint32_t frameIndex = 0u; frameIndex < 300u; ++frameIndex )
+    {
+        pSession->inputs[ 1 ][ frameIndex % gbNetplayFrameHistorySize ] = getPlayerButtons( 1u, frameIndex );
+        pSession->remoteInputFrameCount = frameIndex + 1u;
+        pSession->remoteAckFrameCount   = frameIndex;
+        advanceGBNetplayFrame( pSession, getPlayerButtons( 0u, frameIndex ), eventMasks );
+    }
+
+    const uint32_t rollbackFrameCount = pSettings->maxRollbackFrameCount;
+    const uint32_t frameIndex = pSession->frameIndex;
+
+    std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t measureIndex = 0u; measureIndex < gbBenchmarkRollbackMeasureCount; ++measureIndex )
+    {
+        snapshotGBNetplayFrame( pSession, frameIndex );
+    }
+    const double snapshotSeconds = getElapsedSeconds( startTime ) / gbBenchmarkRollbackMeasureCount;
+
+    startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t measureIndex = 0u; measureIndex < gbBenchmarkRollbackMeasureCount; ++measureIndex )
+    {
+        restoreGBNetplayFrame( pSession, frameIndex );
+    }
+    const double restoreSeconds = getElapsedSeconds( startTime ) / gbBenchmarkRollbackMeasureCount;
+
+    //FK: Run N frames with rendering and go back to the start each time
+    startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t measureIndex = 0u; measureIndex < gbBenchmarkRollbackMeasureCount / 10u; ++measureIndex )
+    {
+        restoreGBNetplayFrame( pSession, frameIndex );
+        for( uint32_t rollbackFrameIndex = 0u; rollbackFrameIndex < rollbackFrameCount; ++rollbackFrameIndex )
+        {
+            runGBLinkCableForCycles( &pSession->linkCable, gbCyclesPerFrame, eventMasks );
+        }
+    }
+    const double renderedSeconds = getElapsedSeconds( startTime ) / ( gbBenchmarkRollbackMeasureCount / 10u );
+    restoreGBNetplayFrame( pSession, frameIndex );
+
+    //FK: Actual rollbacks - advance N frames with a wrong prediction for the remote player and then deliver the correct input
+    double rollbackSeconds = 0.0;
+    for( uint32_t measureIndex = 0u; measureIndex < gbBenchmarkRollbackMeasureCount / 10u; ++measureIndex )
+    {
+        const uint32_t firstFrameIndex = pSession->frameIndex;
+        for( uint32_t rollbackFrameIndex = 0u; rollbackFrameIndex < rollbackFrameCount; ++rollbackFrameIndex )
+        {
+            pSession->remoteAckFrameCount = pSession->localInputFrameCount;
+            advanceGBNetplayFrame( pSession, getPlayerButtons( 0u, pSession->frameIndex ), eventMasks );
+        }
+
+        for( uint32_t remoteFrameIndex = firstFrameIndex; remoteFrameIndex < pSession->frameIndex; ++remoteFrameIndex )
+        {
+            const uint32_t historyIndex = remoteFrameIndex % gbNetplayFrameHistorySize;
+            pSession->inputs[ 1 ][ historyIndex ] = ~pSession->simulatedRemoteInputs[ historyIndex ];
+        }
+
+        pSession->rollbackFrameIndex    = firstFrameIndex;
+        pSession->remoteInputFrameCount = pSession->frameIndex;
+
+        startTime = std::chrono::high_resolution_clock::now();
+        rollbackGBNetplaySession( pSession );
+        rollbackSeconds += getElapsedSeconds( startTime );
+    }
+    rollbackSeconds /= ( gbBenchmarkRollbackMeasureCount / 10u );
+
+    const GBNetplayStats stats = getGBNetplayStats( pSession );
+    const double frameMilliseconds = 1000.0 / gbEmulatorFrameRate;
+    printf( "frame snapshot size:            %zu bytes (both instances)\n", pSession->frameSnapshotSizeInBytes );
+    printf( "snapshot / restore:             %.2f us / %.2f us\n", snapshotSeconds * 1e6, restoreSeconds * 1e6 );
+    printf( "%2u frames with rendering:       %.2f ms\n", rollbackFrameCount, renderedSeconds * 1000.0 );
+    printf( "rollback of %2u frames:          %.2f ms (%.0f%% of a %.1f ms frame, %llu rollbacks)\n", ( uint32_t )stats.maxRollbackFrameCount, rollbackSeconds * 1000.0,
+        rollbackSeconds * 1000.0 / frameMilliseconds * 100.0, frameMilliseconds, ( unsigned long long )stats.rollbackCount );
+}
+
+void sleepUntil( const uint64_t timeInNanoseconds )
+{
+    timespec time;
+    time.tv_sec  = ( time_t )( timeInNanoseconds / 1000000000ull );
+    time.tv_nsec = ( long )( timeInNanoseconds % 1000000000ull );
+    clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr );
+}
+
+GBNetplayPlayerResult runPlayer( const uint8_t* const* ppRomData, const uint32_t localPlayerIndex, const GBNetplaySettings* pSettings, const uint16_t basePort,
+    const uint32_t frameCount, const uint32_t latencyInMilliseconds, const uint32_t jitterInMilliseconds, const uint32_t packetLossPercentage )
+{
+    GBNetplayPlayerResult result = {};
+    GBNetplaySession* pSession = createNetplaySession( ppRomData, localPlayerIndex, pSettings );
+
+    GBNetplayUdpTransport transport;
+    if( !openGBNetplayUdpTransport( &transport, basePort + localPlayerIndex, "127.0.0.1", basePort + 1u - localPlayerIndex ) )
+    {
+        result.timedOut = 1u;
+        return result;
+    }
+
+    setGBNetplayUdpTransportConditions( &transport, latencyInMilliseconds, jitterInMilliseconds, packetLossPercentage, 0x1234u + localPlayerIndex );
+
+    double advanceSeconds = 0.0;
+    uint32_t advanceCount = 0u;
+    uint32_t lingerFrameCount = 0u;
+    uint64_t lastProgressTimeInNanoseconds = getGBNetplayTimeInNanoseconds();
+    uint64_t nextFrameTimeInNanoseconds = lastProgressTimeInNanoseconds;
+    while( lingerFrameCount < gbBenchmarkLingerFrameCount )
+    {
+        sleepUntil( nextFrameTimeInNanoseconds );
+        nextFrameTimeInNanoseconds += gbBenchmarkFrameTimeInNanoseconds;
+
+        pollGBNetplayUdpTransport( &transport, pSession );
+
+        if( pSession->frameIndex < frameCount )
+        {
+            GBEmulatorInstanceEventMask eventMasks[ gbNetplayPlayerCount ];
+            const uint64_t rollbackCount = pSession->stats.rollbackCount;
+            const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+            const GBNetplayAdvanceResult advanceResult = advanceGBNetplayFrame( pSession, getPlayerButtons( localPlayerIndex, pSession->frameIndex ), eventMasks );
+            const double elapsedSeconds = getElapsedSeconds( startTime );
+
+            if( advanceResult == K15_GB_NETPLAY_FRAME_ADVANCED )
+            {
+                advanceSeconds += elapsedSeconds;
+                ++advanceCount;
+                result.maxAdvanceMilliseconds = GetMax( result.maxAdvanceMilliseconds, elapsedSeconds * 1000.0 );
+                lastProgressTimeInNanoseconds = getGBNetplayTimeInNanoseconds();
+            }
+
+            if( pSession->stats.rollbackCount != rollbackCount )
+            {
+                result.maxRollbackMilliseconds = GetMax( result.maxRollbackMilliseconds, elapsedSeconds * 1000.0 );
+            }
+        }
+        else if( pSession->remoteInputFrameCount >= frameCount && pSession->remoteAckFrameCount >= frameCount )
+        {
+            ++lingerFrameCount;
+        }
+
+        sendGBNetplayUdpTransport( &transport, pSession );
+
+        if( getGBNetplayTimeInNanoseconds() - lastProgressTimeInNanoseconds > gbBenchmarkTimeoutInNanoseconds && lingerFrameCount == 0u )
+        {
+            result.timedOut = 1u;
+            break;
+        }
+    }
+
+    //FK: Apply the remote inputs that arrived after the last frame and checksum the final state
+    if( pSession->rollbackFrameIndex < pSession->frameIndex )
+    {
+        rollbackGBNetplaySession( pSession );
+    }
+
+    result.finalChecksum                = calculateGBNetplayFrameChecksum( pSession, pSession->frameIndex );
+    result.finalFrameIndex              = pSession->frameIndex;
+    result.desyncFrameIndex             = getGBNetplayDesyncFrameIndex( pSession );
+    result.stats                        = getGBNetplayStats( pSession );
+    result.averageAdvanceMilliseconds   = advanceCount > 0u ? advanceSeconds / advanceCount * 1000.0 : 0.0;
+    result.droppedPacketCount           = transport.droppedPacketCount;
+
+    closeGBNetplayUdpTransport( &transport );
+    return result;
+}
+
+void printPlayerResult( const uint32_t playerIndex, const GBNetplayPlayerResult& result )
+{
+    printf( "player %u:     %9.2f ms %9.2f ms %9.2f ms %10llu %10llu %8u %9llu %8llu   %016llx\n", playerIndex + 1u, result.averageAdvanceMilliseconds, result.maxAdvanceMilliseconds,
+        result.maxRollbackMilliseconds, ( unsigned long long )result.stats.rollbackCount, ( unsigned long long )result.stats.resimulatedFrameCount, result.stats.maxRollbackFrameCount,
+        ( unsigned long long )result.stats.waitingFrameCount, ( unsigned long long )result.droppedPacketCount, ( unsigned long long )result.finalChecksum );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [frame count] [latency in ms] [jitter in ms] [packet loss in percent] [max rollback frames] [rom file of player 2]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount               = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+    const uint32_t latencyInMilliseconds    = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : 0u;
+    const uint32_t jitterInMilliseconds     = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : 0u;
+    const uint32_t packetLossPercentage     = argc > 5 ? ( uint32_t )strtoul( argv[ 5 ], nullptr, 10 ) : 0u;
+
+    GBNetplaySettings settings;
+    settings.maxRollbackFrameCount = argc > 6 ? ( uint32_t )strtoul( argv[ 6 ], nullptr, 10 ) : settings.maxRollbackFrameCount;
+    if( settings.maxRollbackFrameCount < 2u || settings.maxRollbackFrameCount > gbNetplayMaxRollbackFrameCount )
+    {
+        printf( "Max rollback frames needs to be between 2 and %u\n", gbNetplayMaxRollbackFrameCount );
+        return 1;
+    }
+
+    const char* pRomFilePaths[ gbNetplayPlayerCount ] = { argv[ 1 ], argc > 7 ? argv[ 7 ] : argv[ 1 ] };
+    const uint8_t* pRomData[ gbNetplayPlayerCount ];
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        size_t romSizeInBytes = 0u;
+        pRomData[ playerIndex ] = readFile( pRomFilePaths[ playerIndex ], &romSizeInBytes );
+        if( pRomData[ playerIndex ] == nullptr || !isValidGBRomData( pRomData[ playerIndex ], ( uint32_t )romSizeInBytes ) )
+        {
+            printf( "Could not load rom '%s'\n", pRomFilePaths[ playerIndex ] );
+            return 1;
+        }
+    }
+
+    measureRollbackCost( pRomData, &settings );
+
+    //FK: Every player writes its result into a pipe
+    int resultPipes[ gbNetplayPlayerCount ][ 2 ];
+    pid_t playerProcessIds[ gbNetplayPlayerCount ];
+    const uint16_t basePort = ( uint16_t )( 40000u + ( uint32_t )getpid() % 20000u );
+
+    fflush( nullptr );
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        if( pipe( resultPipes[ playerIndex ] ) != 0 )
+        {
+            printf( "Could not create a pipe\n" );
+            return 1;
+        }
+
+        playerProcessIds[ playerIndex ] = fork();
+        if( playerProcessIds[ playerIndex ] == 0 )
+        {
+            const GBNetplayPlayerResult result = runPlayer( pRomData, playerIndex, &settings, basePort, frameCount, latencyInMilliseconds, jitterInMilliseconds, packetLossPercentage );
+            const bool8_t resultWritten = write( resultPipes[ playerIndex ][ 1 ], &result, sizeof( result ) ) == ( ssize_t )sizeof( result );
+            _exit( resultWritten ? 0 : 1 );
+        }
+    }
+
+    GBNetplayPlayerResult results[ gbNetplayPlayerCount ];
+    bool8_t playersFinished = 1u;
+    for( uint32_t playerIndex = 0u; playerIndex < gbNetplayPlayerCount; ++playerIndex )
+    {
+        playersFinished &= read( resultPipes[ playerIndex ][ 0 ], &results[ playerIndex ], sizeof( GBNetplayPlayerResult ) ) == ( ssize_t )sizeof( GBNetplayPlayerResult );
+        waitpid( playerProcessIds[ playerIndex ], nullptr, 0 );
+        playersFinished &= !results[ playerIndex ].timedOut && results[ playerIndex ].finalFrameIndex == frameCount;
+    }
+
+    const bool8_t checksumsMatch    = playersFinished && results[ 0 ].finalChecksum == results[ 1 ].finalChecksum;
+    const bool8_t noDesync          = playersFinished && results[ 0 ].desyncFrameIndex == gbNetplayInvalidFrameIndex && results[ 1 ].desyncFrameIndex == gbNetplayInvalidFrameIndex;
+    const uint64_t comparedChecksumCount = results[ 0 ].stats.comparedChecksumCount + results[ 1 ].stats.comparedChecksumCount;
+
+    printf( "\n%u frames at %u fps, latency %u ms +/- %u ms, %u%% packet loss, max rollback %u frames\n", frameCount, gbEmulatorFrameRate, latencyInMilliseconds, jitterInMilliseconds,
+        packetLossPercentage, settings.maxRollbackFrameCount );
+    printf( "               avg frame   max frame  max rollback  rollbacks  resimulated  deepest   waiting  dropped   final checksum\n" );
+    printPlayerResult( 0u, results[ 0 ] );
+    printPlayerResult( 1u, results[ 1 ] );
+    printf( "correctness:  %s (final checksums %s, %llu checksums compared during the session, %s)\n", checksumsMatch && noDesync ? "ok" : "FAILED",
+        checksumsMatch ? "match" : "differ", ( unsigned long long )comparedChecksumCount, noDesync ? "no desync" : "desync detected" );
+    return checksumsMatch && noDesync ? 0 : 1;
+}
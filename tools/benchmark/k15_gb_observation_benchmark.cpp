@@ -0,0 +1,136 @@
+//FK: Measures the per frame cost of the observation kernels (packed 2bpp framebuffer -> downsampled grayscale) for the scalar and the SIMD path.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_observation_benchmark.cpp
+//      (add /arch:AVX2 to measure the AVX2 path instead of the SSE2 path)
+//    Usage:
+//      k15_gb_observation_benchmark <rom file> [iteration count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_observation.h"
+
+static constexpr uint32_t gbBenchmarkWarmupFrameCount       = 600u;
+static constexpr uint32_t gbBenchmarkFrameCount             = 64u;
+static constexpr uint32_t gbBenchmarkDefaultIterationCount  = 2000u;
+
+struct GBBenchmarkObservation
+{
+    const char* pName;
+    uint8_t     cropX;
+    uint8_t     cropY;
+    uint8_t     cropWidth;
+    uint8_t     cropHeight;
+    uint8_t     width;
+    uint8_t     height;
+    bool8_t     maxPool;
+};
+
+static constexpr GBBenchmarkObservation gbBenchmarkObservations[] = {
+    { "84x84",                  0u, 0u,  0u,   0u,   84u, 84u, 0u },
+    { "84x84 max-pooled",       0u, 0u,  0u,   0u,   84u, 84u, 1u },
+    { "80x72",                  0u, 0u,  0u,   0u,   80u, 72u, 0u },
+    { "80x72 max-pooled",       0u, 0u,  0u,   0u,   80u, 72u, 1u },
+    { "crop 160x128 -> 84x84",  0u, 16u, 160u, 128u, 84u, 84u, 0u },
+};
+
+typedef void ( *GBBenchmarkObservationFunction )( const GBObservationPlan* pPlan, const uint8_t* pFrameBuffer, const uint8_t* pPreviousFrameBuffer, uint8_t* pObservation, uint8_t* pObservationMirror );
+
+//FK: Returns the average time per frame in nanoseconds
+double measureGBObservationNanosecondsPerFrame( GBBenchmarkObservationFunction observationFunction, const GBObservationPlan* pPlan, const uint8_t* pFrameBuffers,
+    const bool8_t maxPool, const uint32_t iterationCount, uint8_t* pObservation )
+{
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t iterationIndex = 0u; iterationIndex < iterationCount; ++iterationIndex )
+    {
+        for( uint32_t frameIndex = 1u; frameIndex < gbBenchmarkFrameCount; ++frameIndex )
+        {
+            const uint8_t* pFrameBuffer         = pFrameBuffers + frameIndex * gbFrameBufferSizeInBytes;
+            const uint8_t* pPreviousFrameBuffer = maxPool ? pFrameBuffer - gbFrameBufferSizeInBytes : nullptr;
+            observationFunction( pPlan, pFrameBuffer, pPreviousFrameBuffer, pObservation, nullptr );
+        }
+    }
+    const double elapsedSeconds = getElapsedSeconds( startTime );
+
+    return elapsedSeconds * 1000000000.0 / ( ( double )iterationCount * ( gbBenchmarkFrameCount - 1u ) );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [iteration count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t iterationCount = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultIterationCount;
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    uint8_t* pEmulatorInstanceMemory    = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory        = ( uint8_t* )calloc( 1, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pEmulatorInstanceMemory );
+    if( loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        printf( "Cartridge type of rom '%s' is not supported\n", argv[ 1 ] );
+        return 1;
+    }
+
+    //FK: Use real frames of the game instead of random data
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    }
+
+    uint8_t* pFrameBuffers = ( uint8_t* )malloc( gbBenchmarkFrameCount * gbFrameBufferSizeInBytes );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        memcpy( pFrameBuffers + frameIndex * gbFrameBufferSizeInBytes, getGBEmulatorFrameBuffer( pEmulatorInstance ), gbFrameBufferSizeInBytes );
+    }
+
+    uint8_t* pRGBFrameBuffer    = ( uint8_t* )malloc( gbHorizontalResolutionInPixels * gbVerticalResolutionInPixels * 3u );
+    uint8_t* pObservation       = ( uint8_t* )malloc( gbObservationMaxDimension * gbObservationMaxDimension );
+    uint8_t* pScalarObservation = ( uint8_t* )malloc( gbObservationMaxDimension * gbObservationMaxDimension );
+
+    //FK: What the frame costs before it even gets downsampled when going through RGB
+    const std::chrono::high_resolution_clock::time_point rgbStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t iterationIndex = 0u; iterationIndex < iterationCount; ++iterationIndex )
+    {
+        for( uint32_t frameIndex = 1u; frameIndex < gbBenchmarkFrameCount; ++frameIndex )
+        {
+            convertGBFrameBufferToRGB8Buffer( pRGBFrameBuffer, pFrameBuffers + frameIndex * gbFrameBufferSizeInBytes );
+        }
+    }
+    const double rgbNanosecondsPerFrame = getElapsedSeconds( rgbStartTime ) * 1000000000.0 / ( ( double )iterationCount * ( gbBenchmarkFrameCount - 1u ) );
+
+#if defined( K15_GB_OBSERVATION_AVX2 )
+    const char* pSimdName = "avx2";
+#elif defined( K15_GB_OBSERVATION_SSE2 )
+    const char* pSimdName = "sse2";
+#else
+    const char* pSimdName = "none";
+#endif
+
+    printf( "%u frames, %u iterations, simd path: %s\n", gbBenchmarkFrameCount - 1u, iterationCount, pSimdName );
+    printf( "convertGBFrameBufferToRGB8Buffer() only: %.0f ns per frame\n", rgbNanosecondsPerFrame );
+    printf( "observation              scalar ns  simd ns    speedup  matches\n" );
+
+    for( const GBBenchmarkObservation& observation : gbBenchmarkObservations )
+    {
+        const GBObservationPlan plan = createGBObservationPlan( observation.cropX, observation.cropY, observation.cropWidth, observation.cropHeight, observation.width, observation.height );
+        const double scalarNanosecondsPerFrame  = measureGBObservationNanosecondsPerFrame( writeGBObservationScalar, &plan, pFrameBuffers, observation.maxPool, iterationCount, pScalarObservation );
+        const double simdNanosecondsPerFrame    = measureGBObservationNanosecondsPerFrame( writeGBObservation, &plan, pFrameBuffers, observation.maxPool, iterationCount, pObservation );
+
+        //FK: Both paths have to produce the same observation
+        const bool8_t matches = memcmp( pObservation, pScalarObservation, calculateGBObservationSizeInBytes( &plan ) ) == 0;
+        printf( "%-23s  %9.0f  %9.0f  %6.2fx  %s\n", observation.pName, scalarNanosecondsPerFrame, simdNanosecondsPerFrame,
+            scalarNanosecondsPerFrame / simdNanosecondsPerFrame, matches ? "yes" : "NO" );
+    }
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+//FK: Linux only - Boots a rom once, runs it for a number of warmup frames and forks N workers that each run a rollout with their own input (process farm).
+//    Compares this against cold starting every worker (every worker loads the rom from disk and boots the game by itself)
+//    and reports the spin up time and the private memory of every worker for both.
+//    Build (from the repository root):
+//      g++ -std=c++11 -O2 -DK15_RELEASE_BUILD -Iwin32 tools/benchmark/k15_gb_process_farm_benchmark.cpp -o k15_gb_process_farm_benchmark
+//    Usage:
+//      k15_gb_process_farm_benchmark <rom file> [worker count] [warmup frames] [rollout frames]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_process_farm.h"
+
+static constexpr uint32_t gbBenchmarkDefaultWorkerCount         = 8u;
+static constexpr uint32_t gbBenchmarkDefaultWarmupFrameCount    = 600u;
+static constexpr uint32_t gbBenchmarkDefaultRolloutFrameCount   = 60u;
+
+//FK: Every worker gets its own input sequence, derived from the worker index and frame index
+GBEmulatorJoypadState getWorkerJoypadState( const uint32_t workerIndex, const uint32_t frameIndex )
+{
+    uint32_t value = ( workerIndex + 1u ) * 0x9E3779B9u ^ ( frameIndex / 8u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+float getWorkRamReward( const GBEmulatorInstance* pEmulatorInstance, uint32_t workerIndex, uint32_t frameIndex, void* pUserData )
+{
+    K15_UNUSED_VAR( workerIndex );
+    K15_UNUSED_VAR( frameIndex );
+    K15_UNUSED_VAR( pUserData );
+    return ( float )getMappedMemoryValue( &pEmulatorInstance->memoryMapper, 0xC000 ) / 255.0f;
+}
+
+//FK: Loads the rom and runs the given number of frames without any input
+GBEmulatorInstance* bootGBEmulatorInstance( const uint8_t* pRomData, const uint32_t warmupFrameCount )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+
+    GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRamMemory );
+    for( uint32_t frameIndex = 0u; frameIndex < warmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    }
+
+    return pEmulatorInstance;
+}
+
+//FK: Same as runGBProcessFarm(), but every worker reads the rom file and boots the game by itself
+uint32_t runColdStartWorkers( GBProcessFarm* pProcessFarm, const char* pRomFilePath, const uint32_t warmupFrameCount, const GBEmulatorJoypadState* pInputs )
+{
+    memset( pProcessFarm->pResultMemory, 0, pProcessFarm->resultMemorySizeInBytes );
+    fflush( nullptr );
+
+    const uint64_t startTimeInNanoseconds = getGBProcessFarmTimeInNanoseconds();
+    for( uint32_t workerIndex = 0u; workerIndex < pProcessFarm->workerCount; ++workerIndex )
+    {
+        const pid_t workerProcessId = fork();
+        if( workerProcessId == 0 )
+        {
+            size_t romSizeInBytes = 0u;
+            const uint8_t* pRomData = readFile( pRomFilePath, &romSizeInBytes );
+            GBEmulatorInstance* pEmulatorInstance = bootGBEmulatorInstance( pRomData, warmupFrameCount );
+            runGBProcessFarmWorker( pProcessFarm, pEmulatorInstance, workerIndex, pInputs, getWorkRamReward, nullptr, startTimeInNanoseconds );
+            _exit( 0 );
+        }
+
+        pProcessFarm->pWorkerProcessIds[ workerIndex ] = workerProcessId;
+    }
+
+    return waitForGBProcessFarmWorkers( pProcessFarm );
+}
+
+struct GBFarmRunSummary
+{
+    double      wallSeconds;
+    double      averageSpinUpSeconds;
+    double      maxSpinUpSeconds;
+    double      averagePrivateMemoryInKbytes;
+    uint32_t    finishedWorkerCount;
+};
+
+GBFarmRunSummary summarizeGBProcessFarmRun( GBProcessFarm* pProcessFarm, const double wallSeconds, const uint32_t finishedWorkerCount )
+{
+    GBFarmRunSummary summary = {};
+    summary.wallSeconds         = wallSeconds;
+    summary.finishedWorkerCount = finishedWorkerCount;
+
+    for( uint32_t workerIndex = 0u; workerIndex < pProcessFarm->workerCount; ++workerIndex )
+    {
+        const GBProcessFarmWorkerResult* pResult = getGBProcessFarmWorkerResult( pProcessFarm, workerIndex );
+        const double spinUpSeconds = ( double )pResult->spinUpTimeInNanoseconds / 1e9;
+        summary.averageSpinUpSeconds            += spinUpSeconds / pProcessFarm->workerCount;
+        summary.maxSpinUpSeconds                = GetMax( summary.maxSpinUpSeconds, spinUpSeconds );
+        summary.averagePrivateMemoryInKbytes    += ( double )pResult->privateMemoryInBytes / 1024.0 / pProcessFarm->workerCount;
+    }
+
+    return summary;
+}
+
+void printGBFarmRunSummary( const char* pName, const GBFarmRunSummary& summary )
+{
+    printf( "%-13s %9.2f ms %9.2f ms %9.2f ms %12.0f KB    %u\n", pName, summary.averageSpinUpSeconds * 1000.0, summary.maxSpinUpSeconds * 1000.0,
+        summary.wallSeconds * 1000.0, summary.averagePrivateMemoryInKbytes, summary.finishedWorkerCount );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [worker count] [warmup frames] [rollout frames]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t workerCount          = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultWorkerCount;
+    const uint32_t warmupFrameCount     = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultWarmupFrameCount;
+    const uint32_t rolloutFrameCount    = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : gbBenchmarkDefaultRolloutFrameCount;
+    if( workerCount == 0u || workerCount > gbProcessFarmMaxWorkerCount )
+    {
+        printf( "Worker count needs to be between 1 and %u\n", gbProcessFarmMaxWorkerCount );
+        return 1;
+    }
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    GBEmulatorJoypadState* pInputs = ( GBEmulatorJoypadState* )malloc( workerCount * rolloutFrameCount * sizeof( GBEmulatorJoypadState ) );
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        for( uint32_t frameIndex = 0u; frameIndex < rolloutFrameCount; ++frameIndex )
+        {
+            pInputs[ workerIndex * rolloutFrameCount + frameIndex ] = getWorkerJoypadState( workerIndex, frameIndex );
+        }
+    }
+
+    uint8_t* pWarmProcessFarmMemory = ( uint8_t* )malloc( calculateGBProcessFarmMemoryRequirementsInBytes( workerCount ) );
+    uint8_t* pColdProcessFarmMemory = ( uint8_t* )malloc( calculateGBProcessFarmMemoryRequirementsInBytes( workerCount ) );
+    GBProcessFarm* pWarmProcessFarm = createGBProcessFarm( pWarmProcessFarmMemory, workerCount, rolloutFrameCount );
+    GBProcessFarm* pColdProcessFarm = createGBProcessFarm( pColdProcessFarmMemory, workerCount, rolloutFrameCount );
+    if( pWarmProcessFarm == nullptr || pColdProcessFarm == nullptr )
+    {
+        printf( "Could not create the process farm\n" );
+        return 1;
+    }
+
+    const std::chrono::high_resolution_clock::time_point bootStartTime = std::chrono::high_resolution_clock::now();
+    GBEmulatorInstance* pWarmInstance = bootGBEmulatorInstance( pRomData, warmupFrameCount );
+    const double bootSeconds = getElapsedSeconds( bootStartTime );
+
+    const std::chrono::high_resolution_clock::time_point warmStartTime = std::chrono::high_resolution_clock::now();
+    const uint32_t warmFinishedWorkerCount = runGBProcessFarm( pWarmProcessFarm, pWarmInstance, pInputs, getWorkRamReward, nullptr );
+    const GBFarmRunSummary warmSummary = summarizeGBProcessFarmRun( pWarmProcessFarm, getElapsedSeconds( warmStartTime ), warmFinishedWorkerCount );
+
+    const std::chrono::high_resolution_clock::time_point coldStartTime = std::chrono::high_resolution_clock::now();
+    const uint32_t coldFinishedWorkerCount = runColdStartWorkers( pColdProcessFarm, argv[ 1 ], warmupFrameCount, pInputs );
+    const GBFarmRunSummary coldSummary = summarizeGBProcessFarmRun( pColdProcessFarm, getElapsedSeconds( coldStartTime ), coldFinishedWorkerCount );
+
+    //FK: Both runs start at the same state, so the rollouts have to be identical
+    uint32_t mismatchingWorkerCount = 0u;
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        const GBProcessFarmWorkerResult* pWarmResult = getGBProcessFarmWorkerResult( pWarmProcessFarm, workerIndex );
+        const GBProcessFarmWorkerResult* pColdResult = getGBProcessFarmWorkerResult( pColdProcessFarm, workerIndex );
+
+        bool8_t resultsMatch = pWarmResult->finished && pColdResult->finished;
+        resultsMatch &= pWarmResult->reward == pColdResult->reward && pWarmResult->vblankCount == pColdResult->vblankCount;
+        resultsMatch &= memcmp( pWarmResult->workRam, pColdResult->workRam, gbProcessFarmWorkRamSizeInBytes ) == 0;
+        resultsMatch &= memcmp( getGBProcessFarmFrameBufferHashes( pWarmProcessFarm, workerIndex ), getGBProcessFarmFrameBufferHashes( pColdProcessFarm, workerIndex ),
+            rolloutFrameCount * sizeof( uint64_t ) ) == 0;
+        mismatchingWorkerCount += !resultsMatch;
+    }
+
+    printf( "workers: %u, %u warmup frames, %u rollout frames, rom: %zu KB\n", workerCount, warmupFrameCount, rolloutFrameCount, romSizeInBytes / 1024u );
+    printf( "boot (load + warmup) in the parent process: %.2f ms\n", bootSeconds * 1000.0 );
+    printf( "              avg spin up   max spin up     wall time  private memory  finished workers\n" );
+    printGBFarmRunSummary( "forked:", warmSummary );
+    printGBFarmRunSummary( "cold start:", coldSummary );
+    printf( "spin up speedup:   %.2fx (max spin up)\n", coldSummary.maxSpinUpSeconds / warmSummary.maxSpinUpSeconds );
+    printf( "memory reduction:  %.2fx (private memory per worker)\n", coldSummary.averagePrivateMemoryInKbytes / warmSummary.averagePrivateMemoryInKbytes );
+    printf( "correctness:       %s (%u of %u workers differ from the cold started workers)\n", mismatchingWorkerCount == 0u ? "ok" : "FAILED", mismatchingWorkerCount, workerCount );
+
+    destroyGBProcessFarm( pColdProcessFarm );
+    destroyGBProcessFarm( pWarmProcessFarm );
+    return mismatchingWorkerCount == 0u ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+//FK: Measures the throughput of the reinforcement learning environment in steps per second for each observation mode.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_rl_env_benchmark.cpp
+//    Usage:
+//      k15_gb_rl_env_benchmark <rom file> [instance count] [frames to hold] [step count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_rl_env.h"
+
+static constexpr uint32_t gbBenchmarkWarmupFrameCount           = 600u;
+static constexpr uint32_t gbBenchmarkMaxEpisodeFrameCount       = 1800u;
+static constexpr uint32_t gbBenchmarkDefaultInstanceCount       = 16u;
+static constexpr uint32_t gbBenchmarkDefaultFramesToHold        = 4u;
+static constexpr uint32_t gbBenchmarkDefaultStepCount           = 500u;
+
+struct GBBenchmarkObservationMode
+{
+    const char*                     pName;
+    GBEnvironmentObservationMode    observationMode;
+    uint8_t                         observationWidth;
+    uint8_t                         observationHeight;
+    uint8_t                         frameStackSize;
+    bool8_t                         maxPoolFrames;
+};
+
+static constexpr GBBenchmarkObservationMode gbBenchmarkObservationModes[] = {
+    { "ram only",           K15_GB_ENVIRONMENT_OBSERVATION_RAM_ONLY,        0u,     0u,     1u, 0u },
+    { "framebuffer 2bpp",   K15_GB_ENVIRONMENT_OBSERVATION_FRAME_BUFFER,    0u,     0u,     1u, 0u },
+    { "grayscale 84x84",    K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE,       84u,    84u,    1u, 0u },
+    { "grayscale 80x72",    K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE,       80u,    72u,    1u, 0u },
+    { "84x84 pooled x4",    K15_GB_ENVIRONMENT_OBSERVATION_GRAYSCALE,       84u,    84u,    4u, 1u },
+};
+
+//FK: Returns the number of steps (one step = one instance applying one action) per second
+double measureGBEnvironmentStepsPerSecond( const uint8_t* pRomData, const GBBenchmarkObservationMode* pMode, const uint32_t instanceCount,
+    const uint32_t framesToHold, const uint32_t stepCount, size_t* pOutObservationSizeInBytes )
+{
+    GBEnvironmentSettings settings;
+    initGBEnvironmentSettings( &settings );
+    settings.observationMode        = pMode->observationMode;
+    settings.observationWidth       = pMode->observationWidth;
+    settings.observationHeight      = pMode->observationHeight;
+    settings.frameStackSize         = pMode->frameStackSize;
+    settings.maxPoolFrames          = pMode->maxPoolFrames;
+    settings.maxEpisodeFrameCount   = gbBenchmarkMaxEpisodeFrameCount;
+    settings.maxNoopFrameCount      = 30u;
+    settings.ramAddressCount        = 16u;
+    for( uint32_t ramAddressIndex = 0u; ramAddressIndex < settings.ramAddressCount; ++ramAddressIndex )
+    {
+        settings.ramAddresses[ ramAddressIndex ] = ( uint16_t )( 0xC000 + ramAddressIndex * 0x100 );
+    }
+
+    uint8_t* pEnvironmentMemory = ( uint8_t* )malloc( calculateGBEnvironmentMemoryRequirementsInBytes( pRomData, instanceCount, &settings ) );
+    GBEnvironment* pEnvironment = createGBEnvironment( pEnvironmentMemory, pRomData, instanceCount, &settings );
+    if( pEnvironment == nullptr )
+    {
+        free( pEnvironmentMemory );
+        return 0.0;
+    }
+
+    //FK: Start the episodes after the boot sequence of the game
+    GBEmulatorInstance* pStartInstance = getGBEnvironmentInstance( pEnvironment, 0u );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pStartInstance, gbCyclesPerFrame );
+    }
+    setGBEnvironmentStartInstance( pEnvironment, pStartInstance );
+
+    const size_t observationSizeInBytes = calculateGBEnvironmentObservationSizeInBytes( &settings );
+    GBEnvironmentBuffers buffers;
+    buffers.pObservations   = observationSizeInBytes > 0u ? ( uint8_t* )malloc( instanceCount * observationSizeInBytes ) : nullptr;
+    buffers.pRamValues      = ( uint8_t* )malloc( instanceCount * settings.ramAddressCount );
+    buffers.pDoneMasks      = ( GBEnvironmentDoneMask* )malloc( instanceCount * sizeof( GBEnvironmentDoneMask ) );
+    buffers.pLagFrameCounts = nullptr;
+    GBEnvironmentAction* pActions = ( GBEnvironmentAction* )malloc( instanceCount * sizeof( GBEnvironmentAction ) );
+
+    resetGBEnvironment( pEnvironment, 0x4B3135ull, &buffers );
+
+    uint32_t randomState = 0x1234567u;
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t stepIndex = 0u; stepIndex < stepCount; ++stepIndex )
+    {
+        for( uint32_t instanceIndex = 0u; instanceIndex < instanceCount; ++instanceIndex )
+        {
+            //FK: xorshift32
+            randomState ^= randomState << 13u;
+            randomState ^= randomState >> 17u;
+            randomState ^= randomState << 5u;
+            pActions[ instanceIndex ] = ( GBEnvironmentAction )randomState;
+        }
+
+        stepGBEnvironment( pEnvironment, pActions, framesToHold, &buffers );
+    }
+    const double elapsedSeconds = getElapsedSeconds( startTime );
+
+    free( pActions );
+    free( buffers.pDoneMasks );
+    free( buffers.pRamValues );
+    free( buffers.pObservations );
+    destroyGBEnvironment( pEnvironment );
+    free( pEnvironmentMemory );
+
+    *pOutObservationSizeInBytes = observationSizeInBytes;
+    return ( double )instanceCount * stepCount / elapsedSeconds;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [instance count] [frames to hold] [step count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t instanceCount    = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultInstanceCount;
+    const uint32_t framesToHold     = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultFramesToHold;
+    const uint32_t stepCount        = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : gbBenchmarkDefaultStepCount;
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    if( instanceCount == 0u )
+    {
+        printf( "Instance count needs to be at least 1\n" );
+        return 1;
+    }
+
+    printf( "%u instances, %u frames per step, %u batched steps\n", instanceCount, framesToHold, stepCount );
+    printf( "observation         bytes   steps/s      frames/s     us per step\n" );
+
+    for( const GBBenchmarkObservationMode& mode : gbBenchmarkObservationModes )
+    {
+        size_t observationSizeInBytes = 0u;
+        const double stepsPerSecond = measureGBEnvironmentStepsPerSecond( pRomData, &mode, instanceCount, framesToHold, stepCount, &observationSizeInBytes );
+        if( stepsPerSecond == 0.0 )
+        {
+            printf( "Cartridge type of rom '%s' is not supported\n", argv[ 1 ] );
+            return 1;
+        }
+
+        printf( "%-18s  %5zu  %10.0f  %12.0f  %10.3f\n", mode.pName, observationSizeInBytes, stepsPerSecond, stepsPerSecond * framesToHold, 1000000.0 / stepsPerSecond );
+    }
+
+    return 0;
+}
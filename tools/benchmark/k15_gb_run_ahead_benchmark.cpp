@@ -0,0 +1,157 @@
+//FK: Reports the cpu cost per host frame of run-ahead for different run-ahead frame counts, both restoring the snapshot into the same instance
+//    and running the speculative frames on a second instance. Also checks that run-ahead doesn't change the emulated state and that
+//    the shown frame is the frame plain emulation shows N frames later (using a constant input).
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_run_ahead_benchmark.cpp
+//    Usage:
+//      k15_gb_run_ahead_benchmark <rom file> [frame count] [max run-ahead frame count]
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_run_ahead.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount              = 600u;
+static constexpr uint32_t gbBenchmarkDefaultMaxRunAheadFrameCount   = 6u;
+static constexpr uint32_t gbBenchmarkWarmupFrameCount               = 120u;
+
+GBEmulatorJoypadState getFrameJoypadState( const uint32_t frameIndex )
+{
+    uint32_t value = 0x9E3779B9u ^ ( frameIndex / 8u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory );
+    return pInstance;
+}
+
+int compareFrameTimes( const void* pA, const void* pB )
+{
+    const double a = *( const double* )pA;
+    const double b = *( const double* )pB;
+    return a < b ? -1 : ( a > b ? 1 : 0 );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [frame count] [max run-ahead frame count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount               = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+    const uint32_t maxRunAheadFrameCount    = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultMaxRunAheadFrameCount;
+
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    //FK: Plain emulation as reference - once with the input script and once with a constant input (recording every shown frame)
+    GBEmulatorInstance* pStartInstance = createInstance( pRomData );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pStartInstance, gbCyclesPerFrame );
+    }
+
+    uint8_t* pStartSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pStartInstance ) );
+    snapshotGBEmulator( pStartInstance, pStartSnapshot );
+
+    GBEmulatorInstance* pReferenceInstance = createInstance( pRomData );
+    restoreGBEmulator( pReferenceInstance, pStartSnapshot );
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        setGBEmulatorJoypadState( pReferenceInstance, getFrameJoypadState( frameIndex ) );
+        runGBEmulatorForCycles( pReferenceInstance, gbCyclesPerFrame );
+    }
+
+    const uint32_t shownFrameCount = frameCount + maxRunAheadFrameCount;
+    uint8_t* pReferenceFrameBuffers = ( uint8_t* )malloc( shownFrameCount * gbFrameBufferSizeInBytes );
+    GBEmulatorInstance* pConstantInputInstance = createInstance( pRomData );
+    restoreGBEmulator( pConstantInputInstance, pStartSnapshot );
+    for( uint32_t frameIndex = 0u; frameIndex < shownFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pConstantInputInstance, gbCyclesPerFrame );
+        memcpy( pReferenceFrameBuffers + frameIndex * gbFrameBufferSizeInBytes, getGBEmulatorFrameBuffer( pConstantInputInstance ), gbFrameBufferSizeInBytes );
+    }
+
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+    GBEmulatorInstance* pSecondInstance = createInstance( pRomData );
+    uint8_t* pRunAheadMemory = ( uint8_t* )malloc( calculateGBRunAheadMemoryRequirementsInBytes( pInstance ) );
+    double* pFrameTimes = ( double* )malloc( frameCount * sizeof( double ) );
+    GBEmulatorJoypadState constantJoypadState;
+    constantJoypadState.value = 0u;
+    const double hostFrameMilliseconds = 1000.0 / gbEmulatorFrameRate;
+
+    uint32_t mismatchingStateCount = 0u;
+    uint32_t mismatchingShownFrameCount = 0u;
+
+    printf( "frames:     %u per configuration (%.1f ms host frame)\n", frameCount, hostFrameMilliseconds );
+    printf( "run-ahead   mode             avg/frame   p99/frame   max/frame   of host frame\n" );
+    for( uint32_t runAheadFrameCount = 0u; runAheadFrameCount <= maxRunAheadFrameCount; ++runAheadFrameCount )
+    {
+        for( uint32_t modeIndex = 0u; modeIndex < 2u; ++modeIndex )
+        {
+            if( runAheadFrameCount == 0u && modeIndex == 1u )
+            {
+                continue;
+            }
+
+            restoreGBEmulator( pInstance, pStartSnapshot );
+            GBRunAhead* pRunAhead = createGBRunAhead( pRunAheadMemory, pInstance, modeIndex == 1u ? pSecondInstance : nullptr, runAheadFrameCount );
+
+            for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+            {
+                const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+                runGBRunAheadFrame( pRunAhead, getFrameJoypadState( frameIndex ) );
+                pFrameTimes[ frameIndex ] = getElapsedSeconds( startTime ) * 1000.0;
+            }
+
+            mismatchingStateCount += !instancesMatch( pInstance, pReferenceInstance, InstanceCompare_Registers | InstanceCompare_MappedMemory );
+
+            //FK: The frame shown after host frame n is the frame plain emulation shows after frame n + N
+            restoreGBEmulator( pInstance, pStartSnapshot );
+            pRunAhead = createGBRunAhead( pRunAheadMemory, pInstance, modeIndex == 1u ? pSecondInstance : nullptr, runAheadFrameCount );
+            for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+            {
+                runGBRunAheadFrame( pRunAhead, constantJoypadState );
+
+                //FK: The first frame without run-ahead still contains scanlines of the previous configuration (framebuffers aren't part of snapshots)
+                if( runAheadFrameCount == 0u && frameIndex == 0u )
+                {
+                    continue;
+                }
+
+                const uint8_t* pReferenceFrameBuffer = pReferenceFrameBuffers + ( frameIndex + runAheadFrameCount ) * gbFrameBufferSizeInBytes;
+                mismatchingShownFrameCount += memcmp( getGBRunAheadFrameBuffer( pRunAhead ), pReferenceFrameBuffer, gbFrameBufferSizeInBytes ) != 0;
+            }
+
+            double totalMilliseconds = 0.0;
+            for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+            {
+                totalMilliseconds += pFrameTimes[ frameIndex ];
+            }
+
+            qsort( pFrameTimes, frameCount, sizeof( double ), compareFrameTimes );
+            const double averageMilliseconds = totalMilliseconds / frameCount;
+            printf( "%9u   %-15s  %7.3f ms  %7.3f ms  %7.3f ms   %5.1f%%\n", runAheadFrameCount, modeIndex == 0u ? "restore" : "second instance", averageMilliseconds,
+                pFrameTimes[ ( frameCount * 99u ) / 100u ], pFrameTimes[ frameCount - 1u ], averageMilliseconds / hostFrameMilliseconds * 100.0 );
+        }
+    }
+
+    const bool8_t correct = mismatchingStateCount == 0u && mismatchingShownFrameCount == 0u;
+    printf( "correctness: %s (%u configurations changed the emulated state, %u shown frames differ from plain emulation)\n", correct ? "ok" : "FAILED",
+        mismatchingStateCount, mismatchingShownFrameCount );
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+//FK: Compares running fixed frame sized cycle counts with runGBEmulatorForCycles() against stopping at vblank with runGBEmulatorUntil().
+//    Reports how often a fixed chunk finishes no frame or two frames (a dropped or doubled frame when presenting once per chunk),
+//    the cost of both and how many cycles a bot saves by stepping to the next joypad read instead of to the end of the frame.
+//    Also checks that every stop happens right after the instruction that met the condition.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_run_until_benchmark.cpp
+//    Usage:
+//      k15_gb_run_until_benchmark <rom file> [frame count]
+
+#include "../k15_gb_tool_common.h"
+
+static constexpr uint32_t gbBenchmarkDefaultFrameCount  = 3000u;
+static constexpr uint32_t gbBenchmarkWarmupFrameCount   = 120u;
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory );
+    return pInstance;
+}
+
+uint8_t getLy( GBEmulatorInstance* pInstance )
+{
+    return *getMappedMemoryAddress( &pInstance->memoryMapper, K15_GB_MAPPED_IO_ADDRESS_LY );
+}
+
+//FK: Reference for runGBEmulatorUntil() - runs single instructions until the condition is met by one of them
+uint32_t runReferenceUntil( GBEmulatorInstance* pInstance, const GBEmulatorStopMask stopMask, const uint32_t maxCycles )
+{
+    uint32_t cycleCount = 0u;
+    while( true )
+    {
+        const uint8_t ly = getLy( pInstance );
+        const uint32_t joypadReadCount = pInstance->memoryMapper.joypadReadCount;
+        cycleCount += runSingleInstruction( pInstance );
+
+        if( cycleCount >= maxCycles )
+        {
+            return cycleCount;
+        }
+
+        if( ( stopMask & K15_GB_STOP_AT_VBLANK ) && ly != 144 && getLy( pInstance ) == 144 )
+        {
+            return cycleCount;
+        }
+
+        if( ( stopMask & K15_GB_STOP_AT_JOYPAD_READ ) && joypadReadCount != pInstance->memoryMapper.joypadReadCount )
+        {
+            return cycleCount;
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [frame count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultFrameCount;
+
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    GBEmulatorInstance* pStartInstance = createInstance( pRomData );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pStartInstance, gbCyclesPerFrame );
+    }
+
+    uint8_t* pStartSnapshot = ( uint8_t* )malloc( calculateGBEmulatorSnapshotSizeInBytes( pStartInstance ) );
+    snapshotGBEmulator( pStartInstance, pStartSnapshot );
+
+    GBEmulatorInstance* pInstance = createInstance( pRomData );
+    GBEmulatorInstance* pReferenceInstance = createInstance( pRomData );
+
+    //FK: Fixed chunks - finished frames (LY reaching 144) get counted using a single instruction loop, runGBEmulatorForCycles() is only used for timing
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    uint32_t chunkFrameCounts[ 3 ] = { 0u, 0u, 0u };
+    for( uint32_t chunkIndex = 0u; chunkIndex < frameCount; ++chunkIndex )
+    {
+        uint32_t finishedFrameCount = 0u;
+        uint32_t cycleCount = 0u;
+        while( cycleCount < gbCyclesPerFrame )
+        {
+            const uint8_t ly = getLy( pInstance );
+            cycleCount += runSingleInstruction( pInstance );
+            finishedFrameCount += ly != 144 && getLy( pInstance ) == 144;
+        }
+
+        ++chunkFrameCounts[ GetMin( finishedFrameCount, 2u ) ];
+    }
+
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t chunkIndex = 0u; chunkIndex < frameCount; ++chunkIndex )
+    {
+        runGBEmulatorForCycles( pInstance, gbCyclesPerFrame );
+    }
+    const double fixedChunkSeconds = getElapsedSeconds( startTime );
+
+    //FK: Stopping at vblank - every call finishes exactly one frame (with the lcd enabled)
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    uint32_t minFrameCycleCount = 0xFFFFFFFFu;
+    uint32_t maxFrameCycleCount = 0u;
+    uint32_t stoppedAtVblankCount = 0u;
+    startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        const GBEmulatorRunResult result = runGBEmulatorUntil( pInstance, K15_GB_STOP_AT_VBLANK, 2u * gbCyclesPerFrame );
+        stoppedAtVblankCount += ( result.stopMask & K15_GB_STOP_AT_VBLANK ) > 0u;
+
+        //FK: Skip the first call, it only runs up to the vblank of the frame that was already in progress
+        if( frameIndex > 0u )
+        {
+            minFrameCycleCount = GetMin( minFrameCycleCount, result.cycleCount );
+            maxFrameCycleCount = GetMax( maxFrameCycleCount, result.cycleCount );
+        }
+    }
+    const double untilVblankSeconds = getElapsedSeconds( startTime );
+
+    //FK: Stops have to happen after the same instruction as a single instruction loop checking the condition
+    uint32_t mismatchCount = 0u;
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    restoreGBEmulator( pReferenceInstance, pStartSnapshot );
+    const GBEmulatorStopMask checkedStopMasks[] = { K15_GB_STOP_AT_VBLANK, K15_GB_STOP_AT_JOYPAD_READ, K15_GB_STOP_NONE };
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount / 4u; ++frameIndex )
+    {
+        const GBEmulatorStopMask stopMask = checkedStopMasks[ frameIndex % 3u ];
+        const uint32_t maxCycles = gbCyclesPerFrame / ( 1u + frameIndex % 4u );
+        const GBEmulatorRunResult result = runGBEmulatorUntil( pInstance, stopMask, maxCycles );
+        const uint32_t referenceCycleCount = runReferenceUntil( pReferenceInstance, stopMask, maxCycles );
+
+        mismatchCount += result.cycleCount != referenceCycleCount || !instancesMatch( pInstance, pReferenceInstance );
+        mismatchCount += ( result.stopMask & K15_GB_STOP_AT_VBLANK ) && getLy( pInstance ) != 144;
+    }
+
+    //FK: Stopping at an address - the instruction at that address must not have run yet
+    const uint16_t stopAddress = pInstance->cpuState.registers.PC;
+    setGBEmulatorStopAddress( pInstance, stopAddress );
+    const GBEmulatorRunResult addressResult = runGBEmulatorUntil( pInstance, K15_GB_STOP_AT_ADDRESS, 8u * gbCyclesPerFrame );
+    const bool8_t stoppedAtAddress = ( addressResult.stopMask & K15_GB_STOP_AT_ADDRESS ) > 0u;
+    mismatchCount += stoppedAtAddress && pInstance->cpuState.registers.PC != stopAddress;
+
+    //FK: A bot that wants to act on the next input poll - stepping to the joypad read instead of to the end of the frame
+    restoreGBEmulator( pInstance, pStartSnapshot );
+    uint64_t cyclesToJoypadRead = 0u;
+    uint32_t joypadReadStopCount = 0u;
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        runGBEmulatorUntil( pInstance, K15_GB_STOP_AT_VBLANK, 2u * gbCyclesPerFrame );
+        const GBEmulatorRunResult result = runGBEmulatorUntil( pInstance, K15_GB_STOP_AT_JOYPAD_READ, gbCyclesPerFrame );
+        if( result.stopMask & K15_GB_STOP_AT_JOYPAD_READ )
+        {
+            cyclesToJoypadRead += result.cycleCount;
+            ++joypadReadStopCount;
+        }
+    }
+
+    const double fixedFramesPerSecond = frameCount / fixedChunkSeconds;
+    const double untilFramesPerSecond = frameCount / untilVblankSeconds;
+    printf( "frames:              %u\n", frameCount );
+    printf( "fixed chunks:        %.0f frames/s, %u chunks finished no frame, %u finished two frames (of %u)\n", fixedFramesPerSecond, chunkFrameCounts[ 0 ], chunkFrameCounts[ 2 ], frameCount );
+    printf( "until vblank:        %.0f frames/s (%+.1f%%), %u of %u calls stopped at vblank, %u..%u cycles per frame\n", untilFramesPerSecond,
+        ( fixedChunkSeconds / untilVblankSeconds - 1.0 ) * 100.0, stoppedAtVblankCount, frameCount, stoppedAtVblankCount > 1u ? minFrameCycleCount : 0u, maxFrameCycleCount );
+    printf( "until joypad read:   %u of %u frames read JOYP, avg %.0f cycles after vblank (%.1f%% of a frame)\n", joypadReadStopCount, frameCount,
+        joypadReadStopCount > 0u ? ( double )cyclesToJoypadRead / joypadReadStopCount : 0.0,
+        joypadReadStopCount > 0u ? ( double )cyclesToJoypadRead / joypadReadStopCount / gbCyclesPerFrame * 100.0 : 0.0 );
+    printf( "until address:       0x%04X %s after %u cycles\n", stopAddress, stoppedAtAddress ? "reached" : "not reached", addressResult.cycleCount );
+    printf( "correctness:         %s (%u stops differ from a single instruction loop)\n", mismatchCount == 0u ? "ok" : "FAILED", mismatchCount );
+    return mismatchCount == 0u ? 0 : 1;
+}
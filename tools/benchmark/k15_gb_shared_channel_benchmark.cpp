@@ -0,0 +1,227 @@
+//FK: Linux only - Measures the round trip latency of the shared channel between two processes.
+//    The parent runs the emulator and publishes every frame, a forked controller process opens the channel by name (like an external
+//    process would), reads the framebuffer and the ram windows and submits an input that is derived from them.
+//    The round trip is the time between the publish and the parent seeing the input. It's measured once without emulation
+//    (pure ping pong) and once with the emulator running a frame between the round trips.
+//    Build (from the repository root):
+//      g++ -std=c++11 -O2 -DK15_RELEASE_BUILD -Iwin32 tools/benchmark/k15_gb_shared_channel_benchmark.cpp -o k15_gb_shared_channel_benchmark
+//    Usage:
+//      k15_gb_shared_channel_benchmark <rom file> [round trip count] [spin count]
+
+#include <algorithm>
+
+#include <sys/wait.h>
+
+#include "../k15_gb_tool_common.h"
+
+//FK: Set the spin count before including the channel, so it can be changed from the command line
+static uint32_t gbBenchmarkSpinCount = 4096u;
+#define K15_GB_SHARED_CHANNEL_SPIN_COUNT gbBenchmarkSpinCount
+#include "../../k15_gb_shared_channel.h"
+
+static constexpr uint32_t gbBenchmarkDefaultRoundTripCount  = 2000u;
+static constexpr uint32_t gbBenchmarkWarmupFrameCount       = 300u;
+static constexpr uint64_t gbBenchmarkTimeoutInNanoseconds   = 5000000000ull;
+static constexpr uint32_t gbBenchmarkRamWindowCount         = 2u;
+static constexpr uint16_t gbBenchmarkRamWindowAddresses[ gbBenchmarkRamWindowCount ]      = { 0xC000, 0xFF80 };
+static constexpr uint16_t gbBenchmarkRamWindowSizesInBytes[ gbBenchmarkRamWindowCount ]   = { 0x0100, 0x007F };
+
+//FK: The controller derives its input from everything it read, so the parent can check that the controller saw the published frame
+uint8_t calculateControllerButtons( const uint8_t* pFrameBuffer, const uint8_t* const* pRamWindows, const uint32_t frameSequence )
+{
+    uint32_t hash = frameSequence * 0x9E3779B9u;
+    for( uint32_t byteIndex = 0u; byteIndex < K15_GB_SHARED_CHANNEL_FRAME_BUFFER_SIZE; ++byteIndex )
+    {
+        hash = ( hash ^ pFrameBuffer[ byteIndex ] ) * 0x01000193u;
+    }
+
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < gbBenchmarkRamWindowCount; ++ramWindowIndex )
+    {
+        for( uint32_t byteIndex = 0u; byteIndex < gbBenchmarkRamWindowSizesInBytes[ ramWindowIndex ]; ++byteIndex )
+        {
+            hash = ( hash ^ pRamWindows[ ramWindowIndex ][ byteIndex ] ) * 0x01000193u;
+        }
+    }
+
+    return ( uint8_t )( hash ^ ( hash >> 8u ) ^ ( hash >> 16u ) ^ ( hash >> 24u ) );
+}
+
+//FK: Runs in the forked process and only uses the controller side of the channel
+int runController( const char* pChannelName )
+{
+    GBSharedChannel* pChannel = openGBSharedChannel( pChannelName );
+    if( pChannel == nullptr )
+    {
+        return 1;
+    }
+
+    const uint8_t* pRamWindows[ gbBenchmarkRamWindowCount ];
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < gbBenchmarkRamWindowCount; ++ramWindowIndex )
+    {
+        pRamWindows[ ramWindowIndex ] = getGBSharedChannelRamWindow( pChannel, ramWindowIndex );
+    }
+
+    uint32_t frameSequence = 0u;
+    while( true )
+    {
+        const uint32_t newFrameSequence = waitForGBSharedChannelFrame( pChannel, frameSequence, 0u );
+        if( newFrameSequence == frameSequence )
+        {
+            break;
+        }
+
+        frameSequence = newFrameSequence;
+        submitGBSharedChannelInput( pChannel, calculateControllerButtons( getGBSharedChannelFrameBuffer( pChannel ), pRamWindows, frameSequence ), frameSequence );
+    }
+
+    closeGBSharedChannel( pChannel );
+    return 0;
+}
+
+struct GBRoundTripSummary
+{
+    double      minMicroseconds;
+    double      medianMicroseconds;
+    double      p99Microseconds;
+    double      maxMicroseconds;
+    double      averageMicroseconds;
+    double      framesPerSecond;
+    uint32_t    mismatchCount;
+    uint32_t    timeoutCount;
+};
+
+GBRoundTripSummary runRoundTrips( GBSharedChannel* pChannel, GBEmulatorInstance* pEmulatorInstance, const uint32_t roundTripCount, const bool8_t runEmulator, uint64_t* pRoundTripTimes )
+{
+    GBRoundTripSummary summary = {};
+
+    const uint8_t* pRamWindows[ gbBenchmarkRamWindowCount ];
+    for( uint32_t ramWindowIndex = 0u; ramWindowIndex < gbBenchmarkRamWindowCount; ++ramWindowIndex )
+    {
+        pRamWindows[ ramWindowIndex ] = getGBSharedChannelRamWindow( pChannel, ramWindowIndex );
+    }
+
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t roundTripIndex = 0u; roundTripIndex < roundTripCount; ++roundTripIndex )
+    {
+        if( runEmulator )
+        {
+            runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        }
+
+        const uint64_t publishTimeInNanoseconds = getGBSharedChannelTimeInNanoseconds();
+        const uint32_t frameSequence = publishGBSharedChannelFrame( pChannel, pEmulatorInstance );
+        if( !waitForGBSharedChannelInput( pChannel, pEmulatorInstance, gbBenchmarkTimeoutInNanoseconds ) )
+        {
+            ++summary.timeoutCount;
+            break;
+        }
+
+        pRoundTripTimes[ roundTripIndex ] = getGBSharedChannelTimeInNanoseconds() - publishTimeInNanoseconds;
+
+        //FK: The channel still contains what the controller read, so the input has to match
+        const uint8_t expectedButtons = calculateControllerButtons( getGBSharedChannelFrameBuffer( pChannel ), pRamWindows, frameSequence );
+        summary.mismatchCount += pChannel->buttons != expectedButtons;
+    }
+
+    const double elapsedSeconds = getElapsedSeconds( startTime );
+    const uint32_t finishedRoundTripCount = roundTripCount - summary.timeoutCount;
+    if( finishedRoundTripCount == roundTripCount )
+    {
+        std::sort( pRoundTripTimes, pRoundTripTimes + roundTripCount );
+
+        double sumMicroseconds = 0.0;
+        for( uint32_t roundTripIndex = 0u; roundTripIndex < roundTripCount; ++roundTripIndex )
+        {
+            sumMicroseconds += ( double )pRoundTripTimes[ roundTripIndex ] / 1000.0;
+        }
+
+        summary.minMicroseconds     = ( double )pRoundTripTimes[ 0 ] / 1000.0;
+        summary.medianMicroseconds  = ( double )pRoundTripTimes[ roundTripCount / 2u ] / 1000.0;
+        summary.p99Microseconds     = ( double )pRoundTripTimes[ ( roundTripCount * 99u ) / 100u ] / 1000.0;
+        summary.maxMicroseconds     = ( double )pRoundTripTimes[ roundTripCount - 1u ] / 1000.0;
+        summary.averageMicroseconds = sumMicroseconds / roundTripCount;
+        summary.framesPerSecond     = roundTripCount / elapsedSeconds;
+    }
+
+    return summary;
+}
+
+void printGBRoundTripSummary( const char* pName, const GBRoundTripSummary& summary )
+{
+    printf( "%-17s %8.2f us %8.2f us %8.2f us %8.2f us %8.2f us %10.0f/s\n", pName, summary.minMicroseconds, summary.medianMicroseconds, summary.p99Microseconds,
+        summary.maxMicroseconds, summary.averageMicroseconds, summary.framesPerSecond );
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [round trip count] [spin count]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t roundTripCount = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultRoundTripCount;
+    gbBenchmarkSpinCount = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkSpinCount;
+    if( roundTripCount == 0u )
+    {
+        printf( "Round trip count needs to be at least 1\n" );
+        return 1;
+    }
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pInstanceMemory );
+    loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRamMemory );
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    }
+
+    char channelName[ 64 ];
+    snprintf( channelName, sizeof( channelName ), "/k15_gb_channel_benchmark_%d", ( int )getpid() );
+
+    GBSharedChannel* pChannel = createGBSharedChannel( channelName, gbBenchmarkRamWindowAddresses, gbBenchmarkRamWindowSizesInBytes, gbBenchmarkRamWindowCount );
+    if( pChannel == nullptr )
+    {
+        printf( "Could not create the shared channel '%s'\n", channelName );
+        return 1;
+    }
+
+    fflush( nullptr );
+    const pid_t controllerProcessId = fork();
+    if( controllerProcessId == 0 )
+    {
+        _exit( runController( channelName ) );
+    }
+
+    uint64_t* pRoundTripTimes = ( uint64_t* )malloc( roundTripCount * sizeof( uint64_t ) );
+    const GBRoundTripSummary pingPongSummary = runRoundTrips( pChannel, pEmulatorInstance, roundTripCount, 0u, pRoundTripTimes );
+    const GBRoundTripSummary emulatorSummary = runRoundTrips( pChannel, pEmulatorInstance, roundTripCount, 1u, pRoundTripTimes );
+
+    destroyGBSharedChannel( pChannel, channelName );
+
+    int controllerStatus = 0;
+    waitpid( controllerProcessId, &controllerStatus, 0 );
+    const bool8_t controllerFinished = WIFEXITED( controllerStatus ) && WEXITSTATUS( controllerStatus ) == 0;
+
+    const uint32_t mismatchCount = pingPongSummary.mismatchCount + emulatorSummary.mismatchCount;
+    const uint32_t timeoutCount = pingPongSummary.timeoutCount + emulatorSummary.timeoutCount;
+    const bool8_t succeeded = controllerFinished && mismatchCount == 0u && timeoutCount == 0u;
+
+    printf( "round trips: %u per run, spin count: %u, shared memory: %u bytes, cpus: %ld\n", roundTripCount, gbBenchmarkSpinCount,
+        calculateGBSharedChannelSizeInBytes( gbBenchmarkRamWindowSizesInBytes, gbBenchmarkRamWindowCount ), sysconf( _SC_NPROCESSORS_ONLN ) );
+    printf( "                       min     median        p99        max    average     frames\n" );
+    printGBRoundTripSummary( "ping pong:", pingPongSummary );
+    printGBRoundTripSummary( "with emulation:", emulatorSummary );
+    printf( "correctness:       %s (%u mismatching inputs, %u timeouts, controller %s)\n", succeeded ? "ok" : "FAILED", mismatchCount, timeoutCount,
+        controllerFinished ? "finished" : "failed" );
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+//FK: Measures how many snapshots can be restored per second on a single core.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_snapshot_benchmark.cpp
+//    Usage:
+//      k15_gb_snapshot_benchmark <rom file> [restore count] [frames to run between restores]
+
+#include "../k15_gb_tool_common.h"
+
+static constexpr uint32_t gbBenchmarkWarmupFrameCount       = 600u;
+static constexpr uint32_t gbBenchmarkDefaultRestoreCount    = 1000000u;
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [restore count] [frames to run between restores]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t restoreCount     = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultRestoreCount;
+    const uint32_t framesPerRestore = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : 0u;
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    uint8_t* pEmulatorInstanceMemory    = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory        = ( uint8_t* )calloc( 1, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pEmulatorInstanceMemory );
+    if( loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        printf( "Cartridge type of rom '%s' is not supported\n", argv[ 1 ] );
+        return 1;
+    }
+
+    //FK: Get past the boot sequence of the game so the snapshot contains something meaningful
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    }
+
+    const size_t snapshotSizeInBytes = calculateGBEmulatorSnapshotSizeInBytes( pEmulatorInstance );
+    uint8_t* pSnapshotMemory = ( uint8_t* )malloc( snapshotSizeInBytes );
+
+    const std::chrono::high_resolution_clock::time_point snapshotStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t snapshotIndex = 0u; snapshotIndex < restoreCount; ++snapshotIndex )
+    {
+        snapshotGBEmulator( pEmulatorInstance, pSnapshotMemory );
+    }
+    const double snapshotSeconds = getElapsedSeconds( snapshotStartTime );
+
+    if( restoreGBEmulator( pEmulatorInstance, pSnapshotMemory ) != K15_GB_STATE_LOAD_SUCCESS )
+    {
+        printf( "Could not restore the snapshot\n" );
+        return 1;
+    }
+
+    const std::chrono::high_resolution_clock::time_point restoreStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t restoreIndex = 0u; restoreIndex < restoreCount; ++restoreIndex )
+    {
+        restoreGBEmulator( pEmulatorInstance, pSnapshotMemory );
+        for( uint32_t frameIndex = 0u; frameIndex < framesPerRestore; ++frameIndex )
+        {
+            runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        }
+    }
+    const double restoreSeconds = getElapsedSeconds( restoreStartTime );
+
+    printf( "snapshot size:        %zu bytes\n", snapshotSizeInBytes );
+    printf( "snapshots per second: %.0f (%.3f us per snapshot)\n", restoreCount / snapshotSeconds, snapshotSeconds / restoreCount * 1000000.0 );
+    printf( "restores per second:  %.0f (%.3f us per restore, %u frames run after each restore)\n", restoreCount / restoreSeconds, restoreSeconds / restoreCount * 1000000.0, framesPerRestore );
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+//FK: Fills a snapshot store the way a tree search would (restore a random node, play a few frames with random input, store the result)
+//    and reports the dedup ratio and how many snapshots can be restored per second on a single core.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\benchmark\k15_gb_snapshot_store_benchmark.cpp
+//    Usage:
+//      k15_gb_snapshot_store_benchmark <rom file> [snapshot count] [frames per node]
+
+#include "../k15_gb_tool_common.h"
+
+static constexpr uint32_t gbBenchmarkWarmupFrameCount       = 600u;
+static constexpr uint32_t gbBenchmarkDefaultSnapshotCount   = 10000u;
+static constexpr uint32_t gbBenchmarkDefaultFramesPerNode   = 4u;
+static constexpr uint32_t gbBenchmarkRestoreCount           = 1000000u;
+
+//FK: xorshift, deterministic across platforms unlike rand()
+uint32_t getNextRandomNumber( uint32_t* pRandomState )
+{
+    uint32_t value = *pRandomState;
+    value ^= value << 13u;
+    value ^= value >> 17u;
+    value ^= value << 5u;
+    *pRandomState = value;
+    return value;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <rom file> [snapshot count] [frames per node]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t snapshotCount    = argc > 2 ? ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 ) : gbBenchmarkDefaultSnapshotCount;
+    const uint32_t framesPerNode    = argc > 3 ? ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 ) : gbBenchmarkDefaultFramesPerNode;
+    if( snapshotCount < 2u )
+    {
+        printf( "Snapshot count needs to be at least 2\n" );
+        return 1;
+    }
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( argv[ 1 ], &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", argv[ 1 ] );
+        return 1;
+    }
+
+    uint8_t* pEmulatorInstanceMemory    = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory        = ( uint8_t* )calloc( 1, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pEmulatorInstance = createGBEmulatorInstance( pEmulatorInstanceMemory );
+    if( loadGBEmulatorRom( pEmulatorInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        printf( "Cartridge type of rom '%s' is not supported\n", argv[ 1 ] );
+        return 1;
+    }
+
+    for( uint32_t frameIndex = 0u; frameIndex < gbBenchmarkWarmupFrameCount; ++frameIndex )
+    {
+        runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+    }
+
+    //FK: Worst case is that no page can be shared at all (+1 for cartridge ram that is smaller than a page)
+    const uint32_t pagesPerSnapshot = ( uint32_t )( calculateGBEmulatorSnapshotSizeInBytes( pEmulatorInstance ) / gbSnapshotStorePageSizeInBytes ) + 1u;
+    const uint32_t pageCapacity = snapshotCount * pagesPerSnapshot;
+    uint8_t* pSnapshotStoreMemory = ( uint8_t* )malloc( calculateGBSnapshotStoreMemoryRequirementsInBytes( pageCapacity, snapshotCount ) );
+    GBSnapshotStore* pSnapshotStore = createGBSnapshotStore( pSnapshotStoreMemory, pageCapacity, snapshotCount );
+    GBSnapshotHandle* pSnapshotHandles = ( GBSnapshotHandle* )malloc( snapshotCount * sizeof( GBSnapshotHandle ) );
+
+    uint32_t randomState = 0x4B31355Fu;
+    pSnapshotHandles[ 0 ] = storeGBEmulatorSnapshot( pSnapshotStore, pEmulatorInstance );
+
+    const std::chrono::high_resolution_clock::time_point storeStartTime = std::chrono::high_resolution_clock::now();
+    double storeSeconds = 0.0;
+    for( uint32_t snapshotIndex = 1u; snapshotIndex < snapshotCount; ++snapshotIndex )
+    {
+        const GBSnapshotHandle parentHandle = pSnapshotHandles[ getNextRandomNumber( &randomState ) % snapshotIndex ];
+        restoreGBEmulatorSnapshot( pSnapshotStore, pEmulatorInstance, parentHandle );
+
+        GBEmulatorJoypadState joypadState;
+        joypadState.value = ( uint16_t )( getNextRandomNumber( &randomState ) & 0x0F0F );
+        setGBEmulatorJoypadState( pEmulatorInstance, joypadState );
+        for( uint32_t frameIndex = 0u; frameIndex < framesPerNode; ++frameIndex )
+        {
+            runGBEmulatorForCycles( pEmulatorInstance, gbCyclesPerFrame );
+        }
+
+        const std::chrono::high_resolution_clock::time_point snapshotStartTime = std::chrono::high_resolution_clock::now();
+        pSnapshotHandles[ snapshotIndex ] = storeGBEmulatorSnapshot( pSnapshotStore, pEmulatorInstance );
+        storeSeconds += getElapsedSeconds( snapshotStartTime );
+    }
+    const double treeSeconds = getElapsedSeconds( storeStartTime );
+
+    const std::chrono::high_resolution_clock::time_point restoreStartTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t restoreIndex = 0u; restoreIndex < gbBenchmarkRestoreCount; ++restoreIndex )
+    {
+        const GBSnapshotHandle snapshotHandle = pSnapshotHandles[ getNextRandomNumber( &randomState ) % snapshotCount ];
+        restoreGBEmulatorSnapshot( pSnapshotStore, pEmulatorInstance, snapshotHandle );
+    }
+    const double restoreSeconds = getElapsedSeconds( restoreStartTime );
+
+    const GBSnapshotStoreStats stats = getGBSnapshotStoreStats( pSnapshotStore );
+    const size_t undedupedSizeInBytes = ( size_t )stats.snapshotCount * calculateGBEmulatorSnapshotSizeInBytes( pEmulatorInstance );
+    const size_t storeSizeInBytes = stats.pageMemoryUsedInBytes + ( size_t )stats.snapshotCount * calculateGBSnapshotStoreEntrySizeInBytes();
+
+    printf( "snapshots:            %u (%u frames per node, %.2f s to build the tree)\n", stats.snapshotCount, framesPerNode, treeSeconds );
+    printf( "pages:                %u unique / %u referenced (dedup ratio %.2fx)\n", stats.uniquePageCount, stats.referencedPageCount,
+        ( double )stats.referencedPageCount / ( double )stats.uniquePageCount );
+    printf( "memory:               %.2f MB (plain snapshots would need %.2f MB, %.2fx)\n", storeSizeInBytes / ( 1024.0 * 1024.0 ),
+        undedupedSizeInBytes / ( 1024.0 * 1024.0 ), ( double )undedupedSizeInBytes / ( double )storeSizeInBytes );
+    printf( "stores per second:    %.0f (%.3f us per store)\n", ( snapshotCount - 1u ) / storeSeconds, storeSeconds / ( snapshotCount - 1u ) * 1000000.0 );
+    printf( "restores per second:  %.0f (%.3f us per restore, random handles)\n", gbBenchmarkRestoreCount / restoreSeconds, restoreSeconds / gbBenchmarkRestoreCount * 1000000.0 );
+
+    return 0;
+}
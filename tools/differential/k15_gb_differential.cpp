@@ -0,0 +1,280 @@
+//FK: Runs a corpus of roms through the differential runner (see k15_gb_differential.h) in parallel: every rom runs on a reference instance
+//    that executes one instruction at a time and on an instance using the optimized path. Stops a rom at its first mismatch and prints a diff.
+//    Illegal and unimplemented opcodes don't break into the debugger, so a broken rom doesn't stop the whole corpus.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\differential\k15_gb_differential.cpp
+//    Usage:
+//      k15_gb_differential <path> <compare interval in cycles> <frame count> <rom file> [rom file ...]
+//    Paths:
+//      cycles      runGBEmulatorForCycles()
+//      until       runGBEmulatorUntil() stopping at every condition
+//      norender    runGBEmulatorForCycles() with rendering disabled (framebuffers aren't compared)
+
+#define K15_BREAK_ON_UNKNOWN_INSTRUCTION    0
+#define K15_BREAK_ON_ILLEGAL_INSTRUCTION    0
+
+#include <thread>
+#include <atomic>
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_differential.h"
+
+enum DifferentialRomResult : uint8_t
+{
+    DifferentialRomResult_Match = 0,
+    DifferentialRomResult_Mismatch,
+    DifferentialRomResult_LoadFailed
+};
+
+struct DifferentialPath
+{
+    const char*                 pName;
+    GBDifferentialRunFunction   pRunFunction;
+    bool8_t                     rendersFrames;
+};
+
+static const DifferentialPath differentialPaths[] = {
+    { "cycles",     runGBDifferentialForCycles,         1u },
+    { "until",      runGBDifferentialUntil,             1u },
+    { "norender",   runGBDifferentialWithoutRendering,  0u },
+};
+
+struct DifferentialRom
+{
+    const char*             pRomFilePath;
+    DifferentialRomResult   result;
+    uint32_t                mismatchFrameIndex;
+    GBDifferentialStats     stats;
+    GBDifferentialMismatch  mismatch;
+};
+
+struct DifferentialCorpus
+{
+    DifferentialRom*        pRoms;
+    const DifferentialPath* pPath;
+    std::atomic<uint32_t>   nextRomIndex;
+    uint32_t                romCount;
+    uint32_t                compareIntervalInCycles;
+    uint32_t                frameCount;
+};
+
+//FK: Buttons are held for a couple of frames like a player would, every rom gets a different sequence
+GBEmulatorJoypadState getFrameJoypadState( const uint32_t romIndex, const uint32_t frameIndex )
+{
+    uint32_t value = ( 0x9E3779B9u + romIndex * 0x27D4EB2Fu ) ^ ( frameIndex / 12u ) * 0x85EBCA6Bu;
+    value ^= value >> 15u;
+
+    GBEmulatorJoypadState joypadState;
+    joypadState.value = ( uint16_t )( value & 0x0F0F );
+    return joypadState;
+}
+
+GBEmulatorInstance* createInstance( const uint8_t* pRomData )
+{
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    if( loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        free( pCartridgeRamMemory );
+        free( pInstanceMemory );
+        return nullptr;
+    }
+
+    return pInstance;
+}
+
+void destroyInstance( GBEmulatorInstance* pInstance )
+{
+    if( pInstance != nullptr )
+    {
+        free( pInstance->cartridge.pRamBaseAddress );
+        free( pInstance );
+    }
+}
+
+void runDifferentialRom( DifferentialCorpus* pCorpus, const uint32_t romIndex )
+{
+    DifferentialRom* pRom = pCorpus->pRoms + romIndex;
+    pRom->result = DifferentialRomResult_LoadFailed;
+
+    size_t romSizeInBytes = 0u;
+    uint8_t* pRomData = readFile( pRom->pRomFilePath, &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        free( pRomData );
+        return;
+    }
+
+    GBEmulatorInstance* pReferenceInstance = createInstance( pRomData );
+    GBEmulatorInstance* pOptimizedInstance = createInstance( pRomData );
+    if( pReferenceInstance != nullptr && pOptimizedInstance != nullptr )
+    {
+        uint8_t runnerMemory[ sizeof( GBDifferentialRunner ) ];
+        GBDifferentialRunner* pRunner = createGBDifferentialRunner( runnerMemory, pReferenceInstance, pOptimizedInstance, pCorpus->pPath->pRunFunction, nullptr,
+            pCorpus->compareIntervalInCycles, pCorpus->pPath->rendersFrames );
+
+        pRom->result = DifferentialRomResult_Match;
+        for( uint32_t frameIndex = 0u; frameIndex < pCorpus->frameCount; ++frameIndex )
+        {
+            if( !runGBDifferentialRunner( pRunner, getFrameJoypadState( romIndex, frameIndex ), gbCyclesPerFrame, &pRom->mismatch ) )
+            {
+                pRom->result = DifferentialRomResult_Mismatch;
+                pRom->mismatchFrameIndex = frameIndex;
+                break;
+            }
+        }
+
+        pRom->stats = getGBDifferentialRunnerStats( pRunner );
+    }
+
+    destroyInstance( pReferenceInstance );
+    destroyInstance( pOptimizedInstance );
+    free( pRomData );
+}
+
+void runDifferentialWorker( DifferentialCorpus* pCorpus )
+{
+    while( true )
+    {
+        const uint32_t romIndex = pCorpus->nextRomIndex.fetch_add( 1u );
+        if( romIndex >= pCorpus->romCount )
+        {
+            return;
+        }
+
+        runDifferentialRom( pCorpus, romIndex );
+    }
+}
+
+void printMismatch( const DifferentialRom* pRom )
+{
+    const GBDifferentialMismatch* pMismatch = &pRom->mismatch;
+    printf( "  frame %u, cycle %llu (optimized: %llu), last instruction of the reference at PC 0x%04X\n", pRom->mismatchFrameIndex,
+        ( unsigned long long )pMismatch->referenceCycle, ( unsigned long long )pMismatch->optimizedCycle, pMismatch->lastReferencePC );
+
+    printf( "  differing regions:" );
+    for( uint32_t regionIndex = 0u; regionIndex < K15_GB_STATE_HASH_REGION_COUNT; ++regionIndex )
+    {
+        if( pMismatch->regionMask & ( 1u << regionIndex ) )
+        {
+            printf( " %s", getGBStateHashRegionName( ( GBStateHashRegion )regionIndex ) );
+        }
+    }
+    printf( "%s\n", pMismatch->frameBufferDiffers ? " framebuffer" : "" );
+
+    const GBCpuState* pA = &pMismatch->referenceCpuState;
+    const GBCpuState* pB = &pMismatch->optimizedCpuState;
+    printf( "              reference          optimized\n" );
+
+    const char* pRegisterNames[] = { "AF", "BC", "DE", "HL", "SP", "PC" };
+    const uint16_t registers[][ 2 ] = {
+        { pA->registers.AF, pB->registers.AF }, { pA->registers.BC, pB->registers.BC }, { pA->registers.DE, pB->registers.DE },
+        { pA->registers.HL, pB->registers.HL }, { pA->registers.SP, pB->registers.SP }, { pA->registers.PC, pB->registers.PC } };
+    for( uint32_t registerIndex = 0u; registerIndex < 6u; ++registerIndex )
+    {
+        const char* pMarker = registers[ registerIndex ][ 0 ] != registers[ registerIndex ][ 1 ] ? "<--" : "";
+        printf( "    %-9s 0x%04X             0x%04X             %s\n", pRegisterNames[ registerIndex ], registers[ registerIndex ][ 0 ], registers[ registerIndex ][ 1 ], pMarker );
+    }
+
+    printf( "    %-9s %-18u %-18u %s\n", "cycles", pA->cycleCounter, pB->cycleCounter, pA->cycleCounter != pB->cycleCounter ? "<--" : "" );
+    printf( "    %-9s 0x%04X/%-11u 0x%04X/%-11u %s\n", "dma", pA->dmaAddress, pA->dmaCycleCounter, pB->dmaAddress, pB->dmaCycleCounter,
+        pA->dmaAddress != pB->dmaAddress || pA->dmaCycleCounter != pB->dmaCycleCounter ? "<--" : "" );
+    printf( "    %-9s %u%u%u%u%u%u             %u%u%u%u%u%u             (IME halt stop dma haltBug pendingEI)\n", "flags",
+        pA->flags.IME, pA->flags.halt, pA->flags.stop, pA->flags.dma, pA->flags.haltBug, pA->flags.pendingEI,
+        pB->flags.IME, pB->flags.halt, pB->flags.stop, pB->flags.dma, pB->flags.haltBug, pB->flags.pendingEI );
+
+    const uint32_t printedMemoryDiffCount = pMismatch->memoryDiffCount < gbDifferentialMaxMemoryDiffCount ? pMismatch->memoryDiffCount : gbDifferentialMaxMemoryDiffCount;
+    for( uint32_t memoryDiffIndex = 0u; memoryDiffIndex < printedMemoryDiffCount; ++memoryDiffIndex )
+    {
+        const GBDifferentialMemoryDiff* pMemoryDiff = pMismatch->memoryDiffs + memoryDiffIndex;
+        printf( "    0x%04X    0x%02X               0x%02X\n", pMemoryDiff->address, pMemoryDiff->referenceValue, pMemoryDiff->optimizedValue );
+    }
+
+    if( pMismatch->memoryDiffCount > printedMemoryDiffCount )
+    {
+        printf( "    ... %u more differing bytes of mapped memory\n", pMismatch->memoryDiffCount - printedMemoryDiffCount );
+    }
+
+    if( pMismatch->cartridgeRamDiffCount > 0u )
+    {
+        printf( "    %u differing bytes of cartridge ram, first one at offset 0x%05X\n", pMismatch->cartridgeRamDiffCount, pMismatch->firstCartridgeRamDiffOffset );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 5 )
+    {
+        printf( "Usage: %s <path> <compare interval in cycles> <frame count> <rom file> [rom file ...]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const DifferentialPath* pPath = nullptr;
+    for( uint32_t pathIndex = 0u; pathIndex < sizeof( differentialPaths ) / sizeof( differentialPaths[ 0 ] ); ++pathIndex )
+    {
+        pPath = strcmp( argv[ 1 ], differentialPaths[ pathIndex ].pName ) == 0 ? differentialPaths + pathIndex : pPath;
+    }
+
+    const uint32_t compareIntervalInCycles = ( uint32_t )strtoul( argv[ 2 ], nullptr, 10 );
+    if( pPath == nullptr || compareIntervalInCycles == 0u )
+    {
+        printf( "Unknown path '%s' (cycles, until or norender) or invalid compare interval\n", argv[ 1 ] );
+        return 1;
+    }
+
+    DifferentialCorpus corpus;
+    corpus.romCount                 = ( uint32_t )( argc - 4 );
+    corpus.pRoms                    = ( DifferentialRom* )calloc( corpus.romCount, sizeof( DifferentialRom ) );
+    corpus.pPath                    = pPath;
+    corpus.compareIntervalInCycles  = compareIntervalInCycles;
+    corpus.frameCount               = ( uint32_t )strtoul( argv[ 3 ], nullptr, 10 );
+    corpus.nextRomIndex             = 0u;
+
+    for( uint32_t romIndex = 0u; romIndex < corpus.romCount; ++romIndex )
+    {
+        corpus.pRoms[ romIndex ].pRomFilePath = argv[ 4 + romIndex ];
+    }
+
+    uint32_t workerCount = ( uint32_t )std::thread::hardware_concurrency();
+    workerCount = workerCount == 0u ? 1u : workerCount;
+    workerCount = workerCount > corpus.romCount ? corpus.romCount : workerCount;
+
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    std::thread* pWorkers = new std::thread[ workerCount ];
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        pWorkers[ workerIndex ] = std::thread( runDifferentialWorker, &corpus );
+    }
+
+    for( uint32_t workerIndex = 0u; workerIndex < workerCount; ++workerIndex )
+    {
+        pWorkers[ workerIndex ].join();
+    }
+    const double seconds = getElapsedSeconds( startTime );
+    delete[] pWorkers;
+
+    uint32_t resultCounts[ 3 ] = {};
+    uint64_t comparisonCount = 0u;
+    uint64_t cycleCount = 0u;
+    for( uint32_t romIndex = 0u; romIndex < corpus.romCount; ++romIndex )
+    {
+        const DifferentialRom* pRom = corpus.pRoms + romIndex;
+        ++resultCounts[ pRom->result ];
+        comparisonCount += pRom->stats.comparisonCount;
+        cycleCount += pRom->stats.cycleCount;
+
+        const char* pResultNames[] = { "match", "MISMATCH", "could not load" };
+        printf( "%-8s %s\n", pResultNames[ pRom->result ], pRom->pRomFilePath );
+        if( pRom->result == DifferentialRomResult_Mismatch )
+        {
+            printMismatch( pRom );
+        }
+    }
+
+    printf( "path '%s', compared every %u cycles: %u roms on %u threads in %.2f s (%llu comparisons, %.0f emulated frames/s)\n", pPath->pName, compareIntervalInCycles,
+        corpus.romCount, workerCount, seconds, ( unsigned long long )comparisonCount, ( double )cycleCount / gbCyclesPerFrame / seconds );
+    printf( "correctness: %s (%u match, %u mismatch, %u could not be loaded)\n", resultCounts[ DifferentialRomResult_Mismatch ] == 0u ? "ok" : "FAILED",
+        resultCounts[ DifferentialRomResult_Match ], resultCounts[ DifferentialRomResult_Mismatch ], resultCounts[ DifferentialRomResult_LoadFailed ] );
+    return resultCounts[ DifferentialRomResult_Mismatch ] == 0u && resultCounts[ DifferentialRomResult_LoadFailed ] == 0u ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+//FK: Helpers shared by the command line tools (benchmarks, differential runner, state bisect and the headless emulator).
+//    Include this instead of k15_gb_emulator.h - defines that change the emulator (K15_BREAK_ON_*, K15_GB_FRAME_BUFFER_COUNT, ...)
+//    have to be set before including it.
+#ifndef K15_GB_TOOL_COMMON
+#define K15_GB_TOOL_COMMON
+
+#ifndef _CRT_SECURE_NO_WARNINGS
+#   define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#ifndef restrict_modifier
+#   ifdef _MSC_VER
+#       define restrict_modifier __restrict
+#   else
+#       define restrict_modifier __restrict__
+#   endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+
+#include "../k15_gb_emulator.h"
+
+enum GBInstanceCompareFlags : uint8_t
+{
+    InstanceCompare_Registers       = ( 1u << 0u ),
+    InstanceCompare_MappedMemory    = ( 1u << 1u ),
+    InstanceCompare_FrameBuffers    = ( 1u << 2u ),
+
+    //FK: cpu, apu, ppu, timer, serial and input poll state plus the memory mapper registers, byte by byte.
+    //    Cartridge and rom/ram bank pointers are skipped since they differ between instances with their own cartridge ram
+    InstanceCompare_SubStates       = ( 1u << 3u ),
+    InstanceCompare_CartridgeRam    = ( 1u << 4u ),
+    InstanceCompare_CycleCount      = ( 1u << 5u ),
+
+    InstanceCompare_Default         = InstanceCompare_Registers | InstanceCompare_MappedMemory | InstanceCompare_CycleCount
+};
+
+uint8_t* readFile( const char* pFilePath, size_t* pOutFileSizeInBytes )
+{
+    FILE* pFile = fopen( pFilePath, "rb" );
+    if( pFile == nullptr )
+    {
+        return nullptr;
+    }
+
+    fseek( pFile, 0, SEEK_END );
+    const long fileSizeInBytes = ftell( pFile );
+    fseek( pFile, 0, SEEK_SET );
+
+    uint8_t* pFileData = nullptr;
+    if( fileSizeInBytes > 0 )
+    {
+        pFileData = ( uint8_t* )malloc( fileSizeInBytes );
+        if( fread( pFileData, 1, fileSizeInBytes, pFile ) != ( size_t )fileSizeInBytes )
+        {
+            free( pFileData );
+            pFileData = nullptr;
+        }
+    }
+
+    fclose( pFile );
+    *pOutFileSizeInBytes = ( size_t )fileSizeInBytes;
+    return pFileData;
+}
+
+double getElapsedSeconds( const std::chrono::high_resolution_clock::time_point startTime )
+{
+    const std::chrono::duration<double> elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
+    return elapsedTime.count();
+}
+
+bool8_t instancesMatch( const GBEmulatorInstance* pInstance, const GBEmulatorInstance* pOtherInstance, const uint8_t compareFlags = InstanceCompare_Default )
+{
+    bool8_t match = 1u;
+    if( compareFlags & InstanceCompare_Registers )
+    {
+        match &= memcmp( &pInstance->cpuState.registers, &pOtherInstance->cpuState.registers, sizeof( pInstance->cpuState.registers ) ) == 0;
+    }
+
+    if( compareFlags & InstanceCompare_SubStates )
+    {
+        match &= memcmp( &pInstance->cpuState, &pOtherInstance->cpuState, offsetof( GBEmulatorInstance, cartridge ) - offsetof( GBEmulatorInstance, cpuState ) ) == 0;
+        match &= memcmp( &pInstance->memoryMapper, &pOtherInstance->memoryMapper, offsetof( GBMemoryMapper, pRom0Bank ) ) == 0;
+    }
+
+    if( compareFlags & InstanceCompare_MappedMemory )
+    {
+        match &= memcmp( pInstance->memoryMapper.memory, pOtherInstance->memoryMapper.memory, gbMappedMemorySizeInBytes ) == 0;
+    }
+
+    if( compareFlags & InstanceCompare_CycleCount )
+    {
+        match &= getGBEmulatorCycleCount( pInstance ) == getGBEmulatorCycleCount( pOtherInstance );
+    }
+
+    if( compareFlags & InstanceCompare_FrameBuffers )
+    {
+        match &= memcmp( pInstance->gbFrameBuffers, pOtherInstance->gbFrameBuffers, sizeof( pInstance->gbFrameBuffers ) ) == 0;
+    }
+
+    if( compareFlags & InstanceCompare_CartridgeRam )
+    {
+        const uint32_t ramSizeInBytes = pInstance->cartridge.ramSizeInBytes;
+        match &= ramSizeInBytes == pOtherInstance->cartridge.ramSizeInBytes;
+        match &= ramSizeInBytes == 0u || memcmp( pInstance->cartridge.pRamBaseAddress, pOtherInstance->cartridge.pRamBaseAddress, ramSizeInBytes ) == 0;
+    }
+
+    return match;
+}
+
+#endif //K15_GB_TOOL_COMMON
@@ -0,0 +1,707 @@
+//FK: Finds the first frame and instruction at which two runs of the same input movie (see k15_gb_movie.h) stop having the same state.
+//    - 'bisect' runs two configurations side by side, compares the state hashes at every checkpoint, bisects down to the first differing frame
+//      and then steps that frame one instruction at a time on both instances and prints a diff of the first differing state.
+//    - 'hash' and 'trace' write the state hash of every frame (or every instruction of a single frame) to a log file, 'compare' finds the
+//      first differing entry of two log files - use these to compare different builds or machines.
+//    Build (from the repository root):
+//      cl /nologo /O2 /DK15_RELEASE_BUILD /Iwin32 tools\state_bisect\k15_gb_state_bisect.cpp
+//    Usage:
+//      k15_gb_state_bisect record <rom file> <movie file> [frame count] [keyframe interval]
+//      k15_gb_state_bisect hash <rom file> <movie file> <log file> [config]
+//      k15_gb_state_bisect trace <rom file> <movie file> <frame> <log file> [config]
+//      k15_gb_state_bisect compare <log file> <other log file>
+//      k15_gb_state_bisect bisect <rom file> <movie file> <config> <other config> [checkpoint interval]
+//    Configs:
+//      plain       frames run using runGBEmulatorForCycles()
+//      norender    same as plain with rendering disabled
+//      snapshot    snapshot and restore the instance before every frame
+//      savestate   store and load a save state before every frame
+
+#include "../k15_gb_tool_common.h"
+#include "../../k15_gb_movie.h"
+
+static constexpr uint32_t gbStateBisectDefaultFrameCount            = 3600u;
+static constexpr uint32_t gbStateBisectDefaultCheckpointInterval    = 60u;
+static constexpr uint32_t gbStateBisectMaxPrintedMemoryDiffCount    = 16u;
+static constexpr uint32_t gbStateHashLogFourCC                      = FourCC( 'K', 'G', 'B', 'H' );
+static constexpr uint32_t gbStateHashLogFrameLog                    = 0xFFFFFFFFu;
+
+enum StateBisectConfig : uint8_t
+{
+    StateBisectConfig_Plain = 0,
+    StateBisectConfig_NoRender,
+    StateBisectConfig_Snapshot,
+    StateBisectConfig_SaveState,
+
+    StateBisectConfig_Count
+};
+
+static const char* stateBisectConfigNames[ StateBisectConfig_Count ] = { "plain", "norender", "snapshot", "savestate" };
+
+struct StateHashLogHeader
+{
+    uint32_t    fourCC;
+    uint32_t    regionCount;
+    uint32_t    entryCount;
+    uint32_t    traceFrameIndex;    //FK: gbStateHashLogFrameLog for logs with an entry per frame
+};
+
+struct StateHashLogEntry
+{
+    uint64_t    cycle;              //FK: See getGBEmulatorCycleCount()
+    uint32_t    frameIndex;
+    uint32_t    instructionIndex;
+    uint32_t    pc;                 //FK: PC of the instruction that ran last
+    uint32_t    padding;
+    GBStateHash stateHash;
+};
+
+struct StateBisectRun
+{
+    GBEmulatorInstance* pInstance;
+    uint8_t*            pScratchMemory;     //FK: Snapshot or save state of the config
+    uint8_t*            pCheckpoint;
+    StateBisectConfig   config;
+};
+
+bool8_t writeFile( const char* pFilePath, const void* pData, const size_t dataSizeInBytes )
+{
+    FILE* pFile = fopen( pFilePath, "wb" );
+    if( pFile == nullptr )
+    {
+        return 0u;
+    }
+
+    const bool8_t success = fwrite( pData, 1, dataSizeInBytes, pFile ) == dataSizeInBytes;
+    fclose( pFile );
+    return success;
+}
+
+bool8_t parseConfig( const char* pConfigName, StateBisectConfig* pOutConfig )
+{
+    for( uint8_t configIndex = 0u; configIndex < StateBisectConfig_Count; ++configIndex )
+    {
+        if( strcmp( pConfigName, stateBisectConfigNames[ configIndex ] ) == 0 )
+        {
+            *pOutConfig = ( StateBisectConfig )configIndex;
+            return 1u;
+        }
+    }
+
+    printf( "Unknown config '%s'\n", pConfigName );
+    return 0u;
+}
+
+GBEmulatorInstance* createInstance( const char* pRomFilePath )
+{
+    size_t romSizeInBytes = 0u;
+    const uint8_t* pRomData = readFile( pRomFilePath, &romSizeInBytes );
+    if( pRomData == nullptr || !isValidGBRomData( pRomData, ( uint32_t )romSizeInBytes ) )
+    {
+        printf( "Could not load rom '%s'\n", pRomFilePath );
+        return nullptr;
+    }
+
+    uint8_t* pInstanceMemory = ( uint8_t* )malloc( calculateGBEmulatorMemoryRequirementsInBytes() );
+    uint8_t* pCartridgeRamMemory = ( uint8_t* )calloc( 1u, gbMaxRamSizeInBytes );
+    GBEmulatorInstance* pInstance = createGBEmulatorInstance( pInstanceMemory );
+    if( loadGBEmulatorRom( pInstance, pRomData, pCartridgeRamMemory ) != K15_GB_CARTRIDGE_MAPPED_SUCCESSFULLY )
+    {
+        printf( "Cartridge type of rom '%s' is not supported\n", pRomFilePath );
+        return nullptr;
+    }
+
+    return pInstance;
+}
+
+//FK: Returns the joypad state of every frame, the instance is put into the start state of the movie
+GBEmulatorJoypadState* loadMovie( GBEmulatorInstance* pInstance, const char* pMovieFilePath, uint32_t* pOutFrameCount )
+{
+    size_t movieSizeInBytes = 0u;
+    const uint8_t* pMovieMemory = readFile( pMovieFilePath, &movieSizeInBytes );
+
+    GBMovie movie;
+    if( pMovieMemory == nullptr || openGBMovie( &movie, pMovieMemory, movieSizeInBytes, pInstance ) != K15_GB_MOVIE_LOAD_SUCCESS )
+    {
+        printf( "Could not load movie '%s' (or it has been recorded using a different rom)\n", pMovieFilePath );
+        return nullptr;
+    }
+
+    GBEmulatorJoypadState* pJoypadStates = ( GBEmulatorJoypadState* )malloc( ( movie.header.frameCount + 1u ) * sizeof( GBEmulatorJoypadState ) );
+    unpackGBMovieInput( &movie, pJoypadStates );
+    loadGBMovieStartState( pInstance, movie.pStartState, movie.header.startStateSizeInBytes );
+
+    *pOutFrameCount = movie.header.frameCount;
+    return pJoypadStates;
+}
+
+void createRun( StateBisectRun* pRun, GBEmulatorInstance* pInstance, const StateBisectConfig config )
+{
+    const size_t snapshotSizeInBytes = calculateGBEmulatorSnapshotSizeInBytes( pInstance );
+    const size_t stateSizeInBytes = calculateGBEmulatorStateSizeInBytes( pInstance );
+
+    pRun->pInstance         = pInstance;
+    pRun->pScratchMemory    = ( uint8_t* )malloc( snapshotSizeInBytes > stateSizeInBytes ? snapshotSizeInBytes : stateSizeInBytes );
+    pRun->pCheckpoint       = ( uint8_t* )malloc( snapshotSizeInBytes );
+    pRun->config            = config;
+}
+
+//FK: Everything a config does before the instructions of a frame run
+void beginRunFrame( StateBisectRun* pRun, const GBEmulatorJoypadState joypadState )
+{
+    GBEmulatorInstance* pInstance = pRun->pInstance;
+    switch( pRun->config )
+    {
+        case StateBisectConfig_Snapshot:
+            snapshotGBEmulator( pInstance, pRun->pScratchMemory );
+            restoreGBEmulator( pInstance, pRun->pScratchMemory );
+            break;
+        case StateBisectConfig_SaveState:
+        {
+            const size_t stateSizeInBytes = storeGBEmulatorState( pInstance, pRun->pScratchMemory, calculateGBEmulatorStateSizeInBytes( pInstance ) );
+            loadGBEmulatorState( pInstance, pRun->pScratchMemory, stateSizeInBytes );
+            break;
+        }
+        default:
+            break;
+    }
+
+    setGBEmulatorRenderingEnabled( pInstance, pRun->config != StateBisectConfig_NoRender );
+    setGBEmulatorJoypadState( pInstance, joypadState );
+}
+
+void runFrame( StateBisectRun* pRun, const GBEmulatorJoypadState joypadState )
+{
+    beginRunFrame( pRun, joypadState );
+    runGBEmulatorForCycles( pRun->pInstance, gbCyclesPerFrame );
+}
+
+void printStateHashRegions( const GBStateHash* pStateHash, const GBStateHash* pOtherStateHash )
+{
+    printf( "differing regions:" );
+    for( uint8_t regionIndex = 0u; regionIndex < K15_GB_STATE_HASH_REGION_COUNT; ++regionIndex )
+    {
+        if( pStateHash->regionHashes[ regionIndex ] != pOtherStateHash->regionHashes[ regionIndex ] )
+        {
+            printf( " %s", getGBStateHashRegionName( ( GBStateHashRegion )regionIndex ) );
+        }
+    }
+    printf( "\n" );
+}
+
+void printCpuStateDiff( const GBEmulatorInstance* pInstance, const GBEmulatorInstance* pOtherInstance )
+{
+    const GBCpuState* pA = &pInstance->cpuState;
+    const GBCpuState* pB = &pOtherInstance->cpuState;
+    printf( "            %-18s %-18s\n", "run", "other run" );
+
+    const char* pRegisterNames[] = { "AF", "BC", "DE", "HL", "SP", "PC" };
+    const uint16_t registers[][ 2 ] = {
+        { pA->registers.AF, pB->registers.AF }, { pA->registers.BC, pB->registers.BC }, { pA->registers.DE, pB->registers.DE },
+        { pA->registers.HL, pB->registers.HL }, { pA->registers.SP, pB->registers.SP }, { pA->registers.PC, pB->registers.PC } };
+    for( uint32_t registerIndex = 0u; registerIndex < 6u; ++registerIndex )
+    {
+        const char* pMarker = registers[ registerIndex ][ 0 ] != registers[ registerIndex ][ 1 ] ? "<--" : "";
+        printf( "  %-9s 0x%04X             0x%04X             %s\n", pRegisterNames[ registerIndex ], registers[ registerIndex ][ 0 ], registers[ registerIndex ][ 1 ], pMarker );
+    }
+
+    printf( "  %-9s %-18u %-18u %s\n", "cycles", pA->cycleCounter, pB->cycleCounter, pA->cycleCounter != pB->cycleCounter ? "<--" : "" );
+    printf( "  %-9s %-18llu %-18llu %s\n", "total", ( unsigned long long )pA->totalCycleCounter, ( unsigned long long )pB->totalCycleCounter,
+        pA->totalCycleCounter != pB->totalCycleCounter ? "<--" : "" );
+    printf( "  %-9s %u%u%u%u%u%u             %u%u%u%u%u%u             (IME halt stop dma haltBug pendingEI)\n", "flags",
+        pA->flags.IME, pA->flags.halt, pA->flags.stop, pA->flags.dma, pA->flags.haltBug, pA->flags.pendingEI,
+        pB->flags.IME, pB->flags.halt, pB->flags.stop, pB->flags.dma, pB->flags.haltBug, pB->flags.pendingEI );
+}
+
+uint16_t getMappedMemoryOffsetAddress( const size_t memoryOffset )
+{
+    if( memoryOffset < gbWorkRamMemoryOffset )
+    {
+        return ( uint16_t )( 0x8000 + memoryOffset - gbVideoRamMemoryOffset );
+    }
+
+    if( memoryOffset < gbHighMemoryOffset )
+    {
+        return ( uint16_t )( 0xC000 + memoryOffset - gbWorkRamMemoryOffset );
+    }
+
+    return ( uint16_t )( 0xFE00 + memoryOffset - gbHighMemoryOffset );
+}
+
+void printMemoryDiff( const GBEmulatorInstance* pInstance, const GBEmulatorInstance* pOtherInstance )
+{
+    uint32_t diffCount = 0u;
+    const uint8_t* pMemory = pInstance->memoryMapper.memory;
+    const uint8_t* pOtherMemory = pOtherInstance->memoryMapper.memory;
+    for( size_t memoryOffset = 0u; memoryOffset < gbMappedMemorySizeInBytes; ++memoryOffset )
+    {
+        if( pMemory[ memoryOffset ] != pOtherMemory[ memoryOffset ] && diffCount++ < gbStateBisectMaxPrintedMemoryDiffCount )
+        {
+            printf( "  0x%04X    0x%02X               0x%02X\n", getMappedMemoryOffsetAddress( memoryOffset ), pMemory[ memoryOffset ], pOtherMemory[ memoryOffset ] );
+        }
+    }
+
+    const GBCartridge* pCartridge = &pInstance->cartridge;
+    const GBCartridge* pOtherCartridge = &pOtherInstance->cartridge;
+    for( uint32_t ramOffset = 0u; ramOffset < pCartridge->ramSizeInBytes; ++ramOffset )
+    {
+        if( pCartridge->pRamBaseAddress[ ramOffset ] != pOtherCartridge->pRamBaseAddress[ ramOffset ] && diffCount++ < gbStateBisectMaxPrintedMemoryDiffCount )
+        {
+            printf( "  ram+0x%05X 0x%02X              0x%02X\n", ramOffset, pCartridge->pRamBaseAddress[ ramOffset ], pOtherCartridge->pRamBaseAddress[ ramOffset ] );
+        }
+    }
+
+    if( diffCount > gbStateBisectMaxPrintedMemoryDiffCount )
+    {
+        printf( "  ... %u more differing bytes\n", diffCount - gbStateBisectMaxPrintedMemoryDiffCount );
+    }
+}
+
+int recordMovie( int argc, char** argv )
+{
+    if( argc < 4 )
+    {
+        printf( "Usage: %s record <rom file> <movie file> [frame count] [keyframe interval]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const uint32_t frameCount       = argc > 4 ? ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 ) : gbStateBisectDefaultFrameCount;
+    const uint32_t keyframeInterval = argc > 5 ? ( uint32_t )strtoul( argv[ 5 ], nullptr, 10 ) : gbMovieDefaultKeyframeInterval;
+    GBEmulatorInstance* pInstance = createInstance( argv[ 2 ] );
+    if( pInstance == nullptr || frameCount == 0u || keyframeInterval == 0u )
+    {
+        return 1;
+    }
+
+    uint8_t* pRecorderMemory = ( uint8_t* )malloc( calculateGBMovieRecorderMemoryRequirementsInBytes( pInstance, frameCount, keyframeInterval, 1u ) );
+    GBMovieRecorder* pRecorder = createGBMovieRecorder( pRecorderMemory, pInstance, frameCount, keyframeInterval, 1u, 1u );
+    if( pRecorder == nullptr )
+    {
+        printf( "Could not record movie '%s'\n", argv[ 3 ] );
+        return 1;
+    }
+
+    //FK: Scripted input, buttons are held for a couple of frames like a player would
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        uint32_t value = 0x9E3779B9u ^ ( frameIndex / 12u ) * 0x85EBCA6Bu;
+        value ^= value >> 15u;
+
+        GBEmulatorJoypadState joypadState;
+        joypadState.value = ( uint16_t )( value & 0x0F0F );
+        runGBMovieRecorderFrame( pRecorder, joypadState );
+    }
+
+    uint8_t* pMovieMemory = ( uint8_t* )malloc( calculateGBMovieSizeInBytes( pRecorder ) );
+    const size_t movieSizeInBytes = writeGBMovie( pRecorder, pMovieMemory );
+    if( !writeFile( argv[ 3 ], pMovieMemory, movieSizeInBytes ) )
+    {
+        printf( "Could not write movie '%s'\n", argv[ 3 ] );
+        return 1;
+    }
+
+    printf( "recorded %u frames (%zu bytes)\n", frameCount, movieSizeInBytes );
+    return 0;
+}
+
+bool8_t writeStateHashLog( const char* pLogFilePath, const StateHashLogEntry* pEntries, const uint32_t entryCount, const uint32_t traceFrameIndex )
+{
+    StateHashLogHeader header;
+    header.fourCC           = gbStateHashLogFourCC;
+    header.regionCount      = K15_GB_STATE_HASH_REGION_COUNT;
+    header.entryCount       = entryCount;
+    header.traceFrameIndex  = traceFrameIndex;
+
+    const size_t logSizeInBytes = sizeof( header ) + entryCount * sizeof( StateHashLogEntry );
+    uint8_t* pLogMemory = ( uint8_t* )malloc( logSizeInBytes );
+    memcpy( pLogMemory, &header, sizeof( header ) );
+    memcpy( pLogMemory + sizeof( header ), pEntries, entryCount * sizeof( StateHashLogEntry ) );
+
+    const bool8_t success = writeFile( pLogFilePath, pLogMemory, logSizeInBytes );
+    if( !success )
+    {
+        printf( "Could not write log '%s'\n", pLogFilePath );
+    }
+
+    free( pLogMemory );
+    return success;
+}
+
+void fillStateHashLogEntry( StateHashLogEntry* pEntry, const GBEmulatorInstance* pInstance, const uint32_t frameIndex, const uint32_t instructionIndex, const uint16_t pc )
+{
+    pEntry->cycle               = getGBEmulatorCycleCount( pInstance );
+    pEntry->frameIndex          = frameIndex;
+    pEntry->instructionIndex    = instructionIndex;
+    pEntry->pc                  = pc;
+    pEntry->padding             = 0u;
+    calculateGBEmulatorStateHash( pInstance, &pEntry->stateHash );
+}
+
+int hashMovie( int argc, char** argv )
+{
+    if( argc < 5 )
+    {
+        printf( "Usage: %s hash <rom file> <movie file> <log file> [config]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    StateBisectConfig config = StateBisectConfig_Plain;
+    GBEmulatorInstance* pInstance = createInstance( argv[ 2 ] );
+    if( pInstance == nullptr || ( argc > 5 && !parseConfig( argv[ 5 ], &config ) ) )
+    {
+        return 1;
+    }
+
+    uint32_t frameCount = 0u;
+    const GBEmulatorJoypadState* pJoypadStates = loadMovie( pInstance, argv[ 3 ], &frameCount );
+    if( pJoypadStates == nullptr )
+    {
+        return 1;
+    }
+
+    StateBisectRun run;
+    createRun( &run, pInstance, config );
+
+    StateHashLogEntry* pEntries = ( StateHashLogEntry* )malloc( frameCount * sizeof( StateHashLogEntry ) );
+    double hashSeconds = 0.0;
+    const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+    for( uint32_t frameIndex = 0u; frameIndex < frameCount; ++frameIndex )
+    {
+        runFrame( &run, pJoypadStates[ frameIndex ] );
+
+        const std::chrono::high_resolution_clock::time_point hashStartTime = std::chrono::high_resolution_clock::now();
+        fillStateHashLogEntry( pEntries + frameIndex, pInstance, frameIndex, 0u, pInstance->cpuState.registers.PC );
+        hashSeconds += getElapsedSeconds( hashStartTime );
+    }
+    const double seconds = getElapsedSeconds( startTime );
+
+    printf( "hashed %u frames (%s): %.0f frames/s, %.2f us per state hash (%.1f%% of the frame time)\n", frameCount, stateBisectConfigNames[ config ],
+        frameCount / seconds, hashSeconds / frameCount * 1000000.0, hashSeconds / seconds * 100.0 );
+    return writeStateHashLog( argv[ 4 ], pEntries, frameCount, gbStateHashLogFrameLog ) ? 0 : 1;
+}
+
+int traceMovieFrame( int argc, char** argv )
+{
+    if( argc < 6 )
+    {
+        printf( "Usage: %s trace <rom file> <movie file> <frame> <log file> [config]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    StateBisectConfig config = StateBisectConfig_Plain;
+    GBEmulatorInstance* pInstance = createInstance( argv[ 2 ] );
+    if( pInstance == nullptr || ( argc > 6 && !parseConfig( argv[ 6 ], &config ) ) )
+    {
+        return 1;
+    }
+
+    uint32_t frameCount = 0u;
+    const GBEmulatorJoypadState* pJoypadStates = loadMovie( pInstance, argv[ 3 ], &frameCount );
+    const uint32_t traceFrameIndex = ( uint32_t )strtoul( argv[ 4 ], nullptr, 10 );
+    if( pJoypadStates == nullptr || traceFrameIndex >= frameCount )
+    {
+        printf( "Frame %u is not part of the movie\n", traceFrameIndex );
+        return 1;
+    }
+
+    StateBisectRun run;
+    createRun( &run, pInstance, config );
+    for( uint32_t frameIndex = 0u; frameIndex < traceFrameIndex; ++frameIndex )
+    {
+        runFrame( &run, pJoypadStates[ frameIndex ] );
+    }
+
+    //FK: Instructions take at least 4 cycles
+    StateHashLogEntry* pEntries = ( StateHashLogEntry* )malloc( ( gbCyclesPerFrame / 4u + 1u ) * sizeof( StateHashLogEntry ) );
+    beginRunFrame( &run, pJoypadStates[ traceFrameIndex ] );
+    pInstance->flags.value = 0;
+
+    uint32_t instructionCount = 0u;
+    uint32_t cycleCount = 0u;
+    while( cycleCount < gbCyclesPerFrame )
+    {
+        const uint16_t pc = pInstance->cpuState.registers.PC;
+        cycleCount += runSingleInstruction( pInstance );
+        fillStateHashLogEntry( pEntries + instructionCount, pInstance, traceFrameIndex, instructionCount, pc );
+        ++instructionCount;
+    }
+
+    printf( "traced %u instructions of frame %u (%s)\n", instructionCount, traceFrameIndex, stateBisectConfigNames[ config ] );
+    return writeStateHashLog( argv[ 5 ], pEntries, instructionCount, traceFrameIndex ) ? 0 : 1;
+}
+
+const StateHashLogEntry* loadStateHashLog( const char* pLogFilePath, StateHashLogHeader* pOutHeader )
+{
+    size_t logSizeInBytes = 0u;
+    const uint8_t* pLogMemory = readFile( pLogFilePath, &logSizeInBytes );
+    if( pLogMemory == nullptr || logSizeInBytes < sizeof( StateHashLogHeader ) )
+    {
+        printf( "Could not load log '%s'\n", pLogFilePath );
+        return nullptr;
+    }
+
+    memcpy( pOutHeader, pLogMemory, sizeof( StateHashLogHeader ) );
+    if( pOutHeader->fourCC != gbStateHashLogFourCC || pOutHeader->regionCount != K15_GB_STATE_HASH_REGION_COUNT ||
+        sizeof( StateHashLogHeader ) + pOutHeader->entryCount * sizeof( StateHashLogEntry ) > logSizeInBytes )
+    {
+        printf( "'%s' is not a state hash log of this version\n", pLogFilePath );
+        return nullptr;
+    }
+
+    return ( const StateHashLogEntry* )( pLogMemory + sizeof( StateHashLogHeader ) );
+}
+
+int compareLogs( int argc, char** argv )
+{
+    if( argc < 4 )
+    {
+        printf( "Usage: %s compare <log file> <other log file>\n", argv[ 0 ] );
+        return 1;
+    }
+
+    StateHashLogHeader header;
+    StateHashLogHeader otherHeader;
+    const StateHashLogEntry* pEntries = loadStateHashLog( argv[ 2 ], &header );
+    const StateHashLogEntry* pOtherEntries = loadStateHashLog( argv[ 3 ], &otherHeader );
+    if( pEntries == nullptr || pOtherEntries == nullptr )
+    {
+        return 1;
+    }
+
+    if( header.traceFrameIndex != otherHeader.traceFrameIndex )
+    {
+        printf( "The logs don't contain the same frames\n" );
+        return 1;
+    }
+
+    const uint32_t entryCount = header.entryCount < otherHeader.entryCount ? header.entryCount : otherHeader.entryCount;
+    for( uint32_t entryIndex = 0u; entryIndex < entryCount; ++entryIndex )
+    {
+        const StateHashLogEntry* pEntry = pEntries + entryIndex;
+        const StateHashLogEntry* pOtherEntry = pOtherEntries + entryIndex;
+        if( pEntry->stateHash.hash == pOtherEntry->stateHash.hash && pEntry->cycle == pOtherEntry->cycle )
+        {
+            continue;
+        }
+
+        if( header.traceFrameIndex == gbStateHashLogFrameLog )
+        {
+            printf( "first differing frame: %u (use 'trace' with this frame to find the instruction)\n", pEntry->frameIndex );
+        }
+        else
+        {
+            printf( "first differing instruction: %u of frame %u, PC 0x%04X (other log: PC 0x%04X)\n", pEntry->instructionIndex, pEntry->frameIndex, pEntry->pc, pOtherEntry->pc );
+        }
+
+        printf( "cycle: %llu (other log: %llu)\n", ( unsigned long long )pEntry->cycle, ( unsigned long long )pOtherEntry->cycle );
+        printStateHashRegions( &pEntry->stateHash, &pOtherEntry->stateHash );
+        return 2;
+    }
+
+    if( header.entryCount != otherHeader.entryCount )
+    {
+        printf( "logs match for the first %u entries, but one log is longer (%u vs %u entries)\n", entryCount, header.entryCount, otherHeader.entryCount );
+        return 2;
+    }
+
+    printf( "logs match (%u entries)\n", entryCount );
+    return 0;
+}
+
+bool8_t runsMatch( const StateBisectRun* pRun, const StateBisectRun* pOtherRun, GBStateHash* pOutStateHash, GBStateHash* pOutOtherStateHash )
+{
+    calculateGBEmulatorStateHash( pRun->pInstance, pOutStateHash );
+    calculateGBEmulatorStateHash( pOtherRun->pInstance, pOutOtherStateHash );
+    return pOutStateHash->hash == pOutOtherStateHash->hash;
+}
+
+void restoreCheckpoint( StateBisectRun* pRun, StateBisectRun* pOtherRun )
+{
+    restoreGBEmulator( pRun->pInstance, pRun->pCheckpoint );
+    restoreGBEmulator( pOtherRun->pInstance, pOtherRun->pCheckpoint );
+}
+
+int bisectConfigs( int argc, char** argv )
+{
+    if( argc < 6 )
+    {
+        printf( "Usage: %s bisect <rom file> <movie file> <config> <other config> [checkpoint interval]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    StateBisectConfig config = StateBisectConfig_Plain;
+    StateBisectConfig otherConfig = StateBisectConfig_Plain;
+    if( !parseConfig( argv[ 4 ], &config ) || !parseConfig( argv[ 5 ], &otherConfig ) )
+    {
+        return 1;
+    }
+
+    const uint32_t checkpointInterval = argc > 6 ? ( uint32_t )strtoul( argv[ 6 ], nullptr, 10 ) : gbStateBisectDefaultCheckpointInterval;
+    GBEmulatorInstance* pInstance = createInstance( argv[ 2 ] );
+    GBEmulatorInstance* pOtherInstance = createInstance( argv[ 2 ] );
+    if( pInstance == nullptr || pOtherInstance == nullptr || checkpointInterval == 0u )
+    {
+        return 1;
+    }
+
+    uint32_t frameCount = 0u;
+    uint32_t otherFrameCount = 0u;
+    const GBEmulatorJoypadState* pJoypadStates = loadMovie( pInstance, argv[ 3 ], &frameCount );
+    if( pJoypadStates == nullptr || loadMovie( pOtherInstance, argv[ 3 ], &otherFrameCount ) == nullptr )
+    {
+        return 1;
+    }
+
+    StateBisectRun run;
+    StateBisectRun otherRun;
+    createRun( &run, pInstance, config );
+    createRun( &otherRun, pOtherInstance, otherConfig );
+
+    //FK: Compare the state hashes at every checkpoint, the checkpoint is the last frame at which both runs still matched
+    GBStateHash stateHash;
+    GBStateHash otherStateHash;
+    uint32_t checkpointFrameIndex = 0u;
+    uint32_t frameIndex = 0u;
+    snapshotGBEmulator( pInstance, run.pCheckpoint );
+    snapshotGBEmulator( pOtherInstance, otherRun.pCheckpoint );
+
+    bool8_t runsDiffer = !runsMatch( &run, &otherRun, &stateHash, &otherStateHash );
+    while( !runsDiffer && frameIndex < frameCount )
+    {
+        runFrame( &run, pJoypadStates[ frameIndex ] );
+        runFrame( &otherRun, pJoypadStates[ frameIndex ] );
+        ++frameIndex;
+
+        if( frameIndex % checkpointInterval != 0u && frameIndex != frameCount )
+        {
+            continue;
+        }
+
+        runsDiffer = !runsMatch( &run, &otherRun, &stateHash, &otherStateHash );
+        if( !runsDiffer )
+        {
+            checkpointFrameIndex = frameIndex;
+            snapshotGBEmulator( pInstance, run.pCheckpoint );
+            snapshotGBEmulator( pOtherInstance, otherRun.pCheckpoint );
+        }
+    }
+
+    if( !runsDiffer )
+    {
+        printf( "'%s' and '%s' match for all %u frames\n", stateBisectConfigNames[ config ], stateBisectConfigNames[ otherConfig ], frameCount );
+        return 0;
+    }
+
+    if( frameIndex == 0u )
+    {
+        printf( "The start states differ\n" );
+        printStateHashRegions( &stateHash, &otherStateHash );
+        return 2;
+    }
+
+    //FK: Both runs match after lowFrameCount frames and differ after highFrameCount frames
+    uint32_t lowFrameCount = checkpointFrameIndex;
+    uint32_t highFrameCount = frameIndex;
+    while( highFrameCount - lowFrameCount > 1u )
+    {
+        const uint32_t middleFrameCount = lowFrameCount + ( highFrameCount - lowFrameCount ) / 2u;
+        restoreCheckpoint( &run, &otherRun );
+        for( frameIndex = checkpointFrameIndex; frameIndex < middleFrameCount; ++frameIndex )
+        {
+            runFrame( &run, pJoypadStates[ frameIndex ] );
+            runFrame( &otherRun, pJoypadStates[ frameIndex ] );
+        }
+
+        if( runsMatch( &run, &otherRun, &stateHash, &otherStateHash ) )
+        {
+            lowFrameCount = middleFrameCount;
+        }
+        else
+        {
+            highFrameCount = middleFrameCount;
+        }
+    }
+
+    const uint32_t differingFrameIndex = lowFrameCount;
+    printf( "first differing frame: %u\n", differingFrameIndex );
+
+    //FK: Step the differing frame one instruction at a time
+    restoreCheckpoint( &run, &otherRun );
+    for( frameIndex = checkpointFrameIndex; frameIndex < differingFrameIndex; ++frameIndex )
+    {
+        runFrame( &run, pJoypadStates[ frameIndex ] );
+        runFrame( &otherRun, pJoypadStates[ frameIndex ] );
+    }
+
+    beginRunFrame( &run, pJoypadStates[ differingFrameIndex ] );
+    beginRunFrame( &otherRun, pJoypadStates[ differingFrameIndex ] );
+    pInstance->flags.value = 0;
+    pOtherInstance->flags.value = 0;
+
+    uint32_t instructionIndex = 0u;
+    uint32_t cycleCount = 0u;
+    uint16_t pc = pInstance->cpuState.registers.PC;
+    bool8_t instructionFound = !runsMatch( &run, &otherRun, &stateHash, &otherStateHash );
+    if( instructionFound )
+    {
+        printf( "the states already differ before the first instruction of the frame ('%s' or '%s' changed the state)\n",
+            stateBisectConfigNames[ config ], stateBisectConfigNames[ otherConfig ] );
+    }
+
+    while( !instructionFound && cycleCount < gbCyclesPerFrame )
+    {
+        pc = pInstance->cpuState.registers.PC;
+        const uint8_t opcode = getMappedMemoryValue( &pInstance->memoryMapper, pc );
+        cycleCount += runSingleInstruction( pInstance );
+        runSingleInstruction( pOtherInstance );
+
+        instructionFound = !runsMatch( &run, &otherRun, &stateHash, &otherStateHash );
+        if( instructionFound )
+        {
+            printf( "first differing instruction: %u of the frame, opcode 0x%02X at PC 0x%04X (%u cycles into the frame)\n", instructionIndex, opcode, pc, cycleCount );
+        }
+
+        ++instructionIndex;
+    }
+
+    if( !instructionFound )
+    {
+        printf( "the frame didn't differ when stepping it one instruction at a time\n" );
+        return 2;
+    }
+
+    printStateHashRegions( &stateHash, &otherStateHash );
+    printf( "cpu ('%s' vs '%s'):\n", stateBisectConfigNames[ config ], stateBisectConfigNames[ otherConfig ] );
+    printCpuStateDiff( pInstance, pOtherInstance );
+    printf( "memory:\n" );
+    printMemoryDiff( pInstance, pOtherInstance );
+    return 2;
+}
+
+int main( int argc, char** argv )
+{
+    const char* pCommand = argc > 1 ? argv[ 1 ] : "";
+    if( strcmp( pCommand, "record" ) == 0 )
+    {
+        return recordMovie( argc, argv );
+    }
+    else if( strcmp( pCommand, "hash" ) == 0 )
+    {
+        return hashMovie( argc, argv );
+    }
+    else if( strcmp( pCommand, "trace" ) == 0 )
+    {
+        return traceMovieFrame( argc, argv );
+    }
+    else if( strcmp( pCommand, "compare" ) == 0 )
+    {
+        return compareLogs( argc, argv );
+    }
+    else if( strcmp( pCommand, "bisect" ) == 0 )
+    {
+        return bisectConfigs( argc, argv );
+    }
+
+    printf( "Usage: %s record|hash|trace|compare|bisect ... (see the top of k15_gb_state_bisect.cpp)\n", argv[ 0 ] );
+    return 1;
+}
@@ -125,6 +125,10 @@ constexpr uint32_t gbDownloadTestRoms		= 62u;
 constexpr uint32_t gbPaintTimerId			= 150u;
 
 constexpr uint8_t gbDefaultScale = 2u;
+constexpr size_t gbRewindBudgetInBytes = Mbyte( 16 );
+constexpr uint16_t gbRewindFramesPerSnapshot = 2u;
+constexpr uint16_t gbRewindSnapshotsPerKeyframe = 30u;
+constexpr uint8_t gbAutosaveStateSlot = 0u;
 
 const char* pSettingsFormatting = R"(
 stateSlot=%hhu
@@ -133,7 +137,8 @@ windowPosX=%d
 windowPosY=%d
 fullscreen=%hhu
 maximized=%hhu
-userMessage=%hhu)";
+userMessage=%hhu
+autosaveIntervalInSeconds=%hu)";
 
 const char* pSettingsPath = "k15_gb_emu_settings.ini";
 
@@ -160,6 +165,7 @@ struct Win32Settings
 	bool8_t showUserMessage;
 	int32_t	windowPosX;
 	int32_t	windowPosY;
+	uint16_t autosaveIntervalInSeconds;
 };
 
 #define K15_RETURN_ON_HRESULT_ERROR(comFunction) \
@@ -205,11 +211,29 @@ struct Win32UserMessage
 	uint32_t 		timeToLiveInMilliseconds;
 };
 
+struct Win32AsyncStateSave
+{
+	char				stateFileName[MAX_PATH]		= {};
+	GBEmulatorInstance*	pEmulatorInstance 			= nullptr;
+	uint8_t*			pRawStateMemory				= nullptr;
+	uint8_t*			pStateMemory				= nullptr;
+	size_t				stateMemorySizeInBytes		= 0u;
+	HANDLE				pSaveRequestEvent			= nullptr;
+	HANDLE				pThreadHandle				= nullptr;
+	volatile LONG		saveInProgress				= 0;	//FK: Set until the result of the save has been reported (see runEmulatorForHostFrame())
+	volatile LONG		saveRequested				= 0;
+	volatile LONG		shutdownRequested			= 0;
+	bool8_t				succeeded					= 0u;
+	bool8_t				autosave					= 0u;
+};
+
 struct Win32EmulatorContext
 {
 	char				romBaseFileName[MAX_PATH];
 
 	GBEmulatorInstance*	pEmulatorInstance = nullptr;
+	GBRewindBuffer*		pRewindBuffer = nullptr;
+	Win32AsyncStateSave	asyncStateSave;
 	
 	Win32FileMapping	romMapping;
 	Win32FileMapping	ramMapping;
@@ -220,7 +244,10 @@ struct Win32EmulatorContext
 	uint32_t			cyclesPerHostFrameRest		= 0;
 	Win32InputType 		dominantInputType 			= Gamepad;
 	uint8_t 			stateSlot 					= 1u;
+	uint32_t			framesSinceAutosave			= 0u;
+	uint16_t			autosaveIntervalInSeconds	= 0u; //FK: 0 = autosave disabled
 	uint8_t				cyclePerHostFrameFactor		= 1u;
+	bool8_t				rewinding					= 0u;
 };
 
 enum class RomSourceType : uint8_t
@@ -315,6 +342,7 @@ Win32Settings serializeSettings( Win32ApplicationContext* pContext )
 	settings.fullscreen 		= pContext->fullscreen;
 	settings.maximized			= pContext->windowMaximized;
 	settings.showUserMessage	= pContext->showUserMessage;
+	settings.autosaveIntervalInSeconds = pContext->emulatorContext.autosaveIntervalInSeconds;
 
 	return settings;
 }
@@ -332,7 +360,7 @@ bool8_t writeSettingsToFile( const Win32Settings* pSettings, const char* pPath )
 		pSettings->stateSlot, pSettings->scaleFactor, 
 		pSettings->windowPosX, pSettings->windowPosY, 
 		pSettings->fullscreen, pSettings->maximized,
-		pSettings->showUserMessage );
+		pSettings->showUserMessage, pSettings->autosaveIntervalInSeconds );
 
 	DWORD bytesWritten = 0u;
 	const BOOL writeResult = WriteFile( pFileHandle, settingsBuffer, charsWritten, &bytesWritten, nullptr );
@@ -359,11 +387,14 @@ bool8_t loadSettingsFromFile( Win32Settings* pOutSettings, const char* pPath )
 		return 0;
 	}
 
+	//FK: Settings files of older versions don't have all settings
+	pOutSettings->autosaveIntervalInSeconds = 0u;
+
 	sscanf_s( settingsBuffer, pSettingsFormatting, 
 		&pOutSettings->stateSlot, &pOutSettings->scaleFactor, 
 		&pOutSettings->windowPosX, &pOutSettings->windowPosY, 
 		&pOutSettings->fullscreen, &pOutSettings->maximized,
-		&pOutSettings->showUserMessage );
+		&pOutSettings->showUserMessage, &pOutSettings->autosaveIntervalInSeconds );
 
 	return 1;
 }
@@ -683,7 +714,7 @@ void loadStateInSlot( GBEmulatorInstance* pEmulatorInstance, const char* pStateF
 		return;
 	}
 
-	const GBStateLoadResult result = loadGBEmulatorState( pEmulatorInstance, stateFileMapping.pFileBaseAddress );
+	const GBStateLoadResult result = loadGBEmulatorState( pEmulatorInstance, stateFileMapping.pFileBaseAddress, stateFileMapping.fileSizeInBytes );
 	switch( result )
 	{
 		case K15_GB_STATE_LOAD_SUCCESS:
@@ -706,21 +737,139 @@ void loadStateInSlot( GBEmulatorInstance* pEmulatorInstance, const char* pStateF
 	unmapFileMapping( &stateFileMapping );
 }
 
-void saveStateInSlot( GBEmulatorInstance* pEmulatorInstance, const char* pStateFileName, uint8_t stateSlot, Win32UserMessage* pUserMessage )
+bool8_t writeFileContent( const char* pFileName, const uint8_t* pData, const size_t dataSizeInBytes )
 {
-	const size_t stateSizeInBytes = calculateGBEmulatorStateSizeInBytes( pEmulatorInstance );
+	const HANDLE pFileHandle = CreateFileA( pFileName, GENERIC_WRITE, 0u, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( pFileHandle == INVALID_HANDLE_VALUE )
+	{
+		const DWORD lastError = GetLastError();
+		printf("Could not open file handle to '%s'. CreateFileA() error = %lu\n", pFileName, lastError );
+		return 0;
+	}
 
-	Win32FileMapping stateFileMapping;
-	if( mapFileForWriting( &stateFileMapping, pStateFileName, stateSizeInBytes ) == 0 )
+	DWORD bytesWritten = 0u;
+	const BOOL writeResult = WriteFile( pFileHandle, pData, ( DWORD )dataSizeInBytes, &bytesWritten, nullptr );
+	
+	//FK: Make sure the content is on disk before the file gets renamed
+	const BOOL flushResult = FlushFileBuffers( pFileHandle );
+	CloseHandle( pFileHandle );
+
+	return writeResult && flushResult && bytesWritten == dataSizeInBytes;
+}
+
+//FK: Write to a temporary file first and rename afterwards, so that a crash while writing doesn't leave a broken file behind
+bool8_t writeFileContentAtomically( const char* pFileName, const uint8_t* pData, const size_t dataSizeInBytes )
+{
+	char tempFileName[MAX_PATH];
+	sprintf_s( tempFileName, sizeof( tempFileName ), "%s.tmp", pFileName );
+
+	if( !writeFileContent( tempFileName, pData, dataSizeInBytes ) )
 	{
-		setUserMessage( pUserMessage, "Can't open state" );
-		return;
+		DeleteFileA( tempFileName );
+		return 0;
 	}
 
-	storeGBEmulatorState( pEmulatorInstance, stateFileMapping.pFileBaseAddress, stateSizeInBytes );
-	unmapFileMapping( &stateFileMapping );
+	if( MoveFileExA( tempFileName, pFileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) == FALSE )
+	{
+		const DWORD lastError = GetLastError();
+		printf("Could not rename '%s' to '%s'. MoveFileExA() error = %lu\n", tempFileName, pFileName, lastError );
+		DeleteFileA( tempFileName );
+		return 0;
+	}
+
+	return 1;
+}
+
+DWORD WINAPI asyncStateSaveThreadProc( LPVOID pParameter )
+{
+	Win32AsyncStateSave* pAsyncStateSave = ( Win32AsyncStateSave* )pParameter;
+	while( WaitForSingleObject( pAsyncStateSave->pSaveRequestEvent, INFINITE ) == WAIT_OBJECT_0 )
+	{
+		//FK: A pending save still gets written when shutting down
+		if( InterlockedExchange( &pAsyncStateSave->saveRequested, 0 ) != 0 )
+		{
+			const size_t stateSizeInBytes = storeGBEmulatorStateFromRawState( pAsyncStateSave->pRawStateMemory, pAsyncStateSave->pStateMemory, pAsyncStateSave->stateMemorySizeInBytes );
+			pAsyncStateSave->succeeded = stateSizeInBytes > 0u && writeFileContentAtomically( pAsyncStateSave->stateFileName, pAsyncStateSave->pStateMemory, stateSizeInBytes );
+
+			//FK: Publishes succeeded to the emulator thread, saveInProgress is cleared by the emulator thread after the result has been reported
+			signalGBEmulatorStateSaved( pAsyncStateSave->pEmulatorInstance );
+		}
+
+		if( pAsyncStateSave->shutdownRequested != 0 )
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+bool8_t setupAsyncStateSave( Win32AsyncStateSave* pAsyncStateSave, GBEmulatorInstance* pEmulatorInstance )
+{
+	//FK: Allocate for the biggest possible state so that saving never has to allocate
+	const size_t rawStateSizeInBytes = calculateGBEmulatorMaxRawStateSizeInBytes();
+	const size_t stateSizeInBytes = calculateGBEmulatorMaxStateSizeInBytes();
+	
+	pAsyncStateSave->pRawStateMemory 		= ( uint8_t* )VirtualAlloc( nullptr, rawStateSizeInBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	pAsyncStateSave->pStateMemory 			= ( uint8_t* )VirtualAlloc( nullptr, stateSizeInBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	pAsyncStateSave->stateMemorySizeInBytes	= stateSizeInBytes;
+	pAsyncStateSave->pEmulatorInstance		= pEmulatorInstance;
+	if( pAsyncStateSave->pRawStateMemory == nullptr || pAsyncStateSave->pStateMemory == nullptr )
+	{
+		return 0;
+	}
+
+	pAsyncStateSave->pSaveRequestEvent = CreateEventA( nullptr, FALSE, FALSE, nullptr );
+	if( pAsyncStateSave->pSaveRequestEvent == nullptr )
+	{
+		return 0;
+	}
+
+	pAsyncStateSave->pThreadHandle = CreateThread( nullptr, 0u, asyncStateSaveThreadProc, pAsyncStateSave, 0u, nullptr );
+	return pAsyncStateSave->pThreadHandle != nullptr;
+}
+
+//FK: Waits for a save that is currently in progress to be written
+void shutdownAsyncStateSave( Win32AsyncStateSave* pAsyncStateSave )
+{
+	if( pAsyncStateSave->pThreadHandle != nullptr )
+	{
+		InterlockedExchange( &pAsyncStateSave->shutdownRequested, 1 );
+		SetEvent( pAsyncStateSave->pSaveRequestEvent );
+		WaitForSingleObject( pAsyncStateSave->pThreadHandle, INFINITE );
+		CloseHandle( pAsyncStateSave->pThreadHandle );
+		pAsyncStateSave->pThreadHandle = nullptr;
+	}
+
+	if( pAsyncStateSave->pSaveRequestEvent != nullptr )
+	{
+		CloseHandle( pAsyncStateSave->pSaveRequestEvent );
+		pAsyncStateSave->pSaveRequestEvent = nullptr;
+	}
 
-	setUserMessage( pUserMessage, "State saved!" );
+	VirtualFree( pAsyncStateSave->pRawStateMemory, 0u, MEM_RELEASE );
+	VirtualFree( pAsyncStateSave->pStateMemory, 0u, MEM_RELEASE );
+	pAsyncStateSave->pRawStateMemory	= nullptr;
+	pAsyncStateSave->pStateMemory		= nullptr;
+}
+
+//FK: Only takes a raw snapshot of the emulator state on the calling thread, 
+//	  compression and writing is done on the save thread. K15_GB_STATE_SAVED_EVENT_FLAG will be raised once the state is written.
+//	  Returns 0 while the result of the previous save hasn't been reported yet, so succeeded and autosave always belong to the reported save.
+bool8_t saveStateInSlot( Win32AsyncStateSave* pAsyncStateSave, const char* pStateFileName, const bool8_t autosave )
+{
+	if( InterlockedCompareExchange( &pAsyncStateSave->saveInProgress, 1, 0 ) != 0 )
+	{
+		return 0;
+	}
+
+	storeGBEmulatorRawState( pAsyncStateSave->pEmulatorInstance, pAsyncStateSave->pRawStateMemory );
+	strcpy_s( pAsyncStateSave->stateFileName, sizeof( pAsyncStateSave->stateFileName ), pStateFileName );
+	pAsyncStateSave->autosave = autosave;
+
+	InterlockedExchange( &pAsyncStateSave->saveRequested, 1 );
+	SetEvent( pAsyncStateSave->pSaveRequestEvent );
+	return 1;
 }
 
 void updateMonitorSettings( Win32ApplicationContext* pContext )
@@ -866,6 +1015,7 @@ bool8_t loadRomData( Win32ApplicationContext* pContext, const char* pRomName, ui
 	}
 
 	strcpy_s( pContext->emulatorContext.romBaseFileName, sizeof( pContext->emulatorContext.romBaseFileName ), pRomName );
+	resetGBRewindBuffer( pContext->emulatorContext.pRewindBuffer );
 	setUserMessage( &pContext->userMessage, "Rom loaded!");
 
 	enableRomMenuItems( pContext );
@@ -1451,7 +1601,36 @@ void saveEmulatorState( Win32ApplicationContext* pContext )
 
 	char stateFileName[MAX_PATH];
 	generateStateFileName( stateFileName, sizeof( stateFileName ), pEmulatorContext->stateSlot, pEmulatorContext->romBaseFileName );
-	saveStateInSlot( pEmulatorContext->pEmulatorInstance, stateFileName, pEmulatorContext->stateSlot, &pContext->userMessage );
+	if( !saveStateInSlot( &pEmulatorContext->asyncStateSave, stateFileName, 0u ) )
+	{
+		setUserMessage( &pContext->userMessage, "Save in progress" );
+	}
+}
+
+void autosaveEmulatorState( Win32EmulatorContext* pEmulatorContext )
+{
+	char stateFileName[MAX_PATH];
+	generateStateFileName( stateFileName, sizeof( stateFileName ), gbAutosaveStateSlot, pEmulatorContext->romBaseFileName );
+
+	//FK: Try again next frame if a save is currently in progress
+	if( saveStateInSlot( &pEmulatorContext->asyncStateSave, stateFileName, 1u ) )
+	{
+		pEmulatorContext->framesSinceAutosave = 0u;
+	}
+}
+
+void loadAutosaveEmulatorState( Win32ApplicationContext* pContext )
+{
+	Win32EmulatorContext* pEmulatorContext = &pContext->emulatorContext;
+	if( !isGBEmulatorRomMapped( pEmulatorContext->pEmulatorInstance ) )
+	{
+		setUserMessage( &pContext->userMessage, "Failed to map state file." );
+		return;
+	}
+
+	char stateFileName[MAX_PATH];
+	generateStateFileName( stateFileName, sizeof( stateFileName ), gbAutosaveStateSlot, pEmulatorContext->romBaseFileName );
+	loadStateInSlot( pEmulatorContext->pEmulatorInstance, stateFileName, gbAutosaveStateSlot, &pContext->userMessage );
 }
 
 void setEmulatorSpeedFactor( Win32ApplicationContext* pContext, uint8_t speedFactor )
@@ -1835,6 +2014,7 @@ LRESULT CALLBACK MainWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM l
 
 	case WM_KILLFOCUS:
 		pContext->hasFocus = 0;
+		pContext->emulatorContext.rewinding = 0;
 		break;
 
 	case WM_TIMER:
@@ -2375,6 +2555,20 @@ bool8_t setupEmulator( Win32EmulatorContext* pContext )
 	}
 
 	pContext->pEmulatorInstance = createGBEmulatorInstance( pEmulatorInstanceMemory );
+
+	const size_t rewindBufferMemorySizeInBytes = calculateGBRewindBufferMemoryRequirementsInBytes( gbRewindBudgetInBytes );
+	uint8_t* pRewindBufferMemory = (uint8_t*)VirtualAlloc( nullptr, rewindBufferMemorySizeInBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	if( pRewindBufferMemory == nullptr )
+	{
+		return 0;
+	}
+
+	pContext->pRewindBuffer = createGBRewindBuffer( pRewindBufferMemory, gbRewindBudgetInBytes, gbRewindFramesPerSnapshot, gbRewindSnapshotsPerKeyframe );
+
+	if( !setupAsyncStateSave( &pContext->asyncStateSave, pContext->pEmulatorInstance ) )
+	{
+		return 0;
+	}
 	setDefaultKeyboardBinding( pContext->digipadKeyboardMappings, pContext->actionButtonKeyboardMappings );
 
 	return 1;
@@ -2426,6 +2620,7 @@ void queryWin32SystemKeys( Win32ApplicationContext* pContext )
 		uint8_t slot3_state 			: 1;
 		uint8_t quicksave_state 		: 1;
 		uint8_t quickload_state 		: 1;
+		uint8_t autosaveload_state 		: 1;
 		uint8_t toggle_fullscreen_state : 1;
 		uint8_t exit_fullscreen_state 	: 1;
 	};
@@ -2440,9 +2635,13 @@ void queryWin32SystemKeys( Win32ApplicationContext* pContext )
 	currentKeyStates.slot3_state  				= ( GetAsyncKeyState( VK_F4  	) & 0x8000 ) > 0;
 	currentKeyStates.quicksave_state  			= ( GetAsyncKeyState( VK_F6  	) & 0x8000 ) > 0;
 	currentKeyStates.quickload_state  			= ( GetAsyncKeyState( VK_F9  	) & 0x8000 ) > 0;
+	currentKeyStates.autosaveload_state 		= ( GetAsyncKeyState( VK_F8  	) & 0x8000 ) > 0;
 	currentKeyStates.toggle_fullscreen_state 	= ( GetAsyncKeyState( VK_F11 	) & 0x8000 ) > 0;
 	currentKeyStates.exit_fullscreen_state 		= ( GetAsyncKeyState( VK_ESCAPE ) & 0x8000 ) > 0;
 
+	//FK: Rewind while backspace is held
+	pEmulatorContext->rewinding = ( GetAsyncKeyState( VK_BACK ) & 0x8000 ) > 0;
+
 	if( currentKeyStates.slot1_state != prevKeyStates.slot1_state &&
 		currentKeyStates.slot1_state )
 	{
@@ -2474,6 +2673,13 @@ void queryWin32SystemKeys( Win32ApplicationContext* pContext )
 	{
 		loadEmulatorState( pContext );
 	}
+
+	//FK: Load autosave
+	if( currentKeyStates.autosaveload_state != prevKeyStates.autosaveload_state &&
+		currentKeyStates.autosaveload_state )
+	{
+		loadAutosaveEmulatorState( pContext );
+	}
 	
 	//FK: Fullscreen
 	if( currentKeyStates.toggle_fullscreen_state != prevKeyStates.toggle_fullscreen_state &&
@@ -2508,6 +2714,7 @@ void applySettings( const Win32Settings* pSettings, Win32ApplicationContext* pCo
 {
 	changeStateSlot( pContext, pSettings->stateSlot );
 
+	pContext->emulatorContext.autosaveIntervalInSeconds = pSettings->autosaveIntervalInSeconds;
 	pContext->menuFrameBufferScale = pSettings->scaleFactor;
 	pContext->windowPosX = pSettings->windowPosX;
 	pContext->windowPosY = pSettings->windowPosY;
@@ -2569,6 +2776,50 @@ void updateUserMessage( Win32UserMessage* pUserMessage, const uint32_t deltaTime
 	pUserMessage->timeToLiveInMilliseconds -= deltaTimeInMicroSeconds;
 }
 
+GBEmulatorInstanceEventMask runEmulatorForHostFrame( Win32ApplicationContext* pContext, const uint32_t cycleCountForThisHostFrame )
+{
+	Win32EmulatorContext* pEmulatorContext = &pContext->emulatorContext;
+
+	const bool8_t romMapped = isGBEmulatorRomMapped( pEmulatorContext->pEmulatorInstance );
+	if( pEmulatorContext->rewinding && romMapped )
+	{
+		rewindGBEmulator( pEmulatorContext->pRewindBuffer, pEmulatorContext->pEmulatorInstance );
+	}
+
+	const GBEmulatorInstanceEventMask emulatorEventMask = runGBEmulatorForCycles( pEmulatorContext->pEmulatorInstance, cycleCountForThisHostFrame );
+
+	//FK: Report the finished save before a new one (eg: the autosave below) can be started
+	if( emulatorEventMask & K15_GB_STATE_SAVED_EVENT_FLAG )
+	{
+		Win32AsyncStateSave* pAsyncStateSave = &pEmulatorContext->asyncStateSave;
+		if( !pAsyncStateSave->succeeded )
+		{
+			setUserMessage( &pContext->userMessage, "Can't save state" );
+		}
+		else if( !pAsyncStateSave->autosave )
+		{
+			setUserMessage( &pContext->userMessage, "State saved!" );
+		}
+
+		InterlockedExchange( &pAsyncStateSave->saveInProgress, 0 );
+	}
+
+	//FK: Don't record snapshots while rewinding, otherwise the rewind buffer would refill itself
+	if( ( emulatorEventMask & K15_GB_VBLANK_EVENT_FLAG ) && !pEmulatorContext->rewinding && romMapped )
+	{
+		updateGBRewindBuffer( pEmulatorContext->pRewindBuffer, pEmulatorContext->pEmulatorInstance );
+
+		++pEmulatorContext->framesSinceAutosave;
+		const uint32_t autosaveIntervalInFrames = pEmulatorContext->autosaveIntervalInSeconds * gbEmulatorFrameRate;
+		if( autosaveIntervalInFrames > 0u && pEmulatorContext->framesSinceAutosave >= autosaveIntervalInFrames )
+		{
+			autosaveEmulatorState( pEmulatorContext );
+		}
+	}
+
+	return emulatorEventMask;
+}
+
 void runVsyncMainLoop( Win32ApplicationContext* pContext )
 {
 	bool8_t loopRunning = true;
@@ -2614,7 +2865,7 @@ void runVsyncMainLoop( Win32ApplicationContext* pContext )
 		//FK: TODO: Consider `rest cycles` if refresh rate is not evenly divisible. 
 		const uint32_t cyclesPerFrame = gbCyclesPerSecond / pContext->monitorRefreshRate;
 		const uint32_t cycleCountForThisHostFrame = cyclesPerFrame * pEmulatorContext->cyclePerHostFrameFactor;
-		const GBEmulatorInstanceEventMask emulatorEventMask = runGBEmulatorForCycles( pEmulatorContext->pEmulatorInstance, cycleCountForThisHostFrame );
+		const GBEmulatorInstanceEventMask emulatorEventMask = runEmulatorForHostFrame( pContext, cycleCountForThisHostFrame );
 		if( emulatorEventMask & K15_GB_VBLANK_EVENT_FLAG )
 		{
 			const uint8_t* pGameBoyNativeFrameBuffer = getGBEmulatorFrameBuffer( pEmulatorContext->pEmulatorInstance );
@@ -2688,7 +2939,7 @@ void runNonVsyncMainLoop( Win32ApplicationContext* pContext )
 		}
 
 		const uint32_t cycleCountForThisHostFrame = gbCyclesPerFrame * pEmulatorContext->cyclePerHostFrameFactor;
-		const GBEmulatorInstanceEventMask emulatorEventMask = runGBEmulatorForCycles( pEmulatorContext->pEmulatorInstance, cycleCountForThisHostFrame );
+		const GBEmulatorInstanceEventMask emulatorEventMask = runEmulatorForHostFrame( pContext, cycleCountForThisHostFrame );
 
 		//FK: Since we're running with locked 60hz in non-vsync the vblank flag should *always* be set.
 		if( emulatorEventMask & K15_GB_VBLANK_EVENT_FLAG )
@@ -2785,6 +3036,7 @@ int CALLBACK WinMain(HINSTANCE hInstance,
 		runNonVsyncMainLoop( &appContext );
 	}
 
+	shutdownAsyncStateSave( &appContext.emulatorContext.asyncStateSave );
 	return 0;
 }
 